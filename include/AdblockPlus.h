@@ -29,5 +29,6 @@
 
 #pragma once
 
+#include <AdblockPlus/FrameContext.h>
 #include <AdblockPlus/PlatformFactory.h>
 #include <AdblockPlus/ReferrerMapping.h>
@@ -76,6 +76,12 @@ namespace AdblockPlus
      */
     struct CreationParameters
     {
+      CreationParameters()
+          : matchCacheSize(0), nativeMatcherEnabled(false), warmStartImageEnabled(false),
+            replicaCount(0)
+      {
+      }
+
       /**
        * `AdblockPlus::FilterEngineFactory::Prefs` name - value list of preconfigured
        * prefs.
@@ -97,6 +103,56 @@ namespace AdblockPlus
        * on the current connection.
        */
       IsConnectionAllowedAsyncCallback isSubscriptionDownloadAllowedCallback;
+
+      /**
+       * Maximal number of results of `AdblockPlus::IFilterEngine::Matches` to
+       * keep in memory, so repeated requests do not have to be matched again.
+       * The cache is emptied on every change of filters or subscriptions.
+       * With `nativeMatcherEnabled` it also bounds the results of
+       * `MatchesBatch` and `MatchesAsync` which repeated requests get
+       * without locking the JavaScript engine.
+       * Default: 0, what disables the cache.
+       * @see AdblockPlus::IFilterEngine::GetMatchCacheStats
+       */
+      size_t matchCacheSize;
+
+      /**
+       * Keeps a native index of the active URL filters, which finds out
+       * without calling into JavaScript that a request doesn't match any
+       * filter. Requests which might match are still matched in JavaScript,
+       * so the results are the same. The index is an immutable snapshot of
+       * the filters, so requests which don't match are answered from any
+       * thread without waiting for the JavaScript engine. Also keeps the
+       * domains of the element hiding filters, so that element hiding for
+       * other domains is computed in JavaScript only once. Default: false.
+       */
+      bool nativeMatcherEnabled;
+
+      /**
+       * Saves the data the native index and the element hiding domains are
+       * built from in the file `patterns.image` once the filters are loaded.
+       * On the next start with the same `patterns.ini` they are restored
+       * from that file rather than retrieved from JavaScript. JavaScript
+       * still parses `patterns.ini` as before, the image only saves
+       * building the native data. Only used together with
+       * `nativeMatcherEnabled`. Default: false.
+       */
+      bool warmStartImageEnabled;
+
+      /**
+       * Number of additional JavaScript engines, each with its own isolate,
+       * which are kept in sync with the filters of the filter engine and
+       * answer `Matches`, `MatchesBatch`, `IsContentAllowlisted`,
+       * `ShouldBlockRequest`, `GetElementHidingStyleSheet` and
+       * `GetElementHidingEmulationSelectors`, so that these calls can run on
+       * several threads in parallel. The replicas neither download nor store
+       * anything, all other calls are handled by the filter engine itself.
+       * Every replica is a complete copy of the filters, so each one takes
+       * about as much memory as the filter engine.
+       * Only used by `AdblockPlus::Platform::CreateFilterEngineAsync`.
+       * Default: 0, what disables the replicas.
+       */
+      size_t replicaCount;
     };
 
     /**
@@ -0,0 +1,96 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <AdblockPlus/Filter.h>
+#include <AdblockPlus/IFilterEngine.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Describes the frame in which requests are made or elements are hidden.
+   * All requests of a frame share the same chain of documents, so the
+   * answers to whether the frame is allowlisted (e.g. CONTENT_TYPE_DOCUMENT,
+   * CONTENT_TYPE_ELEMHIDE, CONTENT_TYPE_GENERICHIDE and
+   * CONTENT_TYPE_GENERICBLOCK) are the same for them. A `FrameContext`
+   * remembers these answers, so create it once per frame and pass it to the
+   * IFilterEngine methods accepting it. The remembered answers are discarded
+   * automatically when filters or subscriptions change.
+   * A `FrameContext` can be used from several threads but should be used
+   * with one IFilterEngine only.
+   */
+  class FrameContext
+  {
+  public:
+    /**
+     * Constructor.
+     * @param documentUrls Chain of documents URLs, starting with the frame's
+     *        document, ending with the top-level frame's document. Can be
+     *        empty for requests which are not made from any document.
+     * @param siteKey Optional: public key provided by the frame's document.
+     */
+    explicit FrameContext(const std::vector<std::string>& documentUrls,
+                          const std::string& siteKey = "");
+
+    FrameContext(const FrameContext&) = delete;
+    FrameContext& operator=(const FrameContext&) = delete;
+
+    /**
+     * @return Chain of document URLs passed to the constructor.
+     */
+    const std::vector<std::string>& GetDocumentUrls() const;
+
+    /**
+     * @return URL of the frame's document, or an empty string if there is
+     *         none.
+     */
+    std::string GetDocumentUrl() const;
+
+    /**
+     * @return Public key passed to the constructor.
+     */
+    const std::string& GetSiteKey() const;
+
+  private:
+    friend class DefaultFilterEngine;
+
+    struct AllowlistingResult
+    {
+      IFilterEngine::ContentTypeMask contentTypeMask;
+      uint64_t generation;
+      Filter filter;
+    };
+
+    bool FindAllowlistingFilter(IFilterEngine::ContentTypeMask contentTypeMask,
+                                uint64_t generation,
+                                Filter* filter) const;
+    void StoreAllowlistingFilter(IFilterEngine::ContentTypeMask contentTypeMask,
+                                 uint64_t generation,
+                                 const Filter& filter) const;
+
+    const std::vector<std::string> documentUrls;
+    const std::string siteKey;
+    mutable std::mutex mutex;
+    mutable std::vector<AllowlistingResult> allowlistingResults;
+  };
+}
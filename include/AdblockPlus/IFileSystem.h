@@ -85,6 +85,92 @@ namespace AdblockPlus
                       const ReadCallback& doneCallback,
                       const Callback& errorCallback) const = 0;
 
+    /**
+     * Content of a file which stays valid and unchanged as long as the
+     * instance is alive, e.g. a memory mapping of the file.
+     */
+    class IFileContent
+    {
+    public:
+      virtual ~IFileContent() = default;
+      virtual const uint8_t* data() const = 0;
+      virtual size_t size() const = 0;
+    };
+
+    /**
+     * `IFileContent` holding an `IOBuffer`.
+     */
+    class BufferFileContent : public IFileContent
+    {
+    public:
+      explicit BufferFileContent(IOBuffer&& buffer) : buffer(std::move(buffer))
+      {
+      }
+
+      const uint8_t* data() const override
+      {
+        return buffer.data();
+      }
+
+      size_t size() const override
+      {
+        return buffer.size();
+      }
+
+    private:
+      IOBuffer buffer;
+    };
+
+    typedef std::shared_ptr<const IFileContent> FileContentPtr;
+
+    /**
+     * Callback type for the asynchronous ReadContent call.
+     * @param File content.
+     */
+    typedef std::function<void(const FileContentPtr&)> ReadContentCallback;
+
+    /**
+     * Reads from a file like `Read`, but allows implementations to avoid
+     * copying the content, e.g. by mapping the file into memory. The content
+     * may be referenced by JavaScript strings until they are garbage
+     * collected. The default implementation calls `Read`.
+     * @param fileName File name.
+     * @param doneCallback The function called on completion with the content.
+     *   If this function throws then the implementation should call
+     *   `errorCallback`.
+     * @param errorCallback The function called if an error occured.
+     */
+    virtual void ReadContent(const std::string& fileName,
+                             const ReadContentCallback& doneCallback,
+                             const Callback& errorCallback) const;
+
+    /**
+     * Callback type for the asynchronous ReadChunks call.
+     * @param chunk Next part of the file content, empty once the end of the
+     *   file is reached.
+     * @param next Requests the following chunk, nothing more is read until
+     *   it is called. Call it at most once, it does nothing after the end of
+     *   the file.
+     */
+    typedef std::function<void(IOBuffer&& chunk, const std::function<void()>& next)>
+        ReadChunkCallback;
+
+    /**
+     * Reads from a file in chunks, so that the content can be processed
+     * before the whole file is read and without holding all of it in memory.
+     * The default implementation calls `Read` and passes the whole content
+     * as a single chunk.
+     * @param fileName File name.
+     * @param chunkSize Maximum size of a chunk, must not be zero.
+     * @param chunkCallback The function called with each chunk. If this
+     *   function throws then the implementation should call `errorCallback`.
+     * @param errorCallback The function called if an error occured.
+     */
+    virtual void ReadChunks(const std::string& fileName,
+                            size_t chunkSize,
+                            const ReadChunkCallback& chunkCallback,
+                            const Callback& errorCallback) const;
+
     /**
      * Writes to a file.
      * @param fileName File name.
@@ -94,6 +180,17 @@ namespace AdblockPlus
     virtual void
     Write(const std::string& fileName, const IOBuffer& data, const Callback& callback) = 0;
 
+    /**
+     * Appends to an existing file, implementations should write only the
+     * new data. The default implementation calls `Read` and `Write` with
+     * the whole content.
+     * @param fileName File name.
+     * @param data The data to append.
+     * @param callback The function called on completion.
+     */
+    virtual void
+    Append(const std::string& fileName, const IOBuffer& data, const Callback& callback);
+
     /**
      * Moves a file (i.e. renames it).
      * @param fromFileName Current file name.
@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <string>
@@ -29,6 +32,8 @@
 
 namespace AdblockPlus
 {
+  class FrameContext;
+
   /**
    * Main component of libadblockplus.
    * It handles:
@@ -128,6 +133,59 @@ namespace AdblockPlus
       std::string text;
     };
 
+    /**
+     * Used in the argument of MatchesBatch, see Matches for the meaning of the
+     * fields.
+     */
+    struct MatchRequest
+    {
+      std::string url;
+      ContentTypeMask contentTypeMask;
+      std::string documentUrl;
+      std::string siteKey;
+      bool specificOnly;
+    };
+
+    /**
+     * Used in the return type of MatchesBatch. If there was no match then
+     * `filterText` is empty and `type` is `Filter::Type::TYPE_INVALID`.
+     */
+    struct MatchResult
+    {
+      std::string filterText;
+      Filter::Type type;
+    };
+
+    /**
+     * Callback type invoked by MatchesAsync.
+     */
+    typedef std::function<void(const MatchResult&)> MatchCallback;
+
+    /**
+     * Used in the return type of ShouldBlockRequest.
+     */
+    struct BlockingDecision
+    {
+      bool shouldBlock;
+      Filter filter;
+    };
+
+    /**
+     * Counters of the match cache, see
+     * FilterEngineFactory::CreationParameters::matchCacheSize.
+     */
+    struct MatchCacheStats
+    {
+      /// Number of Matches calls answered from the cache.
+      uint64_t hits;
+      /// Number of Matches calls which had to consult the filters.
+      uint64_t misses;
+      /// Number of currently stored results.
+      size_t size;
+      /// Maximal number of stored results, 0 if the cache is disabled.
+      size_t capacity;
+    };
+
     virtual ~IFilterEngine() = default;
 
     /**
@@ -214,6 +272,59 @@ namespace AdblockPlus
                            const std::string& siteKey = "",
                            bool specificOnly = false) const = 0;
 
+    /**
+     * Checks if any active filter matches the supplied URL requested from
+     * the supplied frame. Generic filters are skipped if the frame is
+     * allowlisted with CONTENT_TYPE_GENERICBLOCK.
+     * @param url URL to match.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param frame Frame requesting the resource.
+     * @return Matching filter, or an invalid filter if there was no match.
+     */
+    virtual Filter Matches(const std::string& url,
+                           ContentTypeMask contentTypeMask,
+                           const FrameContext& frame) const = 0;
+
+    /**
+     * Checks a batch of requests against the active filters at once, what
+     * is cheaper than a call of Matches per request when there are many of
+     * them, e.g. for all subresources of a page.
+     * @param requests Requests to match, see Matches for the meaning of the
+     *        fields.
+     * @return Compact match results in the same order as `requests`.
+     */
+    virtual std::vector<MatchResult>
+    MatchesBatch(const std::vector<MatchRequest>& requests) const = 0;
+
+    /**
+     * Does the same as Matches without blocking the calling thread while
+     * JavaScript is busy, e.g. parsing a downloaded subscription. Requests
+     * are matched in batches on a dedicated thread, identical requests
+     * waiting at the same time are matched only once.
+     * @param request Request to match, see Matches for the meaning of the
+     *        fields.
+     * @param callback Invoked exactly once with the result, either on the
+     *        matching thread, on the calling thread before MatchesAsync
+     *        returns if the result is known without JavaScript, or with
+     *        `fallback` once `timeout` has elapsed or the engine is being
+     *        destroyed.
+     * @param timeout Time after which `fallback` is passed to `callback`.
+     * @param fallback Result to use when the request couldn't be matched in
+     *        time. Defaults to no match.
+     */
+    virtual void MatchesAsync(const MatchRequest& request,
+                              const MatchCallback& callback,
+                              std::chrono::milliseconds timeout = std::chrono::milliseconds::max(),
+                              const MatchResult& fallback = {"",
+                                                             Filter::Type::TYPE_INVALID}) const = 0;
+
+    /**
+     * Retrieves the counters of the match cache, which can be used to find
+     * an appropriate cache size.
+     * @return Counters accumulated since the creation of the engine.
+     */
+    virtual MatchCacheStats GetMatchCacheStats() const = 0;
+
     /**
      * Checks whether the resource at the supplied URL is allowlisted.
      * @param url URL of the resource.
@@ -229,6 +340,53 @@ namespace AdblockPlus
                                       const std::vector<std::string>& documentUrls,
                                       const std::string& sitekey = "") const = 0;
 
+    /**
+     * Checks whether the supplied frame is allowlisted for the supplied
+     * content type, e.g. CONTENT_TYPE_DOCUMENT or CONTENT_TYPE_ELEMHIDE. The
+     * answer is remembered in `frame`.
+     * @param contentTypeMask Content type mask to check.
+     * @param frame Frame to check.
+     * @return `true` if the frame is allowlisted.
+     */
+    virtual bool IsContentAllowlisted(ContentTypeMask contentTypeMask,
+                                      const FrameContext& frame) const = 0;
+
+    /**
+     * Decides whether the request to the supplied URL should be blocked.
+     * It does the same as the following sequence of calls but crosses into
+     * JavaScript only once:
+     * - IsContentAllowlisted with CONTENT_TYPE_GENERICBLOCK to find out whether
+     *   only specific filters apply,
+     * - Matches with the immediate parent frame as `documentUrl`,
+     * - IsContentAllowlisted with CONTENT_TYPE_DOCUMENT if a blocking filter
+     *   matched.
+     * @param url URL of the requested resource.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param documentUrls Chain of URLs requesting the resource,
+     *        starting with the resource's parent frame, ending with
+     *        the top-level frame.
+     * @param siteKey Optional: public key provided by the document.
+     * @return The decision along with the filter which made it: the matching
+     *         blocking or allowing filter, the filter allowlisting the
+     *         document, or an invalid filter if no filter applies.
+     */
+    virtual BlockingDecision ShouldBlockRequest(const std::string& url,
+                                                ContentTypeMask contentTypeMask,
+                                                const std::vector<std::string>& documentUrls,
+                                                const std::string& siteKey = "") const = 0;
+
+    /**
+     * Same as the ShouldBlockRequest above, but allowlisting of the frame
+     * is looked up only once per `frame`.
+     * @param url URL of the requested resource.
+     * @param contentTypeMask Content type mask of the requested resource.
+     * @param frame Frame requesting the resource.
+     * @return See the ShouldBlockRequest above.
+     */
+    virtual BlockingDecision ShouldBlockRequest(const std::string& url,
+                                                ContentTypeMask contentTypeMask,
+                                                const FrameContext& frame) const = 0;
+
     /**
      * Retrieves CSS style sheet for all element hiding filters active on the
      * supplied domain.
@@ -240,6 +398,15 @@ namespace AdblockPlus
     virtual std::string GetElementHidingStyleSheet(const std::string& url,
                                                    bool specificOnly = false) const = 0;
 
+    /**
+     * Retrieves CSS style sheet for the document of the supplied frame.
+     * Takes into account whether the frame is allowlisted with
+     * CONTENT_TYPE_ELEMHIDE or CONTENT_TYPE_GENERICHIDE.
+     * @param frame Frame to retrieve the style sheet for.
+     * @return CSS style sheet, empty if nothing should be hidden.
+     */
+    virtual std::string GetElementHidingStyleSheet(const FrameContext& frame) const = 0;
+
     /**
      * Retrieves CSS selectors for all element hiding emulation filters active on the
      * supplied domain.
@@ -251,6 +418,16 @@ namespace AdblockPlus
     virtual std::vector<EmulationSelector>
     GetElementHidingEmulationSelectors(const std::string& url) const = 0;
 
+    /**
+     * Retrieves CSS selectors of element hiding emulation filters for the
+     * document of the supplied frame. Takes into account whether the frame
+     * is allowlisted with CONTENT_TYPE_ELEMHIDE.
+     * @param frame Frame to retrieve the selectors for.
+     * @return List of CSS selectors along with the text property.
+     */
+    virtual std::vector<EmulationSelector>
+    GetElementHidingEmulationSelectors(const FrameContext& frame) const = 0;
+
     /**
      * Adds the observer to be notified on various events applying to filters and subscriptions.
      *
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <chrono>
+
 #include <AdblockPlus/IExecutor.h>
 #include <AdblockPlus/Platform.h>
 
@@ -32,6 +34,11 @@ namespace AdblockPlus
      */
     struct CreationParameters
     {
+      CreationParameters()
+          : useJsEventLoop(false), jsTimeSlice(50), jsLineChunkSize(1000), useJsCodeCache(false)
+      {
+      }
+
       LogSystemPtr logSystem;
       TimerPtr timer;
       WebRequestPtr webRequest;
@@ -46,6 +53,34 @@ namespace AdblockPlus
        * subsystems is not provided.
        */
       std::unique_ptr<IExecutor> executor;
+      /**
+       * Optional, if `true` JavaScript triggered by timers, file system, web
+       * request and resource reader callbacks as well as filter engine calls
+       * are executed on a single thread owned by `JsEngine`. Filter engine
+       * calls are executed before pending callbacks, which reduces their
+       * latency while e.g. subscriptions are being updated.
+       */
+      bool useJsEventLoop;
+      /**
+       * How long long-running JavaScript jobs, like parsing a filter list
+       * read from a file or serializing filters for saving, may run before
+       * letting other tasks, e.g. filter engine calls, execute. Zero
+       * disables slicing.
+       */
+      std::chrono::milliseconds jsTimeSlice;
+      /**
+       * How many lines of a file, e.g. of a filter list, are passed to
+       * JavaScript per call when it's loaded. Bigger chunks mean fewer calls
+       * between C++ and JavaScript.
+       */
+      size_t jsLineChunkSize;
+      /**
+       * Optional, if `true` the code V8 compiles for the scripts of the
+       * library is stored via the file system and reused by later runs,
+       * which makes creating the filter engine faster. The cache files are
+       * named after the scripts, with a `.v8cache` extension.
+       */
+      bool useJsCodeCache;
     };
 
     /**
@@ -56,5 +91,15 @@ namespace AdblockPlus
     CreatePlatform(CreationParameters&& parameters = CreationParameters());
 
     static std::unique_ptr<IExecutor> CreateExecutor();
+
+    /**
+     * Creates an executor which runs tasks on a fixed number of worker
+     * threads instead of a new thread per task.
+     * @param threadCount number of worker threads.
+     * @param queueCapacity number of tasks waiting for a worker before the
+     *                      queue grows. Dispatching never blocks.
+     */
+    static std::unique_ptr<IExecutor> CreateExecutor(size_t threadCount,
+                                                     size_t queueCapacity = 256);
   };
 }
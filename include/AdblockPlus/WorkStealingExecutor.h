@@ -0,0 +1,131 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <AdblockPlus/IExecutor.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Executor running tasks on a fixed number of worker threads, which can be
+   * passed as `PlatformFactory::CreationParameters::executor`.
+   * Every worker has its own deque. Tasks dispatched from within a task go
+   * to the deque of the same worker, which runs the newest task first, so
+   * that related work stays on the same core. Tasks dispatched by other
+   * threads go to a shared queue. Idle workers steal the oldest tasks from
+   * the deques of busy workers.
+   */
+  class WorkStealingExecutor : public IExecutor
+  {
+  public:
+    /**
+     * Counters for tuning the number of workers and the split of work into
+     * tasks, see `GetStatistics()`.
+     */
+    struct Statistics
+    {
+      /**
+       * Number of tasks dispatched and not started yet.
+       */
+      size_t queueDepth;
+
+      /**
+       * Number of tasks in the deque of each worker.
+       */
+      std::vector<size_t> workerQueueDepths;
+
+      /**
+       * Number of tasks dispatched by workers to their own deques.
+       */
+      uint64_t localTasks;
+
+      /**
+       * Number of tasks dispatched to the shared queue.
+       */
+      uint64_t sharedTasks;
+
+      /**
+       * Number of tasks taken from the deque of another worker.
+       */
+      uint64_t steals;
+    };
+
+    /**
+     * Constructor, the worker threads are started after finishing this call.
+     * @param threadCount Number of worker threads, at least one is started.
+     */
+    explicit WorkStealingExecutor(size_t threadCount);
+
+    /**
+     * Destructor, same as `Stop()`.
+     */
+    ~WorkStealingExecutor();
+
+    /**
+     * Schedules `call` to be run by one of the workers.
+     * @param call is a function object which is called within a worker
+     *        thread. There is no effect if `call` is empty or if `Stop` had
+     *        been already called.
+     */
+    void Dispatch(const std::function<void()>& call) override;
+
+    /**
+     * Waits until all already dispatched tasks are finished and stops the
+     * worker threads, any subsequent calls of `Dispatch` have no effect.
+     * Must not be called from a dispatched task.
+     */
+    void Stop() override;
+
+    /**
+     * @return Current values of the counters, they may be inconsistent with
+     *         each other while tasks are dispatched.
+     */
+    Statistics GetStatistics() const;
+
+  private:
+    typedef std::function<void()> Task;
+    class Worker;
+
+    void ThreadFunc(Worker& worker);
+    // Returns the worker running on the calling thread, if any.
+    Worker* CurrentWorker() const;
+    Task* FindTask(Worker& worker);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    mutable std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<Task*> sharedQueue;
+    std::atomic<bool> isRunning;
+    std::atomic<size_t> pendingCount;
+    std::atomic<size_t> sleepingCount;
+    std::atomic<uint64_t> localTasks;
+    std::atomic<uint64_t> sharedTasks;
+    std::atomic<uint64_t> steals;
+  };
+}
@@ -19,7 +19,7 @@
 
 let API = (() =>
 {
-  const {Filter} = require("filterClasses");
+  const {Filter, BlockingFilter, URLFilter} = require("filterClasses");
   const {Subscription} = require("subscriptionClasses");
   const {SpecialSubscription, DownloadableSubscription} = require("subscriptionClasses");
   const {filterStorage} = require("filterStorage");
@@ -35,20 +35,38 @@ let API = (() =>
   const {registerSubscription} = require("init");
   const {snippets, compileScript} = require("snippets");
 
+  // Keep in sync with IFilterEngine::ContentType.
+  const CONTENT_TYPE_DOCUMENT = 1 << 27;
+  const CONTENT_TYPE_GENERICBLOCK = 1 << 28;
+
+  // Parse the minimum URL once to get a URLInfo instance to copy from.
+  const urlInfoTemplate = parseURL("http://a.com/");
+
+  const elemHideClassNames = new Set(["ElemHideFilter", "ElemHideException",
+                                      "ElemHideEmulationFilter"]);
+
+  function createURLInfo(href, protocol, hostname)
+  {
+    let urlInfo = Object.assign(
+      Object.create(Object.getPrototypeOf(urlInfoTemplate)), urlInfoTemplate
+    );
+
+    // Note: There is currently no way to update the URLInfo object other
+    // than to set the private properties directly.
+    urlInfo._href = href;
+    urlInfo._protocol = protocol;
+    urlInfo._hostname = hostname;
+    return urlInfo;
+  }
+
   function getURLInfo(url)
   {
-    // Parse the minimum URL to get a URLInfo instance.
-    let urlInfo = parseURL("http://a.com/");
+    let urlInfo;
 
     try
     {
       let uri = new URI(url);
-
-      // Note: There is currently no way to update the URLInfo object other
-      // than to set the private properties directly.
-      urlInfo._href = url;
-      urlInfo._protocol = uri.scheme + ":";
-      urlInfo._hostname = uri.asciiHost;
+      urlInfo = createURLInfo(url, uri.scheme + ":", uri.asciiHost);
     }
     catch (error)
     {
@@ -58,6 +76,25 @@ let API = (() =>
     return urlInfo;
   }
 
+  function matchURLInfo(urlInfo, contentTypeMask, documentHost, siteKey,
+                        specificOnly)
+  {
+    // Number cast to 32-bit integer then back to Number
+    // before passing to the API
+    // @see https://stackoverflow.com/a/11385688
+    //
+    // During the typecast (upcast) in JsEngine#newValue(int)
+    // int -> int64_t (signed long)
+    // sign bit is transfered to the new value
+    // hence the value becomes negative
+    // (0x80000000 -> -0x80000000 = 0x80000000 -> 0xffffffff80000000)
+    // we have to convert it to unsigned before passing futher
+    contentTypeMask = contentTypeMask >>> 0;
+
+    return defaultMatcher.match(urlInfo, contentTypeMask, documentHost,
+                                siteKey, specificOnly);
+  }
+
   return {
     getFilterFromText(text)
     {
@@ -200,21 +237,237 @@ let API = (() =>
         return null;
 
       let documentHost = extractHostFromURL(documentUrl);
+      return matchURLInfo(urlInfo, contentTypeMask, documentHost, siteKey,
+                          specificOnly);
+    },
+
+    // Same as checkFilterMatch but for URLs which have been parsed already,
+    // protocol and hostname are the same as URI.scheme + ":" and
+    // URI.asciiHost, documentHost is the same as extractHostFromURL().
+    checkParsedFilterMatch(url, protocol, hostname, contentTypeMask,
+                           documentHost, siteKey, specificOnly)
+    {
+      return matchURLInfo(createURLInfo(url, protocol, hostname),
+                          contentTypeMask, documentHost, siteKey, specificOnly);
+    },
+
+    checkFilterMatches(requests)
+    {
+      // Every request takes seven consecutive elements, the same as the
+      // arguments of checkParsedFilterMatch. If protocol is null then the URL
+      // is parsed here. Every result takes two: filter text and filter class
+      // name, both empty if there is no match.
+      let results = [];
+      for (let i = 0; i + 6 < requests.length; i += 7)
+      {
+        let filter = null;
+        if (requests[i])
+        {
+          let urlInfo;
+          if (requests[i + 1] === null)
+            urlInfo = getURLInfo(requests[i]);
+          else
+            urlInfo = createURLInfo(requests[i], requests[i + 1], requests[i + 2]);
+          if (urlInfo)
+          {
+            filter = matchURLInfo(urlInfo, requests[i + 3], requests[i + 4],
+                                  requests[i + 5], requests[i + 6]);
+          }
+        }
+        if (filter)
+          results.push(filter.text, filter.constructor.name);
+        else
+          results.push("", "");
+      }
+      return results;
+    },
+
+    getAllowlistingFilter(contentTypeMask, documentUrls, siteKey)
+    {
+      // WebExt finds allow filters by iterating through parent frames.
+      // https://gitlab.com/eyeo/adblockplus/adblockpluschrome/-/blob/6a345b830841052c09cfce6faf77eb8e682d7b7a/lib/allowlisting.js#L84
+      for (let i = 0; i < documentUrls.length; i++)
+      {
+        // At the top of the frame hierarchy the frame itself is passed as
+        // parent, this is consistent with WebExt ("|| frame.url.hostname"):
+        // https://gitlab.com/eyeo/adblockplus/adblockpluschrome/-/blob/6a345b830841052c09cfce6faf77eb8e682d7b7a/lib/allowlisting.js#L53
+        let parentUrl = documentUrls[i + 1] || documentUrls[i];
+        let filter = API.checkFilterMatch(documentUrls[i], contentTypeMask,
+                                          parentUrl, siteKey, false);
+        if (filter)
+          return filter;
+      }
+      return null;
+    },
+
+    shouldBlockRequest(url, contentTypeMask, documentUrls, siteKey)
+    {
+      let specificOnly = !!API.getAllowlistingFilter(CONTENT_TYPE_GENERICBLOCK,
+                                                     documentUrls, siteKey);
+      let filter = API.checkFilterMatch(url, contentTypeMask,
+                                        documentUrls[0] || "", siteKey,
+                                        specificOnly);
+      if (filter instanceof BlockingFilter)
+      {
+        let documentFilter = API.getAllowlistingFilter(CONTENT_TYPE_DOCUMENT,
+                                                       documentUrls, siteKey);
+        if (documentFilter)
+          return documentFilter;
+      }
+      return filter;
+    },
+
+    getURLFilterData(texts)
+    {
+      // Every URL filter of the enabled subscriptions takes seven consecutive
+      // elements: text, pattern (the regular expression source for regular
+      // expression filters, null if unknown), whether the pattern is a
+      // regular expression, contentType, matchCase, whether the filter is
+      // restricted to sitekeys and the number of domains, followed by the
+      // given number of pairs of domain name and whether the filter is active
+      // on that domain.
+      // If the texts of some filters are given only these filters are
+      // returned, unless they are not URL filters or not in any enabled
+      // subscription.
+      let data = [];
+      let seen = new Set();
+      let filterTexts = function*()
+      {
+        if (texts)
+        {
+          for (let text of texts)
+          {
+            for (let subscription of filterStorage.subscriptions(text))
+            {
+              if (!subscription.disabled)
+              {
+                yield text;
+                break;
+              }
+            }
+          }
+          return;
+        }
 
-      // Number cast to 32-bit integer then back to Number
-      // before passing to the API
-      // @see https://stackoverflow.com/a/11385688
-      //
-      // During the typecast (upcast) in JsEngine#newValue(int)
-      // int -> int64_t (signed long)
-      // sign bit is transfered to the new value
-      // hence the value becomes negative
-      // (0x80000000 -> -0x80000000 = 0x80000000 -> 0xffffffff80000000)
-      // we have to convert it to unsigned before passing futher
-      contentTypeMask = contentTypeMask >>> 0;
-
-      return defaultMatcher.match(urlInfo, contentTypeMask, documentHost,
-                                  siteKey, specificOnly);
+        for (let subscription of filterStorage.subscriptions())
+        {
+          if (!subscription.disabled)
+            yield* subscription.filterText();
+        }
+      };
+
+      for (let text of filterTexts())
+      {
+        if (seen.has(text))
+          continue;
+        seen.add(text);
+
+        let filter = Filter.fromText(text);
+        if (!(filter instanceof URLFilter))
+          continue;
+
+        let pattern = null;
+        let isRegExp = false;
+        if (typeof filter.pattern == "string")
+        {
+          pattern = filter.pattern;
+          if (pattern.length >= 2 && pattern[0] == "/" &&
+              pattern[pattern.length - 1] == "/")
+          {
+            pattern = pattern.substring(1, pattern.length - 1);
+            isRegExp = true;
+          }
+        }
+        else if (filter.regexp)
+        {
+          pattern = filter.regexp.source;
+          isRegExp = true;
+        }
+
+        let domains = filter.domains ? [...filter.domains] : [];
+        data.push(text, pattern, isRegExp, filter.contentType,
+                  !!filter.matchCase,
+                  !!(filter.sitekeys && filter.sitekeys.length),
+                  domains.length);
+        for (let [domain, isIncluded] of domains)
+          data.push(domain, !!isIncluded);
+      }
+      return data;
+    },
+
+    getElementHidingDomains()
+    {
+      // Domains which element hiding filters, exceptions or emulation
+      // filters of the enabled subscriptions are restricted to or excluded
+      // from. Element hiding is the same for all other domains.
+      let domains = new Set();
+      for (let subscription of filterStorage.subscriptions())
+      {
+        if (subscription.disabled)
+          continue;
+
+        for (let text of subscription.filterText())
+        {
+          let filter = Filter.fromText(text);
+          if (!elemHideClassNames.has(filter.constructor.name) ||
+              !filter.domains)
+            continue;
+
+          for (let domain of filter.domains.keys())
+          {
+            if (domain)
+              domains.add(domain);
+          }
+        }
+      }
+      return [...domains];
+    },
+
+    getFilterState()
+    {
+      // Every subscription takes three consecutive elements: URL, whether it
+      // is disabled and the number of its filters, followed by the text of
+      // each filter.
+      let data = [];
+      for (let subscription of filterStorage.subscriptions())
+      {
+        let filterText = [...subscription.filterText()];
+        data.push(subscription.url, subscription.disabled, filterText.length);
+        for (let text of filterText)
+          data.push(text);
+      }
+      return data;
+    },
+
+    setFilterState(data)
+    {
+      // Takes the output of getFilterState() of another engine. Subscriptions
+      // whose filters didn't change are kept, so that the matcher doesn't
+      // have to index them again.
+      let urls = new Set();
+      for (let i = 0; i + 2 < data.length;)
+      {
+        let url = data[i];
+        let disabled = data[i + 1];
+        let filterText = data.slice(i + 3, i + 3 + data[i + 2]);
+        i += 3 + filterText.length;
+        urls.add(url);
+
+        let subscription = Subscription.fromURL(url);
+        if (!filterStorage.hasSubscription(subscription))
+          filterStorage.addSubscription(subscription);
+        let currentFilterText = [...subscription.filterText()];
+        if (currentFilterText.length != filterText.length ||
+            currentFilterText.some((text, index) => text != filterText[index]))
+          filterStorage.updateSubscriptionFilters(subscription, filterText);
+        if (subscription.disabled != disabled)
+          subscription.disabled = disabled;
+      }
+      for (let subscription of [...filterStorage.subscriptions()])
+      {
+        if (!urls.has(subscription.url))
+          filterStorage.removeSubscription(subscription);
+      }
     },
 
     getElementHidingStyleSheet(url, specificOnly)
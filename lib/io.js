@@ -17,19 +17,37 @@
 
 "use strict";
 
-function readFileAsync(fileName)
+function writeFileAsync(fileName, content)
 {
   return new Promise((resolve, reject) =>
   {
-    _fileSystem.read(fileName, resolve, reject);
+    _fileSystem.write(fileName, content, (error) =>
+    {
+      if (error)
+        return reject(error);
+      resolve();
+    });
   });
 }
 
-function writeFileAsync(fileName, content)
+function writeLinesAsync(fileName, lines)
 {
   return new Promise((resolve, reject) =>
   {
-    _fileSystem.write(fileName, content, (error) =>
+    _fileSystem.writeLines(fileName, lines, (error) =>
+    {
+      if (error)
+        return reject(error);
+      resolve();
+    });
+  });
+}
+
+function compactLinesAsync(fileName)
+{
+  return new Promise((resolve, reject) =>
+  {
+    _fileSystem.compactLines(fileName, (error) =>
     {
       if (error)
         return reject(error);
@@ -38,33 +56,174 @@ function writeFileAsync(fileName, content)
   });
 }
 
+// Operations on a file wait for the previous ones, e.g. so that a file isn't
+// read while its journal is being merged into it.
+let fileOperations = new Map();
+
+function queueFileOperation(fileName, operation)
+{
+  let previous = fileOperations.get(fileName) || Promise.resolve();
+  let result = previous.then(operation);
+  let done = result.catch(() => {});
+  fileOperations.set(fileName, done);
+  done.then(() =>
+  {
+    if (fileOperations.get(fileName) == done)
+      fileOperations.delete(fileName);
+  });
+  return result;
+}
+
+// Changes written by writeToFile() may be appended to a journal next to the
+// file. Once there were no further changes for a while, the journal is
+// merged into the file.
+const compactionDelay = 5 * 60 * 1000;
+let writeCounts = new Map();
+
+function scheduleCompaction(fileName)
+{
+  let writeCount = (writeCounts.get(fileName) || 0) + 1;
+  writeCounts.set(fileName, writeCount);
+  setTimeout(() =>
+  {
+    if (writeCounts.get(fileName) != writeCount)
+      return;
+    writeCounts.delete(fileName);
+    queueFileOperation(fileName, () => compactLinesAsync(fileName)).catch(() => {});
+  }, compactionDelay);
+}
+
+// Changes to the data which filterStorage.saveToDisk() passes to
+// writeToFile(). Lines collected over several time slices may mix data from
+// before and after such a change, so they are discarded and saved again.
+const dataChangeEvents = [
+  "load",
+  "filter.added",
+  "filter.disabled",
+  "filter.hitCount",
+  "filter.lastHit",
+  "filter.moved",
+  "filter.removed",
+  "subscription.added",
+  "subscription.disabled",
+  "subscription.downloadStatus",
+  "subscription.errors",
+  "subscription.fixedTitle",
+  "subscription.homepage",
+  "subscription.lastCheck",
+  "subscription.lastDownload",
+  "subscription.removed",
+  "subscription.title",
+  "subscription.updated"
+];
+let dataChangeCount = 0;
+let watchingDataChanges = false;
+// Files whose lines were discarded, the next lines for them are collected
+// at once, so that frequent changes can't keep them from being saved.
+let discardedFiles = new Set();
+
+function watchDataChanges()
+{
+  let module = require("filterNotifier");
+  if (watchingDataChanges || !module)
+    return;
+  watchingDataChanges = true;
+  for (let event of dataChangeEvents)
+    module.filterNotifier.on(event, () => dataChangeCount++);
+}
+
 exports.IO =
 {
   lineBreak: "\n",
 
   readFromFile(fileName, listener)
   {
+    return queueFileOperation(fileName, () => new Promise((resolve, reject) =>
+    {
+      _fileSystem.readLinesFromFile(fileName, lines =>
+      {
+        for (let line of lines)
+          listener(line);
+      }, resolve, reject);
+    }));
+  },
+
+  writeToFile(fileName, generator)
+  {
+    // Serializing e.g. all filters takes a while, so yield to other tasks
+    // every time slice instead of blocking them until the end.
+    watchDataChanges();
+    let timeSlice = discardedFiles.delete(fileName) ? 0 : _fileSystem.getTimeSlice();
+    let initialDataChangeCount = dataChangeCount;
+    let sliced = false;
+    let iterator = generator[Symbol.iterator]();
+    let lines = [];
     return new Promise((resolve, reject) =>
     {
-      _fileSystem.readFromFile(fileName, listener, resolve, reject);
+      let processSlice = () =>
+      {
+        let deadline = Date.now() + timeSlice;
+        try
+        {
+          for (let count = 1; ; count++)
+          {
+            let {value, done} = iterator.next();
+            if (done)
+              break;
+            lines.push(value);
+            if (timeSlice > 0 && count % 100 == 0 && Date.now() >= deadline)
+            {
+              sliced = true;
+              setTimeout(processSlice, 0);
+              return;
+            }
+          }
+        }
+        catch (error)
+        {
+          reject(error);
+          return;
+        }
+        if (sliced && dataChangeCount != initialDataChangeCount)
+        {
+          // A save requested while this one is running follows it.
+          discardedFiles.add(fileName);
+          require("filterStorage").filterStorage.saveToDisk();
+          resolve();
+          return;
+        }
+        // Stored in a binary format, which readFromFile() recognizes.
+        queueFileOperation(fileName, () => writeLinesAsync(fileName, lines)).then(() =>
+        {
+          resolve();
+          scheduleCompaction(fileName);
+        }, reject);
+      };
+      processSlice();
     });
   },
 
-  writeToFile(fileName, generator)
+  exportToText(fileName, textFileName)
   {
-    let content = Array.from(generator).join(this.lineBreak) + this.lineBreak;
-    return writeFileAsync(fileName, content);
+    // Files written by writeToFile() are binary, for debugging this writes
+    // the same lines as text, e.g. patterns.ini in the INI format.
+    let lines = [];
+    return this.readFromFile(fileName, line => lines.push(line)).then(
+      () => writeFileAsync(textFileName, lines.join(this.lineBreak) + this.lineBreak));
   },
 
   copyFile(fromFileName, toFileName)
   {
-    return readFileAsync(fromFileName).then(
-      content => writeFileAsync(toFileName, content));
+    // Files written by writeToFile() are binary and may have a journal next
+    // to them, so the lines are copied instead of the content.
+    let lines = [];
+    return this.readFromFile(fromFileName, line => lines.push(line)).then(
+      () => queueFileOperation(toFileName, () => writeLinesAsync(toFileName, lines)));
   },
 
   renameFile(fromFileName, newNameFile)
   {
-    return new Promise((resolve, reject) =>
+    return queueFileOperation(fromFileName, () => new Promise((resolve, reject) =>
     {
       _fileSystem.move(fromFileName, newNameFile, (error) =>
       {
@@ -72,12 +231,12 @@ exports.IO =
           return reject(error);
         resolve();
       });
-    });
+    }));
   },
 
   removeFile(fileName)
   {
-    return new Promise((resolve, reject) =>
+    return queueFileOperation(fileName, () => new Promise((resolve, reject) =>
     {
       _fileSystem.remove(fileName, (error) =>
       {
@@ -85,7 +244,7 @@ exports.IO =
           return reject(error);
         resolve();
       });
-    });
+    }));
   },
 
   statFile(fileName, callback)
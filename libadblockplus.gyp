@@ -57,6 +57,25 @@
       '<@(library_files)',
       '<@(load_after_files)',
     ],
+    # Set to 1 to create the JavaScript context from a V8 startup snapshot,
+    # created on the build machine by abpsnapshot. Scripts using the host
+    # objects while being evaluated (file system, timers, preferences,
+    # app info) must not be part of it.
+    'use_js_snapshot%': 0,
+    'snapshot_files': [
+      'compat.js',
+      'io.js',
+      'utils.js',
+      'elemHideHitRegistration.js',
+      'perf_hooks.js',
+      'publicSuffixList.json',
+      'subscriptions.json',
+      'resources.json',
+      'jsbn.js',
+      'rusha.js',
+      'rsa.js',
+      'punycode.js',
+    ],
   },
   'targets': [{
     'target_name': 'libadblockplus',
@@ -70,6 +89,7 @@
       'include/AdblockPlus/AppInfo.h',
       'include/AdblockPlus/Filter.h',
       'include/AdblockPlus/FilterEngineFactory.h',
+      'include/AdblockPlus/FrameContext.h',
       'include/AdblockPlus/IElement.h',
       'include/AdblockPlus/IExecutor.h',
       'include/AdblockPlus/IFileSystem.h',
@@ -85,12 +105,20 @@
       'include/AdblockPlus/PlatformFactory.h',
       'include/AdblockPlus/ReferrerMapping.h',
       'include/AdblockPlus/Subscription.h',
+      'include/AdblockPlus/WorkStealingExecutor.h',
       'src/ActiveObject.cpp',
       'src/ActiveObject.h',
       'src/AsyncExecutor.cpp',
       'src/AsyncExecutor.h',
+      'src/ChaseLevDeque.h',
+      'src/AsyncMatcher.cpp',
+      'src/AsyncMatcher.h',
+      'src/ApiFunctions.cpp',
+      'src/ApiFunctions.h',
       'src/AppInfoJsObject.cpp',
       'src/AppInfoJsObject.h',
+      'src/AsciiScanner.cpp',
+      'src/AsciiScanner.h',
       'src/ConsoleJsObject.cpp',
       'src/ConsoleJsObject.h',
       'src/DefaultFileSystem.cpp',
@@ -111,14 +139,21 @@
       'src/DefaultTimer.h',
       'src/DefaultWebRequest.cpp',
       'src/DefaultWebRequest.h',
+      'src/DomainTrie.h',
       'src/FileSystemJsObject.cpp',
       'src/FileSystemJsObject.h',
       'src/Filter.cpp',
       'src/FilterEngineFactory.cpp',
+      'src/FilterStorageFile.cpp',
+      'src/FilterStorageFile.h',
+      'src/FilterStorageJournal.cpp',
+      'src/FilterStorageJournal.h',
+      'src/FrameContext.cpp',
       'src/GlobalJsObject.cpp',
       'src/GlobalJsObject.h',
       'src/ElementUtils.cpp',
       'src/ElementUtils.h',
+      'src/IFileSystem.cpp',
       'src/IFilterEngine.cpp',
       'src/JsContext.cpp',
       'src/JsContext.h',
@@ -126,19 +161,38 @@
       'src/JsEngine.h',
       'src/JsError.cpp',
       'src/JsError.h',
+      'src/JsEventLoop.cpp',
+      'src/JsEventLoop.h',
+      'src/JsSnapshot.cpp',
+      'src/JsSnapshot.h',
       'src/JsValue.cpp',
+      'src/MatchCache.cpp',
+      'src/MatchCache.h',
+      'src/NativeMatcher.cpp',
+      'src/NativeMatcher.h',
       'src/PlatformFactory.cpp',
       'src/ReferrerMapping.cpp',
+      'src/ReplicatedFilterEngine.cpp',
+      'src/ReplicatedFilterEngine.h',
       'src/ResourceReaderJsObject.cpp',
       'src/ResourceReaderJsObject.h',
+      'src/ScriptCodeCache.cpp',
+      'src/ScriptCodeCache.h',
       'src/Subscription.cpp',
       'src/SynchronizedCollection.h',
       'src/Thread.cpp',
       'src/Thread.h',
+      'src/ThreadPoolExecutor.cpp',
+      'src/ThreadPoolExecutor.h',
+      'src/UrlParser.cpp',
+      'src/UrlParser.h',
       'src/Utils.cpp',
       'src/Utils.h',
+      'src/WarmStartImage.cpp',
+      'src/WarmStartImage.h',
       'src/WebRequestJsObject.cpp',
       'src/WebRequestJsObject.h',
+      'src/WorkStealingExecutor.cpp',
       '<(INTERMEDIATE_DIR)/adblockplus.js.cpp'
     ],
     'defines': [
@@ -178,6 +232,25 @@
     'conditions': [
       ['OS=="android"', {
         'standalone_static_library': 1, # disable thin archives
+      }],
+      ['use_js_snapshot==1', {
+        'dependencies': ['abpsnapshot'],
+        'defines': ['ABP_JS_SNAPSHOT'],
+        'sources': ['<(INTERMEDIATE_DIR)/adblockplus.snapshot.cpp'],
+        'actions': [{
+          'action_name': 'create_js_snapshot',
+          'inputs': [
+            '<(PRODUCT_DIR)/abpsnapshot<(EXECUTABLE_SUFFIX)',
+          ],
+          'outputs': [
+            '<(INTERMEDIATE_DIR)/adblockplus.snapshot.cpp'
+          ],
+          'action': [
+            '<(PRODUCT_DIR)/abpsnapshot<(EXECUTABLE_SUFFIX)',
+            '<@(_outputs)',
+            '<@(snapshot_files)',
+          ]
+        }]
       }]
     ],
     'actions': [{
@@ -200,5 +273,51 @@
         '--after', '<@(load_after_files)',
       ]
     }]
+  }, {
+    'target_name': 'abpsnapshot',
+    'type': 'executable',
+    'include_dirs': [
+      '<(libv8_include_dir)'
+    ],
+    'sources': [
+      'snapshot/src/Main.cpp',
+      'src/JsSnapshot.cpp',
+      'src/JsSnapshot.h',
+      '<(INTERMEDIATE_DIR)/adblockplus.js.cpp'
+    ],
+    'link_settings': {
+      'libraries': [
+        '<@(libv8_libs)'
+      ],
+      'library_dirs': [
+        '<(libv8_lib_dir)'
+      ]
+    },
+    'msvs_settings': {
+      'VCLinkerTool': {
+        'SubSystem': '1',   # Console
+        'AdditionalLibraryDirectories': ['<(libv8_lib_dir)'],
+      }
+    },
+    'actions': [{
+      'action_name': 'convert_js',
+      'inputs': [
+        'convert_js.py',
+        '<@(library_files)',
+        '<@(load_before_files)',
+        '<@(load_after_files)',
+      ],
+      'outputs': [
+        '<(INTERMEDIATE_DIR)/adblockplus.js.cpp'
+      ],
+      'action': [
+        'python3',
+        'convert_js.py',
+        '<@(_outputs)',
+        '--before', '<@(load_before_files)',
+        '--convert', '<@(library_files)',
+        '--after', '<@(load_after_files)',
+      ]
+    }]
   }]
 }
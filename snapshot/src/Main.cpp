@@ -0,0 +1,122 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <libplatform/libplatform.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <v8.h>
+#include <vector>
+
+#include "../../src/JsSnapshot.h"
+
+// Generated by convert_js.py, file names and sources alternating.
+extern std::string jsSources[];
+
+namespace
+{
+  const std::string* FindSource(const std::string& fileName)
+  {
+    for (int i = 0; !jsSources[i].empty(); i += 2)
+    {
+      if (jsSources[i] == fileName)
+        return &jsSources[i + 1];
+    }
+    return nullptr;
+  }
+
+  void WriteSnapshot(std::ostream& out,
+                     const std::string& snapshot,
+                     const std::vector<std::string>& fileNames)
+  {
+    out << "#include <string>\n";
+    out << "extern const unsigned char jsSnapshotData[] = {";
+    for (size_t i = 0; i < snapshot.size(); ++i)
+    {
+      if (i % 32 == 0)
+        out << "\n";
+      out << static_cast<unsigned>(static_cast<unsigned char>(snapshot[i])) << ",";
+    }
+    out << "};\n";
+    out << "extern const size_t jsSnapshotSize = " << snapshot.size() << ";\n";
+    out << "std::string jsSnapshotFiles[] = {";
+    for (const auto& fileName : fileNames)
+      out << "std::string(\"" << fileName << "\"), ";
+    out << "std::string()};\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <output.cpp> <script>..." << std::endl;
+    return 1;
+  }
+
+  // The flags have to match the ones JsEngine runs with, V8 rejects the
+  // snapshot otherwise.
+  std::string flags = "--use_strict";
+  v8::V8::SetFlagsFromString(flags.c_str(), flags.length());
+  std::unique_ptr<v8::Platform> platform = v8::platform::NewDefaultPlatform();
+  v8::V8::InitializePlatform(platform.get());
+  v8::V8::Initialize();
+
+  int result = 0;
+  try
+  {
+    std::vector<std::pair<std::string, std::string>> scripts;
+    std::vector<std::string> fileNames;
+    // Scripts are evaluated in the order of jsSources rather than the order
+    // of the arguments, that is the order the engine evaluates them in.
+    for (int i = 0; !jsSources[i].empty(); i += 2)
+    {
+      for (int arg = 2; arg < argc; ++arg)
+      {
+        if (jsSources[i] == argv[arg])
+        {
+          scripts.emplace_back(jsSources[i], jsSources[i + 1]);
+          fileNames.push_back(jsSources[i]);
+          break;
+        }
+      }
+    }
+    for (int arg = 2; arg < argc; ++arg)
+    {
+      if (!FindSource(argv[arg]))
+        throw std::runtime_error(std::string("Unknown script ") + argv[arg]);
+    }
+
+    std::string snapshot = AdblockPlus::JsSnapshot::Create(scripts);
+    std::ofstream out(argv[1], std::ios_base::out | std::ios_base::trunc);
+    WriteSnapshot(out, snapshot, fileNames);
+    if (!out)
+      throw std::runtime_error(std::string("Failed to write ") + argv[1]);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    result = 1;
+  }
+
+  v8::V8::Dispose();
+  v8::V8::ShutdownPlatform();
+  return result;
+}
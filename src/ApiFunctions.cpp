@@ -0,0 +1,150 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ApiFunctions.h"
+
+#include <cassert>
+
+#include "JsContext.h"
+
+using namespace AdblockPlus;
+
+ApiFunctions::ApiFunctions(JsEngine& jsEngine)
+    : jsEngine(jsEngine), functions(static_cast<size_t>(Function::FUNCTION_COUNT))
+{
+}
+
+void ApiFunctions::Resolve()
+{
+  const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+  JsValue api = jsEngine.Evaluate("API");
+  for (size_t i = 0; i < functions.size(); ++i)
+    Get(static_cast<Function>(i), api);
+}
+
+JsValue ApiFunctions::Call(Function function, const JsValueList& params) const
+{
+  std::unique_ptr<JsValue> result;
+  jsEngine.RunInteractive([this, function, &params, &result] {
+    result.reset(new JsValue(Get(function).Call(params)));
+  });
+  return std::move(*result);
+}
+
+JsValue ApiFunctions::Call(Function function, const JsValue& arg) const
+{
+  std::unique_ptr<JsValue> result;
+  jsEngine.RunInteractive([this, function, &arg, &result] {
+    result.reset(new JsValue(Get(function).Call(arg)));
+  });
+  return std::move(*result);
+}
+
+const JsValue& ApiFunctions::Get(Function function) const
+{
+  const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+  const auto& slot = functions[static_cast<size_t>(function)];
+  if (slot)
+    return *slot;
+  return Get(function, jsEngine.Evaluate("API"));
+}
+
+const JsValue& ApiFunctions::Get(Function function, const JsValue& api) const
+{
+  auto& slot = functions[static_cast<size_t>(function)];
+  if (!slot)
+    slot.reset(new JsValue(api.GetProperty(FunctionToString(function))));
+  return *slot;
+}
+
+// static
+std::string ApiFunctions::FunctionToString(Function function)
+{
+  switch (function)
+  {
+  case Function::GET_FILTER_FROM_TEXT:
+    return "getFilterFromText";
+  case Function::ADD_FILTER_TO_LIST:
+    return "addFilterToList";
+  case Function::REMOVE_FILTER_FROM_LIST:
+    return "removeFilterFromList";
+  case Function::GET_LISTED_FILTERS:
+    return "getListedFilters";
+  case Function::GET_SUBSCRIPTION_FROM_URL:
+    return "getSubscriptionFromUrl";
+  case Function::GET_SUBSCRIPTIONS_FROM_FILTER:
+    return "getSubscriptionsFromFilter";
+  case Function::ADD_SUBSCRIPTION_TO_LIST:
+    return "addSubscriptionToList";
+  case Function::REMOVE_SUBSCRIPTION_FROM_LIST:
+    return "removeSubscriptionFromList";
+  case Function::UPDATE_SUBSCRIPTION:
+    return "updateSubscription";
+  case Function::IS_SUBSCRIPTION_UPDATING:
+    return "isSubscriptionUpdating";
+  case Function::GET_LISTED_SUBSCRIPTIONS:
+    return "getListedSubscriptions";
+  case Function::GET_RECOMMENDED_SUBSCRIPTIONS:
+    return "getRecommendedSubscriptions";
+  case Function::IS_AA_SUBSCRIPTION:
+    return "isAASubscription";
+  case Function::SET_AA_SUBSCRIPTION_ENABLED:
+    return "setAASubscriptionEnabled";
+  case Function::IS_AA_SUBSCRIPTION_ENABLED:
+    return "isAASubscriptionEnabled";
+  case Function::CHECK_FILTER_MATCH:
+    return "checkFilterMatch";
+  case Function::CHECK_PARSED_FILTER_MATCH:
+    return "checkParsedFilterMatch";
+  case Function::CHECK_FILTER_MATCHES:
+    return "checkFilterMatches";
+  case Function::GET_URL_FILTER_DATA:
+    return "getURLFilterData";
+  case Function::GET_ELEMENT_HIDING_DOMAINS:
+    return "getElementHidingDomains";
+  case Function::GET_FILTER_STATE:
+    return "getFilterState";
+  case Function::SET_FILTER_STATE:
+    return "setFilterState";
+  case Function::GET_ALLOWLISTING_FILTER:
+    return "getAllowlistingFilter";
+  case Function::SHOULD_BLOCK_REQUEST:
+    return "shouldBlockRequest";
+  case Function::GET_ELEMENT_HIDING_STYLE_SHEET:
+    return "getElementHidingStyleSheet";
+  case Function::GET_ELEMENT_HIDING_EMULATION_SELECTORS:
+    return "getElementHidingEmulationSelectors";
+  case Function::GET_PREF:
+    return "getPref";
+  case Function::SET_PREF:
+    return "setPref";
+  case Function::VERIFY_SIGNATURE:
+    return "verifySignature";
+  case Function::COMPOSE_FILTER_SUGGESTIONS:
+    return "composeFilterSuggestions";
+  case Function::START_SYNCHRONIZATION:
+    return "startSynchronization";
+  case Function::STOP_SYNCHRONIZATION:
+    return "stopSynchronization";
+  case Function::GET_SNIPPETS_SCRIPT:
+    return "getSnippetsScript";
+
+  default:
+    assert(false && "Missing case");
+    return {};
+  }
+}
@@ -0,0 +1,124 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <AdblockPlus/JsValue.h>
+
+namespace AdblockPlus
+{
+  class JsEngine;
+
+  /**
+   * Table of the `API.*` entry points exported by lib/api.js.
+   *
+   * The functions are looked up once and kept as persistent handles, so that
+   * calling into the filter engine doesn't require compiling and running a
+   * script just to find the function to call. All access to the table happens
+   * while the isolate is locked, which also serializes the lookups.
+   */
+  class ApiFunctions
+  {
+  public:
+    enum class Function
+    {
+      GET_FILTER_FROM_TEXT,
+      ADD_FILTER_TO_LIST,
+      REMOVE_FILTER_FROM_LIST,
+      GET_LISTED_FILTERS,
+      GET_SUBSCRIPTION_FROM_URL,
+      GET_SUBSCRIPTIONS_FROM_FILTER,
+      ADD_SUBSCRIPTION_TO_LIST,
+      REMOVE_SUBSCRIPTION_FROM_LIST,
+      UPDATE_SUBSCRIPTION,
+      IS_SUBSCRIPTION_UPDATING,
+      GET_LISTED_SUBSCRIPTIONS,
+      GET_RECOMMENDED_SUBSCRIPTIONS,
+      IS_AA_SUBSCRIPTION,
+      SET_AA_SUBSCRIPTION_ENABLED,
+      IS_AA_SUBSCRIPTION_ENABLED,
+      CHECK_FILTER_MATCH,
+      CHECK_PARSED_FILTER_MATCH,
+      CHECK_FILTER_MATCHES,
+      GET_URL_FILTER_DATA,
+      GET_ELEMENT_HIDING_DOMAINS,
+      GET_FILTER_STATE,
+      SET_FILTER_STATE,
+      GET_ALLOWLISTING_FILTER,
+      SHOULD_BLOCK_REQUEST,
+      GET_ELEMENT_HIDING_STYLE_SHEET,
+      GET_ELEMENT_HIDING_EMULATION_SELECTORS,
+      GET_PREF,
+      SET_PREF,
+      VERIFY_SIGNATURE,
+      COMPOSE_FILTER_SUGGESTIONS,
+      START_SYNCHRONIZATION,
+      STOP_SYNCHRONIZATION,
+      GET_SNIPPETS_SCRIPT,
+      // Not a function, keep it last.
+      FUNCTION_COUNT
+    };
+
+    explicit ApiFunctions(JsEngine& jsEngine);
+
+    /**
+     * Looks up all entry points at once. It should be called as soon as the
+     * scripts are loaded, entries which are requested before are looked up
+     * on demand.
+     */
+    void Resolve();
+
+    /**
+     * Calls an entry point.
+     * @param function Entry point to call.
+     * @param params Arguments to pass.
+     * @return Value returned by the function.
+     */
+    JsValue Call(Function function, const JsValueList& params = JsValueList()) const;
+
+    /**
+     * Calls an entry point with a single argument.
+     * @param function Entry point to call.
+     * @param arg Argument to pass.
+     * @return Value returned by the function.
+     */
+    JsValue Call(Function function, const JsValue& arg) const;
+
+    /**
+     * @return The JavaScript engine the functions belong to.
+     */
+    JsEngine& GetJsEngine() const
+    {
+      return jsEngine;
+    }
+
+    static std::string FunctionToString(Function function);
+
+  private:
+    const JsValue& Get(Function function) const;
+    const JsValue& Get(Function function, const JsValue& api) const;
+
+    JsEngine& jsEngine;
+    mutable std::vector<std::unique_ptr<JsValue>> functions;
+  };
+
+  typedef std::shared_ptr<ApiFunctions> ApiFunctionsPtr;
+}
@@ -0,0 +1,199 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsciiScanner.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ABP_ASCII_SCANNER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const size_t BLOCK_SIZE = 16;
+
+  bool IsKeywordChar(char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '%';
+  }
+
+  // Scalar conversion of str[begin, end), returns false for non-ASCII input.
+  bool ToLowerAsciiRange(const std::string& str, size_t begin, size_t end, char* out)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      char c = str[i];
+      if (static_cast<unsigned char>(c) >= 0x80)
+        return false;
+      out[i] = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+    return true;
+  }
+
+  void FindKeywordCharactersRange(const std::string& str,
+                                  size_t begin,
+                                  size_t end,
+                                  std::vector<uint64_t>* mask)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (IsKeywordChar(str[i]))
+        (*mask)[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+
+  // |value| must not be zero.
+  int CountTrailingZeros(uint64_t value)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    int count = 0;
+    while (!(value & 1))
+    {
+      value >>= 1;
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  // Finds the first bit at or after |from| which equals |set|.
+  size_t FindBit(const std::vector<uint64_t>& mask, size_t size, size_t from, bool set)
+  {
+    size_t word = from / 64;
+    if (from >= size || word >= mask.size())
+      return size;
+    uint64_t bits = (set ? mask[word] : ~mask[word]) & (~uint64_t(0) << (from % 64));
+    for (;;)
+    {
+      if (bits)
+        return std::min(size, word * 64 + CountTrailingZeros(bits));
+      if (++word >= mask.size())
+        return size;
+      bits = set ? mask[word] : ~mask[word];
+    }
+  }
+}
+
+bool AsciiScanner::ToLowerAscii(const std::string& str, std::string* lowerCase)
+{
+  lowerCase->resize(str.size());
+  size_t i = 0;
+#ifdef ABP_ASCII_SCANNER_SSE2
+  // Non-ASCII bytes are negative as signed characters, so they are not in the
+  // range of upper case letters and have their sign bit set.
+  const __m128i beforeA = _mm_set1_epi8('A' - 1);
+  const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+  const __m128i caseBit = _mm_set1_epi8('a' - 'A');
+  int nonAscii = 0;
+  for (; i + BLOCK_SIZE <= str.size(); i += BLOCK_SIZE)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i));
+    nonAscii |= _mm_movemask_epi8(block);
+    __m128i isUpper =
+        _mm_and_si128(_mm_cmpgt_epi8(block, beforeA), _mm_cmplt_epi8(block, afterZ));
+    block = _mm_add_epi8(block, _mm_and_si128(isUpper, caseBit));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&(*lowerCase)[i]), block);
+  }
+  if (nonAscii)
+    return false;
+#endif
+  return ToLowerAsciiRange(str, i, str.size(), &(*lowerCase)[0]);
+}
+
+bool AsciiScanner::ToLowerAsciiScalar(const std::string& str, std::string* lowerCase)
+{
+  lowerCase->resize(str.size());
+  return ToLowerAsciiRange(str, 0, str.size(), &(*lowerCase)[0]);
+}
+
+bool AsciiScanner::IsAscii(const uint8_t* data, size_t size)
+{
+  size_t i = 0;
+#ifdef ABP_ASCII_SCANNER_SSE2
+  for (; i + BLOCK_SIZE <= size; i += BLOCK_SIZE)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (_mm_movemask_epi8(block))
+      return false;
+  }
+#endif
+  return IsAsciiScalar(data + i, size - i);
+}
+
+bool AsciiScanner::IsAsciiScalar(const uint8_t* data, size_t size)
+{
+  return std::all_of(data, data + size, [](uint8_t c) {
+    return c < 0x80;
+  });
+}
+
+void AsciiScanner::FindKeywordCharacters(const std::string& str, std::vector<uint64_t>* mask)
+{
+  mask->assign((str.size() + 63) / 64, 0);
+  size_t i = 0;
+#ifdef ABP_ASCII_SCANNER_SSE2
+  // Blocks start at multiples of 16, so a block never spans two elements of
+  // the mask.
+  const __m128i beforeLowerA = _mm_set1_epi8('a' - 1);
+  const __m128i afterLowerZ = _mm_set1_epi8('z' + 1);
+  const __m128i beforeZero = _mm_set1_epi8('0' - 1);
+  const __m128i afterNine = _mm_set1_epi8('9' + 1);
+  const __m128i percent = _mm_set1_epi8('%');
+  for (; i + BLOCK_SIZE <= str.size(); i += BLOCK_SIZE)
+  {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i));
+    __m128i isLetter =
+        _mm_and_si128(_mm_cmpgt_epi8(block, beforeLowerA), _mm_cmplt_epi8(block, afterLowerZ));
+    __m128i isDigit =
+        _mm_and_si128(_mm_cmpgt_epi8(block, beforeZero), _mm_cmplt_epi8(block, afterNine));
+    __m128i isKeywordChar =
+        _mm_or_si128(_mm_or_si128(isLetter, isDigit), _mm_cmpeq_epi8(block, percent));
+    uint64_t bits = static_cast<uint16_t>(_mm_movemask_epi8(isKeywordChar));
+    (*mask)[i / 64] |= bits << (i % 64);
+  }
+#endif
+  FindKeywordCharactersRange(str, i, str.size(), mask);
+}
+
+void AsciiScanner::FindKeywordCharactersScalar(const std::string& str,
+                                               std::vector<uint64_t>* mask)
+{
+  mask->assign((str.size() + 63) / 64, 0);
+  FindKeywordCharactersRange(str, 0, str.size(), mask);
+}
+
+size_t
+AsciiScanner::NextKeywordRun(const std::vector<uint64_t>& mask, size_t size, size_t* position)
+{
+  size_t start = FindBit(mask, size, *position, true);
+  *position = FindBit(mask, size, start, false);
+  return start;
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Character class scans over URLs, processing 16 characters at a time with
+   * SSE2 where available. The scalar variants produce the same results and
+   * are used on other platforms and for the remainder of the input.
+   */
+  namespace AsciiScanner
+  {
+    /**
+     * Converts ASCII letters to lower case.
+     * @param str String to convert.
+     * @param lowerCase Receives the converted string, unspecified if the
+     *        result is `false`.
+     * @return `false` if `str` contains non-ASCII characters.
+     */
+    bool ToLowerAscii(const std::string& str, std::string* lowerCase);
+    bool ToLowerAsciiScalar(const std::string& str, std::string* lowerCase);
+
+    /**
+     * @return `true` if all `size` bytes at `data` are ASCII characters.
+     */
+    bool IsAscii(const uint8_t* data, size_t size);
+    bool IsAsciiScalar(const uint8_t* data, size_t size);
+
+    /**
+     * Marks the characters which can be part of a filter keyword, [a-z0-9%].
+     * @param str Lower case string to scan.
+     * @param mask Receives a bit per character of `str`, bit `i % 64` of
+     *        element `i / 64` is set for a keyword character at `i`.
+     */
+    void FindKeywordCharacters(const std::string& str, std::vector<uint64_t>* mask);
+    void FindKeywordCharactersScalar(const std::string& str, std::vector<uint64_t>* mask);
+
+    /**
+     * Finds the next run of keyword characters.
+     * @param mask Result of `FindKeywordCharacters()`.
+     * @param size Length of the scanned string.
+     * @param position Position to start at, receives the end of the run.
+     * @return Start of the run, `size` if there is none.
+     */
+    size_t NextKeywordRun(const std::vector<uint64_t>& mask, size_t size, size_t* position);
+  }
+}
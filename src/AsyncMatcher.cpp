@@ -0,0 +1,225 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncMatcher.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // Maximal number of requests passed to MatchesBatch at once.
+  const size_t MAX_BATCH_SIZE = 64;
+}
+
+bool AsyncMatcher::Key::operator==(const Key& other) const
+{
+  return url == other.url && contentTypeMask == other.contentTypeMask &&
+         documentUrl == other.documentUrl && siteKey == other.siteKey &&
+         specificOnly == other.specificOnly;
+}
+
+std::size_t AsyncMatcher::KeyHash::operator()(const Key& key) const
+{
+  std::hash<std::string> stringHash;
+  std::size_t result = stringHash(key.url);
+  result = result * 31 + stringHash(key.documentUrl);
+  result = result * 31 + stringHash(key.siteKey);
+  result = result * 31 + key.contentTypeMask;
+  return result * 2 + (key.specificOnly ? 1 : 0);
+}
+
+AsyncMatcher::AsyncMatcher(const IFilterEngine& filterEngine)
+    : filterEngine(filterEngine), stopping(false)
+{
+  matchingThread = std::thread([this]() { MatchingThreadFunc(); });
+  deadlineThread = std::thread([this]() { DeadlineThreadFunc(); });
+}
+
+AsyncMatcher::~AsyncMatcher()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  requestsQueued.notify_all();
+  deadlinesChanged.notify_all();
+  matchingThread.join();
+  deadlineThread.join();
+
+  Completions completions;
+  for (auto& pendingRequest : pendingRequests)
+  {
+    for (auto& waiter : pendingRequest.second.waiters)
+      Complete(*waiter, waiter->fallback, &completions);
+  }
+  pendingRequests.clear();
+  Call(completions);
+}
+
+void AsyncMatcher::Match(const IFilterEngine::MatchRequest& request,
+                         const IFilterEngine::MatchCallback& callback,
+                         std::chrono::milliseconds timeout,
+                         const IFilterEngine::MatchResult& fallback)
+{
+  auto waiter = std::make_shared<Waiter>();
+  waiter->callback = callback;
+  waiter->fallback = fallback;
+  waiter->completed = false;
+
+  Key key{request.url,
+          request.contentTypeMask,
+          request.documentUrl,
+          request.siteKey,
+          request.specificOnly};
+  auto now = Clock::now();
+  bool hasDeadline = timeout < std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   Clock::time_point::max() - now);
+  bool deadlinesUpdated = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    waiter->deadline = deadlines.end();
+    if (hasDeadline)
+    {
+      waiter->deadline = deadlines.emplace(now + timeout, waiter.get());
+      deadlinesUpdated = waiter->deadline == deadlines.begin();
+    }
+
+    auto& pendingRequest = pendingRequests[key];
+    // Identical requests share the result of the first one.
+    if (pendingRequest.waiters.empty())
+      queue.push_back(std::move(key));
+    pendingRequest.waiters.push_back(std::move(waiter));
+  }
+  requestsQueued.notify_one();
+  if (deadlinesUpdated)
+    deadlinesChanged.notify_one();
+}
+
+void AsyncMatcher::MatchingThreadFunc()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    requestsQueued.wait(lock, [this]() { return stopping || !queue.empty(); });
+    if (stopping)
+      return;
+
+    std::vector<Key> keys;
+    std::vector<IFilterEngine::MatchRequest> requests;
+    while (!queue.empty() && keys.size() < MAX_BATCH_SIZE)
+    {
+      Key& key = queue.front();
+      requests.push_back(
+          {key.url, key.contentTypeMask, key.documentUrl, key.siteKey, key.specificOnly});
+      keys.push_back(std::move(key));
+      queue.pop_front();
+    }
+
+    lock.unlock();
+    std::vector<IFilterEngine::MatchResult> results;
+    try
+    {
+      results = filterEngine.MatchesBatch(requests);
+    }
+    catch (...)
+    {
+      // The waiters get their fallback below.
+    }
+    lock.lock();
+
+    Completions completions;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      auto it = pendingRequests.find(keys[i]);
+      if (it == pendingRequests.end())
+        continue;
+      for (auto& waiter : it->second.waiters)
+        Complete(*waiter, i < results.size() ? results[i] : waiter->fallback, &completions);
+      pendingRequests.erase(it);
+    }
+    lock.unlock();
+    Call(completions);
+    lock.lock();
+  }
+}
+
+void AsyncMatcher::DeadlineThreadFunc()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  {
+    if (stopping)
+      return;
+    if (deadlines.empty())
+    {
+      deadlinesChanged.wait(lock);
+      continue;
+    }
+    auto now = Clock::now();
+    // Copied, the entry can be removed while waiting.
+    Clock::time_point nextDeadline = deadlines.begin()->first;
+    if (nextDeadline > now)
+    {
+      deadlinesChanged.wait_until(lock, nextDeadline);
+      continue;
+    }
+
+    Completions completions;
+    while (!deadlines.empty() && deadlines.begin()->first <= now)
+    {
+      Waiter& waiter = *deadlines.begin()->second;
+      Complete(waiter, waiter.fallback, &completions);
+    }
+    lock.unlock();
+    Call(completions);
+    lock.lock();
+  }
+}
+
+void AsyncMatcher::Complete(Waiter& waiter,
+                            const IFilterEngine::MatchResult& result,
+                            Completions* completions)
+{
+  if (waiter.completed)
+    return;
+  waiter.completed = true;
+  if (waiter.deadline != deadlines.end())
+  {
+    deadlines.erase(waiter.deadline);
+    waiter.deadline = deadlines.end();
+  }
+  completions->emplace_back(std::move(waiter.callback), result);
+}
+
+// static
+void AsyncMatcher::Call(const Completions& completions)
+{
+  for (const auto& completion : completions)
+  {
+    try
+    {
+      completion.first(completion.second);
+    }
+    catch (...)
+    {
+      // Exceptions of one callback must not affect the others.
+    }
+  }
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <AdblockPlus/IFilterEngine.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Implementation of IFilterEngine::MatchesAsync on top of
+   * IFilterEngine::MatchesBatch.
+   * Requests are queued and matched in batches on a dedicated thread,
+   * requests which are identical to one that is queued or being matched
+   * wait for its result instead of being matched again. A second thread
+   * passes the fallback result to callers whose timeout has elapsed.
+   */
+  class AsyncMatcher
+  {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * Constructor, starts the threads.
+     * @param filterEngine Engine matching the requests, it has to outlive
+     *        the `AsyncMatcher`.
+     */
+    explicit AsyncMatcher(const IFilterEngine& filterEngine);
+
+    /**
+     * Destructor, waits for the batch being matched and passes the fallback
+     * result to all callers still waiting.
+     */
+    ~AsyncMatcher();
+
+    /**
+     * See IFilterEngine::MatchesAsync.
+     */
+    void Match(const IFilterEngine::MatchRequest& request,
+               const IFilterEngine::MatchCallback& callback,
+               std::chrono::milliseconds timeout,
+               const IFilterEngine::MatchResult& fallback);
+
+  private:
+    struct Key
+    {
+      std::string url;
+      IFilterEngine::ContentTypeMask contentTypeMask;
+      std::string documentUrl;
+      std::string siteKey;
+      bool specificOnly;
+
+      bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash
+    {
+      std::size_t operator()(const Key& key) const;
+    };
+
+    struct Waiter;
+    typedef std::multimap<Clock::time_point, Waiter*> Deadlines;
+
+    struct Waiter
+    {
+      IFilterEngine::MatchCallback callback;
+      IFilterEngine::MatchResult fallback;
+      bool completed;
+      // deadlines.end() if the waiter has no deadline.
+      Deadlines::iterator deadline;
+    };
+
+    struct PendingRequest
+    {
+      std::vector<std::shared_ptr<Waiter>> waiters;
+    };
+
+    typedef std::vector<std::pair<IFilterEngine::MatchCallback, IFilterEngine::MatchResult>>
+        Completions;
+
+    void MatchingThreadFunc();
+    void DeadlineThreadFunc();
+    // Has to be called with `mutex` locked, the returned callbacks have to be
+    // called without it.
+    void Complete(Waiter& waiter,
+                  const IFilterEngine::MatchResult& result,
+                  Completions* completions);
+    static void Call(const Completions& completions);
+
+    const IFilterEngine& filterEngine;
+    std::mutex mutex;
+    std::condition_variable requestsQueued;
+    std::condition_variable deadlinesChanged;
+    bool stopping;
+    std::unordered_map<Key, PendingRequest, KeyHash> pendingRequests;
+    // Pending requests which are not being matched yet, oldest first.
+    std::deque<Key> queue;
+    Deadlines deadlines;
+    std::thread matchingThread;
+    std::thread deadlineThread;
+  };
+}
@@ -0,0 +1,170 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * Deque of Chase and Lev, see "Dynamic Circular Work-Stealing Deque" and
+   * "Correct and Efficient Work-Stealing for Weak Memory Models" by Lê et al.
+   * Only the owner thread pushes and takes values at the bottom, any other
+   * thread can steal values from the top. The buffer grows as needed, the
+   * replaced buffers are kept until the deque is destroyed because thieves
+   * may still read from them.
+   * @param T trivially copyable type of the values, e.g. a pointer.
+   */
+  template<typename T> class ChaseLevDeque
+  {
+  public:
+    explicit ChaseLevDeque(size_t capacity = 64)
+        : top(0), bottom(0), buffer(new Buffer(RoundUpToPowerOfTwo(capacity)))
+    {
+    }
+
+    ~ChaseLevDeque()
+    {
+      delete buffer.load(std::memory_order_relaxed);
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    /**
+     * Adds `value` at the bottom, may only be called by the owner.
+     */
+    void Push(T value)
+    {
+      const int64_t b = bottom.load(std::memory_order_relaxed);
+      const int64_t t = top.load(std::memory_order_acquire);
+      Buffer* current = buffer.load(std::memory_order_relaxed);
+      if (b - t >= static_cast<int64_t>(current->capacity))
+        current = Grow(current, t, b);
+      current->Put(b, value);
+      bottom.store(b + 1, std::memory_order_release);
+    }
+
+    /**
+     * Removes the value at the bottom, may only be called by the owner.
+     * @return `false` if the deque is empty.
+     */
+    bool Take(T* value)
+    {
+      const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+      Buffer* current = buffer.load(std::memory_order_relaxed);
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = top.load(std::memory_order_relaxed);
+      if (t > b)
+      {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+      }
+      *value = current->Get(b);
+      if (t < b)
+        return true;
+      // The last value, thieves may be racing for it.
+      const bool taken = top.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return taken;
+    }
+
+    /**
+     * Removes the value at the top, can be called by any thread.
+     * @return `false` if the deque is empty or another thread was faster.
+     */
+    bool Steal(T* value)
+    {
+      int64_t t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const int64_t b = bottom.load(std::memory_order_acquire);
+      if (t >= b)
+        return false;
+      const T result = buffer.load(std::memory_order_acquire)->Get(t);
+      if (!top.compare_exchange_strong(
+              t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return false;
+      *value = result;
+      return true;
+    }
+
+    /**
+     * Approximate number of values, can be called by any thread.
+     */
+    size_t Size() const
+    {
+      const int64_t b = bottom.load(std::memory_order_relaxed);
+      const int64_t t = top.load(std::memory_order_relaxed);
+      return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+  private:
+    struct Buffer
+    {
+      explicit Buffer(size_t capacity)
+          : capacity(capacity), slots(new std::atomic<T>[capacity])
+      {
+      }
+
+      T Get(int64_t index) const
+      {
+        return slots[static_cast<size_t>(index) & (capacity - 1)].load(std::memory_order_relaxed);
+      }
+
+      void Put(int64_t index, T value)
+      {
+        slots[static_cast<size_t>(index) & (capacity - 1)].store(value,
+                                                                 std::memory_order_relaxed);
+      }
+
+      const size_t capacity;
+      std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+      size_t result = 1;
+      while (result < value)
+        result <<= 1;
+      return result;
+    }
+
+    Buffer* Grow(Buffer* current, int64_t t, int64_t b)
+    {
+      Buffer* grown = new Buffer(current->capacity * 2);
+      for (int64_t i = t; i < b; ++i)
+        grown->Put(i, current->Get(i));
+      retiredBuffers.emplace_back(current);
+      buffer.store(grown, std::memory_order_release);
+      return grown;
+    }
+
+    // The owner and the thieves contend for `top`, keep it away from
+    // `bottom` which is mostly used by the owner.
+    std::atomic<int64_t> top;
+    char padding[64];
+    std::atomic<int64_t> bottom;
+    std::atomic<Buffer*> buffer;
+    std::vector<std::unique_ptr<Buffer>> retiredBuffers;
+  };
+}
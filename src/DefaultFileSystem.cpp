@@ -31,7 +31,10 @@
 #include <windows.h>
 #else
 #include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "../src/Utils.h"
@@ -65,6 +68,48 @@ namespace
   {
     return path;
   }
+
+  class MappedFileContent : public IFileSystem::IFileContent
+  {
+  public:
+    MappedFileContent(void* address, size_t size) : address(address), size_(size)
+    {
+    }
+
+    ~MappedFileContent()
+    {
+      munmap(address, size_);
+    }
+
+    const uint8_t* data() const override
+    {
+      return static_cast<const uint8_t*>(address);
+    }
+
+    size_t size() const override
+    {
+      return size_;
+    }
+
+  private:
+    void* address;
+    size_t size_;
+  };
+
+  class FileDescriptor
+  {
+  public:
+    explicit FileDescriptor(int fd) : fd(fd)
+    {
+    }
+
+    ~FileDescriptor()
+    {
+      close(fd);
+    }
+
+    const int fd;
+  };
 #endif
 }
 
@@ -91,10 +136,113 @@ IFileSystem::IOBuffer DefaultFileSystemSync::Read(const std::string& path) const
   return data;
 }
 
+IFileSystem::FileContentPtr DefaultFileSystemSync::ReadContent(const std::string& path) const
+{
+#ifdef _WIN32
+  return std::make_shared<IFileSystem::BufferFileContent>(Read(path));
+#else
+  int fd = open(NormalizePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw RuntimeErrorWithErrno("Failed to open " + path);
+
+  struct stat nativeStat;
+  if (fstat(fd, &nativeStat))
+  {
+    close(fd);
+    throw RuntimeErrorWithErrno("Unable to stat " + path);
+  }
+
+  // Empty files can't be mapped.
+  const size_t size = static_cast<size_t>(nativeStat.st_size);
+  if (size == 0)
+  {
+    close(fd);
+    return std::make_shared<IFileSystem::BufferFileContent>(IFileSystem::IOBuffer());
+  }
+
+  void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED)
+    throw RuntimeErrorWithErrno("Failed to map " + path);
+  return std::make_shared<MappedFileContent>(address, size);
+#endif
+}
+
+DefaultFileSystemSync::ChunkReader
+DefaultFileSystemSync::OpenForReading(const std::string& path) const
+{
+#ifdef _WIN32
+  auto file = std::make_shared<std::ifstream>(NormalizePath(path).c_str(), std::ios_base::binary);
+  if (file->fail())
+    throw RuntimeErrorWithErrno("Failed to open " + path);
+
+  return [file, path](uint64_t offset, size_t size) {
+    file->clear();
+    file->seekg(offset, std::ios_base::beg);
+    IFileSystem::IOBuffer chunk(size);
+    file->read(reinterpret_cast<std::ifstream::char_type*>(chunk.data()), chunk.size());
+    if (file->bad())
+      throw RuntimeErrorWithErrno("Failed to read " + path);
+    chunk.resize(static_cast<size_t>(file->gcount()));
+    return chunk;
+  };
+#else
+  int fd = open(NormalizePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw RuntimeErrorWithErrno("Failed to open " + path);
+
+  auto file = std::make_shared<FileDescriptor>(fd);
+  return [file, path](uint64_t offset, size_t size) {
+    IFileSystem::IOBuffer chunk(size);
+    size_t length = 0;
+    while (length < size)
+    {
+      ssize_t result = pread(file->fd, chunk.data() + length, size - length, offset + length);
+      if (result == 0)
+        break;
+      if (result < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        throw RuntimeErrorWithErrno("Failed to read " + path);
+      }
+      length += static_cast<size_t>(result);
+    }
+    chunk.resize(length);
+    return chunk;
+  };
+#endif
+}
+
 void DefaultFileSystemSync::Write(const std::string& path, const IFileSystem::IOBuffer& data)
 {
+#ifdef _WIN32
   std::ofstream file(NormalizePath(path).c_str(), std::ios_base::out | std::ios_base::binary);
   file.write(reinterpret_cast<const std::ofstream::char_type*>(data.data()), data.size());
+#else
+  // The file may be mapped into memory by ReadContent(), so it's replaced
+  // instead of being truncated and rewritten in place.
+  const std::string newPath = path + ".new";
+  {
+    std::ofstream file(NormalizePath(newPath).c_str(),
+                       std::ios_base::out | std::ios_base::binary);
+    file.write(reinterpret_cast<const std::ofstream::char_type*>(data.data()), data.size());
+  }
+  if (rename(NormalizePath(newPath).c_str(), NormalizePath(path).c_str()))
+    throw RuntimeErrorWithErrno("Failed to write " + path);
+#endif
+}
+
+void DefaultFileSystemSync::Append(const std::string& path, const IFileSystem::IOBuffer& data)
+{
+  std::ofstream file(NormalizePath(path).c_str(),
+                     std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+  if (file.fail())
+    throw RuntimeErrorWithErrno("Failed to open " + path);
+  file.write(reinterpret_cast<const std::ofstream::char_type*>(data.data()), data.size());
+  file.close();
+  if (file.fail())
+    throw RuntimeErrorWithErrno("Failed to append to " + path);
 }
 
 void DefaultFileSystemSync::Move(const std::string& fromPath, const std::string& toPath)
@@ -198,11 +346,115 @@ void DefaultFileSystem::Read(const std::string& fileName,
                              const Callback& errorCallback) const
 {
   executor.Dispatch([this, fileName, doneCallback, errorCallback] {
+    ReadAndReport(
+        fileName,
+        [this, &fileName, &doneCallback] {
+          doneCallback(syncImpl->Read(Resolve(fileName)));
+        },
+        errorCallback);
+  });
+}
+
+void DefaultFileSystem::ReadContent(const std::string& fileName,
+                                    const ReadContentCallback& doneCallback,
+                                    const Callback& errorCallback) const
+{
+  executor.Dispatch([this, fileName, doneCallback, errorCallback] {
+    ReadAndReport(
+        fileName,
+        [this, &fileName, &doneCallback] {
+          doneCallback(syncImpl->ReadContent(Resolve(fileName)));
+        },
+        errorCallback);
+  });
+}
+
+void DefaultFileSystem::ReadChunks(const std::string& fileName,
+                                   size_t chunkSize,
+                                   const ReadChunkCallback& chunkCallback,
+                                   const Callback& errorCallback) const
+{
+  executor.Dispatch([this, fileName, chunkSize, chunkCallback, errorCallback] {
+    DefaultFileSystemSync::ChunkReader reader;
+    ReadAndReport(
+        fileName,
+        [this, &fileName, &reader] {
+          reader = syncImpl->OpenForReading(Resolve(fileName));
+        },
+        errorCallback);
+    if (reader)
+      ReadChunk(fileName, reader, 0, chunkSize, chunkCallback, errorCallback);
+  });
+}
+
+void DefaultFileSystem::ReadChunk(const std::string& fileName,
+                                  const DefaultFileSystemSync::ChunkReader& reader,
+                                  uint64_t offset,
+                                  size_t chunkSize,
+                                  const ReadChunkCallback& chunkCallback,
+                                  const Callback& errorCallback) const
+{
+  ReadAndReport(
+      fileName,
+      [&] {
+        auto chunk = reader(offset, chunkSize);
+        if (chunk.empty())
+          return chunkCallback(std::move(chunk), [] {});
+
+        // The next chunk is only read once the consumer asks for it, the
+        // file stays open until then.
+        const uint64_t nextOffset = offset + chunk.size();
+        chunkCallback(
+            std::move(chunk),
+            [this, fileName, reader, nextOffset, chunkSize, chunkCallback, errorCallback] {
+              executor.Dispatch(
+                  [this, fileName, reader, nextOffset, chunkSize, chunkCallback, errorCallback] {
+                    ReadChunk(
+                        fileName, reader, nextOffset, chunkSize, chunkCallback, errorCallback);
+                  });
+            });
+      },
+      errorCallback);
+}
+
+void DefaultFileSystem::ReadAndReport(const std::string& fileName,
+                                      const std::function<void()>& read,
+                                      const Callback& errorCallback) const
+{
+  std::string error;
+  try
+  {
+    read();
+    return;
+  }
+  catch (std::exception& e)
+  {
+    error = e.what();
+  }
+  catch (...)
+  {
+    error = "Unknown error while reading from " + fileName + " as " + Resolve(fileName);
+  }
+
+  try
+  {
+    errorCallback(error);
+  }
+  catch (...)
+  {
+    // there is no way to catch an exception thrown from the error callback.
+  }
+}
+
+void DefaultFileSystem::Write(const std::string& fileName,
+                              const IOBuffer& data,
+                              const Callback& callback)
+{
+  executor.Dispatch([this, fileName, data, callback] {
     std::string error;
     try
     {
-      doneCallback(syncImpl->Read(Resolve(fileName)));
-      return;
+      syncImpl->Write(Resolve(fileName), data);
     }
     catch (std::exception& e)
     {
@@ -210,29 +462,21 @@ void DefaultFileSystem::Read(const std::string& fileName,
     }
     catch (...)
     {
-      error = "Unknown error while reading from " + fileName + " as " + Resolve(fileName);
-    }
-
-    try
-    {
-      errorCallback(error);
-    }
-    catch (...)
-    {
-      // there is no way to catch an exception thrown from the error callback.
+      error = "Unknown error while writing to " + fileName + " as " + Resolve(fileName);
     }
+    callback(error);
   });
 }
 
-void DefaultFileSystem::Write(const std::string& fileName,
-                              const IOBuffer& data,
-                              const Callback& callback)
+void DefaultFileSystem::Append(const std::string& fileName,
+                               const IOBuffer& data,
+                               const Callback& callback)
 {
   executor.Dispatch([this, fileName, data, callback] {
     std::string error;
     try
     {
-      syncImpl->Write(Resolve(fileName), data);
+      syncImpl->Append(Resolve(fileName), data);
     }
     catch (std::exception& e)
     {
@@ -240,7 +484,7 @@ void DefaultFileSystem::Write(const std::string& fileName,
     }
     catch (...)
     {
-      error = "Unknown error while writing to " + fileName + " as " + Resolve(fileName);
+      error = "Unknown error while appending to " + fileName + " as " + Resolve(fileName);
     }
     callback(error);
   });
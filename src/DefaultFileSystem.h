@@ -39,7 +39,22 @@ namespace AdblockPlus
   public:
     explicit DefaultFileSystemSync(const std::string& basePath);
     IFileSystem::IOBuffer Read(const std::string& path) const;
+    /**
+     * Maps the file into memory where supported, otherwise same as `Read()`.
+     */
+    IFileSystem::FileContentPtr ReadContent(const std::string& path) const;
+    /**
+     * Reads up to `size` bytes at `offset` of a file opened by
+     * `OpenForReading()`, fewer only at the end of the file.
+     */
+    typedef std::function<IFileSystem::IOBuffer(uint64_t offset, size_t size)> ChunkReader;
+    /**
+     * Opens a file for positioned reads, it stays open as long as the
+     * returned reader is alive.
+     */
+    ChunkReader OpenForReading(const std::string& path) const;
     void Write(const std::string& path, const IFileSystem::IOBuffer& data);
+    void Append(const std::string& path, const IFileSystem::IOBuffer& data);
     void Move(const std::string& fromPath, const std::string& toPath);
     void Remove(const std::string& path);
     IFileSystem::StatResult Stat(const std::string& path) const;
@@ -56,8 +71,17 @@ namespace AdblockPlus
     void Read(const std::string& fileName,
               const ReadCallback& doneCallback,
               const Callback& errorCallback) const override;
+    void ReadContent(const std::string& fileName,
+                     const ReadContentCallback& doneCallback,
+                     const Callback& errorCallback) const override;
+    void ReadChunks(const std::string& fileName,
+                    size_t chunkSize,
+                    const ReadChunkCallback& chunkCallback,
+                    const Callback& errorCallback) const override;
     void
     Write(const std::string& fileName, const IOBuffer& data, const Callback& callback) override;
+    void
+    Append(const std::string& fileName, const IOBuffer& data, const Callback& callback) override;
     void Move(const std::string& fromFileName,
               const std::string& toFileName,
               const Callback& callback) override;
@@ -67,6 +91,17 @@ namespace AdblockPlus
   private:
     // Returns the absolute path to a file.
     std::string Resolve(const std::string& fileName) const;
+    // Calls `read` and passes errors it throws to `errorCallback`.
+    void ReadAndReport(const std::string& fileName,
+                       const std::function<void()>& read,
+                       const Callback& errorCallback) const;
+    // Reads the chunk at `offset` on the executor and passes it on.
+    void ReadChunk(const std::string& fileName,
+                   const DefaultFileSystemSync::ChunkReader& reader,
+                   uint64_t offset,
+                   size_t chunkSize,
+                   const ReadChunkCallback& chunkCallback,
+                   const Callback& errorCallback) const;
     IExecutor& executor;
     std::unique_ptr<DefaultFileSystemSync> syncImpl;
   };
@@ -25,105 +25,175 @@
 #include "DefaultFilterImplementation.h"
 #include "DefaultSubscriptionImplementation.h"
 #include "ElementUtils.h"
+#include "FilterStorageJournal.h"
 #include "JsContext.h"
+#include "UrlParser.h"
+#include "Utils.h"
 
 using namespace AdblockPlus;
 
-DefaultFilterEngine::DefaultFilterEngine(JsEngine& jsEngine) : jsEngine(jsEngine)
+namespace
 {
+  // Above this number of added or removed filters the native matcher is
+  // built from scratch rather than updated.
+  const size_t MAX_CHANGED_FILTERS = 1000;
+
+  // Size of the chunks patterns.ini and its journal are hashed in.
+  const size_t WARM_START_READ_CHUNK_SIZE = 64 * 1024;
+
+  // Identifies a request among the cached results of a native matcher
+  // snapshot.
+  std::string GetResultKey(const IFilterEngine::MatchRequest& request)
+  {
+    std::string key = request.url;
+    key += '\n' + std::to_string(request.contentTypeMask);
+    key += '\n' + UrlParser::ExtractHost(request.documentUrl);
+    key += '\n' + request.siteKey;
+    key += request.specificOnly ? "\n1" : "\n0";
+    return key;
+  }
+
+  // Brings a host into the form DomainTrie expects, fails for non-ASCII
+  // hosts since case conversion of those is left to JavaScript. Leading and
+  // trailing dots are stripped.
+  bool ToTrieDomain(const std::string& host, std::string* domain)
+  {
+    domain->clear();
+    domain->reserve(host.size());
+    for (char c : host)
+    {
+      if (static_cast<unsigned char>(c) >= 0x80)
+        return false;
+      domain->push_back(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+    while (!domain->empty() && domain->back() == '.')
+      domain->pop_back();
+    domain->erase(0, domain->find_first_not_of('.'));
+    return !domain->empty();
+  }
+}
+
+DefaultFilterEngine::DefaultFilterEngine(JsEngine& jsEngine,
+                                         const FilterEngineFactory::CreationParameters& parameters)
+    : jsEngine(jsEngine), api(std::make_shared<ApiFunctions>(jsEngine)),
+      matchCache_(parameters.matchCacheSize), matchCacheSize_(parameters.matchCacheSize),
+      nativeMatcherEnabled_(parameters.nativeMatcherEnabled),
+      nativeMatcherUpdate_(std::make_shared<NativeMatcherUpdate>())
+{
+  nativeMatcherUpdate_->filterEngine = this;
   jsEngine.SetEventCallback("filterChange", [this](JsValueList&& params) {
     this->OnSubscriptionOrFilterChanged(move(params));
   });
+  if (parameters.warmStartImageEnabled && nativeMatcherEnabled_)
+    LoadWarmStartImage();
 }
 
 DefaultFilterEngine::~DefaultFilterEngine()
 {
+  // Waits for requests being matched, they use the JavaScript engine.
+  asyncMatcher_.reset();
   jsEngine.RemoveEventCallback("filterChange");
+  const v8::Locker locker(jsEngine.GetIsolate());
+  nativeMatcherUpdate_->filterEngine = nullptr;
 }
 
 Filter DefaultFilterEngine::GetFilter(const std::string& text) const
 {
-  JsValue func = jsEngine.Evaluate("API.getFilterFromText");
-  return Filter(
-      std::make_unique<DefaultFilterImplementation>(func.Call(jsEngine.NewValue(text)), &jsEngine));
+  return jsEngine.RunInteractive([&]() {
+    return Filter(std::make_unique<DefaultFilterImplementation>(
+        api->Call(ApiFunctions::Function::GET_FILTER_FROM_TEXT, jsEngine.NewValue(text)),
+        &jsEngine));
+  });
 }
 
 Subscription DefaultFilterEngine::GetSubscription(const std::string& url) const
 {
-  JsValue func = jsEngine.Evaluate("API.getSubscriptionFromUrl");
-  return Subscription(std::make_unique<DefaultSubscriptionImplementation>(
-      func.Call(jsEngine.NewValue(url)), &jsEngine));
+  return jsEngine.RunInteractive([&]() {
+    return Subscription(std::make_unique<DefaultSubscriptionImplementation>(
+        api->Call(ApiFunctions::Function::GET_SUBSCRIPTION_FROM_URL, jsEngine.NewValue(url)), api));
+  });
 }
 
 std::vector<Subscription>
 DefaultFilterEngine::GetSubscriptionsFromFilter(const Filter& filter) const
 {
-  JsValue func = jsEngine.Evaluate("API.getSubscriptionsFromFilter");
-  auto subscriptions = func.Call(jsEngine.NewValue(filter.GetRaw()));
-  if (subscriptions.IsNull() || subscriptions.IsUndefined())
-  {
-    return {};
-  }
+  return jsEngine.RunInteractive([&]() -> std::vector<Subscription> {
+    auto subscriptions = api->Call(ApiFunctions::Function::GET_SUBSCRIPTIONS_FROM_FILTER,
+                                   jsEngine.NewValue(filter.GetRaw()));
+    if (subscriptions.IsNull() || subscriptions.IsUndefined())
+    {
+      return {};
+    }
 
-  assert(subscriptions.IsArray());
-  auto subscriptions_values = subscriptions.AsList();
-  std::vector<Subscription> result;
-  result.reserve(subscriptions_values.size());
-  for (auto value : subscriptions_values)
-  {
-    result.push_back(Subscription(
-        std::make_unique<DefaultSubscriptionImplementation>(std::move(value), &jsEngine)));
-  }
+    assert(subscriptions.IsArray());
+    auto subscriptions_values = subscriptions.AsList();
+    std::vector<Subscription> result;
+    result.reserve(subscriptions_values.size());
+    for (auto value : subscriptions_values)
+    {
+      result.push_back(
+          Subscription(std::make_unique<DefaultSubscriptionImplementation>(std::move(value), api)));
+    }
 
-  return result;
+    return result;
+  });
 }
 
 std::vector<Filter> DefaultFilterEngine::GetListedFilters() const
 {
-  JsValue func = jsEngine.Evaluate("API.getListedFilters");
-  JsValueList values = func.Call().AsList();
-  std::vector<Filter> result;
-  for (auto& value : values)
-    result.emplace_back(
-        Filter(std::make_unique<DefaultFilterImplementation>(std::move(value), &jsEngine)));
-  return result;
+  return jsEngine.RunInteractive([&]() {
+    JsValueList values = api->Call(ApiFunctions::Function::GET_LISTED_FILTERS).AsList();
+    std::vector<Filter> result;
+    for (auto& value : values)
+      result.emplace_back(
+          Filter(std::make_unique<DefaultFilterImplementation>(std::move(value), &jsEngine)));
+    return result;
+  });
 }
 
 std::vector<Subscription> DefaultFilterEngine::GetListedSubscriptions() const
 {
-  JsValue func = jsEngine.Evaluate("API.getListedSubscriptions");
-  JsValueList values = func.Call().AsList();
-  std::vector<Subscription> result;
-  for (auto& value : values)
-    result.emplace_back(Subscription(
-        std::make_unique<DefaultSubscriptionImplementation>(std::move(value), &jsEngine)));
-  return result;
+  return jsEngine.RunInteractive([&]() {
+    JsValueList values = api->Call(ApiFunctions::Function::GET_LISTED_SUBSCRIPTIONS).AsList();
+    std::vector<Subscription> result;
+    for (auto& value : values)
+      result.emplace_back(
+          Subscription(std::make_unique<DefaultSubscriptionImplementation>(std::move(value), api)));
+    return result;
+  });
 }
 
 std::vector<Subscription> DefaultFilterEngine::FetchAvailableSubscriptions() const
 {
-  JsValue func = jsEngine.Evaluate("API.getRecommendedSubscriptions");
-  JsValueList values = func.Call().AsList();
-  std::vector<Subscription> result;
-  for (auto& value : values)
-    result.emplace_back(Subscription(
-        std::make_unique<DefaultSubscriptionImplementation>(std::move(value), &jsEngine)));
-  return result;
+  return jsEngine.RunInteractive([&]() {
+    JsValueList values = api->Call(ApiFunctions::Function::GET_RECOMMENDED_SUBSCRIPTIONS).AsList();
+    std::vector<Subscription> result;
+    for (auto& value : values)
+      result.emplace_back(
+          Subscription(std::make_unique<DefaultSubscriptionImplementation>(std::move(value), api)));
+    return result;
+  });
 }
 
 void DefaultFilterEngine::SetAAEnabled(bool enabled)
 {
-  jsEngine.Evaluate("API.setAASubscriptionEnabled").Call(jsEngine.NewValue(enabled));
+  jsEngine.RunInteractive([&]() {
+    api->Call(ApiFunctions::Function::SET_AA_SUBSCRIPTION_ENABLED, jsEngine.NewValue(enabled));
+  });
 }
 
 bool DefaultFilterEngine::IsAAEnabled() const
 {
-  return jsEngine.Evaluate("API.isAASubscriptionEnabled()").AsBool();
+  return jsEngine.RunInteractive([&]() {
+    return api->Call(ApiFunctions::Function::IS_AA_SUBSCRIPTION_ENABLED).AsBool();
+  });
 }
 
 std::string DefaultFilterEngine::GetAAUrl() const
 {
-  return GetPref("subscriptions_exceptionsurl").AsString();
+  return jsEngine.RunInteractive([&]() {
+    return GetPref("subscriptions_exceptionsurl").AsString();
+  });
 }
 
 Filter DefaultFilterEngine::Matches(const std::string& url,
@@ -140,6 +210,120 @@ Filter DefaultFilterEngine::Matches(const std::string& url,
   return CheckFilterMatch(url, contentTypeMask, documentUrl, siteKey, specificOnly);
 }
 
+Filter DefaultFilterEngine::Matches(const std::string& url,
+                                    ContentTypeMask contentTypeMask,
+                                    const FrameContext& frame) const
+{
+  if (url.empty())
+    return Filter();
+  if (!MayMatch(url,
+                contentTypeMask,
+                UrlParser::ExtractHost(frame.GetDocumentUrl()),
+                frame.GetSiteKey()))
+    return Filter();
+  return jsEngine.RunInteractive([&]() {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    bool specificOnly = IsContentAllowlisted(CONTENT_TYPE_GENERICBLOCK, frame);
+    return CheckFilterMatch(
+        url, contentTypeMask, frame.GetDocumentUrl(), frame.GetSiteKey(), specificOnly);
+  });
+}
+
+std::vector<IFilterEngine::MatchResult>
+DefaultFilterEngine::MatchesBatch(const std::vector<MatchRequest>& requests) const
+{
+  std::vector<MatchResult> results;
+  if (requests.empty())
+    return results;
+  results.reserve(requests.size());
+
+  // Requests which no filter matches or which have been matched with the
+  // same filters before don't need the JavaScript engine, if that's all of
+  // them it isn't locked at all.
+  auto snapshot = std::atomic_load(&nativeMatcherSnapshot_);
+  const NativeMatcher* nativeMatcher = snapshot ? snapshot->nativeMatcher.get() : nullptr;
+  std::vector<bool> mayMatch;
+  mayMatch.reserve(requests.size());
+  results.resize(requests.size(), {"", Filter::Type::TYPE_INVALID});
+  ParsedUrl parsedUrl;
+  for (size_t i = 0; i < requests.size(); ++i)
+  {
+    const auto& request = requests[i];
+    auto parseResult = UrlParser::Parse(request.url, &parsedUrl);
+    mayMatch.push_back(parseResult == UrlParser::Result::UNSUPPORTED ||
+                       (parseResult == UrlParser::Result::VALID &&
+                        (!nativeMatcher ||
+                         nativeMatcher->MayMatch(request.url,
+                                                 request.contentTypeMask,
+                                                 UrlParser::ExtractHost(request.documentUrl),
+                                                 request.siteKey))));
+    if (mayMatch.back() && nativeMatcher && GetCachedResult(*snapshot, request, &results[i]))
+      mayMatch.back() = false;
+  }
+  if (std::find(mayMatch.begin(), mayMatch.end(), true) == mayMatch.end())
+    return results;
+
+  return jsEngine.RunInteractive([&]() {
+    auto* isolate = jsEngine.GetIsolate();
+    const JsContext context(isolate, *jsEngine.GetContext());
+    // The requests are flattened into a single array, seven elements per
+    // request, see API.checkFilterMatches.
+    std::vector<v8::Local<v8::Value>> elements;
+    elements.reserve(requests.size() * 7);
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+      const auto& request = requests[i];
+      auto parseResult = UrlParser::Parse(request.url, &parsedUrl);
+      std::string documentHost = UrlParser::ExtractHost(request.documentUrl);
+      if (!mayMatch[i])
+      {
+        // An empty URL never matches.
+        elements.push_back(v8::String::Empty(isolate));
+        elements.push_back(v8::Null(isolate));
+        elements.push_back(v8::Null(isolate));
+      }
+      else
+      {
+        elements.push_back(CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, request.url)));
+        if (parseResult == UrlParser::Result::VALID)
+        {
+          elements.push_back(
+              CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, parsedUrl.scheme + ":")));
+          elements.push_back(
+              CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, parsedUrl.asciiHost)));
+        }
+        else
+        {
+          elements.push_back(v8::Null(isolate));
+          elements.push_back(v8::Null(isolate));
+        }
+      }
+      elements.push_back(v8::Integer::New(isolate, request.contentTypeMask));
+      elements.push_back(CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, documentHost)));
+      elements.push_back(CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, request.siteKey)));
+      elements.push_back(v8::Boolean::New(isolate, request.specificOnly));
+    }
+
+    JsValue matches = api->Call(ApiFunctions::Function::CHECK_FILTER_MATCHES,
+                                jsEngine.NewArrayOfLocals(elements));
+    // Two elements per request: filter text and filter class name.
+    auto list = v8::Local<v8::Array>::Cast(matches.UnwrapValue());
+    for (uint32_t i = 0; i < requests.size() && 2 * i + 1 < list->Length(); ++i)
+    {
+      if (!mayMatch[i])
+        continue;
+      auto text = CHECKED_TO_LOCAL(isolate, list->Get(context.GetV8Context(), 2 * i));
+      auto className = CHECKED_TO_LOCAL(isolate, list->Get(context.GetV8Context(), 2 * i + 1));
+      results[i] = {
+          Utils::FromV8String(isolate, text),
+          DefaultFilterImplementation::ClassNameToType(Utils::FromV8String(isolate, className))};
+      if (nativeMatcher)
+        CacheResult(*snapshot, requests[i], results[i]);
+    }
+    return results;
+  });
+}
+
 bool DefaultFilterEngine::IsContentAllowlisted(const std::string& url,
                                                ContentTypeMask contentTypeMask,
                                                const std::vector<std::string>& documentUrls,
@@ -148,7 +332,81 @@ bool DefaultFilterEngine::IsContentAllowlisted(const std::string& url,
   return GetAllowlistingFilter(url, contentTypeMask, documentUrls, sitekey).IsValid();
 }
 
-// |documentUrl| gets converted to a hostname (domain) within "API.checkFilterMatch".
+bool DefaultFilterEngine::IsContentAllowlisted(ContentTypeMask contentTypeMask,
+                                               const FrameContext& frame) const
+{
+  return GetAllowlistingFilter(contentTypeMask, frame).IsValid();
+}
+
+IFilterEngine::BlockingDecision
+DefaultFilterEngine::ShouldBlockRequest(const std::string& url,
+                                        ContentTypeMask contentTypeMask,
+                                        const std::vector<std::string>& documentUrls,
+                                        const std::string& siteKey) const
+{
+  if (url.empty())
+    return {false, Filter()};
+  // Allowlisting can only change the decision if some filter matches.
+  if (!MayMatch(url,
+                contentTypeMask,
+                UrlParser::ExtractHost(documentUrls.empty() ? "" : documentUrls.front()),
+                siteKey))
+    return {false, Filter()};
+  return jsEngine.RunInteractive([&]() -> BlockingDecision {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    JsValueList params;
+    params.push_back(jsEngine.NewValue(url));
+    params.push_back(jsEngine.NewValue(contentTypeMask));
+    params.push_back(jsEngine.NewArray(documentUrls));
+    params.push_back(jsEngine.NewValue(siteKey));
+    JsValue result = api->Call(ApiFunctions::Function::SHOULD_BLOCK_REQUEST, params);
+    if (result.IsNull())
+      return {false, Filter()};
+    Filter filter(std::make_unique<DefaultFilterImplementation>(std::move(result), &jsEngine));
+    bool shouldBlock = filter.GetType() == Filter::Type::TYPE_BLOCKING;
+    return {shouldBlock, std::move(filter)};
+  });
+}
+
+void DefaultFilterEngine::MatchesAsync(const MatchRequest& request,
+                                       const MatchCallback& callback,
+                                       std::chrono::milliseconds timeout,
+                                       const MatchResult& fallback) const
+{
+  // Same as in MatchesBatch.
+  ParsedUrl parsedUrl;
+  auto parseResult = UrlParser::Parse(request.url, &parsedUrl);
+  auto snapshot = std::atomic_load(&nativeMatcherSnapshot_);
+  const NativeMatcher* nativeMatcher = snapshot ? snapshot->nativeMatcher.get() : nullptr;
+  if (parseResult == UrlParser::Result::INVALID ||
+      (parseResult == UrlParser::Result::VALID && nativeMatcher &&
+       !nativeMatcher->MayMatch(request.url,
+                                request.contentTypeMask,
+                                UrlParser::ExtractHost(request.documentUrl),
+                                request.siteKey)))
+  {
+    callback({"", Filter::Type::TYPE_INVALID});
+    return;
+  }
+  MatchResult result;
+  if (nativeMatcher && GetCachedResult(*snapshot, request, &result))
+  {
+    callback(result);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(asyncMatcherMutex_);
+  if (!asyncMatcher_)
+    asyncMatcher_ = std::make_unique<AsyncMatcher>(*this);
+  lock.unlock();
+  asyncMatcher_->Match(request, callback, timeout, fallback);
+}
+
+IFilterEngine::MatchCacheStats DefaultFilterEngine::GetMatchCacheStats() const
+{
+  return matchCache_.GetStats();
+}
+
 Filter DefaultFilterEngine::CheckFilterMatch(const std::string& url,
                                              ContentTypeMask contentTypeMask,
                                              const std::string& documentUrl,
@@ -157,14 +415,83 @@ Filter DefaultFilterEngine::CheckFilterMatch(const std::string& url,
 {
   if (url.empty())
     return Filter();
-  JsValue func = jsEngine.Evaluate("API.checkFilterMatch");
+  // Answered without locking the JavaScript engine.
+  if (!MayMatch(url, contentTypeMask, UrlParser::ExtractHost(documentUrl), siteKey))
+    return Filter();
+  return jsEngine.RunInteractive([&]() {
+    if (!matchCache_.IsEnabled())
+      return CheckFilterMatchUncached(url, contentTypeMask, documentUrl, siteKey, specificOnly);
+
+    // The cache has to be accessed with the JS engine locked, what also
+    // guarantees that the filters don't change until the result is stored.
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    MatchCache::Key key{
+        url, contentTypeMask, UrlParser::ExtractHost(documentUrl), siteKey, specificOnly};
+    Filter filter;
+    if (matchCache_.Get(key, &filter))
+      return filter;
+    uint64_t generation = matchCache_.GetGeneration();
+    filter = CheckFilterMatchUncached(url, contentTypeMask, documentUrl, siteKey, specificOnly);
+    matchCache_.Put(key, generation, filter);
+    return filter;
+  });
+}
+
+// Same as API.shouldBlockRequest but with the allowlisting of the frame
+// remembered in |frame|.
+IFilterEngine::BlockingDecision DefaultFilterEngine::ShouldBlockRequest(
+    const std::string& url, ContentTypeMask contentTypeMask, const FrameContext& frame) const
+{
+  if (url.empty())
+    return {false, Filter()};
+  if (!MayMatch(url,
+                contentTypeMask,
+                UrlParser::ExtractHost(frame.GetDocumentUrl()),
+                frame.GetSiteKey()))
+    return {false, Filter()};
+  return jsEngine.RunInteractive([&]() -> BlockingDecision {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    Filter filter = Matches(url, contentTypeMask, frame);
+    if (filter.GetType() != Filter::Type::TYPE_BLOCKING)
+      return {false, std::move(filter)};
+    Filter documentFilter = GetAllowlistingFilter(CONTENT_TYPE_DOCUMENT, frame);
+    if (documentFilter.IsValid())
+      return {false, std::move(documentFilter)};
+    return {true, std::move(filter)};
+  });
+}
+
+// |url| and |documentUrl| are parsed natively, only URLs which UrlParser doesn't
+// support are parsed within "API.checkFilterMatch".
+Filter DefaultFilterEngine::CheckFilterMatchUncached(const std::string& url,
+                                                     ContentTypeMask contentTypeMask,
+                                                     const std::string& documentUrl,
+                                                     const std::string& siteKey,
+                                                     bool specificOnly) const
+{
+  ParsedUrl parsedUrl;
+  auto parseResult = UrlParser::Parse(url, &parsedUrl);
+  if (parseResult == UrlParser::Result::INVALID)
+    return Filter();
+
   JsValueList params;
   params.push_back(jsEngine.NewValue(url));
+  if (parseResult == UrlParser::Result::VALID)
+  {
+    params.push_back(jsEngine.NewValue(parsedUrl.scheme + ":"));
+    params.push_back(jsEngine.NewValue(parsedUrl.asciiHost));
+  }
   params.push_back(jsEngine.NewValue(contentTypeMask));
-  params.push_back(jsEngine.NewValue(documentUrl));
+  if (parseResult == UrlParser::Result::VALID)
+    params.push_back(jsEngine.NewValue(UrlParser::ExtractHost(documentUrl)));
+  else
+    params.push_back(jsEngine.NewValue(documentUrl));
   params.push_back(jsEngine.NewValue(siteKey));
   params.push_back(jsEngine.NewValue(specificOnly));
-  JsValue result = func.Call(params);
+  JsValue result = api->Call(parseResult == UrlParser::Result::VALID
+                                 ? ApiFunctions::Function::CHECK_PARSED_FILTER_MATCH
+                                 : ApiFunctions::Function::CHECK_FILTER_MATCH,
+                             params);
   if (!result.IsNull())
     return Filter(std::make_unique<DefaultFilterImplementation>(std::move(result), &jsEngine));
   else
@@ -174,38 +501,78 @@ Filter DefaultFilterEngine::CheckFilterMatch(const std::string& url,
 std::string DefaultFilterEngine::GetElementHidingStyleSheet(const std::string& domain,
                                                             bool specificOnly) const
 {
-  JsValueList params;
-  params.push_back(jsEngine.NewValue(domain));
-  params.push_back(jsEngine.NewValue(specificOnly));
-  JsValue func = jsEngine.Evaluate("API.getElementHidingStyleSheet");
-  return func.Call(params).AsString();
+  return jsEngine.RunInteractive([&]() {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    auto* snapshot = GetGenericElementHidingSnapshot(domain);
+    if (snapshot && snapshot->styleSheets[specificOnly])
+      return *snapshot->styleSheets[specificOnly];
+
+    JsValueList params;
+    params.push_back(jsEngine.NewValue(domain));
+    params.push_back(jsEngine.NewValue(specificOnly));
+    std::string styleSheet =
+        api->Call(ApiFunctions::Function::GET_ELEMENT_HIDING_STYLE_SHEET, params).AsString();
+    if (snapshot)
+      snapshot->styleSheets[specificOnly].reset(new std::string(styleSheet));
+    return styleSheet;
+  });
+}
+
+std::string DefaultFilterEngine::GetElementHidingStyleSheet(const FrameContext& frame) const
+{
+  return jsEngine.RunInteractive([&]() -> std::string {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    if (IsContentAllowlisted(CONTENT_TYPE_ELEMHIDE, frame))
+      return "";
+    return GetElementHidingStyleSheet(frame.GetDocumentUrl(),
+                                      IsContentAllowlisted(CONTENT_TYPE_GENERICHIDE, frame));
+  });
+}
+
+std::vector<IFilterEngine::EmulationSelector>
+DefaultFilterEngine::GetElementHidingEmulationSelectors(const FrameContext& frame) const
+{
+  return jsEngine.RunInteractive([&]() -> std::vector<EmulationSelector> {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    if (IsContentAllowlisted(CONTENT_TYPE_ELEMHIDE, frame))
+      return {};
+    return GetElementHidingEmulationSelectors(frame.GetDocumentUrl());
+  });
 }
 
 std::vector<IFilterEngine::EmulationSelector>
 DefaultFilterEngine::GetElementHidingEmulationSelectors(const std::string& domain) const
 {
-  JsValue func = jsEngine.Evaluate("API.getElementHidingEmulationSelectors");
-  JsValueList result = func.Call(jsEngine.NewValue(domain)).AsList();
-  std::vector<IFilterEngine::EmulationSelector> selectors;
-  selectors.reserve(result.size());
-  for (const auto& r : result)
-    selectors.push_back({r.GetProperty("selector").AsString(), r.GetProperty("text").AsString()});
-  return selectors;
+  return jsEngine.RunInteractive([&]() {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    auto* snapshot = GetGenericElementHidingSnapshot(domain);
+    if (snapshot && snapshot->emulationSelectors)
+      return *snapshot->emulationSelectors;
+
+    JsValueList result = api->Call(ApiFunctions::Function::GET_ELEMENT_HIDING_EMULATION_SELECTORS,
+                                   jsEngine.NewValue(domain))
+                             .AsList();
+    std::vector<IFilterEngine::EmulationSelector> selectors;
+    selectors.reserve(result.size());
+    for (const auto& r : result)
+      selectors.push_back({r.GetProperty("selector").AsString(), r.GetProperty("text").AsString()});
+    if (snapshot)
+      snapshot->emulationSelectors.reset(new std::vector<EmulationSelector>(selectors));
+    return selectors;
+  });
 }
 
 JsValue DefaultFilterEngine::GetPref(const std::string& pref) const
 {
-  JsValue func = jsEngine.Evaluate("API.getPref");
-  return func.Call(jsEngine.NewValue(pref));
+  return api->Call(ApiFunctions::Function::GET_PREF, jsEngine.NewValue(pref));
 }
 
 void DefaultFilterEngine::SetPref(const std::string& pref, const JsValue& value)
 {
-  JsValue func = jsEngine.Evaluate("API.setPref");
   JsValueList params;
   params.push_back(jsEngine.NewValue(pref));
   params.push_back(value);
-  func.Call(params);
+  api->Call(ApiFunctions::Function::SET_PREF, params);
 }
 
 void DefaultFilterEngine::AddEventObserver(EventObserver* observer)
@@ -225,7 +592,9 @@ void DefaultFilterEngine::RemoveEventObserver(EventObserver* observer)
 
 void DefaultFilterEngine::SetAllowedConnectionType(const std::string* value)
 {
-  SetPref("allowed_connection_type", value ? jsEngine.NewValue(*value) : jsEngine.NewValue(""));
+  jsEngine.RunInteractive([&]() {
+    SetPref("allowed_connection_type", value ? jsEngine.NewValue(*value) : jsEngine.NewValue(""));
+  });
 }
 
 // static
@@ -360,12 +729,35 @@ bool DefaultFilterEngine::Transform(const std::string& eventStr, SubscriptionEve
   return false;
 }
 
+// static
+bool DefaultFilterEngine::AffectsMatching(const std::string& action)
+{
+  // Statistics and subscription metadata don't change which filters are
+  // active, all other events might.
+  static const std::string ignoredActions[] = {"save",
+                                               "filter.hitCount",
+                                               "filter.lastHit",
+                                               "filter.moved",
+                                               "subscription.downloading",
+                                               "subscription.downloadStatus",
+                                               "subscription.errors",
+                                               "subscription.fixedTitle",
+                                               "subscription.title",
+                                               "subscription.homepage",
+                                               "subscription.lastCheck",
+                                               "subscription.lastDownload"};
+  return std::find(std::begin(ignoredActions), std::end(ignoredActions), action) ==
+         std::end(ignoredActions);
+}
+
 std::unique_ptr<std::string> DefaultFilterEngine::GetAllowedConnectionType() const
 {
-  auto prefValue = GetPref("allowed_connection_type");
-  if (prefValue.AsString().empty())
-    return nullptr;
-  return std::unique_ptr<std::string>(new std::string(prefValue.AsString()));
+  return jsEngine.RunInteractive([&]() -> std::unique_ptr<std::string> {
+    auto prefValue = GetPref("allowed_connection_type");
+    if (prefValue.AsString().empty())
+      return nullptr;
+    return std::unique_ptr<std::string>(new std::string(prefValue.AsString()));
+  });
 }
 
 void DefaultFilterEngine::OnSubscriptionOrFilterChanged(JsValueList&& params) const
@@ -373,6 +765,25 @@ void DefaultFilterEngine::OnSubscriptionOrFilterChanged(JsValueList&& params) co
   std::string action(params.size() >= 1 && !params[0].IsNull() ? params[0].AsString() : "");
   JsValue item(params.size() >= 2 ? params[1] : jsEngine.NewValue(false));
 
+  if (AffectsMatching(action))
+  {
+    ++filtersGeneration_;
+    matchCache_.Invalidate();
+    // Called from JavaScript, so the engine is locked.
+    if (nativeMatcherEnabled_)
+    {
+      // Changed filters are applied to the current native matcher, element
+      // hiding updates don't concern it, anything else requires a rebuild.
+      if ((action == "filter.added" || action == "filter.removed") && item.IsObject())
+        changedFilters_.push_back(item.GetProperty("text").AsString());
+      else if (action != "elemhideupdate")
+        nativeMatcherRebuildNeeded_ = true;
+      // Until then the filters are still being loaded, see OnFiltersLoaded().
+      if (filtersLoaded_)
+        ScheduleNativeMatcherUpdate();
+    }
+  }
+
   std::unique_lock<std::mutex> lock(callbacksMutex_);
 
   FilterEvent filterEvent;
@@ -389,9 +800,9 @@ void DefaultFilterEngine::OnSubscriptionOrFilterChanged(JsValueList&& params) co
   }
   else if (Transform(action, &subscriptionEvent))
   {
-    Subscription subscription(item.IsObject() ? std::make_unique<DefaultSubscriptionImplementation>(
-                                                    std::move(item), &jsEngine)
-                                              : nullptr);
+    Subscription subscription(
+        item.IsObject() ? std::make_unique<DefaultSubscriptionImplementation>(std::move(item), api)
+                        : nullptr);
 
     for (auto* observer : observers_)
     {
@@ -406,38 +817,41 @@ bool DefaultFilterEngine::VerifySignature(const std::string& key,
                                           const std::string& host,
                                           const std::string& userAgent) const
 {
-  JsValueList params;
-  params.push_back(jsEngine.NewValue(key));
-  params.push_back(jsEngine.NewValue(signature));
-  params.push_back(jsEngine.NewValue(uri));
-  params.push_back(jsEngine.NewValue(host));
-  params.push_back(jsEngine.NewValue(userAgent));
-  JsValue func = jsEngine.Evaluate("API.verifySignature");
-  return func.Call(params).AsBool();
+  return jsEngine.RunInteractive([&]() {
+    JsValueList params;
+    params.push_back(jsEngine.NewValue(key));
+    params.push_back(jsEngine.NewValue(signature));
+    params.push_back(jsEngine.NewValue(uri));
+    params.push_back(jsEngine.NewValue(host));
+    params.push_back(jsEngine.NewValue(userAgent));
+    return api->Call(ApiFunctions::Function::VERIFY_SIGNATURE, params).AsBool();
+  });
 }
 
 std::vector<std::string>
 DefaultFilterEngine::ComposeFilterSuggestions(const IElement* element) const
 {
-  JsValueList params;
-
-  params.push_back(jsEngine.NewValue(element->GetDocumentLocation()));
-  params.push_back(jsEngine.NewValue(element->GetLocalName()));
-  params.push_back(jsEngine.NewValue(element->GetAttribute("id")));
-  params.push_back(jsEngine.NewValue(element->GetAttribute("src")));
-  params.push_back(jsEngine.NewValue(element->GetAttribute("style")));
-  params.push_back(jsEngine.NewValue(element->GetAttribute("class")));
-  params.push_back(jsEngine.NewArray(Utils::GetAssociatedUrls(element)));
-
-  JsValue func = jsEngine.Evaluate("API.composeFilterSuggestions");
-  JsValueList suggestions = func.Call(params).AsList();
-  std::vector<std::string> res;
-  res.reserve(suggestions.size());
-
-  for (const auto& cur : suggestions)
-    res.push_back(cur.AsString());
-
-  return res;
+  return jsEngine.RunInteractive([&]() {
+    JsValueList params;
+
+    params.push_back(jsEngine.NewValue(element->GetDocumentLocation()));
+    params.push_back(jsEngine.NewValue(element->GetLocalName()));
+    params.push_back(jsEngine.NewValue(element->GetAttribute("id")));
+    params.push_back(jsEngine.NewValue(element->GetAttribute("src")));
+    params.push_back(jsEngine.NewValue(element->GetAttribute("style")));
+    params.push_back(jsEngine.NewValue(element->GetAttribute("class")));
+    params.push_back(jsEngine.NewArray(Utils::GetAssociatedUrls(element)));
+
+    JsValueList suggestions =
+        api->Call(ApiFunctions::Function::COMPOSE_FILTER_SUGGESTIONS, params).AsList();
+    std::vector<std::string> res;
+    res.reserve(suggestions.size());
+
+    for (const auto& cur : suggestions)
+      res.push_back(cur.AsString());
+
+    return res;
+  });
 }
 
 Filter DefaultFilterEngine::GetAllowlistingFilter(const std::string& url,
@@ -445,41 +859,479 @@ Filter DefaultFilterEngine::GetAllowlistingFilter(const std::string& url,
                                                   const std::vector<std::string>& documentUrls,
                                                   const std::string& sitekey) const
 {
-  // WebExt finds allow filters by iterating through parent frames of |url|.
-  // https://gitlab.com/eyeo/adblockplus/adblockpluschrome/-/blob/6a345b830841052c09cfce6faf77eb8e682d7b7a/lib/allowlisting.js#L84
-  for (auto it = documentUrls.begin(); it != documentUrls.end(); ++it)
+  auto nativeMatcher = GetNativeMatcher();
+  if (nativeMatcher)
   {
-    const auto& currentUrl = *it;
-    const auto parentIterator = std::next(it);
-    auto parentUrl = parentIterator != documentUrls.end() ? *parentIterator : "";
-    if (parentUrl.empty())
+    // Same frames and parent frames as API.getAllowlistingFilter.
+    bool mayMatch = false;
+    for (size_t i = 0; i < documentUrls.size() && !mayMatch; ++i)
     {
-      // This is the top of the frame hierarchy, pass currentUrl as parent.
-      // This is consistent with WebExt ("|| frame.url.hostname"):
-      // https://gitlab.com/eyeo/adblockplus/adblockpluschrome/-/blob/6a345b830841052c09cfce6faf77eb8e682d7b7a/lib/allowlisting.js#L53
-      parentUrl = currentUrl;
+      const auto& parentUrl =
+          i + 1 < documentUrls.size() && !documentUrls[i + 1].empty() ? documentUrls[i + 1]
+                                                                       : documentUrls[i];
+      mayMatch = !documentUrls[i].empty() &&
+                 nativeMatcher->MayMatch(documentUrls[i],
+                                         contentTypeMask,
+                                         UrlParser::ExtractHost(parentUrl),
+                                         sitekey);
     }
-    auto match = CheckFilterMatch(currentUrl, contentTypeMask, parentUrl, sitekey, false);
-    if (match.IsValid())
-      return match;
+    if (!mayMatch)
+      return Filter();
+  }
+
+  return jsEngine.RunInteractive([&]() {
+    JsValueList params;
+    params.push_back(jsEngine.NewValue(contentTypeMask));
+    params.push_back(jsEngine.NewArray(documentUrls));
+    params.push_back(jsEngine.NewValue(sitekey));
+    JsValue result = api->Call(ApiFunctions::Function::GET_ALLOWLISTING_FILTER, params);
+    if (!result.IsNull())
+      return Filter(std::make_unique<DefaultFilterImplementation>(std::move(result), &jsEngine));
+    else
+      return Filter();
+  });
+}
+
+// The JavaScript engine is locked while the result is looked up, computed and
+// stored, so the filters can't change in between.
+Filter DefaultFilterEngine::GetAllowlistingFilter(ContentTypeMask contentTypeMask,
+                                                  const FrameContext& frame) const
+{
+  return jsEngine.RunInteractive([&]() {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    uint64_t generation = filtersGeneration_;
+    Filter filter;
+    if (frame.FindAllowlistingFilter(contentTypeMask, generation, &filter))
+      return filter;
+    filter =
+        GetAllowlistingFilter("", contentTypeMask, frame.GetDocumentUrls(), frame.GetSiteKey());
+    frame.StoreAllowlistingFilter(contentTypeMask, generation, filter);
+    return filter;
+  });
+}
+
+// The snapshot of the filters is used without locking the JavaScript engine,
+// so requests which no filter matches are answered without waiting for
+// JavaScript. Readers only ever use the last published snapshot, it's
+// replaced whenever the filters change.
+std::shared_ptr<const NativeMatcher> DefaultFilterEngine::GetNativeMatcher() const
+{
+  auto snapshot = std::atomic_load(&nativeMatcherSnapshot_);
+  if (!snapshot)
+    return nullptr;
+  // Keeps the whole snapshot alive for as long as the matcher is used.
+  return std::shared_ptr<const NativeMatcher>(snapshot, snapshot->nativeMatcher.get());
+}
+
+bool DefaultFilterEngine::GetCachedResult(const NativeMatcherSnapshot& snapshot,
+                                          const MatchRequest& request,
+                                          MatchResult* result) const
+{
+  if (matchCacheSize_ == 0)
+    return false;
+  const std::string key = GetResultKey(request);
+  std::lock_guard<std::mutex> lock(snapshot.resultsMutex);
+  auto it = snapshot.results.find(key);
+  if (it == snapshot.results.end())
+    return false;
+  *result = it->second;
+  return true;
+}
+
+void DefaultFilterEngine::CacheResult(const NativeMatcherSnapshot& snapshot,
+                                      const MatchRequest& request,
+                                      const MatchResult& result) const
+{
+  if (matchCacheSize_ == 0)
+    return;
+  std::string key = GetResultKey(request);
+  std::lock_guard<std::mutex> lock(snapshot.resultsMutex);
+  if (snapshot.results.size() >= matchCacheSize_)
+    snapshot.results.clear();
+  snapshot.results[std::move(key)] = result;
+}
+
+// Adding or removing many filters at once emits an event per filter, the
+// native matcher is published once the JavaScript task which changed them is
+// over rather than for every single one.
+void DefaultFilterEngine::ScheduleNativeMatcherUpdate() const
+{
+  if (nativeMatcherUpdate_->scheduled)
+    return;
+  nativeMatcherUpdate_->scheduled = true;
+  jsEngine.GetIsolate()->EnqueueMicrotask(
+      &DefaultFilterEngine::RunNativeMatcherUpdate,
+      new std::shared_ptr<NativeMatcherUpdate>(nativeMatcherUpdate_));
+}
+
+void DefaultFilterEngine::RunNativeMatcherUpdate(void* data)
+{
+  std::unique_ptr<std::shared_ptr<NativeMatcherUpdate>> update(
+      static_cast<std::shared_ptr<NativeMatcherUpdate>*>(data));
+  (*update)->scheduled = false;
+  if ((*update)->filterEngine)
+    (*update)->filterEngine->UpdateNativeMatcherSnapshot();
+}
+
+// Brings the native matcher up to date with the changed filters and publishes
+// it. It's called once the filters have changed, with the JavaScript engine
+// still locked, so readers never have to build the snapshot themselves.
+void DefaultFilterEngine::UpdateNativeMatcherSnapshot() const
+{
+  auto snapshot = std::atomic_load(&nativeMatcherSnapshot_);
+  if (snapshot && changedFilters_.empty() && !nativeMatcherRebuildNeeded_)
+    return;
+  auto newSnapshot = std::make_shared<NativeMatcherSnapshot>();
+  try
+  {
+    if (snapshot && snapshot->nativeMatcher && !nativeMatcherRebuildNeeded_ &&
+        changedFilters_.size() <= MAX_CHANGED_FILTERS)
+      newSnapshot->nativeMatcher = UpdateNativeMatcher(*snapshot->nativeMatcher);
+    else
+      newSnapshot->nativeMatcher = BuildNativeMatcher();
+  }
+  catch (const std::exception& e)
+  {
+    // Without the native matcher all requests are matched in JavaScript.
+    jsEngine.GetLogSystem()(LogSystem::LOG_LEVEL_ERROR,
+                            std::string("Failed to build the native matcher: ") + e.what(),
+                            "");
+  }
+  changedFilters_.clear();
+  nativeMatcherRebuildNeeded_ = false;
+  std::atomic_store(&nativeMatcherSnapshot_,
+                    std::shared_ptr<const NativeMatcherSnapshot>(std::move(newSnapshot)));
+}
+
+// Element hiding filters are indexed by domain in JavaScript, yet for a
+// domain which none of them mentions the result is always the same. Those
+// domains are recognized natively and get the result retrieved for the first
+// of them. The JavaScript engine has to be locked.
+DefaultFilterEngine::ElementHidingSnapshot*
+DefaultFilterEngine::GetGenericElementHidingSnapshot(const std::string& domain) const
+{
+  if (!nativeMatcherEnabled_)
+    return nullptr;
+  if (!elementHidingSnapshot_ || elementHidingSnapshot_->generation != filtersGeneration_)
+  {
+    elementHidingSnapshot_.reset(new ElementHidingSnapshot());
+    elementHidingSnapshot_->generation = filtersGeneration_;
+    try
+    {
+      auto domains = std::make_unique<DomainTrie<bool>>();
+      const WarmStartImage* image = GetWarmStartImage();
+      const std::vector<std::string> mentionedDomains =
+          image ? image->elementHidingDomains : GetElementHidingDomains();
+      std::string trieDomain;
+      for (const auto& value : mentionedDomains)
+      {
+        if (ToTrieDomain(value, &trieDomain))
+          (*domains)[trieDomain] = true;
+      }
+      elementHidingSnapshot_->domains = std::move(domains);
+    }
+    catch (const std::exception& e)
+    {
+      jsEngine.GetLogSystem()(LogSystem::LOG_LEVEL_ERROR,
+                              std::string("Failed to get element hiding domains: ") + e.what(),
+                              "");
+    }
+  }
+  if (!elementHidingSnapshot_->domains)
+    return nullptr;
+
+  // Same as in API.getElementHidingStyleSheet().
+  std::string host =
+      domain.find(':') != std::string::npos ? UrlParser::ExtractHost(domain) : domain;
+  std::string trieDomain;
+  if (!ToTrieDomain(host, &trieDomain))
+    return nullptr;
+  bool mentioned = false;
+  elementHidingSnapshot_->domains->ForEachMatch(trieDomain,
+                                                [&mentioned](bool) { mentioned = true; });
+  return mentioned ? nullptr : elementHidingSnapshot_.get();
+}
+
+std::unique_ptr<NativeMatcher> DefaultFilterEngine::BuildNativeMatcher() const
+{
+  const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+  auto nativeMatcher = std::make_unique<NativeMatcher>();
+  bool saveWarmStartImage;
+  if (const WarmStartImage* image = GetWarmStartImage(&saveWarmStartImage))
+  {
+    for (const auto& filter : image->urlFilters)
+      nativeMatcher->Add(filter);
+    return nativeMatcher;
+  }
+
+  WarmStartImage newImage;
+  AddURLFilterData(api->Call(ApiFunctions::Function::GET_URL_FILTER_DATA),
+                   nativeMatcher.get(),
+                   saveWarmStartImage ? &newImage.urlFilters : nullptr);
+  if (saveWarmStartImage)
+  {
+    newImage.elementHidingDomains = GetElementHidingDomains();
+    SaveWarmStartImage(std::move(newImage));
   }
-  return Filter();
+  return nativeMatcher;
+}
+
+// Applies the changed filters to a copy of the native matcher, only the
+// changed filters have to be retrieved from JavaScript.
+std::unique_ptr<NativeMatcher>
+DefaultFilterEngine::UpdateNativeMatcher(const NativeMatcher& nativeMatcher) const
+{
+  const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+  auto updatedMatcher = std::make_unique<NativeMatcher>(nativeMatcher);
+  // Filters which are still active are added back.
+  for (const auto& text : changedFilters_)
+    updatedMatcher->Remove(text);
+  AddURLFilterData(
+      api->Call(ApiFunctions::Function::GET_URL_FILTER_DATA, jsEngine.NewArray(changedFilters_)),
+      updatedMatcher.get());
+  return updatedMatcher;
+}
+
+void DefaultFilterEngine::AddURLFilterData(const JsValue& data,
+                                           NativeMatcher* nativeMatcher,
+                                           std::vector<NativeMatcher::UrlFilter>* filters) const
+{
+  auto* isolate = jsEngine.GetIsolate();
+  const JsContext context(isolate, *jsEngine.GetContext());
+  if (!data.IsArray())
+    throw std::runtime_error("API.getURLFilterData didn't return an array");
+
+  // See API.getURLFilterData for the layout.
+  auto list = v8::Local<v8::Array>::Cast(data.UnwrapValue());
+  uint32_t length = list->Length();
+  uint32_t i = 0;
+  auto next = [&]() {
+    if (i >= length)
+      throw std::runtime_error("Unexpected end of URL filter data");
+    return CHECKED_TO_LOCAL(isolate, list->Get(context.GetV8Context(), i++));
+  };
+  auto nextString = [&]() { return Utils::FromV8String(isolate, next()); };
+  auto nextBool = [&]() { return next()->BooleanValue(isolate); };
+  auto nextUint = [&]() {
+    return CHECKED_TO_VALUE(next()->Uint32Value(context.GetV8Context()));
+  };
+
+  while (i < length)
+  {
+    NativeMatcher::UrlFilter filter;
+    filter.text = nextString();
+    auto pattern = next();
+    filter.hasPattern = pattern->IsString();
+    if (filter.hasPattern)
+      filter.pattern = Utils::FromV8String(isolate, pattern);
+    filter.isRegExp = nextBool();
+    filter.contentType = nextUint();
+    filter.matchCase = nextBool();
+    filter.hasSitekeys = nextBool();
+    uint32_t domainCount = nextUint();
+    for (uint32_t j = 0; j < domainCount; ++j)
+    {
+      std::string domain = nextString();
+      filter.domains.emplace_back(std::move(domain), nextBool());
+    }
+    nativeMatcher->Add(filter);
+    if (filters)
+      filters->push_back(std::move(filter));
+  }
+}
+
+std::vector<std::string> DefaultFilterEngine::GetElementHidingDomains() const
+{
+  std::vector<std::string> domains;
+  for (const auto& value : api->Call(ApiFunctions::Function::GET_ELEMENT_HIDING_DOMAINS).AsList())
+    domains.push_back(value.AsString());
+  return domains;
+}
+
+// The image is read while the filters are being loaded, patterns.ini has to
+// be read before they are loaded completely. Otherwise it might already have
+// been saved with other filters.
+void DefaultFilterEngine::LoadWarmStartImage()
+{
+  warmStart_ = std::make_shared<WarmStart>();
+  auto warmStart = warmStart_;
+  auto& fileSystem = jsEngine.GetFileSystem();
+  auto readImage = [warmStart, &fileSystem](const std::string& key) {
+    {
+      std::lock_guard<std::mutex> lock(warmStart->mutex);
+      if (warmStart->initialized)
+        return;
+      warmStart->key = key;
+    }
+    fileSystem.Read(
+        WarmStartImage::fileName,
+        [warmStart, key](IFileSystem::IOBuffer&& data) {
+          std::unique_ptr<WarmStartImage> image(new WarmStartImage());
+          if (!image->Deserialize(data, key))
+            return;
+          std::lock_guard<std::mutex> lock(warmStart->mutex);
+          warmStart->image = std::move(image);
+        },
+        [](const std::string&) {});
+  };
+  // Changes since patterns.ini has been written as a whole are in its
+  // journal, the filters are loaded from both. Both are only hashed, chunk
+  // by chunk, JavaScript reads them on its own.
+  auto keyBuilder = std::make_shared<WarmStartImage::KeyBuilder>();
+  auto readJournal = [&fileSystem, keyBuilder, readImage]() {
+    auto hasJournal = std::make_shared<bool>(false);
+    fileSystem.ReadChunks(
+        FilterStorageJournal::GetFileName("patterns.ini"),
+        WARM_START_READ_CHUNK_SIZE,
+        [keyBuilder, readImage, hasJournal](IFileSystem::IOBuffer&& chunk,
+                                            const std::function<void()>& next) {
+          if (chunk.empty())
+            return readImage(keyBuilder->GetKey());
+          *hasJournal = true;
+          keyBuilder->AddJournal(chunk.data(), chunk.size());
+          next();
+        },
+        [keyBuilder, readImage, hasJournal](const std::string&) {
+          // A journal which was read only partly doesn't give a valid key.
+          if (!*hasJournal)
+            readImage(keyBuilder->GetKey());
+        });
+  };
+  fileSystem.ReadChunks(
+      "patterns.ini",
+      WARM_START_READ_CHUNK_SIZE,
+      [keyBuilder, readJournal](IFileSystem::IOBuffer&& chunk, const std::function<void()>& next) {
+        if (chunk.empty())
+          return readJournal();
+        keyBuilder->AddPatterns(chunk.data(), chunk.size());
+        next();
+      },
+      [](const std::string&) {});
+}
+
+void DefaultFilterEngine::OnFiltersLoaded()
+{
+  if (warmStart_)
+  {
+    std::lock_guard<std::mutex> lock(warmStart_->mutex);
+    warmStart_->initialized = true;
+    warmStart_->generation = filtersGeneration_;
+  }
+  filtersLoaded_ = true;
+  if (nativeMatcherEnabled_)
+  {
+    nativeMatcherRebuildNeeded_ = true;
+    UpdateNativeMatcherSnapshot();
+  }
+}
+
+// Returns the image if the filters are still the ones loaded at startup, sets
+// `save` if there is no image for them yet.
+const WarmStartImage* DefaultFilterEngine::GetWarmStartImage(bool* save) const
+{
+  if (save)
+    *save = false;
+  if (!warmStart_)
+    return nullptr;
+  std::lock_guard<std::mutex> lock(warmStart_->mutex);
+  if (!warmStart_->initialized || warmStart_->key.empty() ||
+      warmStart_->generation != filtersGeneration_)
+    return nullptr;
+  if (save)
+    *save = !warmStart_->image && !warmStart_->saved;
+  return warmStart_->image.get();
+}
+
+void DefaultFilterEngine::SaveWarmStartImage(WarmStartImage&& image) const
+{
+  std::string key;
+  {
+    std::lock_guard<std::mutex> lock(warmStart_->mutex);
+    if (warmStart_->saved)
+      return;
+    warmStart_->saved = true;
+    key = warmStart_->key;
+  }
+  // Without the image the next start only retrieves the data from JavaScript.
+  jsEngine.GetFileSystem().Write(
+      WarmStartImage::fileName, image.Serialize(key), [](const std::string&) {});
+}
+
+std::unique_ptr<DefaultFilterEngine::FilterState> DefaultFilterEngine::GetFilterState() const
+{
+  return jsEngine.RunInteractive([&]() {
+    auto* isolate = jsEngine.GetIsolate();
+    const JsContext context(isolate, *jsEngine.GetContext());
+    auto state = std::make_unique<FilterState>();
+    state->generation = filtersGeneration_;
+    JsValue data = api->Call(ApiFunctions::Function::GET_FILTER_STATE);
+    if (!data.IsArray())
+      throw std::runtime_error("API.getFilterState didn't return an array");
+
+    // See API.getFilterState for the layout.
+    auto list = v8::Local<v8::Array>::Cast(data.UnwrapValue());
+    uint32_t length = list->Length();
+    uint32_t i = 0;
+    auto next = [&]() {
+      if (i >= length)
+        throw std::runtime_error("Unexpected end of filter state");
+      return CHECKED_TO_LOCAL(isolate, list->Get(context.GetV8Context(), i++));
+    };
+    while (i < length)
+    {
+      FilterState::SubscriptionState subscription;
+      subscription.url = Utils::FromV8String(isolate, next());
+      subscription.disabled = next()->BooleanValue(isolate);
+      uint32_t filterCount = CHECKED_TO_VALUE(next()->Uint32Value(context.GetV8Context()));
+      subscription.filters.reserve(filterCount);
+      for (uint32_t j = 0; j < filterCount; ++j)
+        subscription.filters.push_back(Utils::FromV8String(isolate, next()));
+      state->subscriptions.push_back(std::move(subscription));
+    }
+    return state;
+  });
+}
+
+void DefaultFilterEngine::SetFilterState(const FilterState& state)
+{
+  jsEngine.RunInteractive([&]() {
+    auto* isolate = jsEngine.GetIsolate();
+    const JsContext context(isolate, *jsEngine.GetContext());
+    std::vector<v8::Local<v8::Value>> elements;
+    for (const auto& subscription : state.subscriptions)
+    {
+      elements.push_back(CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, subscription.url)));
+      elements.push_back(v8::Boolean::New(isolate, subscription.disabled));
+      elements.push_back(v8::Integer::NewFromUnsigned(
+          isolate, static_cast<uint32_t>(subscription.filters.size())));
+      for (const auto& filter : subscription.filters)
+        elements.push_back(CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, filter)));
+    }
+    api->Call(ApiFunctions::Function::SET_FILTER_STATE, jsEngine.NewArrayOfLocals(elements));
+  });
+}
+
+bool DefaultFilterEngine::MayMatch(const std::string& url,
+                                   ContentTypeMask contentTypeMask,
+                                   const std::string& documentHost,
+                                   const std::string& siteKey) const
+{
+  auto nativeMatcher = GetNativeMatcher();
+  return !nativeMatcher || nativeMatcher->MayMatch(url, contentTypeMask, documentHost, siteKey);
 }
 
 void DefaultFilterEngine::AddSubscription(const Subscription& subscription)
 {
   const auto* impl =
       static_cast<const DefaultSubscriptionImplementation*>(subscription.Implementation());
-  JsValue func = jsEngine.Evaluate("API.addSubscriptionToList");
-  func.Call(impl->jsObject);
+  api->Call(ApiFunctions::Function::ADD_SUBSCRIPTION_TO_LIST, impl->jsObject);
 }
 
 void DefaultFilterEngine::RemoveSubscription(const Subscription& subscription)
 {
   const auto* impl =
       static_cast<const DefaultSubscriptionImplementation*>(subscription.Implementation());
-  JsValue func = jsEngine.Evaluate("API.removeSubscriptionFromList");
-  func.Call(impl->jsObject);
+  api->Call(ApiFunctions::Function::REMOVE_SUBSCRIPTION_FROM_LIST, impl->jsObject);
 }
 
 void DefaultFilterEngine::AddFilter(const Filter& filter)
@@ -487,8 +1339,7 @@ void DefaultFilterEngine::AddFilter(const Filter& filter)
   if (!filter.IsValid())
     return;
   const auto* impl = static_cast<const DefaultFilterImplementation*>(filter.Implementation());
-  JsValue func = jsEngine.Evaluate("API.addFilterToList");
-  func.Call(impl->jsObject);
+  api->Call(ApiFunctions::Function::ADD_FILTER_TO_LIST, impl->jsObject);
 }
 
 void DefaultFilterEngine::RemoveFilter(const Filter& filter)
@@ -496,20 +1347,17 @@ void DefaultFilterEngine::RemoveFilter(const Filter& filter)
   if (!filter.IsValid())
     return;
   const auto* impl = static_cast<const DefaultFilterImplementation*>(filter.Implementation());
-  JsValue func = jsEngine.Evaluate("API.removeFilterFromList");
-  func.Call(impl->jsObject);
+  api->Call(ApiFunctions::Function::REMOVE_FILTER_FROM_LIST, impl->jsObject);
 }
 
 void DefaultFilterEngine::StartSynchronization()
 {
-  JsValue func = jsEngine.Evaluate("API.startSynchronization");
-  func.Call();
+  api->Call(ApiFunctions::Function::START_SYNCHRONIZATION);
 }
 
 void DefaultFilterEngine::StopSynchronization()
 {
-  JsValue func = jsEngine.Evaluate("API.stopSynchronization");
-  func.Call();
+  api->Call(ApiFunctions::Function::STOP_SYNCHRONIZATION);
 }
 
 void DefaultFilterEngine::StartObservingEvents()
@@ -517,6 +1365,11 @@ void DefaultFilterEngine::StartObservingEvents()
   AddEventObserver(&observer_);
 }
 
+void DefaultFilterEngine::ResolveApiFunctions()
+{
+  api->Resolve();
+}
+
 void DefaultFilterEngine::Observer::OnFilterEvent(FilterEvent event, const Filter&)
 {
   if (event == IFilterEngine::FilterEvent::FILTERS_SAVE)
@@ -528,12 +1381,13 @@ std::string AdblockPlus::DefaultFilterEngine::GetSnippetScript(const std::string
                                                                const std::string& injectedSource,
                                                                const std::vector<std::string>& injectedList)
 {
-  JsValueList params;
-  params.push_back(jsEngine.NewValue(documentUrl));
-  params.push_back(jsEngine.NewValue(isolatedSource));
-  params.push_back(jsEngine.NewValue(injectedSource));
-  params.push_back(jsEngine.NewArray(injectedList));
-
-  JsValue func = jsEngine.Evaluate("API.getSnippetsScript");
-  return func.Call(params).AsString();
+  return jsEngine.RunInteractive([&]() {
+    JsValueList params;
+    params.push_back(jsEngine.NewValue(documentUrl));
+    params.push_back(jsEngine.NewValue(isolatedSource));
+    params.push_back(jsEngine.NewValue(injectedSource));
+    params.push_back(jsEngine.NewArray(injectedList));
+
+    return api->Call(ApiFunctions::Function::GET_SNIPPETS_SCRIPT, params).AsString();
+  });
 }
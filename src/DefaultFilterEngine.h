@@ -17,14 +17,80 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include <AdblockPlus/FilterEngineFactory.h>
+#include <AdblockPlus/FrameContext.h>
 #include <AdblockPlus/IFilterEngine.h>
 
+#include "ApiFunctions.h"
+#include "AsyncMatcher.h"
+#include "DomainTrie.h"
+#include "MatchCache.h"
+#include "NativeMatcher.h"
+#include "WarmStartImage.h"
+
 namespace AdblockPlus
 {
   class DefaultFilterEngine : public IFilterEngine
   {
+    struct NativeMatcherSnapshot
+    {
+      // Null if the native matcher couldn't be built.
+      std::unique_ptr<const NativeMatcher> nativeMatcher;
+      // Results of MatchesBatch() for requests the native matcher couldn't
+      // rule out, found in JavaScript with the same filters. Repeated
+      // requests are answered from them without locking the JavaScript
+      // engine. Emptied once there are as many as the match cache holds.
+      mutable std::mutex resultsMutex;
+      mutable std::unordered_map<std::string, MatchResult> results;
+    };
+
+    // Lets the microtask which publishes the native matcher outlive the
+    // engine, only accessed with the JavaScript engine locked.
+    struct NativeMatcherUpdate
+    {
+      // Null once the engine is destroyed.
+      const DefaultFilterEngine* filterEngine;
+      bool scheduled = false;
+    };
+
+    struct ElementHidingSnapshot
+    {
+      // Domains the element hiding filters mention, null if they couldn't be
+      // retrieved.
+      std::unique_ptr<DomainTrie<bool>> domains;
+      // Generation of the filters the domains have been retrieved from.
+      uint64_t generation;
+      // Results for any domain which isn't in `domains`, indexed by
+      // `specificOnly`, retrieved on first use.
+      std::unique_ptr<std::string> styleSheets[2];
+      std::unique_ptr<std::vector<EmulationSelector>> emulationSelectors;
+    };
+
+    // Shared with the reads of the image, which may outlive the engine.
+    struct WarmStart
+    {
+      std::mutex mutex;
+      // Key of the filters in patterns.ini and its journal, empty until
+      // they are read or if there is no such file.
+      std::string key;
+      // Image matching `key`, set at most once.
+      std::unique_ptr<const WarmStartImage> image;
+      // Generation of the filters loaded at startup, the image only applies
+      // to them.
+      uint64_t generation = 0;
+      bool initialized = false;
+      bool saved = false;
+    };
+
   public:
-    explicit DefaultFilterEngine(JsEngine& jsEngine);
+    explicit DefaultFilterEngine(JsEngine& jsEngine,
+                                 const FilterEngineFactory::CreationParameters& parameters =
+                                     FilterEngineFactory::CreationParameters());
     ~DefaultFilterEngine();
 
     Filter GetFilter(const std::string& text) const final;
@@ -50,17 +116,47 @@ namespace AdblockPlus
                    const std::string& siteKey = "",
                    bool specificOnly = false) const final;
 
+    Filter Matches(const std::string& url,
+                   ContentTypeMask contentTypeMask,
+                   const FrameContext& frame) const final;
+
+    std::vector<MatchResult> MatchesBatch(const std::vector<MatchRequest>& requests) const final;
+
+    void MatchesAsync(const MatchRequest& request,
+                      const MatchCallback& callback,
+                      std::chrono::milliseconds timeout = std::chrono::milliseconds::max(),
+                      const MatchResult& fallback = {"", Filter::Type::TYPE_INVALID}) const final;
+
+    MatchCacheStats GetMatchCacheStats() const final;
+
     bool IsContentAllowlisted(const std::string& url,
                               ContentTypeMask contentTypeMask,
                               const std::vector<std::string>& documentUrls,
                               const std::string& sitekey = "") const final;
 
+    bool IsContentAllowlisted(ContentTypeMask contentTypeMask,
+                              const FrameContext& frame) const final;
+
+    BlockingDecision ShouldBlockRequest(const std::string& url,
+                                        ContentTypeMask contentTypeMask,
+                                        const std::vector<std::string>& documentUrls,
+                                        const std::string& siteKey = "") const final;
+
+    BlockingDecision ShouldBlockRequest(const std::string& url,
+                                        ContentTypeMask contentTypeMask,
+                                        const FrameContext& frame) const final;
+
     std::string GetElementHidingStyleSheet(const std::string& domain,
                                            bool specificOnly = false) const final;
 
+    std::string GetElementHidingStyleSheet(const FrameContext& frame) const final;
+
     std::vector<EmulationSelector>
     GetElementHidingEmulationSelectors(const std::string& domain) const final;
 
+    std::vector<EmulationSelector>
+    GetElementHidingEmulationSelectors(const FrameContext& frame) const final;
+
     void AddEventObserver(EventObserver* observer) final;
     void RemoveEventObserver(EventObserver* observer) final;
 
@@ -88,6 +184,48 @@ namespace AdblockPlus
                                  const std::vector<std::string>& injectedList) final;
 
     void StartObservingEvents();
+    void ResolveApiFunctions();
+
+    /**
+     * Remembers that the current filters are the ones loaded at startup and
+     * publishes the native matcher for them, has to be called with the
+     * JavaScript engine locked.
+     */
+    void OnFiltersLoaded();
+
+    /**
+     * Subscriptions and their filters, used to copy them to another engine.
+     */
+    struct FilterState
+    {
+      struct SubscriptionState
+      {
+        std::string url;
+        bool disabled;
+        std::vector<std::string> filters;
+      };
+
+      // Filters generation the state has been taken at.
+      uint64_t generation;
+      std::vector<SubscriptionState> subscriptions;
+    };
+
+    /**
+     * @return Number which changes whenever the filters relevant for
+     *         matching might have changed.
+     */
+    uint64_t GetFiltersGeneration() const
+    {
+      return filtersGeneration_;
+    }
+
+    std::unique_ptr<FilterState> GetFilterState() const;
+
+    /**
+     * Replaces all subscriptions and filters.
+     * @param state State taken from another engine with GetFilterState().
+     */
+    void SetFilterState(const FilterState& state);
 
   private:
     class Observer : public EventObserver
@@ -106,6 +244,7 @@ namespace AdblockPlus
     };
 
     JsEngine& jsEngine;
+    ApiFunctionsPtr api;
 
     JsValue GetPref(const std::string& pref) const;
     void SetPref(const std::string& pref, const JsValue& value);
@@ -115,17 +254,75 @@ namespace AdblockPlus
                             const std::string& documentUrl,
                             const std::string& siteKey,
                             bool specificOnly) const;
+    Filter CheckFilterMatchUncached(const std::string& url,
+                                    ContentTypeMask contentTypeMask,
+                                    const std::string& documentUrl,
+                                    const std::string& siteKey,
+                                    bool specificOnly) const;
 
     void OnSubscriptionOrFilterChanged(JsValueList&& params) const;
     Filter GetAllowlistingFilter(const std::string& url,
                                  ContentTypeMask contentTypeMask,
                                  const std::vector<std::string>& documentUrls,
                                  const std::string& sitekey) const;
+    Filter GetAllowlistingFilter(ContentTypeMask contentTypeMask, const FrameContext& frame) const;
+    std::shared_ptr<const NativeMatcher> GetNativeMatcher() const;
+    bool GetCachedResult(const NativeMatcherSnapshot& snapshot,
+                         const MatchRequest& request,
+                         MatchResult* result) const;
+    void CacheResult(const NativeMatcherSnapshot& snapshot,
+                     const MatchRequest& request,
+                     const MatchResult& result) const;
+    void ScheduleNativeMatcherUpdate() const;
+    static void RunNativeMatcherUpdate(void* data);
+    void UpdateNativeMatcherSnapshot() const;
+    std::unique_ptr<NativeMatcher> BuildNativeMatcher() const;
+    std::unique_ptr<NativeMatcher> UpdateNativeMatcher(const NativeMatcher& nativeMatcher) const;
+    void AddURLFilterData(const JsValue& data,
+                          NativeMatcher* nativeMatcher,
+                          std::vector<NativeMatcher::UrlFilter>* filters = nullptr) const;
+    std::vector<std::string> GetElementHidingDomains() const;
+    void LoadWarmStartImage();
+    // Returns the image of the current filters, if any. `save` is set if
+    // the image is still to be created and stored.
+    const WarmStartImage* GetWarmStartImage(bool* save = nullptr) const;
+    void SaveWarmStartImage(WarmStartImage&& image) const;
+    bool MayMatch(const std::string& url,
+                  ContentTypeMask contentTypeMask,
+                  const std::string& documentHost,
+                  const std::string& siteKey) const;
+    ElementHidingSnapshot* GetGenericElementHidingSnapshot(const std::string& domain) const;
     static bool Transform(const std::string& str, FilterEvent* event);
+    static bool AffectsMatching(const std::string& action);
     static bool Transform(const std::string& str, SubscriptionEvent* event);
 
     mutable std::mutex callbacksMutex_;
     Observer observer_{jsEngine};
+    mutable MatchCache matchCache_;
+    const size_t matchCacheSize_;
+    // Incremented whenever the active filters might have changed.
+    mutable std::atomic<uint64_t> filtersGeneration_{0};
+    const bool nativeMatcherEnabled_;
+    // Immutable once published, so it can be read without locking the
+    // JavaScript engine. Only accessed through std::atomic_load() and
+    // std::atomic_store(), null until the filters have been loaded.
+    mutable std::shared_ptr<const NativeMatcherSnapshot> nativeMatcherSnapshot_;
+    // Texts of the filters added or removed since the native matcher snapshot
+    // has been built, and whether other changes require building it from
+    // scratch. Only accessed with the JavaScript engine locked.
+    mutable std::vector<std::string> changedFilters_;
+    mutable bool nativeMatcherRebuildNeeded_ = false;
+    std::shared_ptr<NativeMatcherUpdate> nativeMatcherUpdate_;
+    // Whether OnFiltersLoaded() has been called, only accessed with the
+    // JavaScript engine locked.
+    bool filtersLoaded_ = false;
+    // Only accessed with the JavaScript engine locked.
+    mutable std::unique_ptr<ElementHidingSnapshot> elementHidingSnapshot_;
+    // Null unless the warm start image is enabled.
+    std::shared_ptr<WarmStart> warmStart_;
     std::vector<IFilterEngine::EventObserver*> observers_;
+    mutable std::mutex asyncMatcherMutex_;
+    // Created on first use of MatchesAsync.
+    mutable std::unique_ptr<AsyncMatcher> asyncMatcher_;
   };
 }
@@ -32,7 +32,13 @@ DefaultFilterImplementation::DefaultFilterImplementation(JsValue&& value, JsEngi
 
 IFilterImplementation::Type DefaultFilterImplementation::GetType() const
 {
-  std::string className = jsObject.GetClass();
+  return ClassNameToType(jsObject.GetClass());
+}
+
+// static
+IFilterImplementation::Type
+DefaultFilterImplementation::ClassNameToType(const std::string& className)
+{
   if (className == "BlockingFilter")
     return TYPE_BLOCKING;
   else if (className == "AllowingFilter")
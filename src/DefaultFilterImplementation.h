@@ -39,6 +39,13 @@ namespace AdblockPlus
     bool operator==(const IFilterImplementation& filter) const final;
     std::unique_ptr<IFilterImplementation> Clone() const final;
 
+    /**
+     * Maps the name of a JavaScript filter class to the filter type.
+     * @param className Name of the constructor of a JavaScript filter object.
+     * @return Filter type, TYPE_INVALID for an unknown class.
+     */
+    static Type ClassNameToType(const std::string& className);
+
   private:
     friend class DefaultFilterEngine;
     std::string GetStringProperty(const std::string& name) const;
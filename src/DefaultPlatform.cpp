@@ -19,6 +19,7 @@
 
 #include "DefaultPlatform.h"
 #include "JsEngine.h"
+#include "ReplicatedFilterEngine.h"
 
 using namespace AdblockPlus;
 
@@ -32,9 +33,28 @@ namespace
     if (!param)
       throw std::logic_error(paramName + std::string(" must not be nullptr"));
   }
+
+  void EvaluateJsSource(JsEngine& jsEngine, const std::string& filename)
+  {
+    if (jsEngine.IsEvaluatedInSnapshot(filename))
+      return;
+
+    for (int i = 0; !jsSources[i].empty(); i += 2)
+      if (jsSources[i] == filename)
+      {
+        jsEngine.Evaluate(jsSources[i + 1], jsSources[i]);
+        return;
+      }
+
+    assert(false && "Invalid argument: unknown JavaScript file");
+  }
 }
 
 DefaultPlatform::DefaultPlatform(PlatformFactory::CreationParameters&& creationParameters)
+    : useJsEventLoop_(creationParameters.useJsEventLoop),
+      jsTimeSlice_(creationParameters.jsTimeSlice),
+      jsLineChunkSize_(creationParameters.jsLineChunkSize),
+      useJsCodeCache_(creationParameters.useJsCodeCache)
 {
 #define ASSIGN_PLATFORM_PARAM(param)                                                               \
   ValidatePlatformCreationParameter(param = std::move(creationParameters.param), #param)
@@ -52,6 +72,8 @@ DefaultPlatform::DefaultPlatform(PlatformFactory::CreationParameters&& creationP
 DefaultPlatform::~DefaultPlatform()
 {
   executor->Stop();
+  if (jsEngine)
+    jsEngine->StopEventLoop();
 }
 
 JsEngine& DefaultPlatform::GetJsEngine()
@@ -65,8 +87,11 @@ void DefaultPlatform::SetUp(const AppInfo& appInfo, std::unique_ptr<IV8IsolatePr
   std::lock_guard<std::mutex> lock(modulesMutex_);
   if (jsEngine)
     return;
+  appInfo_ = appInfo;
   JsEngine::Interfaces interfaces{*timer, *fileSystem, *webRequest, *logSystem, *resourceReader};
-  jsEngine = JsEngine::New(appInfo, interfaces, std::move(isolate));
+  jsEngine = JsEngine::New(appInfo, interfaces, std::move(isolate), useJsEventLoop_);
+  jsEngine->SetTimeSlice(jsTimeSlice_);
+  jsEngine->SetLineChunkSize(jsLineChunkSize_);
 }
 
 void DefaultPlatform::CreateFilterEngineAsync(
@@ -83,16 +108,44 @@ void DefaultPlatform::CreateFilterEngineAsync(
   }
 
   GetJsEngine(); // ensures that JsEngine is instantiated
-  FilterEngineFactory::CreateAsync(
-      *jsEngine,
-      GetEvaluateCallback(),
-      [onCreated, filterEnginePromise](std::unique_ptr<IFilterEngine> filterEngine) {
-        const auto& filterEngineRef = *filterEngine;
-        filterEnginePromise->set_value(std::move(filterEngine));
-        if (onCreated)
-          onCreated(filterEngineRef);
-      },
-      parameters);
+  auto setFilterEngine = [onCreated,
+                          filterEnginePromise](std::unique_ptr<IFilterEngine> filterEngine) {
+    const auto& filterEngineRef = *filterEngine;
+    filterEnginePromise->set_value(std::move(filterEngine));
+    if (onCreated)
+      onCreated(filterEngineRef);
+  };
+  auto createFilterEngine = [this, parameters, setFilterEngine]() {
+    FilterEngineFactory::CreateAsync(
+        *jsEngine,
+        GetEvaluateCallback(),
+        [this, parameters, setFilterEngine](std::unique_ptr<IFilterEngine> filterEngine) {
+          if (parameters.replicaCount == 0)
+          {
+            setFilterEngine(std::move(filterEngine));
+            return;
+          }
+          ReplicatedFilterEngine::CreateAsync(std::move(filterEngine),
+                                              parameters,
+                                              appInfo_,
+                                              {*logSystem, *resourceReader},
+                                              &EvaluateJsSource,
+                                              setFilterEngine);
+        },
+        parameters);
+  };
+  if (!useJsCodeCache_)
+  {
+    createFilterEngine();
+    return;
+  }
+  std::vector<std::string> fileNames;
+  for (int i = 0; !jsSources[i].empty(); i += 2)
+  {
+    if (!jsEngine->IsEvaluatedInSnapshot(jsSources[i]))
+      fileNames.push_back(jsSources[i]);
+  }
+  jsEngine->UseCodeCache(fileNames, createFilterEngine);
 }
 
 IFilterEngine& DefaultPlatform::GetFilterEngine()
@@ -134,14 +187,7 @@ std::function<void(const std::string&)> DefaultPlatform::GetEvaluateCallback()
     if (evaluatedJsSources_.find(filename) != evaluatedJsSources_.end())
       return; // NO-OP, file was already evaluated
 
-    for (int i = 0; !jsSources[i].empty(); i += 2)
-      if (jsSources[i] == filename)
-      {
-        jsEngine->Evaluate(jsSources[i + 1], jsSources[i]);
-        evaluatedJsSources_.insert(filename);
-        return;
-      }
-
-    assert(false && "Invalid argument: unknown JavaScript file");
+    EvaluateJsSource(*jsEngine, filename);
+    evaluatedJsSources_.insert(filename);
   };
 }
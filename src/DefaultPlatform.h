@@ -57,6 +57,12 @@ namespace AdblockPlus
 
   private:
     std::unique_ptr<IExecutor> executor;
+    bool useJsEventLoop_;
+    std::chrono::milliseconds jsTimeSlice_;
+    size_t jsLineChunkSize_;
+    bool useJsCodeCache_;
+    // Passed to the JavaScript engines of filter engine replicas.
+    AppInfo appInfo_;
     // used for creation and deletion of modules.
     std::mutex modulesMutex_;
     std::shared_future<std::unique_ptr<IFilterEngine>> filterEngine_;
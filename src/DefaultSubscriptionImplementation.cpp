@@ -26,8 +26,8 @@
 using namespace AdblockPlus;
 
 DefaultSubscriptionImplementation::DefaultSubscriptionImplementation(JsValue&& object,
-                                                                     JsEngine* engine)
-    : jsObject(std::move(object)), jsEngine(engine)
+                                                                     ApiFunctionsPtr api)
+    : jsObject(std::move(object)), api(std::move(api))
 {
   if (!jsObject.IsObject())
     throw std::runtime_error("JavaScript value is not an object");
@@ -45,19 +45,17 @@ void DefaultSubscriptionImplementation::SetDisabled(bool value)
 
 void DefaultSubscriptionImplementation::UpdateFilters()
 {
-  JsValue func = jsEngine->Evaluate("API.updateSubscription");
-  func.Call(jsObject);
+  api->Call(ApiFunctions::Function::UPDATE_SUBSCRIPTION, jsObject);
 }
 
 bool DefaultSubscriptionImplementation::IsUpdating() const
 {
-  JsValue func = jsEngine->Evaluate("API.isSubscriptionUpdating");
-  return func.Call(jsObject).AsBool();
+  return api->Call(ApiFunctions::Function::IS_SUBSCRIPTION_UPDATING, jsObject).AsBool();
 }
 
 bool DefaultSubscriptionImplementation::IsAA() const
 {
-  return jsEngine->Evaluate("API.isAASubscription").Call(jsObject).AsBool();
+  return api->Call(ApiFunctions::Function::IS_AA_SUBSCRIPTION, jsObject).AsBool();
 }
 
 std::string DefaultSubscriptionImplementation::GetTitle() const
@@ -130,5 +128,5 @@ int DefaultSubscriptionImplementation::GetIntProperty(const std::string& name) c
 std::unique_ptr<ISubscriptionImplementation> DefaultSubscriptionImplementation::Clone() const
 {
   JsValue copyObject = jsObject;
-  return std::make_unique<DefaultSubscriptionImplementation>(std::move(copyObject), jsEngine);
+  return std::make_unique<DefaultSubscriptionImplementation>(std::move(copyObject), api);
 }
@@ -20,6 +20,8 @@
 #include <AdblockPlus/ISubscriptionImplementation.h>
 #include <AdblockPlus/JsValue.h>
 
+#include "ApiFunctions.h"
+
 namespace AdblockPlus
 {
   class DefaultSubscriptionImplementation : public ISubscriptionImplementation
@@ -30,9 +32,9 @@ namespace AdblockPlus
      * Normally you shouldn't call this directly, but use
      * IFilterEngine::GetSubscription() instead.
      * @param object JavaScript subscription object.
-     * @param engine JavaScript engine to make calls on object.
+     * @param api Table of the API functions to make calls on object.
      */
-    DefaultSubscriptionImplementation(JsValue&& object, JsEngine* jsEngine);
+    DefaultSubscriptionImplementation(JsValue&& object, ApiFunctionsPtr api);
 
     bool IsDisabled() const final;
     void SetDisabled(bool value) final;
@@ -59,6 +61,6 @@ namespace AdblockPlus
     int GetIntProperty(const std::string& name) const;
 
     JsValue jsObject;
-    JsEngine* jsEngine{nullptr};
+    ApiFunctionsPtr api;
   };
 }
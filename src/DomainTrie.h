@@ -0,0 +1,149 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace AdblockPlus
+{
+  /**
+   * Map from domain names to values, stored as a tree of domain labels
+   * starting with the top-level domain. All values stored for a host and its
+   * parent domains are found in a single walk over the labels of the host,
+   * instead of one lookup per parent domain.
+   * Domain names are expected in lower case, empty labels, e.g. of a leading
+   * or doubled dot, are skipped.
+   */
+  template<typename T>
+  class DomainTrie
+  {
+  public:
+    DomainTrie() : root(new Node()), size(0)
+    {
+    }
+
+    DomainTrie(const DomainTrie& other) : root(new Node(*other.root)), size(other.size)
+    {
+    }
+
+    DomainTrie& operator=(const DomainTrie& other)
+    {
+      root.reset(new Node(*other.root));
+      size = other.size;
+      return *this;
+    }
+
+    /**
+     * @param domain Domain name with at least one label.
+     * @return Value stored for `domain`, value-initialized if there is none
+     *         yet.
+     */
+    T& operator[](const std::string& domain)
+    {
+      assert(!domain.empty());
+      Node* node = root.get();
+      size_t end = domain.size();
+      while (end > 0)
+      {
+        size_t dot = domain.rfind('.', end - 1);
+        size_t start = dot == std::string::npos ? 0 : dot + 1;
+        if (start < end)
+        {
+          auto& child = node->children[domain.substr(start, end - start)];
+          if (!child)
+            child.reset(new Node());
+          node = child.get();
+        }
+        if (start == 0)
+          break;
+        end = dot;
+      }
+      assert(node != root.get());
+      if (!node->value)
+      {
+        node->value.reset(new T());
+        ++size;
+      }
+      return *node->value;
+    }
+
+    /**
+     * Calls `callback` with the value of every domain stored which `host`
+     * equals or is a subdomain of, starting with the top-level domain, so
+     * the value for the most specific domain comes last.
+     * @param host Host name.
+     * @param callback Function taking `const T&`.
+     */
+    template<typename Callback>
+    void ForEachMatch(const std::string& host, Callback&& callback) const
+    {
+      if (host.empty())
+        return;
+      const Node* node = root.get();
+      std::string label;
+      size_t end = host.size();
+      while (end > 0)
+      {
+        size_t dot = host.rfind('.', end - 1);
+        size_t start = dot == std::string::npos ? 0 : dot + 1;
+        if (start < end)
+        {
+          label.assign(host, start, end - start);
+          auto it = node->children.find(label);
+          if (it == node->children.end())
+            return;
+          node = it->second.get();
+          if (node->value)
+            callback(static_cast<const T&>(*node->value));
+        }
+        if (start == 0)
+          return;
+        end = dot;
+      }
+    }
+
+    /**
+     * @return Number of domains stored.
+     */
+    size_t Size() const
+    {
+      return size;
+    }
+
+  private:
+    struct Node
+    {
+      Node() = default;
+
+      Node(const Node& other) : value(other.value ? new T(*other.value) : nullptr)
+      {
+        for (const auto& child : other.children)
+          children[child.first].reset(new Node(*child.second));
+      }
+
+      std::unordered_map<std::string, std::unique_ptr<Node>> children;
+      std::unique_ptr<T> value;
+    };
+
+    std::unique_ptr<Node> root;
+    size_t size;
+  };
+}
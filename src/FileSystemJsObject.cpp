@@ -17,6 +17,9 @@
 
 #include "FileSystemJsObject.h"
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
@@ -25,6 +28,9 @@
 #include <AdblockPlus/JsValue.h>
 #include <AdblockPlus/Platform.h>
 
+#include "AsciiScanner.h"
+#include "FilterStorageFile.h"
+#include "FilterStorageJournal.h"
 #include "JsContext.h"
 #include "JsError.h"
 #include "Utils.h"
@@ -34,6 +40,174 @@ using AdblockPlus::Utils::ThrowExceptionInJS;
 
 namespace
 {
+  /**
+   * Forwards calls to the file system of `jsEngine` and posts the callbacks
+   * as background tasks of the engine, see `JsEngine::Post`.
+   */
+  class BackgroundFileSystem
+  {
+  public:
+    explicit BackgroundFileSystem(JsEngine* jsEngine) : jsEngine(jsEngine)
+    {
+    }
+
+    void Read(const std::string& fileName,
+              const IFileSystem::ReadCallback& callback,
+              const IFileSystem::Callback& errorCallback) const
+    {
+      auto engine = jsEngine;
+      jsEngine->GetFileSystem().Read(
+          fileName,
+          [engine, callback](IFileSystem::IOBuffer&& data) {
+            auto buffer = std::make_shared<IFileSystem::IOBuffer>(std::move(data));
+            engine->Post(JsEventLoop::Priority::BACKGROUND, [callback, buffer] {
+              callback(std::move(*buffer));
+            });
+          },
+          Wrap(errorCallback));
+    }
+
+    void ReadContent(const std::string& fileName,
+                     const IFileSystem::ReadContentCallback& callback,
+                     const IFileSystem::Callback& errorCallback) const
+    {
+      auto engine = jsEngine;
+      jsEngine->GetFileSystem().ReadContent(
+          fileName,
+          [engine, callback](const IFileSystem::FileContentPtr& content) {
+            engine->Post(JsEventLoop::Priority::BACKGROUND, [callback, content] {
+              callback(content);
+            });
+          },
+          Wrap(errorCallback));
+    }
+
+    void ReadChunks(const std::string& fileName,
+                    size_t chunkSize,
+                    const IFileSystem::ReadChunkCallback& callback,
+                    const IFileSystem::Callback& errorCallback) const
+    {
+      auto engine = jsEngine;
+      jsEngine->GetFileSystem().ReadChunks(
+          fileName,
+          chunkSize,
+          [engine, callback](IFileSystem::IOBuffer&& chunk, const std::function<void()>& next) {
+            auto buffer = std::make_shared<IFileSystem::IOBuffer>(std::move(chunk));
+            engine->Post(JsEventLoop::Priority::BACKGROUND, [callback, buffer, next] {
+              callback(std::move(*buffer), next);
+            });
+          },
+          Wrap(errorCallback));
+    }
+
+    void Write(const std::string& fileName,
+               const IFileSystem::IOBuffer& data,
+               const IFileSystem::Callback& callback) const
+    {
+      jsEngine->GetFileSystem().Write(fileName, data, Wrap(callback));
+    }
+
+    void Append(const std::string& fileName,
+                const IFileSystem::IOBuffer& data,
+                const IFileSystem::Callback& callback) const
+    {
+      jsEngine->GetFileSystem().Append(fileName, data, Wrap(callback));
+    }
+
+    void Move(const std::string& fromFileName,
+              const std::string& toFileName,
+              const IFileSystem::Callback& callback) const
+    {
+      jsEngine->GetFileSystem().Move(fromFileName, toFileName, Wrap(callback));
+    }
+
+    void Remove(const std::string& fileName, const IFileSystem::Callback& callback) const
+    {
+      jsEngine->GetFileSystem().Remove(fileName, Wrap(callback));
+    }
+
+    void Stat(const std::string& fileName, const IFileSystem::StatCallback& callback) const
+    {
+      auto engine = jsEngine;
+      jsEngine->GetFileSystem().Stat(
+          fileName,
+          [engine, callback](const IFileSystem::StatResult& statResult, const std::string& error) {
+            engine->Post(JsEventLoop::Priority::BACKGROUND, [callback, statResult, error] {
+              callback(statResult, error);
+            });
+          });
+    }
+
+  private:
+    IFileSystem::Callback Wrap(const IFileSystem::Callback& callback) const
+    {
+      auto engine = jsEngine;
+      return [engine, callback](const std::string& error) {
+        engine->Post(JsEventLoop::Priority::BACKGROUND, [callback, error] {
+          callback(error);
+        });
+      };
+    }
+
+    JsEngine* jsEngine;
+  };
+
+  // Calls the callback passed to a _fileSystem function with the error, if
+  // there is one.
+  void CallWithError(JsEngine* jsEngine,
+                     const JsEngine::ScopedWeakValues& weakCallbackValue,
+                     const std::string& error)
+  {
+    const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
+    JsValueList params;
+    if (!error.empty())
+      params.push_back(jsEngine->NewValue(error));
+    weakCallbackValue.Values()[0].Call(params);
+  }
+
+  // Content of a file written by _fileSystem.writeLines with the changes in
+  // its journal applied, see FilterStorageJournal.
+  struct StoredContent
+  {
+    IFileSystem::FileContentPtr file;
+    IFileSystem::IOBuffer journal;
+    std::vector<FilterStorageFile::Section> sections;
+  };
+
+  void ReadStoredContent(JsEngine* jsEngine,
+                         const std::string& fileName,
+                         const std::function<void(const std::shared_ptr<StoredContent>&)>& callback,
+                         const IFileSystem::Callback& errorCallback)
+  {
+    BackgroundFileSystem(jsEngine).ReadContent(
+        fileName,
+        [=](const IFileSystem::FileContentPtr& file) {
+          auto content = std::make_shared<StoredContent>();
+          content->file = file;
+          auto load = [=] {
+            try
+            {
+              content->sections = jsEngine->GetFilterStorageJournal().Load(
+                  fileName, file->data(), file->size(), content->journal);
+            }
+            catch (const std::exception& e)
+            {
+              return errorCallback(e.what());
+            }
+            callback(content);
+          };
+          // Without a journal there are no changes to apply.
+          BackgroundFileSystem(jsEngine).Read(
+              FilterStorageJournal::GetFileName(fileName),
+              [content, load](IFileSystem::IOBuffer&& journal) {
+                content->journal = std::move(journal);
+                load();
+              },
+              [load](const std::string&) { load(); });
+        },
+        errorCallback);
+  }
+
   namespace ReadCallback
   {
     static void V8Callback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
@@ -53,12 +227,18 @@ namespace
       JsEngine::ScopedWeakValues resolveWeakCallbackValue(jsEngine, {converted[1]});
       JsEngine::ScopedWeakValues rejectWeakCallbackValue(jsEngine, {converted[2]});
       auto fileName = converted[0].AsString();
-      jsEngine->GetFileSystem().Read(
+      BackgroundFileSystem(jsEngine).ReadContent(
           fileName,
-          [jsEngine, resolveWeakCallbackValue](IFileSystem::IOBuffer&& content) {
+          [jsEngine, resolveWeakCallbackValue](const IFileSystem::FileContentPtr& content) {
             const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
+            auto isolate = jsEngine->GetIsolate();
             auto result = jsEngine->NewObject();
-            result.SetStringBufferProperty("content", content);
+            auto jsContent =
+                CHECKED_TO_LOCAL(isolate, Utils::FileContentToV8String(isolate, content));
+            CHECKED_TO_VALUE(result.UnwrapValue().As<v8::Object>()->Set(
+                context.GetV8Context(),
+                CHECKED_TO_LOCAL(isolate, Utils::ToV8String(isolate, "content")),
+                jsContent));
             resolveWeakCallbackValue.Values()[0].Call(result);
           },
           [jsEngine, rejectWeakCallbackValue](const std::string& error) {
@@ -71,91 +251,373 @@ namespace
 
   namespace ReadFromFileCallback
   {
-    inline bool IsEndOfLine(char c)
+    inline bool IsEndOfLine(uint8_t c)
     {
       return c == 10 || c == 13;
     }
 
-    inline StringBuffer::const_iterator SkipEndOfLine(StringBuffer::const_iterator ii,
-                                                      StringBuffer::const_iterator end)
+    inline const uint8_t* SkipEndOfLine(const uint8_t* ii, const uint8_t* end)
     {
       while (ii != end && IsEndOfLine(*ii))
         ++ii;
       return ii;
     }
 
-    inline StringBuffer::const_iterator AdvanceToEndOfLine(StringBuffer::const_iterator ii,
-                                                           StringBuffer::const_iterator end)
+    inline const uint8_t* AdvanceToEndOfLine(const uint8_t* ii, const uint8_t* end)
     {
       while (ii != end && !IsEndOfLine(*ii))
         ++ii;
       return ii;
     }
 
-    void V8Callback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
+    // Size of the chunks in which files are read by readFromFile.
+    const size_t readChunkSize = 64 * 1024;
+
+    // Lines of a file being passed to the listener one by one, or in arrays
+    // of up to `chunkSize` lines if it's not zero. The file is read in
+    // chunks, the start of a line which continues in the next chunk is kept
+    // in `partialLine`.
+    struct LineReader
+    {
+      explicit LineReader(size_t chunkSize) : chunkSize(chunkSize)
+      {
+      }
+
+      void SetData(IFileSystem::IOBuffer&& newData)
+      {
+        data = std::move(newData);
+        position = data.data();
+        end = position + data.size();
+        isAscii = AsciiScanner::IsAscii(position, data.size());
+        endOfFile = data.empty();
+      }
+
+      // Creates a string from the bytes of a line and the partial line
+      // preceding them, pure ASCII content can skip UTF-8 decoding.
+      v8::MaybeLocal<v8::String>
+      NewLine(v8::Isolate* isolate, const uint8_t* begin, const uint8_t* lineEnd)
+      {
+        if (!partialLine.empty())
+        {
+          partialLine.insert(partialLine.end(), begin, lineEnd);
+          auto result =
+              NewString(isolate,
+                        partialLine.data(),
+                        partialLine.size(),
+                        AsciiScanner::IsAscii(partialLine.data(), partialLine.size()));
+          partialLine.clear();
+          return result;
+        }
+        return NewString(isolate, begin, lineEnd - begin, isAscii);
+      }
+
+      static v8::MaybeLocal<v8::String>
+      NewString(v8::Isolate* isolate, const uint8_t* begin, size_t length, bool ascii)
+      {
+        if (length == 0)
+          return v8::String::Empty(isolate);
+        if (ascii)
+          return v8::String::NewFromOneByte(
+              isolate, begin, v8::NewStringType::kNormal, static_cast<int>(length));
+        return v8::String::NewFromUtf8(isolate,
+                                       reinterpret_cast<const char*>(begin),
+                                       v8::NewStringType::kNormal,
+                                       static_cast<int>(length));
+      }
+
+      const size_t chunkSize;
+      IFileSystem::IOBuffer data;
+      const uint8_t* position = nullptr;
+      const uint8_t* end = nullptr;
+      bool isAscii = true;
+      bool endOfFile = false;
+      bool hasLines = false;
+      StringBuffer partialLine;
+    };
+
+    // Passes lines to the listener one by one, or in arrays of up to
+    // `chunkSize` lines if it's not zero.
+    class LineListener
+    {
+    public:
+      LineListener(JsEngine* jsEngine,
+                   const JsContext& context,
+                   const v8::TryCatch& tryCatch,
+                   const JsEngine::ScopedWeakValues& listenerWeakCallbackValue,
+                   size_t chunkSize)
+          : isolate(jsEngine->GetIsolate()), v8Context(context.GetV8Context()),
+            globalContext(v8Context->Global()), tryCatch(tryCatch), chunkSize(chunkSize),
+            processFunc(listenerWeakCallbackValue.Values()[0].UnwrapValue().As<v8::Function>())
+      {
+        if (!globalContext->IsObject())
+          throw std::runtime_error("`this` pointer has to be an object");
+      }
+
+      void Pass(v8::Local<v8::Value> line)
+      {
+        if (chunkSize == 0)
+          return Call(line);
+        lines.push_back(line);
+        if (lines.size() == chunkSize)
+          Flush();
+      }
+
+      void Flush()
+      {
+        if (lines.empty())
+          return;
+        v8::Local<v8::Value> jsLines = v8::Array::New(isolate, lines.data(), lines.size());
+        lines.clear();
+        Call(jsLines);
+      }
+
+      bool HasPendingLines() const
+      {
+        return !lines.empty();
+      }
+
+    private:
+      void Call(v8::Local<v8::Value> value)
+      {
+        CHECKED_TO_LOCAL_WITH_TRY_CATCH(
+            isolate, processFunc->Call(v8Context, globalContext, 1, &value), tryCatch);
+      }
+
+      v8::Isolate* isolate;
+      v8::Local<v8::Context> v8Context;
+      v8::Local<v8::Object> globalContext;
+      const v8::TryCatch& tryCatch;
+      const size_t chunkSize;
+      v8::Local<v8::Function> processFunc;
+      std::vector<v8::Local<v8::Value>> lines;
+    };
+
+    // Passes lines of the current chunk of the file to the listener until
+    // the time slice of the engine is used up. Returns true once the chunk
+    // is processed, then either requests the next one or resolves at the end
+    // of the file.
+    bool ProcessLines(JsEngine* jsEngine,
+                      LineReader& reader,
+                      const std::function<void()>& readNext,
+                      const JsEngine::ScopedWeakValues& listenerWeakCallbackValue,
+                      const JsEngine::ScopedWeakValues& resolveWeakCallbackValue)
+    {
+      const auto timeSlice = jsEngine->GetTimeSlice();
+      const auto deadline = std::chrono::steady_clock::now() + timeSlice;
+      const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
+      auto isolate = jsEngine->GetIsolate();
+      const v8::TryCatch tryCatch(isolate);
+      LineListener listener(
+          jsEngine, context, tryCatch, listenerWeakCallbackValue, reader.chunkSize);
+      auto passLine = [&](v8::Local<v8::Value> jsLine) {
+        reader.hasLines = true;
+        listener.Pass(jsLine);
+      };
+
+      for (;;)
+      {
+        if (reader.partialLine.empty())
+          reader.position = SkipEndOfLine(reader.position, reader.end);
+        if (reader.position == reader.end)
+          break;
+        auto lineEnd = AdvanceToEndOfLine(reader.position, reader.end);
+        if (lineEnd == reader.end)
+        {
+          // The line may continue in the next chunk.
+          reader.partialLine.insert(reader.partialLine.end(), reader.position, lineEnd);
+          reader.position = lineEnd;
+          break;
+        }
+        passLine(CHECKED_TO_LOCAL_WITH_TRY_CATCH(
+            isolate, reader.NewLine(isolate, reader.position, lineEnd), tryCatch));
+        reader.position = lineEnd;
+
+        if (timeSlice.count() > 0 && !listener.HasPendingLines() &&
+            std::chrono::steady_clock::now() >= deadline)
+          return false;
+      }
+
+      // A file without any line is passed as a single empty line.
+      if (reader.endOfFile && (!reader.partialLine.empty() || !reader.hasLines))
+        passLine(CHECKED_TO_LOCAL_WITH_TRY_CATCH(
+            isolate, reader.NewLine(isolate, reader.end, reader.end), tryCatch));
+      // Arrays of lines don't span chunks of the file.
+      listener.Flush();
+
+      if (reader.endOfFile)
+        resolveWeakCallbackValue.Values()[0].Call();
+      else
+        readNext();
+      return true;
+    }
+
+    // Lines of a file written by _fileSystem.writeLines, mapped to memory as
+    // a whole.
+    struct StoredLineReader
+    {
+      StoredLineReader(const std::shared_ptr<StoredContent>& content, size_t chunkSize)
+          : content(content), reader(content->sections), chunkSize(chunkSize)
+      {
+      }
+
+      std::shared_ptr<StoredContent> content;
+      FilterStorageFile::Reader reader;
+      const size_t chunkSize;
+      bool hasLines = false;
+    };
+
+    // Same as ProcessLines for a file written by _fileSystem.writeLines,
+    // returns true once all lines are passed.
+    bool ProcessStoredLines(JsEngine* jsEngine,
+                            StoredLineReader& storedReader,
+                            const JsEngine::ScopedWeakValues& listenerWeakCallbackValue,
+                            const JsEngine::ScopedWeakValues& resolveWeakCallbackValue)
+    {
+      const auto timeSlice = jsEngine->GetTimeSlice();
+      const auto deadline = std::chrono::steady_clock::now() + timeSlice;
+      const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
+      auto isolate = jsEngine->GetIsolate();
+      const v8::TryCatch tryCatch(isolate);
+      LineListener listener(
+          jsEngine, context, tryCatch, listenerWeakCallbackValue, storedReader.chunkSize);
+
+      const uint8_t* line;
+      size_t size;
+      bool isAscii;
+      while (storedReader.reader.Next(&line, &size, &isAscii))
+      {
+        storedReader.hasLines = true;
+        listener.Pass(CHECKED_TO_LOCAL_WITH_TRY_CATCH(
+            isolate, LineReader::NewString(isolate, line, size, isAscii), tryCatch));
+        if (timeSlice.count() > 0 && !listener.HasPendingLines() &&
+            std::chrono::steady_clock::now() >= deadline)
+          return false;
+      }
+
+      if (!storedReader.hasLines)
+        listener.Pass(v8::String::Empty(isolate));
+      listener.Flush();
+      resolveWeakCallbackValue.Values()[0].Call();
+      return true;
+    }
+
+    void ReadStoredLines(JsEngine* jsEngine,
+                         const std::string& fileName,
+                         size_t chunkSize,
+                         const JsEngine::ScopedWeakValues& listenerWeakCallbackValue,
+                         const JsEngine::ScopedWeakValues& resolveWeakCallbackValue,
+                         const JsEngine::ScopedWeakValues& rejectWeakCallbackValue)
+    {
+      auto reject = [jsEngine, rejectWeakCallbackValue](const std::string& error) {
+        const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
+        if (!error.empty())
+          rejectWeakCallbackValue.Values()[0].Call(jsEngine->NewValue(error));
+      };
+      ReadStoredContent(
+          jsEngine,
+          fileName,
+          [=](const std::shared_ptr<StoredContent>& content) {
+            auto storedReader = std::make_shared<StoredLineReader>(content, chunkSize);
+            jsEngine->PostSliced([=] {
+              try
+              {
+                return ProcessStoredLines(jsEngine,
+                                          *storedReader,
+                                          listenerWeakCallbackValue,
+                                          resolveWeakCallbackValue);
+              }
+              catch (const std::exception& e)
+              {
+                reject(e.what());
+                return true;
+              }
+            });
+          },
+          reject);
+    }
+
+    void ReadLines(const v8::FunctionCallbackInfo<v8::Value>& arguments,
+                   const std::string& methodName,
+                   size_t chunkSize)
     {
       AdblockPlus::JsEngine* jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
       AdblockPlus::JsValueList converted = jsEngine->ConvertArguments(arguments);
 
       v8::Isolate* isolate = arguments.GetIsolate();
       if (converted.size() != 4)
-        return ThrowExceptionInJS(isolate, "_fileSystem.readFromFile requires 4 parameters");
+        return ThrowExceptionInJS(isolate, methodName + " requires 4 parameters");
       if (!converted[1].IsFunction())
         return ThrowExceptionInJS(
             isolate,
-            "Second argument to _fileSystem.readFromFile must be a function (listener callback)");
+            "Second argument to " + methodName + " must be a function (listener callback)");
       if (!converted[2].IsFunction())
         return ThrowExceptionInJS(
-            isolate,
-            "Third argument to _fileSystem.readFromFile must be a function (done callback)");
+            isolate, "Third argument to " + methodName + " must be a function (done callback)");
       if (!converted[3].IsFunction())
         return ThrowExceptionInJS(
-            isolate,
-            "Third argument to _fileSystem.readFromFile must be a function (error callback)");
+            isolate, "Third argument to " + methodName + " must be a function (error callback)");
 
       JsEngine::ScopedWeakValues listenerWeakCallbackValue(jsEngine, {converted[1]});
       JsEngine::ScopedWeakValues resolveWeakCallbackValue(jsEngine, {converted[2]});
       JsEngine::ScopedWeakValues rejectWeakCallbackValue(jsEngine, {converted[3]});
       auto fileName = converted[0].AsString();
-      jsEngine->GetFileSystem().Read(
+      auto reader = std::make_shared<LineReader>(chunkSize);
+      BackgroundFileSystem(jsEngine).ReadChunks(
           fileName,
-          [jsEngine, listenerWeakCallbackValue, resolveWeakCallbackValue](
-              IFileSystem::IOBuffer&& content) {
-            const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
-            auto processFunc =
-                listenerWeakCallbackValue.Values()[0].UnwrapValue().As<v8::Function>();
-            auto globalContext = context.GetV8Context()->Global();
-            if (!globalContext->IsObject())
-              throw std::runtime_error("`this` pointer has to be an object");
-
-            auto isolate = jsEngine->GetIsolate();
-            const v8::TryCatch tryCatch(isolate);
-            const auto contentEnd = content.cend();
-            auto stringBegin = SkipEndOfLine(content.begin(), contentEnd);
-            auto v8Context = isolate->GetCurrentContext();
-            do
-            {
-              auto stringEnd = AdvanceToEndOfLine(stringBegin, contentEnd);
-              auto jsLine =
-                  CHECKED_TO_LOCAL_WITH_TRY_CATCH(
-                      isolate,
-                      Utils::StringBufferToV8String(isolate, StringBuffer(stringBegin, stringEnd)),
-                      tryCatch)
-                      .As<v8::Value>();
-
-              CHECKED_TO_LOCAL_WITH_TRY_CATCH(
-                  isolate, processFunc->Call(v8Context, globalContext, 1, &jsLine), tryCatch);
-
-              stringBegin = SkipEndOfLine(stringEnd, contentEnd);
-            } while (stringBegin != contentEnd);
-            resolveWeakCallbackValue.Values()[0].Call();
+          readChunkSize,
+          [jsEngine,
+           fileName,
+           reader,
+           listenerWeakCallbackValue,
+           resolveWeakCallbackValue,
+           rejectWeakCallbackValue](IFileSystem::IOBuffer&& data,
+                                    const std::function<void()>& readNext) {
+            // Files written by _fileSystem.writeLines are read as a whole,
+            // text files which haven't been written again since are still
+            // read line by line. Only the first chunk has no position yet.
+            if (!reader->position && FilterStorageFile::IsStorageFile(data.data(), data.size()))
+              return ReadStoredLines(jsEngine,
+                                     fileName,
+                                     reader->chunkSize,
+                                     listenerWeakCallbackValue,
+                                     resolveWeakCallbackValue,
+                                     rejectWeakCallbackValue);
+            reader->SetData(std::move(data));
+            jsEngine->PostSliced([=] {
+              try
+              {
+                return ProcessLines(jsEngine,
+                                    *reader,
+                                    readNext,
+                                    listenerWeakCallbackValue,
+                                    resolveWeakCallbackValue);
+              }
+              catch (const std::exception& e)
+              {
+                const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
+                rejectWeakCallbackValue.Values()[0].Call(jsEngine->NewValue(e.what()));
+                return true;
+              }
+            });
           },
           [jsEngine, rejectWeakCallbackValue](const std::string& error) {
             const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
             if (!error.empty())
               rejectWeakCallbackValue.Values()[0].Call(jsEngine->NewValue(error));
           });
-    } // V8Callback
+    }
+
+    void V8Callback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
+    {
+      ReadLines(arguments, "_fileSystem.readFromFile", 0);
+    }
+
+    // Same as V8Callback but the listener gets arrays of lines.
+    void ChunkedV8Callback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
+    {
+      auto chunkSize = AdblockPlus::JsEngine::FromArguments(arguments)->GetLineChunkSize();
+      ReadLines(arguments, "_fileSystem.readLinesFromFile", std::max<size_t>(chunkSize, 1));
+    }
   }   // namespace ReadFromFileCallback
 
   void WriteCallback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
@@ -172,7 +634,7 @@ namespace
     JsEngine::ScopedWeakValues weakCallbackValue(jsEngine, {converted[2]});
     auto content = converted[1].AsStringBuffer();
     auto fileName = converted[0].AsString();
-    jsEngine->GetFileSystem().Write(
+    BackgroundFileSystem(jsEngine).Write(
         fileName, content, [jsEngine, weakCallbackValue](const std::string& error) {
           const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
           JsValueList params;
@@ -182,6 +644,114 @@ namespace
         });
   }
 
+  void WriteLinesCallback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
+  {
+    AdblockPlus::JsEngine* jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
+    AdblockPlus::JsValueList converted = jsEngine->ConvertArguments(arguments);
+
+    v8::Isolate* isolate = arguments.GetIsolate();
+    if (converted.size() != 3)
+      return ThrowExceptionInJS(isolate, "_fileSystem.writeLines requires 3 parameters");
+    if (!converted[1].IsArray())
+      return ThrowExceptionInJS(isolate,
+                                "Second argument to _fileSystem.writeLines must be an array");
+    if (!converted[2].IsFunction())
+      return ThrowExceptionInJS(isolate,
+                                "Third argument to _fileSystem.writeLines must be a function");
+
+    JsEngine::ScopedWeakValues weakCallbackValue(jsEngine, {converted[2]});
+    auto fileName = converted[0].AsString();
+    auto v8Context = isolate->GetCurrentContext();
+    auto lines = v8::Local<v8::Array>::Cast(converted[1].UnwrapValue());
+    FilterStorageFile::Writer writer;
+    for (uint32_t i = 0; i < lines->Length(); ++i)
+    {
+      auto line = Utils::StringBufferFromV8String(
+          isolate, CHECKED_TO_LOCAL(isolate, lines->Get(v8Context, i)));
+      writer.AddLine(line.data(), line.size());
+    }
+
+    auto change = jsEngine->GetFilterStorageJournal().Update(fileName, writer.FinishSections());
+    auto done = [jsEngine, fileName, weakCallbackValue](const std::string& error) {
+      // What was written is unknown, the next write replaces the whole file.
+      if (!error.empty())
+        jsEngine->GetFilterStorageJournal().Forget(fileName);
+      CallWithError(jsEngine, weakCallbackValue, error);
+    };
+    BackgroundFileSystem fileSystem(jsEngine);
+    const auto journalFileName = FilterStorageJournal::GetFileName(fileName);
+    switch (change.action)
+    {
+    case FilterStorageJournal::Action::NONE:
+      jsEngine->Post(JsEventLoop::Priority::BACKGROUND, [done] { done(""); });
+      break;
+    case FilterStorageJournal::Action::WRITE_FILE:
+      // A journal which can't be removed doesn't match the new content and
+      // is ignored.
+      fileSystem.Write(
+          fileName, change.data, [fileSystem, journalFileName, done](const std::string& error) {
+            if (!error.empty())
+              return done(error);
+            fileSystem.Remove(journalFileName, [done](const std::string&) { done(""); });
+          });
+      break;
+    case FilterStorageJournal::Action::WRITE_JOURNAL:
+      fileSystem.Write(journalFileName, change.data, done);
+      break;
+    case FilterStorageJournal::Action::APPEND_TO_JOURNAL:
+      fileSystem.Append(journalFileName, change.data, done);
+      break;
+    }
+  }
+
+  void CompactLinesCallback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
+  {
+    AdblockPlus::JsEngine* jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
+    AdblockPlus::JsValueList converted = jsEngine->ConvertArguments(arguments);
+
+    v8::Isolate* isolate = arguments.GetIsolate();
+    if (converted.size() != 2)
+      return ThrowExceptionInJS(isolate, "_fileSystem.compactLines requires 2 parameters");
+    if (!converted[1].IsFunction())
+      return ThrowExceptionInJS(isolate,
+                                "Second argument to _fileSystem.compactLines must be a function");
+
+    JsEngine::ScopedWeakValues weakCallbackValue(jsEngine, {converted[1]});
+    auto fileName = converted[0].AsString();
+    auto done = [jsEngine, weakCallbackValue](const std::string& error) {
+      CallWithError(jsEngine, weakCallbackValue, error);
+    };
+    if (!jsEngine->GetFilterStorageJournal().HasJournal(fileName))
+    {
+      jsEngine->Post(JsEventLoop::Priority::BACKGROUND, [done] { done(""); });
+      return;
+    }
+
+    // The changes in the journal are written to the file, then the journal
+    // doesn't match the content anymore and is removed.
+    ReadStoredContent(
+        jsEngine,
+        fileName,
+        [jsEngine, fileName, done](const std::shared_ptr<StoredContent>& content) {
+          BackgroundFileSystem fileSystem(jsEngine);
+          auto data = FilterStorageFile::Join(content->sections);
+          const size_t size = data.size();
+          fileSystem.Write(
+              fileName,
+              data,
+              [jsEngine, fileSystem, fileName, size, done](const std::string& error) {
+                if (!error.empty())
+                  return done(error);
+                fileSystem.Remove(FilterStorageJournal::GetFileName(fileName),
+                                  [jsEngine, fileName, size, done](const std::string&) {
+                                    jsEngine->GetFilterStorageJournal().Compacted(fileName, size);
+                                    done("");
+                                  });
+              });
+        },
+        done);
+  }
+
   void MoveCallback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
   {
     AdblockPlus::JsEngine* jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
@@ -196,13 +766,21 @@ namespace
     JsEngine::ScopedWeakValues weakCallbackValue(jsEngine, {converted[2]});
     auto from = converted[0].AsString();
     auto to = converted[1].AsString();
-    jsEngine->GetFileSystem().Move(
-        from, to, [jsEngine, weakCallbackValue](const std::string& error) {
-          const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
-          JsValueList params;
-          if (!error.empty())
-            params.push_back(jsEngine->NewValue(error));
-          weakCallbackValue.Values()[0].Call(params);
+    // The journal of a file written by _fileSystem.writeLines moves along.
+    auto& journal = jsEngine->GetFilterStorageJournal();
+    const bool hasJournal = journal.HasJournal(from);
+    journal.Forget(from);
+    journal.Forget(to);
+    BackgroundFileSystem(jsEngine).Move(
+        from, to, [jsEngine, weakCallbackValue, from, to, hasJournal](const std::string& error) {
+          if (!error.empty() || !hasJournal)
+            return CallWithError(jsEngine, weakCallbackValue, error);
+          BackgroundFileSystem(jsEngine).Move(
+              FilterStorageJournal::GetFileName(from),
+              FilterStorageJournal::GetFileName(to),
+              [jsEngine, weakCallbackValue](const std::string& error) {
+                CallWithError(jsEngine, weakCallbackValue, error);
+              });
         });
   }
 
@@ -220,13 +798,19 @@ namespace
 
     JsEngine::ScopedWeakValues weakCallbackValue(jsEngine, {converted[1]});
     auto fileName = converted[0].AsString();
-    jsEngine->GetFileSystem().Remove(
-        fileName, [jsEngine, weakCallbackValue](const std::string& error) {
-          const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
-          JsValueList params;
-          if (!error.empty())
-            params.push_back(jsEngine->NewValue(error));
-          weakCallbackValue.Values()[0].Call(params);
+    // So is the journal of a file written by _fileSystem.writeLines.
+    auto& journal = jsEngine->GetFilterStorageJournal();
+    const bool hasJournal = journal.HasJournal(fileName);
+    journal.Forget(fileName);
+    BackgroundFileSystem(jsEngine).Remove(
+        fileName, [jsEngine, weakCallbackValue, fileName, hasJournal](const std::string& error) {
+          if (!error.empty() || !hasJournal)
+            return CallWithError(jsEngine, weakCallbackValue, error);
+          BackgroundFileSystem(jsEngine).Remove(
+              FilterStorageJournal::GetFileName(fileName),
+              [jsEngine, weakCallbackValue](const std::string& error) {
+                CallWithError(jsEngine, weakCallbackValue, error);
+              });
         });
   }
 
@@ -243,7 +827,7 @@ namespace
 
     JsEngine::ScopedWeakValues weakCallbackValue(jsEngine, {converted[1]});
     auto fileName = converted[0].AsString();
-    jsEngine->GetFileSystem().Stat(
+    BackgroundFileSystem(jsEngine).Stat(
         fileName,
         [jsEngine, weakCallbackValue](const IFileSystem::StatResult& statResult,
                                       const std::string& error) {
@@ -260,15 +844,27 @@ namespace
           weakCallbackValue.Values()[0].Call(params);
         });
   }
+
+  void GetTimeSliceCallback(const v8::FunctionCallbackInfo<v8::Value>& arguments)
+  {
+    AdblockPlus::JsEngine* jsEngine = AdblockPlus::JsEngine::FromArguments(arguments);
+    auto timeSlice = static_cast<double>(jsEngine->GetTimeSlice().count());
+    arguments.GetReturnValue().Set(v8::Number::New(arguments.GetIsolate(), timeSlice));
+  }
 }
 
 JsValue& FileSystemJsObject::Setup(JsEngine& jsEngine, JsValue& obj)
 {
   obj.SetProperty("read", jsEngine.NewCallback(::ReadCallback::V8Callback));
   obj.SetProperty("readFromFile", jsEngine.NewCallback(::ReadFromFileCallback::V8Callback));
+  obj.SetProperty("readLinesFromFile",
+                  jsEngine.NewCallback(::ReadFromFileCallback::ChunkedV8Callback));
   obj.SetProperty("write", jsEngine.NewCallback(::WriteCallback));
+  obj.SetProperty("writeLines", jsEngine.NewCallback(::WriteLinesCallback));
+  obj.SetProperty("compactLines", jsEngine.NewCallback(::CompactLinesCallback));
   obj.SetProperty("move", jsEngine.NewCallback(::MoveCallback));
   obj.SetProperty("remove", jsEngine.NewCallback(::RemoveCallback));
   obj.SetProperty("stat", jsEngine.NewCallback(::StatCallback));
+  obj.SetProperty("getTimeSlice", jsEngine.NewCallback(::GetTimeSliceCallback));
   return obj;
 }
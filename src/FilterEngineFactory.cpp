@@ -110,8 +110,8 @@ void FilterEngineFactory::CreateAsync(JsEngine& jsEngine,
   // STL doesn't like that. This is just a workaround, the function in
   // question retrieves the unique_ptr from within and keeps using that
   // or the reminder of the stack.
-  auto wrappedFilterEngine =
-      std::make_shared<std::unique_ptr<DefaultFilterEngine>>(new DefaultFilterEngine(jsEngine));
+  auto wrappedFilterEngine = std::make_shared<std::unique_ptr<DefaultFilterEngine>>(
+      new DefaultFilterEngine(jsEngine, params));
   auto* bareFilterEngine = wrappedFilterEngine->get();
   {
     auto isSubscriptionDownloadAllowedCallback = params.isSubscriptionDownloadAllowedCallback;
@@ -147,6 +147,8 @@ void FilterEngineFactory::CreateAsync(JsEngine& jsEngine,
   jsEngine.SetEventCallback("_init",
                             [&jsEngine, wrappedFilterEngine, onCreated](JsValueList&& params) {
                               auto uniqueFilterEngine = std::move(*wrappedFilterEngine);
+                              uniqueFilterEngine->ResolveApiFunctions();
+                              uniqueFilterEngine->OnFiltersLoaded();
                               onCreated(std::move(uniqueFilterEngine));
                               jsEngine.RemoveEventCallback("_init");
                             });
@@ -0,0 +1,191 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FilterStorageFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "AsciiScanner.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const char magic[] = "ABPSTOR";
+  const size_t magicSize = sizeof(magic) - 1;
+  const uint8_t version = 1;
+  const size_t headerSize = magicSize + 1 + 4;
+  const size_t sectionHeaderSize = 4 + 1 + 4;
+  const uint8_t asciiFlag = 1;
+
+  void AppendUint(IFileSystem::IOBuffer& data, uint32_t value)
+  {
+    for (int i = 0; i < 4; ++i)
+      data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+
+  uint32_t ToUint(const uint8_t* data)
+  {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+           static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+  }
+
+  void AppendHeader(IFileSystem::IOBuffer& data, size_t sectionCount)
+  {
+    data.insert(data.end(), magic, magic + magicSize);
+    data.push_back(version);
+    AppendUint(data, static_cast<uint32_t>(sectionCount));
+  }
+}
+
+bool FilterStorageFile::IsStorageFile(const uint8_t* data, size_t size)
+{
+  return size > magicSize && std::memcmp(data, magic, magicSize) == 0;
+}
+
+size_t FilterStorageFile::CheckSection(const uint8_t* data, size_t size)
+{
+  if (size < sectionHeaderSize)
+    throw std::runtime_error("Damaged filter storage file, unexpected end");
+  const uint32_t lineCount = ToUint(data);
+  const uint32_t textSize = ToUint(data + 5);
+  if (lineCount > (size - sectionHeaderSize) / 4)
+    throw std::runtime_error("Damaged filter storage file, unexpected end");
+  const size_t textOffset = sectionHeaderSize + 4 * static_cast<size_t>(lineCount);
+  if (textSize > size - textOffset)
+    throw std::runtime_error("Damaged filter storage file, unexpected end");
+
+  uint64_t linesSize = 0;
+  for (const uint8_t* length = data + sectionHeaderSize; length != data + textOffset; length += 4)
+    linesSize += ToUint(length);
+  if (linesSize != textSize)
+    throw std::runtime_error("Damaged filter storage file, unexpected line size");
+  return textOffset + textSize;
+}
+
+std::vector<FilterStorageFile::Section> FilterStorageFile::ReadSections(const uint8_t* data,
+                                                                        size_t size)
+{
+  if (!IsStorageFile(data, size))
+    throw std::runtime_error("Not a filter storage file");
+  if (data[magicSize] != version)
+    throw std::runtime_error("Unsupported version of the filter storage file");
+  if (size < headerSize)
+    throw std::runtime_error("Damaged filter storage file, unexpected end");
+
+  uint32_t count = ToUint(data + magicSize + 1);
+  std::vector<Section> sections;
+  sections.reserve(std::min<size_t>(count, (size - headerSize) / sectionHeaderSize));
+  size_t position = headerSize;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    size_t sectionSize = CheckSection(data + position, size - position);
+    sections.push_back({data + position, sectionSize});
+    position += sectionSize;
+  }
+  if (position != size)
+    throw std::runtime_error("Damaged filter storage file, unexpected data at the end");
+  return sections;
+}
+
+IFileSystem::IOBuffer FilterStorageFile::Join(const std::vector<Section>& sections)
+{
+  size_t size = headerSize;
+  for (const auto& section : sections)
+    size += section.size;
+
+  IFileSystem::IOBuffer data;
+  data.reserve(size);
+  AppendHeader(data, sections.size());
+  for (const auto& section : sections)
+    data.insert(data.end(), section.data, section.data + section.size);
+  return data;
+}
+
+void FilterStorageFile::Writer::AddLine(const uint8_t* data, size_t size)
+{
+  if (size == 0)
+    return;
+  if (sections.empty() || data[0] == '[')
+    sections.emplace_back();
+  auto& section = sections.back();
+  section.lengths.push_back(static_cast<uint32_t>(size));
+  section.text.insert(section.text.end(), data, data + size);
+  section.isAscii = section.isAscii && AsciiScanner::IsAscii(data, size);
+}
+
+std::vector<IFileSystem::IOBuffer> FilterStorageFile::Writer::FinishSections()
+{
+  std::vector<IFileSystem::IOBuffer> result;
+  result.reserve(sections.size());
+  for (const auto& section : sections)
+  {
+    result.emplace_back();
+    auto& data = result.back();
+    data.reserve(sectionHeaderSize + 4 * section.lengths.size() + section.text.size());
+    AppendUint(data, static_cast<uint32_t>(section.lengths.size()));
+    data.push_back(section.isAscii ? asciiFlag : 0);
+    AppendUint(data, static_cast<uint32_t>(section.text.size()));
+    for (uint32_t length : section.lengths)
+      AppendUint(data, length);
+    data.insert(data.end(), section.text.begin(), section.text.end());
+  }
+  sections.clear();
+  return result;
+}
+
+IFileSystem::IOBuffer FilterStorageFile::Writer::Finish()
+{
+  std::vector<Section> views;
+  auto buffers = FinishSections();
+  for (const auto& buffer : buffers)
+    views.push_back({buffer.data(), buffer.size()});
+  return Join(views);
+}
+
+FilterStorageFile::Reader::Reader(const uint8_t* data, size_t size)
+    : sections(ReadSections(data, size))
+{
+}
+
+FilterStorageFile::Reader::Reader(std::vector<Section> sections) : sections(std::move(sections))
+{
+}
+
+bool FilterStorageFile::Reader::Next(const uint8_t** line, size_t* size, bool* isAscii)
+{
+  while (remainingLines == 0)
+  {
+    if (nextSection == sections.size())
+      return false;
+    const uint8_t* section = sections[nextSection++].data;
+    remainingLines = ToUint(section);
+    sectionIsAscii = (section[4] & asciiFlag) != 0;
+    lengths = section + sectionHeaderSize;
+    text = lengths + 4 * static_cast<size_t>(remainingLines);
+  }
+
+  *line = text;
+  *size = ToUint(lengths);
+  *isAscii = sectionIsAscii;
+  lengths += 4;
+  text += *size;
+  --remainingLines;
+  return true;
+}
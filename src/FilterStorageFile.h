@@ -0,0 +1,143 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <AdblockPlus/IFileSystem.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Binary container for the lines of the filter storage, replacing the
+   * text of `patterns.ini`. Lines are grouped into sections, each starting
+   * with an INI section header like `[Subscription]`, so that a
+   * subscription, its metadata and its filters follow each other. Every
+   * section holds a table with the length of each line followed by the
+   * text of all lines, and whether all of them are ASCII, so they can be
+   * converted to strings without scanning them.
+   *
+   * Layout, integers are 32 bits little endian:
+   *   magic "ABPSTOR", version byte, section count, then per section:
+   *   line count, flags byte, text size, line lengths, text.
+   */
+  namespace FilterStorageFile
+  {
+    /**
+     * Serialized section, pointing into the file or another buffer which
+     * has to stay valid while the section is used.
+     */
+    struct Section
+    {
+      const uint8_t* data;
+      size_t size;
+    };
+
+    /**
+     * @return `true` if the data starts like a file written by `Writer`,
+     *         of any version.
+     */
+    bool IsStorageFile(const uint8_t* data, size_t size);
+
+    /**
+     * Checks the section at the start of the data.
+     * @return Size of the section.
+     * @throw std::runtime_error If the section is damaged.
+     */
+    size_t CheckSection(const uint8_t* data, size_t size);
+
+    /**
+     * Splits a file written by `Writer` into its sections.
+     * @throw std::runtime_error If the data isn't a file of the supported
+     *        version or it's damaged.
+     */
+    std::vector<Section> ReadSections(const uint8_t* data, size_t size);
+
+    /**
+     * @return Content of a file consisting of the sections.
+     */
+    IFileSystem::IOBuffer Join(const std::vector<Section>& sections);
+
+    class Writer
+    {
+    public:
+      /**
+       * Appends a line, empty lines are skipped like in text files.
+       */
+      void AddLine(const uint8_t* data, size_t size);
+
+      /**
+       * @return Serialized sections of the file, see `Join`.
+       */
+      std::vector<IFileSystem::IOBuffer> FinishSections();
+
+      /**
+       * @return Content of the file.
+       */
+      IFileSystem::IOBuffer Finish();
+
+    private:
+      struct PendingSection
+      {
+        std::vector<uint32_t> lengths;
+        std::vector<uint8_t> text;
+        bool isAscii = true;
+      };
+      std::vector<PendingSection> sections;
+    };
+
+    /**
+     * Iterates over the lines of sections, which have to stay valid while
+     * the reader is used.
+     */
+    class Reader
+    {
+    public:
+      /**
+       * Reads a file written by `Writer`.
+       * @throw std::runtime_error If the data isn't a file of the supported
+       *        version or it's damaged.
+       */
+      Reader(const uint8_t* data, size_t size);
+
+      /**
+       * Reads sections checked by `CheckSection`.
+       */
+      explicit Reader(std::vector<Section> sections);
+
+      /**
+       * Retrieves the next line.
+       * @param line Receives the start of the line.
+       * @param size Receives the size of the line.
+       * @param isAscii Receives whether the line is pure ASCII.
+       * @return `false` at the end of the sections.
+       */
+      bool Next(const uint8_t** line, size_t* size, bool* isAscii);
+
+    private:
+      std::vector<Section> sections;
+      size_t nextSection = 0;
+      uint32_t remainingLines = 0;
+      const uint8_t* lengths = nullptr;
+      const uint8_t* text = nullptr;
+      bool sectionIsAscii = true;
+    };
+  }
+}
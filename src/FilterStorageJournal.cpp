@@ -0,0 +1,339 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FilterStorageJournal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const char magic[] = "ABPJRNL";
+  const size_t magicSize = sizeof(magic) - 1;
+  const uint8_t version = 1;
+  const size_t headerSize = magicSize + 1;
+  // Size and hash around the body of a record.
+  const size_t recordOverhead = 4 + 8;
+  // The journal may grow to a quarter of the size of the file, small files
+  // get at least this much.
+  const size_t minJournalLimit = 64 * 1024;
+
+  const uint8_t keepSections = 0;
+  const uint8_t newSection = 1;
+
+  // FNV-1a, unlike std::hash it's the same for every build and run.
+  uint64_t Hash(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+  {
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= data[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  void AppendUint(IFileSystem::IOBuffer& data, uint64_t value, int size)
+  {
+    for (int i = 0; i < size; ++i)
+      data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+
+  uint64_t ToUint(const uint8_t* data, int size)
+  {
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++i)
+      value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    return value;
+  }
+
+  uint64_t HashContent(const std::vector<uint64_t>& sectionHashes)
+  {
+    IFileSystem::IOBuffer data;
+    data.reserve(8 * sectionHashes.size());
+    for (uint64_t sectionHash : sectionHashes)
+      AppendUint(data, sectionHash, 8);
+    return Hash(data.data(), data.size());
+  }
+
+  std::vector<uint64_t> HashSections(const std::vector<FilterStorageFile::Section>& sections)
+  {
+    std::vector<uint64_t> result;
+    result.reserve(sections.size());
+    for (const auto& section : sections)
+      result.push_back(Hash(section.data, section.size));
+    return result;
+  }
+
+  std::vector<FilterStorageFile::Section>
+  ToSections(const std::vector<IFileSystem::IOBuffer>& buffers)
+  {
+    std::vector<FilterStorageFile::Section> result;
+    result.reserve(buffers.size());
+    for (const auto& buffer : buffers)
+      result.push_back({buffer.data(), buffer.size()});
+    return result;
+  }
+
+  class BodyReader
+  {
+  public:
+    BodyReader(const uint8_t* data, size_t size) : position(data), end(data + size)
+    {
+    }
+
+    const uint8_t* Skip(size_t size)
+    {
+      if (static_cast<size_t>(end - position) < size)
+        throw std::runtime_error("Damaged journal record, unexpected end");
+      const uint8_t* result = position;
+      position += size;
+      return result;
+    }
+
+    uint64_t ReadUint(int size)
+    {
+      return ToUint(Skip(size), size);
+    }
+
+    bool AtEnd() const
+    {
+      return position == end;
+    }
+
+  private:
+    const uint8_t* position;
+    const uint8_t* end;
+  };
+
+  // Replaces the sections by those described by a record body, if it was
+  // recorded for them.
+  void ApplyRecord(const uint8_t* body,
+                   size_t size,
+                   std::vector<FilterStorageFile::Section>& sections,
+                   std::vector<uint64_t>& sectionHashes)
+  {
+    BodyReader reader(body, size);
+    if (reader.ReadUint(8) != HashContent(sectionHashes))
+      throw std::runtime_error("Journal record doesn't match the content");
+    const uint64_t newContentHash = reader.ReadUint(8);
+
+    std::vector<FilterStorageFile::Section> newSections;
+    std::vector<uint64_t> newSectionHashes;
+    for (uint64_t count = reader.ReadUint(4); count > 0; --count)
+    {
+      const uint8_t type = *reader.Skip(1);
+      if (type == keepSections)
+      {
+        size_t first = reader.ReadUint(4);
+        size_t keepCount = reader.ReadUint(4);
+        if (first > sections.size() || keepCount > sections.size() - first)
+          throw std::runtime_error("Damaged journal record, unexpected section index");
+        newSections.insert(newSections.end(),
+                           sections.begin() + first,
+                           sections.begin() + first + keepCount);
+        newSectionHashes.insert(newSectionHashes.end(),
+                                sectionHashes.begin() + first,
+                                sectionHashes.begin() + first + keepCount);
+      }
+      else if (type == newSection)
+      {
+        size_t sectionSize = reader.ReadUint(4);
+        const uint8_t* section = reader.Skip(sectionSize);
+        if (FilterStorageFile::CheckSection(section, sectionSize) != sectionSize)
+          throw std::runtime_error("Damaged journal record, unexpected section size");
+        newSections.push_back({section, sectionSize});
+        newSectionHashes.push_back(Hash(section, sectionSize));
+      }
+      else
+        throw std::runtime_error("Damaged journal record, unexpected operation");
+    }
+    if (!reader.AtEnd() || HashContent(newSectionHashes) != newContentHash)
+      throw std::runtime_error("Damaged journal record, unexpected content");
+
+    sections = std::move(newSections);
+    sectionHashes = std::move(newSectionHashes);
+  }
+}
+
+std::string FilterStorageJournal::GetFileName(const std::string& fileName)
+{
+  return fileName + ".journal";
+}
+
+std::vector<FilterStorageFile::Section>
+FilterStorageJournal::Load(const std::string& fileName,
+                           const uint8_t* data,
+                           size_t size,
+                           const IFileSystem::IOBuffer& journal)
+{
+  auto sections = FilterStorageFile::ReadSections(data, size);
+  FileState state;
+  state.sectionHashes = HashSections(sections);
+  state.size = size;
+  if (!journal.empty())
+  {
+    // Records after a damaged one, e.g. one which was written only partly,
+    // or records for other content are ignored, the next write replaces
+    // them.
+    size_t position = headerSize;
+    try
+    {
+      if (journal.size() < headerSize || std::memcmp(journal.data(), magic, magicSize) != 0 ||
+          journal[magicSize] != version)
+        throw std::runtime_error("Unsupported journal");
+      while (position != journal.size())
+      {
+        if (journal.size() - position < recordOverhead)
+          throw std::runtime_error("Damaged journal, unexpected end");
+        const size_t bodySize = ToUint(&journal[position], 4);
+        if (bodySize > journal.size() - position - recordOverhead)
+          throw std::runtime_error("Damaged journal, unexpected end");
+        const uint8_t* body = &journal[position + 4];
+        if (ToUint(body + bodySize, 8) != Hash(body, bodySize))
+          throw std::runtime_error("Damaged journal, unexpected hash");
+        ApplyRecord(body, bodySize, sections, state.sectionHashes);
+        position += recordOverhead + bodySize;
+      }
+    }
+    catch (const std::exception&)
+    {
+      state.journalDamaged = true;
+    }
+    state.journalSize = position;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  files[fileName] = std::move(state);
+  return sections;
+}
+
+FilterStorageJournal::Change
+FilterStorageJournal::Update(const std::string& fileName,
+                             const std::vector<IFileSystem::IOBuffer>& sections)
+{
+  auto newSections = ToSections(sections);
+  auto newSectionHashes = HashSections(newSections);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = files.find(fileName);
+  if (it != files.end() && !it->second.journalDamaged)
+  {
+    FileState& state = it->second;
+    if (newSectionHashes == state.sectionHashes)
+      return {Action::NONE, {}};
+
+    IFileSystem::IOBuffer body;
+    AppendUint(body, HashContent(state.sectionHashes), 8);
+    AppendUint(body, HashContent(newSectionHashes), 8);
+    const size_t countPosition = body.size();
+    AppendUint(body, 0, 4);
+
+    // Runs of sections which follow each other in the previous content are
+    // kept as a whole, e.g. the filters of a subscription.
+    std::unordered_map<uint64_t, uint32_t> indices;
+    for (uint32_t i = 0; i < state.sectionHashes.size(); ++i)
+      indices.emplace(state.sectionHashes[i], i);
+    uint32_t operationCount = 0;
+    uint32_t keepFirst = 0;
+    uint32_t keepCount = 0;
+    auto finishKeep = [&] {
+      if (keepCount == 0)
+        return;
+      body.push_back(keepSections);
+      AppendUint(body, keepFirst, 4);
+      AppendUint(body, keepCount, 4);
+      ++operationCount;
+      keepCount = 0;
+    };
+    for (size_t i = 0; i < newSections.size(); ++i)
+    {
+      const uint64_t hash = newSectionHashes[i];
+      const size_t next = keepFirst + keepCount;
+      if (keepCount > 0 && next < state.sectionHashes.size() && state.sectionHashes[next] == hash)
+      {
+        ++keepCount;
+        continue;
+      }
+      finishKeep();
+      auto index = indices.find(hash);
+      if (index != indices.end())
+      {
+        keepFirst = index->second;
+        keepCount = 1;
+        continue;
+      }
+      body.push_back(newSection);
+      AppendUint(body, newSections[i].size, 4);
+      body.insert(body.end(), newSections[i].data, newSections[i].data + newSections[i].size);
+      ++operationCount;
+    }
+    finishKeep();
+    for (int i = 0; i < 4; ++i)
+      body[countPosition + i] = static_cast<uint8_t>(operationCount >> (8 * i));
+
+    const size_t journalSize = std::max(state.journalSize, headerSize);
+    if (journalSize + recordOverhead + body.size() <= std::max(minJournalLimit, state.size / 4))
+    {
+      Change change;
+      if (state.journalSize == 0)
+      {
+        change.action = Action::WRITE_JOURNAL;
+        change.data.insert(change.data.end(), magic, magic + magicSize);
+        change.data.push_back(version);
+      }
+      else
+        change.action = Action::APPEND_TO_JOURNAL;
+      AppendUint(change.data, body.size(), 4);
+      change.data.insert(change.data.end(), body.begin(), body.end());
+      AppendUint(change.data, Hash(body.data(), body.size()), 8);
+      state.journalSize = journalSize + recordOverhead + body.size();
+      state.sectionHashes = std::move(newSectionHashes);
+      return change;
+    }
+  }
+
+  Change change{Action::WRITE_FILE, FilterStorageFile::Join(newSections)};
+  FileState& state = files[fileName];
+  state = FileState();
+  state.sectionHashes = std::move(newSectionHashes);
+  state.size = change.data.size();
+  return change;
+}
+
+bool FilterStorageJournal::HasJournal(const std::string& fileName) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = files.find(fileName);
+  return it != files.end() && (it->second.journalSize > 0 || it->second.journalDamaged);
+}
+
+void FilterStorageJournal::Compacted(const std::string& fileName, size_t size)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  FileState& state = files[fileName];
+  state.size = size;
+  state.journalSize = 0;
+  state.journalDamaged = false;
+}
+
+void FilterStorageJournal::Forget(const std::string& fileName)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  files.erase(fileName);
+}
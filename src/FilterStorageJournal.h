@@ -0,0 +1,126 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <AdblockPlus/IFileSystem.h>
+
+#include "FilterStorageFile.h"
+
+namespace AdblockPlus
+{
+  /**
+   * Keeps track of the content of files written by `_fileSystem.writeLines`,
+   * so that a change to a few sections, e.g. a new custom filter, can be
+   * appended to a journal next to the file instead of rewriting all
+   * subscriptions. Each record describes the new content as ranges of
+   * sections kept from the previous content and new sections, and names
+   * the hashes of both contents, so that it's only applied to the content
+   * it was recorded for. Once the journal grows too large the file is
+   * written as a whole again and the journal removed.
+   * It's thread-safe, the file system calls back on its own threads.
+   *
+   * Journal layout, integers are little endian:
+   *   magic "ABPJRNL", version byte, then per record:
+   *   32 bit body size, body, 64 bit hash of the body.
+   * Record body:
+   *   64 bit hash of the previous content, 64 bit hash of the new content,
+   *   32 bit operation count, then per operation a type byte followed by
+   *   either the 32 bit index and count of kept sections or the 32 bit size
+   *   of a new section and the section itself.
+   */
+  class FilterStorageJournal
+  {
+  public:
+    enum class Action
+    {
+      NONE,
+      WRITE_FILE,
+      WRITE_JOURNAL,
+      APPEND_TO_JOURNAL
+    };
+
+    struct Change
+    {
+      Action action;
+      IFileSystem::IOBuffer data;
+    };
+
+    /**
+     * @return Name of the journal of a file.
+     */
+    static std::string GetFileName(const std::string& fileName);
+
+    /**
+     * Restores the content of a file from the file and its journal and
+     * remembers it, so that changes can be recorded from then on.
+     * A damaged journal is applied up to the damage.
+     * @param journal Content of the journal, empty if there is none.
+     * @return Sections of the content, pointing into `data` and `journal`.
+     * @throw std::runtime_error If the file itself is damaged.
+     */
+    std::vector<FilterStorageFile::Section> Load(const std::string& fileName,
+                                                 const uint8_t* data,
+                                                 size_t size,
+                                                 const IFileSystem::IOBuffer& journal);
+
+    /**
+     * Records the new content of a file.
+     * @param sections Serialized sections, see
+     *        `FilterStorageFile::Writer::FinishSections`.
+     * @return How to store the content: nothing if it didn't change, the
+     *         whole file, to be followed by removing the journal, or a
+     *         journal record to be written as a new journal or appended to
+     *         the existing one.
+     */
+    Change Update(const std::string& fileName, const std::vector<IFileSystem::IOBuffer>& sections);
+
+    /**
+     * @return `true` if the file has a journal which should be compacted.
+     */
+    bool HasJournal(const std::string& fileName) const;
+
+    /**
+     * Notes that the file was written as a whole and its journal removed.
+     */
+    void Compacted(const std::string& fileName, size_t size);
+
+    /**
+     * Forgets about a file, e.g. after it was moved or couldn't be written.
+     */
+    void Forget(const std::string& fileName);
+
+  private:
+    struct FileState
+    {
+      std::vector<uint64_t> sectionHashes;
+      size_t size = 0;
+      size_t journalSize = 0;
+      bool journalDamaged = false;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::string, FileState> files;
+  };
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/FrameContext.h>
+
+using namespace AdblockPlus;
+
+FrameContext::FrameContext(const std::vector<std::string>& documentUrls, const std::string& siteKey)
+    : documentUrls(documentUrls), siteKey(siteKey)
+{
+}
+
+const std::vector<std::string>& FrameContext::GetDocumentUrls() const
+{
+  return documentUrls;
+}
+
+std::string FrameContext::GetDocumentUrl() const
+{
+  return documentUrls.empty() ? "" : documentUrls.front();
+}
+
+const std::string& FrameContext::GetSiteKey() const
+{
+  return siteKey;
+}
+
+bool FrameContext::FindAllowlistingFilter(IFilterEngine::ContentTypeMask contentTypeMask,
+                                          uint64_t generation,
+                                          Filter* filter) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& result : allowlistingResults)
+  {
+    if (result.contentTypeMask == contentTypeMask && result.generation == generation)
+    {
+      *filter = result.filter;
+      return true;
+    }
+  }
+  return false;
+}
+
+void FrameContext::StoreAllowlistingFilter(IFilterEngine::ContentTypeMask contentTypeMask,
+                                           uint64_t generation,
+                                           const Filter& filter) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& result : allowlistingResults)
+  {
+    if (result.contentTypeMask == contentTypeMask)
+    {
+      result.generation = generation;
+      result.filter = filter;
+      return;
+    }
+  }
+  allowlistingResults.push_back({contentTypeMask, generation, filter});
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/IFileSystem.h>
+
+using namespace AdblockPlus;
+
+void IFileSystem::ReadContent(const std::string& fileName,
+                              const ReadContentCallback& doneCallback,
+                              const Callback& errorCallback) const
+{
+  Read(
+      fileName,
+      [doneCallback](IOBuffer&& buffer) {
+        doneCallback(std::make_shared<BufferFileContent>(std::move(buffer)));
+      },
+      errorCallback);
+}
+
+void IFileSystem::ReadChunks(const std::string& fileName,
+                             size_t chunkSize,
+                             const ReadChunkCallback& chunkCallback,
+                             const Callback& errorCallback) const
+{
+  Read(
+      fileName,
+      [chunkCallback](IOBuffer&& buffer) {
+        if (buffer.empty())
+          return chunkCallback(IOBuffer(), [] {});
+        chunkCallback(std::move(buffer), [chunkCallback] {
+          chunkCallback(IOBuffer(), [] {});
+        });
+      },
+      errorCallback);
+}
+
+void IFileSystem::Append(const std::string& fileName,
+                         const IOBuffer& data,
+                         const Callback& callback)
+{
+  Read(
+      fileName,
+      [this, fileName, data, callback](IOBuffer&& buffer) {
+        buffer.insert(buffer.end(), data.begin(), data.end());
+        Write(fileName, buffer, callback);
+      },
+      callback);
+}
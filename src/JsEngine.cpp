@@ -17,6 +17,8 @@
 
 #include <AdblockPlus.h>
 #include <assert.h>
+#include <future>
+#include <thread>
 
 // TODO check whether this can be removed after V8 upgrade
 #pragma clang diagnostic push
@@ -27,6 +29,7 @@
 #include "GlobalJsObject.h"
 #include "JsContext.h"
 #include "JsError.h"
+#include "JsSnapshot.h"
 #include "Utils.h"
 
 namespace
@@ -85,12 +88,13 @@ namespace
   class ScopedV8Isolate : public AdblockPlus::IV8IsolateProvider
   {
   public:
-    ScopedV8Isolate()
+    explicit ScopedV8Isolate(v8::StartupData* snapshot = nullptr)
     {
       V8Initializer::Init();
       allocator.reset(v8::ArrayBuffer::Allocator::NewDefaultAllocator());
       v8::Isolate::CreateParams isolateParams;
       isolateParams.array_buffer_allocator = allocator.get();
+      isolateParams.snapshot_blob = snapshot;
       isolate_ = v8::Isolate::New(isolateParams);
     }
 
@@ -142,7 +146,9 @@ void JsEngine::ScheduleTimer(const v8::FunctionCallbackInfo<v8::Value>& argument
       CHECKED_TO_VALUE(arguments[1]->IntegerValue(arguments.GetIsolate()->GetCurrentContext()));
 
   jsEngine->GetTimer().SetTimer(std::chrono::milliseconds(millis), [jsEngine, timerParamsID] {
-    jsEngine->CallTimerTask(timerParamsID);
+    jsEngine->Post(JsEventLoop::Priority::BACKGROUND, [jsEngine, timerParamsID] {
+      jsEngine->CallTimerTask(timerParamsID);
+    });
   });
 }
 
@@ -172,6 +178,8 @@ AdblockPlus::JsEngine::JsEngine(const Interfaces& interfaces,
 
 JsEngine::~JsEngine()
 {
+  // Pending tasks reference this instance, so drop them first.
+  StopEventLoop();
   std::lock_guard<std::mutex> lock(jsWeakValuesListsMutex_);
   for (auto* weakValue : registeredWeakValues_)
     weakValue->Invalidate();
@@ -180,13 +188,19 @@ JsEngine::~JsEngine()
 std::unique_ptr<AdblockPlus::JsEngine>
 AdblockPlus::JsEngine::New(const AppInfo& appInfo,
                            const Interfaces& interfaces,
-                           std::unique_ptr<IV8IsolateProvider> isolate)
+                           std::unique_ptr<IV8IsolateProvider> isolate,
+                           bool useEventLoop)
 {
+  v8::StartupData* snapshot = nullptr;
   if (!isolate)
   {
-    isolate.reset(new ScopedV8Isolate());
+    snapshot = JsSnapshot::Get();
+    isolate.reset(new ScopedV8Isolate(snapshot));
   }
   std::unique_ptr<AdblockPlus::JsEngine> result(new JsEngine(interfaces, std::move(isolate)));
+  result->fromSnapshot_ = snapshot != nullptr;
+  if (useEventLoop)
+    result->eventLoop_.reset(new JsEventLoop());
 
   const v8::Locker locker(result->GetIsolate());
   const v8::Isolate::Scope isolateScope(result->GetIsolate());
@@ -199,6 +213,95 @@ AdblockPlus::JsEngine::New(const AppInfo& appInfo,
   return result;
 }
 
+void JsEngine::Post(JsEventLoop::Priority priority, JsEventLoop::Task&& task)
+{
+  if (!eventLoop_)
+  {
+    task();
+    return;
+  }
+  eventLoop_->Post(priority, std::move(task));
+}
+
+void JsEngine::RunInteractive(const std::function<void()>& task)
+{
+  if (!eventLoop_ || eventLoop_->IsLoopThread() || v8::Locker::IsLocked(GetIsolate()))
+  {
+    task();
+    return;
+  }
+  // If the loop is stopped before executing the task, the future reports
+  // a broken promise instead of blocking forever.
+  auto packagedTask = std::make_shared<std::packaged_task<void()>>(task);
+  auto result = packagedTask->get_future();
+  if (!eventLoop_->Post(JsEventLoop::Priority::INTERACTIVE, [packagedTask] {
+        (*packagedTask)();
+      }))
+  {
+    task();
+    return;
+  }
+  result.get();
+}
+
+void JsEngine::StopEventLoop()
+{
+  if (eventLoop_)
+    eventLoop_->Stop();
+}
+
+void JsEngine::PostSliced(const std::function<bool()>& slice)
+{
+  if (!eventLoop_)
+  {
+    while (!slice())
+      std::this_thread::yield();
+    return;
+  }
+  Post(JsEventLoop::Priority::BACKGROUND, [this, slice] {
+    if (!slice())
+      PostSliced(slice);
+  });
+}
+
+void JsEngine::SetTimeSlice(std::chrono::milliseconds timeSlice)
+{
+  timeSlice_ = timeSlice.count();
+}
+
+std::chrono::milliseconds JsEngine::GetTimeSlice() const
+{
+  return std::chrono::milliseconds(timeSlice_);
+}
+
+void JsEngine::SetLineChunkSize(size_t chunkSize)
+{
+  lineChunkSize_ = chunkSize;
+}
+
+size_t JsEngine::GetLineChunkSize() const
+{
+  return lineChunkSize_;
+}
+
+bool JsEngine::IsEvaluatedInSnapshot(const std::string& fileName) const
+{
+  return fromSnapshot_ && JsSnapshot::Contains(fileName);
+}
+
+void JsEngine::UseCodeCache(const std::vector<std::string>& fileNames,
+                            const std::function<void()>& done)
+{
+  codeCache_.reset(new ScriptCodeCache(fileSystem));
+  codeCacheFileNames_ = std::set<std::string>(fileNames.begin(), fileNames.end());
+  codeCache_->Load(fileNames, done);
+}
+
+ScriptCodeCache::Stats JsEngine::GetCodeCacheStats() const
+{
+  return codeCache_ ? codeCache_->GetStats() : ScriptCodeCache::Stats();
+}
+
 AdblockPlus::JsValue AdblockPlus::JsEngine::GetGlobalObject()
 {
   JsContext context(GetIsolate(), *GetContext());
@@ -211,10 +314,16 @@ AdblockPlus::JsValue AdblockPlus::JsEngine::Evaluate(const std::string& source,
   auto isolate = GetIsolate();
   const JsContext context(isolate, *GetContext());
   const v8::TryCatch tryCatch(isolate);
-  auto script =
-      CHECKED_TO_LOCAL_WITH_TRY_CATCH(isolate, CompileScript(isolate, source, filename), tryCatch);
+  const bool useCodeCache = codeCache_ && codeCacheFileNames_.count(filename) > 0;
+  auto script = CHECKED_TO_LOCAL_WITH_TRY_CATCH(
+      isolate,
+      useCodeCache ? codeCache_->Compile(isolate, source, filename)
+                   : CompileScript(isolate, source, filename),
+      tryCatch);
   auto result =
       CHECKED_TO_LOCAL_WITH_TRY_CATCH(isolate, script->Run(isolate->GetCurrentContext()), tryCatch);
+  if (useCodeCache)
+    codeCache_->Update(filename, script);
   return JsValue(GetIsolateProviderPtr(), GetContext(), result);
 }
 
@@ -307,6 +416,15 @@ JsValue JsEngine::NewArray(const std::vector<std::string>& values)
                  v8::Array::New(isolate, elements.data(), elements.size()));
 }
 
+JsValue JsEngine::NewArrayOfLocals(const std::vector<v8::Local<v8::Value>>& values)
+{
+  const JsContext context(GetIsolate(), *GetContext());
+  // v8::Array::New doesn't modify the elements but takes a non-const pointer.
+  auto* elements = const_cast<v8::Local<v8::Value>*>(values.data());
+  return JsValue(
+      GetIsolateProviderPtr(), GetContext(), v8::Array::New(GetIsolate(), elements, values.size()));
+}
+
 AdblockPlus::JsValue AdblockPlus::JsEngine::NewCallback(const v8::FunctionCallback& callback)
 {
   auto isolate = GetIsolate();
@@ -17,13 +17,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <type_traits>
 
 #include <AdblockPlus/AppInfo.h>
 #include <AdblockPlus/IFileSystem.h>
@@ -34,6 +39,10 @@
 #include <AdblockPlus/JsValue.h>
 #include <AdblockPlus/LogSystem.h>
 
+#include "FilterStorageJournal.h"
+#include "JsEventLoop.h"
+#include "ScriptCodeCache.h"
+
 namespace AdblockPlus
 {
   class JsEngine;
@@ -126,11 +135,119 @@ namespace AdblockPlus
      * @param interfaces contains implementation for the interfaces JsEngine uses.
      * @param isolate A provider of v8::Isolate, if the value is nullptr then
      *        a default implementation is used.
+     * @param useEventLoop If `true` the engine owns a thread executing
+     *        JavaScript triggered by timers, file system, web request and
+     *        resource reader callbacks as well as calls made through `RunInteractive`,
+     *        see `Post`.
      * @return New `JsEngine` instance.
      */
     static std::unique_ptr<JsEngine> New(const AppInfo& appInfo,
                                          const Interfaces& interfaces,
-                                         std::unique_ptr<IV8IsolateProvider> isolate = nullptr);
+                                         std::unique_ptr<IV8IsolateProvider> isolate = nullptr,
+                                         bool useEventLoop = false);
+
+    /**
+     * Executes `task` on the event loop thread after all pending tasks of a
+     * higher priority. If the engine has no event loop, `task` is executed
+     * immediately on the calling thread.
+     * @param priority Priority of the task.
+     * @param task Task to execute.
+     */
+    void Post(JsEventLoop::Priority priority, JsEventLoop::Task&& task);
+
+    /**
+     * Executes `task` with the interactive priority and waits until it's
+     * finished, exceptions thrown by `task` are rethrown to the caller.
+     * `task` is executed on the calling thread if the engine has no event loop,
+     * if it's called from the event loop thread or if the calling thread
+     * already holds the JavaScript lock.
+     * @param task Task to execute.
+     */
+    void RunInteractive(const std::function<void()>& task);
+
+    /**
+     * Same as above for a `task` returning a value.
+     * @param task Task to execute.
+     * @return Value returned by `task`.
+     */
+    template<typename Task>
+    auto RunInteractive(Task&& task) ->
+        typename std::enable_if<!std::is_void<decltype(task())>::value, decltype(task())>::type
+    {
+      std::unique_ptr<decltype(task())> result;
+      RunInteractive(std::function<void()>([&task, &result] {
+        result.reset(new decltype(task())(task()));
+      }));
+      return std::move(*result);
+    }
+
+    /**
+     * Stops the event loop, if any, after the currently executed task is
+     * finished. Afterwards background tasks are dropped and interactive
+     * tasks are executed on the calling thread. It should be called before
+     * destroying the interfaces used by the engine.
+     */
+    void StopEventLoop();
+
+    /**
+     * Calls `slice` until it returns `true`. Every call is a separate
+     * background task, so pending interactive tasks are executed in between,
+     * see `Post`. Without an event loop all calls are made on the calling
+     * thread, `slice` should then release the JavaScript lock before returning.
+     * @param slice Processes the next part of a long job, it should return
+     *        after about `GetTimeSlice()`.
+     */
+    void PostSliced(const std::function<bool()>& slice);
+
+    /**
+     * Sets how long long-running jobs like reading a filter list from a file
+     * may hold the JavaScript lock before letting other tasks run.
+     * @param timeSlice Duration of a slice, zero disables slicing.
+     */
+    void SetTimeSlice(std::chrono::milliseconds timeSlice);
+
+    /**
+     * @return Duration of a slice, see `SetTimeSlice`.
+     */
+    std::chrono::milliseconds GetTimeSlice() const;
+
+    /**
+     * Sets how many lines of a file `_fileSystem.readLinesFromFile` passes to
+     * the listener at once. Bigger chunks mean fewer calls into JavaScript.
+     * @param chunkSize Number of lines, zero is treated as one.
+     */
+    void SetLineChunkSize(size_t chunkSize);
+
+    /**
+     * @return Number of lines per chunk, see `SetLineChunkSize`.
+     */
+    size_t GetLineChunkSize() const;
+
+    /**
+     * Checks whether a script of the library is already evaluated in the
+     * V8 startup snapshot the context was created from, so it must not be
+     * evaluated again. Engines with an isolate passed to `New()` don't use
+     * the snapshot.
+     * @param fileName File name of the script, as in `jsSources`.
+     * @return `true` if the script is part of the context already.
+     */
+    bool IsEvaluatedInSnapshot(const std::string& fileName) const;
+
+    /**
+     * Starts keeping the code V8 compiles for the scripts evaluated with one
+     * of `fileNames` in a persistent cache, see `ScriptCodeCache`. Other
+     * scripts, e.g. those evaluated by the embedder, are compiled as before.
+     * Should be called before any script is evaluated.
+     * @param fileNames File names of the scripts to cache the code of.
+     * @param done Called once the cache entries are read.
+     */
+    void UseCodeCache(const std::vector<std::string>& fileNames, const std::function<void()>& done);
+
+    /**
+     * @return Code cache hits, misses and compile times, all zero if the
+     *         code cache isn't used.
+     */
+    ScriptCodeCache::Stats GetCodeCacheStats() const;
 
     /**
      * Registers the callback function for an event.
@@ -157,7 +274,7 @@ namespace AdblockPlus
      * Evaluates a JavaScript expression.
      * @param source JavaScript expression to evaluate.
      * @param filename Optional file name for the expression, used in error
-     *        messages.
+     *        messages and as the key of the code cache.
      * @return Result of the evaluated expression.
      */
     JsValue Evaluate(const std::string& source, const std::string& filename = "");
@@ -205,6 +322,15 @@ namespace AdblockPlus
      */
     JsValue NewArray(const std::vector<std::string>& values);
 
+    /**
+     * Creates a new JavaScript array from values which are already in the
+     * current handle scope, it saves wrapping every element into `JsValue`.
+     * It's not an overload of `NewArray`, so that braced lists of string
+     * literals keep resolving to the array of strings.
+     * @return New `JsValue` instance.
+     */
+    JsValue NewArrayOfLocals(const std::vector<v8::Local<v8::Value>>& values);
+
     /**
      * Creates a JavaScript function that invokes a C++ callback.
      * @param callback C++ callback to invoke. The callback receives a
@@ -292,6 +418,15 @@ namespace AdblockPlus
       return resourceReader;
     }
 
+    /**
+     * Content of the files written by `_fileSystem.writeLines`, only to be
+     * used on the thread of the engine.
+     */
+    FilterStorageJournal& GetFilterStorageJournal()
+    {
+      return filterStorageJournal_;
+    }
+
   private:
     void CallTimerTask(const JsWeakValuesID& timerParamsID);
 
@@ -341,5 +476,12 @@ namespace AdblockPlus
     JsWeakValuesLists jsWeakValuesLists_;
     std::mutex jsWeakValuesListsMutex_;
     std::vector<ScopedWeakValues::RegisteredWeakValue*> registeredWeakValues_;
+    std::unique_ptr<JsEventLoop> eventLoop_;
+    std::atomic<std::chrono::milliseconds::rep> timeSlice_{0};
+    std::atomic<size_t> lineChunkSize_{1000};
+    bool fromSnapshot_ = false;
+    std::unique_ptr<ScriptCodeCache> codeCache_;
+    std::set<std::string> codeCacheFileNames_;
+    FilterStorageJournal filterStorageJournal_;
   };
 }
@@ -0,0 +1,96 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JsEventLoop.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace AdblockPlus;
+
+JsEventLoop::JsEventLoop() : isRunning(true)
+{
+  thread = std::thread([this] {
+    ThreadFunc();
+  });
+}
+
+JsEventLoop::~JsEventLoop()
+{
+  Stop();
+}
+
+bool JsEventLoop::Post(Priority priority, Task&& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isRunning)
+      return false;
+    if (task)
+      queues[static_cast<size_t>(priority)].push_back(std::move(task));
+  }
+  hasTasks.notify_one();
+  return true;
+}
+
+void JsEventLoop::Stop()
+{
+  std::deque<Task> dropped[static_cast<size_t>(Priority::PRIORITY_COUNT)];
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    isRunning = false;
+    std::swap(dropped, queues);
+  }
+  hasTasks.notify_one();
+  if (thread.joinable())
+    thread.join();
+}
+
+bool JsEventLoop::IsLoopThread() const
+{
+  return std::this_thread::get_id() == thread.get_id();
+}
+
+void JsEventLoop::ThreadFunc()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (isRunning)
+  {
+    auto queue = std::find_if(std::begin(queues), std::end(queues), [](const std::deque<Task>& q) {
+      return !q.empty();
+    });
+    if (queue == std::end(queues))
+    {
+      hasTasks.wait(lock);
+      continue;
+    }
+    Task task = std::move(queue->front());
+    queue->pop_front();
+    lock.unlock();
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      // do nothing, but the thread will be alive.
+    }
+    // Destroy the task before taking the lock, it may own JS values.
+    task = Task();
+    lock.lock();
+  }
+}
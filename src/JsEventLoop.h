@@ -0,0 +1,76 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace AdblockPlus
+{
+  /**
+   * A single thread executing posted tasks, where tasks of a higher priority
+   * are always started before any pending task of a lower priority. Tasks of
+   * the same priority are executed in the order they were posted.
+   * When stopped, pending and further posted tasks are dropped without being
+   * executed.
+   */
+  class JsEventLoop
+  {
+  public:
+    enum class Priority
+    {
+      INTERACTIVE,
+      BACKGROUND,
+      PRIORITY_COUNT
+    };
+
+    typedef std::function<void()> Task;
+
+    JsEventLoop();
+    ~JsEventLoop();
+
+    /**
+     * Adds `task` to the end of the queue of the given priority.
+     * @return `false` if the loop is stopped, `task` is dropped in that case.
+     */
+    bool Post(Priority priority, Task&& task);
+
+    /**
+     * Waits for the currently executed task to finish and stops the thread.
+     * Must not be called from the loop thread.
+     */
+    void Stop();
+
+    /**
+     * @return `true` if called from the thread executing the tasks.
+     */
+    bool IsLoopThread() const;
+
+  private:
+    void ThreadFunc();
+
+    std::mutex mutex;
+    std::condition_variable hasTasks;
+    bool isRunning;
+    std::deque<Task> queues[static_cast<size_t>(Priority::PRIORITY_COUNT)];
+    std::thread thread;
+  };
+}
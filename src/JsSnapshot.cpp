@@ -0,0 +1,103 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JsSnapshot.h"
+
+#include <memory>
+#include <stdexcept>
+
+#ifdef ABP_JS_SNAPSHOT
+// Generated by the abpsnapshot tool.
+extern const unsigned char jsSnapshotData[];
+extern const size_t jsSnapshotSize;
+extern std::string jsSnapshotFiles[];
+#endif
+
+using namespace AdblockPlus;
+
+namespace
+{
+  std::string ToString(v8::Isolate* isolate, v8::Local<v8::Value> value)
+  {
+    v8::String::Utf8Value utf8Value(isolate, value);
+    return *utf8Value ? std::string(*utf8Value, utf8Value.length()) : std::string();
+  }
+}
+
+v8::StartupData* JsSnapshot::Get()
+{
+#ifdef ABP_JS_SNAPSHOT
+  static v8::StartupData snapshot = {reinterpret_cast<const char*>(jsSnapshotData),
+                                     static_cast<int>(jsSnapshotSize)};
+  return &snapshot;
+#else
+  return nullptr;
+#endif
+}
+
+bool JsSnapshot::Contains(const std::string& fileName)
+{
+#ifdef ABP_JS_SNAPSHOT
+  for (int i = 0; !jsSnapshotFiles[i].empty(); ++i)
+  {
+    if (jsSnapshotFiles[i] == fileName)
+      return true;
+  }
+#endif
+  return false;
+}
+
+std::string JsSnapshot::Create(const std::vector<std::pair<std::string, std::string>>& scripts)
+{
+  v8::SnapshotCreator creator;
+  v8::Isolate* isolate = creator.GetIsolate();
+  {
+    const v8::HandleScope handleScope(isolate);
+    auto context = v8::Context::New(isolate);
+    const v8::Context::Scope contextScope(context);
+    for (const auto& script : scripts)
+    {
+      const v8::TryCatch tryCatch(isolate);
+      auto fileName = v8::String::NewFromUtf8(isolate,
+                                              script.first.c_str(),
+                                              v8::NewStringType::kNormal,
+                                              static_cast<int>(script.first.size()));
+      auto source = v8::String::NewFromUtf8(isolate,
+                                            script.second.c_str(),
+                                            v8::NewStringType::kNormal,
+                                            static_cast<int>(script.second.size()));
+      if (fileName.IsEmpty() || source.IsEmpty())
+        throw std::runtime_error("Failed to create the source of " + script.first);
+      v8::ScriptOrigin origin(fileName.ToLocalChecked());
+      v8::Local<v8::Script> compiled;
+      if (!v8::Script::Compile(context, source.ToLocalChecked(), &origin).ToLocal(&compiled) ||
+          compiled->Run(context).IsEmpty())
+      {
+        throw std::runtime_error("Failed to evaluate " + script.first + ": " +
+                                 ToString(isolate, tryCatch.Exception()));
+      }
+    }
+    creator.SetDefaultContext(context);
+  }
+
+  // Keeping the compiled functions also saves compiling them at startup.
+  v8::StartupData blob = creator.CreateBlob(v8::SnapshotCreator::FunctionCodeHandling::kKeep);
+  if (!blob.data)
+    throw std::runtime_error("Failed to create the snapshot");
+  std::unique_ptr<const char[]> data(blob.data);
+  return std::string(blob.data, blob.raw_size);
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <v8.h>
+#include <vector>
+
+namespace AdblockPlus
+{
+  /**
+   * V8 startup snapshot with some of the library's scripts already
+   * evaluated, see `use_js_snapshot` in libadblockplus.gyp. Only scripts
+   * which don't use the objects set up by `GlobalJsObject` while being
+   * evaluated, and only require other scripts of the snapshot, can be part
+   * of it.
+   */
+  namespace JsSnapshot
+  {
+    /**
+     * @return The snapshot the library is built with, null if there is none.
+     */
+    v8::StartupData* Get();
+
+    /**
+     * @return `true` if the script `fileName` is evaluated in the snapshot
+     *         returned by `Get()`.
+     */
+    bool Contains(const std::string& fileName);
+
+    /**
+     * Evaluates scripts in a new context and serializes it, used by the
+     * abpsnapshot tool. V8 has to be initialized.
+     * @param scripts File names and sources of the scripts, in the order of
+     *        evaluation.
+     * @return The snapshot data.
+     */
+    std::string Create(const std::vector<std::pair<std::string, std::string>>& scripts);
+  }
+}
@@ -0,0 +1,111 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MatchCache.h"
+
+#include <functional>
+
+using namespace AdblockPlus;
+
+bool MatchCache::Key::operator==(const Key& other) const
+{
+  return url == other.url && contentTypeMask == other.contentTypeMask &&
+         documentHost == other.documentHost && siteKey == other.siteKey &&
+         specificOnly == other.specificOnly;
+}
+
+std::size_t MatchCache::KeyHash::operator()(const Key& key) const
+{
+  std::hash<std::string> stringHash;
+  std::size_t result = stringHash(key.url);
+  result = result * 31 + stringHash(key.documentHost);
+  result = result * 31 + stringHash(key.siteKey);
+  result = result * 31 + key.contentTypeMask;
+  return result * 2 + (key.specificOnly ? 1 : 0);
+}
+
+MatchCache::MatchCache(std::size_t capacity)
+    : capacity(capacity), generation(0), entriesGeneration(0), hits(0), misses(0)
+{
+}
+
+uint64_t MatchCache::GetGeneration() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return generation;
+}
+
+void MatchCache::Invalidate()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ++generation;
+}
+
+bool MatchCache::Get(const Key& key, Filter* filter)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  DropStaleEntries();
+  auto it = index.find(key);
+  if (it == index.end())
+  {
+    ++misses;
+    return false;
+  }
+  ++hits;
+  entries.splice(entries.begin(), entries, it->second);
+  *filter = it->second->second;
+  return true;
+}
+
+void MatchCache::Put(const Key& key, uint64_t resultGeneration, const Filter& filter)
+{
+  if (!IsEnabled())
+    return;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (resultGeneration != generation)
+    return;
+  DropStaleEntries();
+  auto it = index.find(key);
+  if (it != index.end())
+  {
+    entries.splice(entries.begin(), entries, it->second);
+    it->second->second = filter;
+    return;
+  }
+  if (entries.size() >= capacity)
+  {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+  entries.emplace_front(key, filter);
+  index.emplace(key, entries.begin());
+}
+
+IFilterEngine::MatchCacheStats MatchCache::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return {hits, misses, entriesGeneration == generation ? entries.size() : 0, capacity};
+}
+
+void MatchCache::DropStaleEntries()
+{
+  if (entriesGeneration == generation)
+    return;
+  index.clear();
+  entries.clear();
+  entriesGeneration = generation;
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <AdblockPlus/IFilterEngine.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Size-bounded LRU cache of request matching results.
+   * Every entry is stamped with the generation it was computed in, any
+   * change of the filters has to be reported via `Invalidate()` which starts
+   * a new generation and thereby drops all entries.
+   * Stored filters hold JavaScript values, so the methods should be called
+   * with a `JsContext` acquired, in order to always take the JavaScript lock
+   * before the lock of the cache.
+   */
+  class MatchCache
+  {
+  public:
+    struct Key
+    {
+      std::string url;
+      IFilterEngine::ContentTypeMask contentTypeMask;
+      std::string documentHost;
+      std::string siteKey;
+      bool specificOnly;
+
+      bool operator==(const Key& other) const;
+    };
+
+    /**
+     * Constructor.
+     * @param capacity Maximal number of entries, 0 disables the cache.
+     */
+    explicit MatchCache(std::size_t capacity);
+
+    bool IsEnabled() const
+    {
+      return capacity > 0;
+    }
+
+    /**
+     * Returns the current generation, it should be retrieved before the
+     * result to be stored is computed and then passed to `Put()`.
+     */
+    uint64_t GetGeneration() const;
+
+    /**
+     * Starts a new generation, all existing entries become stale.
+     */
+    void Invalidate();
+
+    /**
+     * Looks up the result for `key` and counts a hit or a miss.
+     * @param key Request to look up.
+     * @param filter Receives the stored result in case of a hit.
+     * @return `true` in case of a hit.
+     */
+    bool Get(const Key& key, Filter* filter);
+
+    /**
+     * Stores the result for `key`, evicting the least recently used entry
+     * if the cache is full. The result is dropped if it has been computed in
+     * a generation which is not current anymore.
+     */
+    void Put(const Key& key, uint64_t generation, const Filter& filter);
+
+    IFilterEngine::MatchCacheStats GetStats() const;
+
+  private:
+    struct KeyHash
+    {
+      std::size_t operator()(const Key& key) const;
+    };
+    typedef std::list<std::pair<Key, Filter>> Entries;
+
+    void DropStaleEntries();
+
+    const std::size_t capacity;
+    mutable std::mutex mutex;
+    uint64_t generation;
+    uint64_t entriesGeneration;
+    uint64_t hits;
+    uint64_t misses;
+    // Most recently used entries are at the front.
+    Entries entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash> index;
+  };
+}
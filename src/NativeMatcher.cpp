@@ -0,0 +1,566 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NativeMatcher.h"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+
+#include "AsciiScanner.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // Longer URLs are not checked against regular expressions, std::regex
+  // recurses per character.
+  const size_t MAX_REGEXP_URL_LENGTH = 4096;
+
+  // Number of counters of the keyword Bloom filter, a few times the number
+  // of distinct keywords in the common filter lists.
+  const size_t KEYWORD_COUNTER_COUNT = 1 << 18;
+
+  bool IsAscii(const std::string& str)
+  {
+    return std::all_of(str.begin(), str.end(), [](char c) {
+      return static_cast<unsigned char>(c) < 0x80;
+    });
+  }
+
+  std::string ToLowerAscii(const std::string& str)
+  {
+    std::string result(str);
+    for (auto& c : result)
+    {
+      if (c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+    }
+    return result;
+  }
+
+  // Whether a domain name has a leading, trailing or doubled dot.
+  bool HasEmptyLabel(const std::string& domain)
+  {
+    return domain.front() == '.' || domain.back() == '.' || domain.find("..") != std::string::npos;
+  }
+
+  // Characters which can be part of a keyword, [a-z0-9%].
+  bool IsKeywordChar(char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '%';
+  }
+
+  // Characters matched by the ^ placeholder, see filterToRegExp() in
+  // patterns.js: all ASCII characters but alphanumeric ones and _%.-
+  bool IsSeparator(char c)
+  {
+    unsigned char u = static_cast<unsigned char>(c);
+    return u <= 0x24 || (u >= 0x26 && u <= 0x2C) || u == 0x2F || (u >= 0x3A && u <= 0x40) ||
+           (u >= 0x5B && u <= 0x5E) || u == 0x60 || (u >= 0x7B && u <= 0x7F);
+  }
+
+  // Matches a pattern segment without wildcards at |pos|, returns the end of
+  // the match or std::string::npos.
+  size_t MatchSegment(const std::string& segment, const std::string& location, size_t pos)
+  {
+    for (char c : segment)
+    {
+      if (c == '^')
+      {
+        // The placeholder also matches the end of the address.
+        if (pos == location.size())
+          continue;
+        if (!IsSeparator(location[pos]))
+          return std::string::npos;
+      }
+      else if (pos == location.size() || location[pos] != c)
+      {
+        return std::string::npos;
+      }
+      ++pos;
+    }
+    return pos;
+  }
+}
+
+struct NativeMatcher::CompiledFilter
+{
+  enum class Anchor
+  {
+    NONE,
+    // |pattern
+    START,
+    // ||pattern
+    HOST
+  };
+
+  // Keyword the filter is indexed by, empty if there is none.
+  std::string keyword;
+  // Domains the filter is restricted to or excluded from.
+  std::vector<std::string> domains;
+  uint32_t contentType = 0;
+  bool matchCase = false;
+  bool hasSitekeys = false;
+  bool hasDomains = false;
+  // Whether the filter is active on domains it doesn't list.
+  bool activeByDefault = false;
+  // The location check can't be done natively.
+  bool matchesAnyLocation = false;
+  std::unique_ptr<std::regex> regexp;
+  Anchor startAnchor = Anchor::NONE;
+  bool endAnchor = false;
+  // The pattern split at wildcards.
+  std::vector<std::string> segments;
+
+  bool MatchesSegments(const std::string& location, size_t pos, bool fixedStart) const;
+};
+
+bool NativeMatcher::CompiledFilter::MatchesSegments(const std::string& location,
+                                                    size_t pos,
+                                                    bool fixedStart) const
+{
+  for (size_t i = 0; i < segments.size(); ++i)
+  {
+    const std::string& segment = segments[i];
+    bool mustEnd = endAnchor && i + 1 == segments.size();
+    if (i == 0 && fixedStart)
+    {
+      pos = MatchSegment(segment, location, pos);
+      if (pos == std::string::npos || (mustEnd && pos != location.size()))
+        return false;
+      continue;
+    }
+
+    size_t end = std::string::npos;
+    if (segment.find('^') == std::string::npos)
+    {
+      if (mustEnd)
+      {
+        if (location.size() >= pos + segment.size() &&
+            location.compare(location.size() - segment.size(), segment.size(), segment) == 0)
+          end = location.size();
+      }
+      else
+      {
+        size_t start = location.find(segment, pos);
+        if (start != std::string::npos)
+          end = start + segment.size();
+      }
+    }
+    else
+    {
+      for (size_t start = pos; start <= location.size(); ++start)
+      {
+        end = MatchSegment(segment, location, start);
+        if (end != std::string::npos && (!mustEnd || end == location.size()))
+          break;
+        end = std::string::npos;
+      }
+    }
+    if (end == std::string::npos)
+      return false;
+    pos = end;
+  }
+  return true;
+}
+
+// Domain restrictions of the filters which apply to the document host, they
+// are looked up once per request and only if a filter restricted to domains
+// has to be checked.
+class NativeMatcher::DocumentDomain
+{
+public:
+  DocumentDomain(const NativeMatcher& matcher, const std::string& host)
+      : matcher(matcher), host(host), resolved(false), isAscii(false)
+  {
+  }
+
+  // Same as ActiveFilter.isActiveOnDomain() in filterClasses.js.
+  bool IsActive(const CompiledFilter& filter)
+  {
+    if (!filter.hasDomains)
+      return true;
+    if (host.empty())
+      return filter.activeByDefault;
+    if (!resolved)
+      Resolve();
+    // Case conversion of non-ASCII characters is left to JavaScript.
+    if (!isAscii)
+      return true;
+    auto it = activeFilters.find(&filter);
+    return it == activeFilters.end() ? filter.activeByDefault : it->second;
+  }
+
+private:
+  void Resolve()
+  {
+    resolved = true;
+    isAscii = IsAscii(host);
+    if (!isAscii)
+      return;
+    std::string domain = ToLowerAscii(host);
+    while (!domain.empty() && domain.back() == '.')
+      domain.pop_back();
+    // The most specific domain comes last and decides.
+    matcher.filtersByDomain.ForEachMatch(
+        domain, [this](const std::vector<std::pair<const CompiledFilter*, bool>>& filters) {
+          for (const auto& filter : filters)
+            activeFilters[filter.first] = filter.second;
+        });
+  }
+
+  const NativeMatcher& matcher;
+  const std::string& host;
+  bool resolved;
+  bool isAscii;
+  std::unordered_map<const CompiledFilter*, bool> activeFilters;
+};
+
+NativeMatcher::NativeMatcher() : keywordCounters(KEYWORD_COUNTER_COUNT)
+{
+}
+
+NativeMatcher::NativeMatcher(const NativeMatcher& other) = default;
+
+NativeMatcher::~NativeMatcher()
+{
+}
+
+void NativeMatcher::Add(const UrlFilter& filter)
+{
+  if (filters.count(filter.text))
+    return;
+
+  auto compiled = std::make_shared<CompiledFilter>();
+  compiled->contentType = filter.contentType;
+  compiled->matchCase = filter.matchCase;
+  compiled->hasSitekeys = filter.hasSitekeys;
+  compiled->hasDomains = !filter.domains.empty();
+  for (const auto& domain : filter.domains)
+  {
+    if (domain.first.empty())
+    {
+      compiled->activeByDefault = domain.second;
+      continue;
+    }
+    // JavaScript never applies a domain name with empty labels to a
+    // document. Ignoring such an exclusion is the same, indexing such an
+    // inclusion without them only lets more requests through to JavaScript.
+    if (!domain.second && HasEmptyLabel(domain.first))
+      continue;
+    std::string name = domain.first;
+    name.erase(0, name.find_first_not_of('.'));
+    if (name.empty())
+      continue;
+    filtersByDomain[name].emplace_back(compiled.get(), domain.second);
+    compiled->domains.push_back(name);
+  }
+
+  std::string keyword;
+  if (!filter.hasPattern)
+  {
+    compiled->matchesAnyLocation = true;
+  }
+  else if (filter.isRegExp)
+  {
+    try
+    {
+      auto flags = std::regex::ECMAScript | std::regex::nosubs;
+      if (!filter.matchCase)
+        flags |= std::regex::icase;
+      compiled->regexp = std::make_unique<std::regex>(filter.pattern, flags);
+    }
+    catch (const std::regex_error&)
+    {
+      compiled->matchesAnyLocation = true;
+    }
+  }
+  else if (!IsAscii(filter.pattern))
+  {
+    compiled->matchesAnyLocation = true;
+  }
+  else
+  {
+    std::string pattern = filter.matchCase ? filter.pattern : ToLowerAscii(filter.pattern);
+    // filterToRegExp() drops an anchor following a separator placeholder.
+    if (pattern.size() >= 2 && pattern.compare(pattern.size() - 2, 2, "^|") == 0)
+      pattern.pop_back();
+    if (pattern.compare(0, 2, "||") == 0)
+    {
+      compiled->startAnchor = CompiledFilter::Anchor::HOST;
+      pattern.erase(0, 2);
+    }
+    else if (pattern.compare(0, 1, "|") == 0)
+    {
+      compiled->startAnchor = CompiledFilter::Anchor::START;
+      pattern.erase(0, 1);
+    }
+    if (!pattern.empty() && pattern.back() == '|')
+    {
+      compiled->endAnchor = true;
+      pattern.pop_back();
+    }
+    // Anchors next to wildcards have no effect.
+    if (!pattern.empty() && pattern.front() == '*')
+      compiled->startAnchor = CompiledFilter::Anchor::NONE;
+    if (!pattern.empty() && pattern.back() == '*')
+      compiled->endAnchor = false;
+
+    size_t start = 0;
+    while (start <= pattern.size())
+    {
+      size_t end = pattern.find('*', start);
+      if (end == std::string::npos)
+        end = pattern.size();
+      if (end > start)
+        compiled->segments.push_back(pattern.substr(start, end - start));
+      start = end + 1;
+    }
+
+    keyword = FindKeyword(filter.pattern);
+  }
+
+  if (keyword.empty())
+  {
+    keywordlessFilters.push_back(compiled.get());
+  }
+  else
+  {
+    auto& keywordFilters = filtersByKeyword[keyword];
+    if (keywordFilters.empty())
+      CountKeyword(keyword, 1);
+    keywordFilters.push_back(compiled.get());
+    compiled->keyword = std::move(keyword);
+  }
+  filters.emplace(filter.text, std::move(compiled));
+}
+
+void NativeMatcher::Remove(const std::string& text)
+{
+  auto it = filters.find(text);
+  if (it == filters.end())
+    return;
+  const CompiledFilter* compiled = it->second.get();
+
+  for (const auto& domain : compiled->domains)
+  {
+    auto& domainFilters = filtersByDomain[domain];
+    domainFilters.erase(
+        std::remove_if(domainFilters.begin(),
+                       domainFilters.end(),
+                       [compiled](const std::pair<const CompiledFilter*, bool>& entry) {
+                         return entry.first == compiled;
+                       }),
+        domainFilters.end());
+  }
+
+  if (compiled->keyword.empty())
+  {
+    keywordlessFilters.erase(
+        std::find(keywordlessFilters.begin(), keywordlessFilters.end(), compiled));
+  }
+  else
+  {
+    auto keywordIt = filtersByKeyword.find(compiled->keyword);
+    assert(keywordIt != filtersByKeyword.end());
+    auto& keywordFilters = keywordIt->second;
+    keywordFilters.erase(std::find(keywordFilters.begin(), keywordFilters.end(), compiled));
+    if (keywordFilters.empty())
+    {
+      filtersByKeyword.erase(keywordIt);
+      CountKeyword(compiled->keyword, -1);
+    }
+  }
+  filters.erase(it);
+}
+
+// FNV-1a, the upper and the lower half select the two Bloom filter counters.
+// static
+uint64_t NativeMatcher::HashKeyword(const char* begin, const char* end)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char* c = begin; c != end; ++c)
+  {
+    hash ^= static_cast<unsigned char>(*c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void NativeMatcher::CountKeyword(const std::string& keyword, int delta)
+{
+  uint64_t hash = HashKeyword(keyword.data(), keyword.data() + keyword.size());
+  for (size_t index : {hash % KEYWORD_COUNTER_COUNT, (hash >> 32) % KEYWORD_COUNTER_COUNT})
+  {
+    // A saturated counter doesn't know how many keywords it counts anymore.
+    if (keywordCounters[index] < UINT8_MAX)
+      keywordCounters[index] += delta;
+  }
+}
+
+bool NativeMatcher::MayContainKeyword(uint64_t hash) const
+{
+  return keywordCounters[hash % KEYWORD_COUNTER_COUNT] != 0 &&
+         keywordCounters[(hash >> 32) % KEYWORD_COUNTER_COUNT] != 0;
+}
+
+// Finds the next sequence of keyword characters starting after |*position|
+// which is surrounded by characters that can't be part of a keyword, same
+// as /[^a-z0-9%*][a-z0-9%]{2,}(?=[^a-z0-9%*])/ in matcher.js. Such sequence
+// matches a whole token of the URL if the filter matches.
+// static
+std::string NativeMatcher::FindKeywordCandidate(const std::string& pattern, size_t* position)
+{
+  for (size_t i = *position; i < pattern.size(); ++i)
+  {
+    if (IsKeywordChar(pattern[i]) || pattern[i] == '*')
+      continue;
+    size_t end = i + 1;
+    while (end < pattern.size() && IsKeywordChar(pattern[end]))
+      ++end;
+    if (end - i - 1 >= 2 && end < pattern.size() && pattern[end] != '*')
+    {
+      *position = end;
+      return pattern.substr(i + 1, end - i - 1);
+    }
+  }
+  *position = pattern.size();
+  return "";
+}
+
+std::string NativeMatcher::FindKeyword(const std::string& pattern) const
+{
+  std::string lowerCasePattern = ToLowerAscii(pattern);
+  std::string result;
+  size_t resultCount = 0;
+  size_t position = 0;
+  // Prefer the keyword shared by the fewest filters, then the longest one.
+  for (;;)
+  {
+    std::string candidate = FindKeywordCandidate(lowerCasePattern, &position);
+    if (candidate.empty())
+      break;
+    auto it = filtersByKeyword.find(candidate);
+    size_t count = it == filtersByKeyword.end() ? 0 : it->second.size();
+    if (result.empty() || count < resultCount ||
+        (count == resultCount && candidate.size() > result.size()))
+    {
+      result = candidate;
+      resultCount = count;
+    }
+  }
+  return result;
+}
+
+bool NativeMatcher::MayMatch(const std::string& url,
+                             uint32_t contentTypeMask,
+                             const std::string& documentHost,
+                             const std::string& siteKey) const
+{
+  std::string lowerCaseUrl;
+  if (!AsciiScanner::ToLowerAscii(url, &lowerCaseUrl))
+    return true;
+  DocumentDomain documentDomain(*this, documentHost);
+
+  for (const auto* filter : keywordlessFilters)
+  {
+    if (MayMatch(*filter, url, lowerCaseUrl, contentTypeMask, documentDomain, siteKey))
+      return true;
+  }
+
+  std::vector<uint64_t> keywordChars;
+  AsciiScanner::FindKeywordCharacters(lowerCaseUrl, &keywordChars);
+  size_t end = 0;
+  for (;;)
+  {
+    size_t i = AsciiScanner::NextKeywordRun(keywordChars, lowerCaseUrl.size(), &end);
+    if (i == lowerCaseUrl.size())
+      break;
+    if (end - i >= 2 &&
+        MayContainKeyword(HashKeyword(lowerCaseUrl.data() + i, lowerCaseUrl.data() + end)))
+    {
+      auto it = filtersByKeyword.find(lowerCaseUrl.substr(i, end - i));
+      if (it != filtersByKeyword.end())
+      {
+        for (const auto* filter : it->second)
+        {
+          if (MayMatch(*filter, url, lowerCaseUrl, contentTypeMask, documentDomain, siteKey))
+            return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+// static
+bool NativeMatcher::MatchesLocation(const CompiledFilter& filter,
+                                    const std::string& url,
+                                    const std::string& lowerCaseUrl)
+{
+  if (filter.matchesAnyLocation)
+    return true;
+
+  const std::string& location = filter.matchCase ? url : lowerCaseUrl;
+  if (filter.regexp)
+  {
+    if (location.size() > MAX_REGEXP_URL_LENGTH)
+      return true;
+    return std::regex_search(location, *filter.regexp);
+  }
+
+  switch (filter.startAnchor)
+  {
+  case CompiledFilter::Anchor::NONE:
+    return filter.MatchesSegments(location, 0, false);
+  case CompiledFilter::Anchor::START:
+    return filter.MatchesSegments(location, 0, true);
+  case CompiledFilter::Anchor::HOST:
+    // The pattern has to start at the beginning of a host name label, i.e.
+    // after the slashes following the scheme or after a dot. Any position
+    // after a slash or a dot is accepted, so this is less strict than
+    // JavaScript.
+    for (size_t pos = 1; pos <= location.size(); ++pos)
+    {
+      char previous = location[pos - 1];
+      if ((previous == '/' || previous == '.') && filter.MatchesSegments(location, pos, true))
+        return true;
+    }
+    return false;
+  default:
+    assert(false && "Missing case");
+    return {};
+  }
+}
+
+// static
+bool NativeMatcher::MayMatch(const CompiledFilter& filter,
+                             const std::string& url,
+                             const std::string& lowerCaseUrl,
+                             uint32_t contentTypeMask,
+                             DocumentDomain& documentDomain,
+                             const std::string& siteKey)
+{
+  if ((filter.contentType & contentTypeMask) == 0)
+    return false;
+  if (filter.hasSitekeys && siteKey.empty())
+    return false;
+  if (!documentDomain.IsActive(filter))
+    return false;
+  return MatchesLocation(filter, url, lowerCaseUrl);
+}
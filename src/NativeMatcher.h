@@ -0,0 +1,139 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "DomainTrie.h"
+
+namespace AdblockPlus
+{
+  /**
+   * Native index of the active URL filters (blocking and allowing), used to
+   * find out without calling into JavaScript that no filter matches a
+   * request. Filters are indexed by a keyword taken from their pattern, so
+   * only a few of them have to be checked per request.
+   * The checks are conservative: whenever the outcome can't be determined
+   * natively (e.g. `$third-party` or `specificOnly` are not evaluated, the
+   * URL contains non-ASCII characters) a filter is treated as a possible
+   * match and the request has to be matched by the JavaScript matcher, which
+   * remains the reference implementation.
+   * A counting Bloom filter of the keywords rejects most tokens of a URL
+   * before the keyword index is looked up. Filters can be added and removed
+   * on a copy of the index, so that changes don't require rebuilding it.
+   */
+  class NativeMatcher
+  {
+  public:
+    /**
+     * Properties of a URL filter, as parsed by `URLFilter` from
+     * filterClasses.js.
+     */
+    struct UrlFilter
+    {
+      // Filter text, identifies the filter.
+      std::string text;
+      // Filter pattern without options, lower case unless `matchCase`. If
+      // `isRegExp` is true then it is the source of the regular expression.
+      std::string pattern;
+      bool isRegExp = false;
+      // False if the pattern is unknown, then only the options are checked.
+      bool hasPattern = true;
+      uint32_t contentType = 0;
+      bool matchCase = false;
+      bool hasSitekeys = false;
+      // Domain name and whether the filter is active on it, the empty domain
+      // name holds the default. Empty if the filter is active everywhere.
+      std::vector<std::pair<std::string, bool>> domains;
+    };
+
+    NativeMatcher();
+    NativeMatcher(const NativeMatcher& other);
+    ~NativeMatcher();
+
+    /**
+     * Adds a filter to the index, does nothing if a filter with the same text
+     * is in the index already.
+     */
+    void Add(const UrlFilter& filter);
+
+    /**
+     * Removes a filter from the index.
+     * @param text Text of the filter, nothing happens if there is no such
+     *        filter in the index.
+     */
+    void Remove(const std::string& text);
+
+    /**
+     * Checks whether any filter can match the request.
+     * @param url Request URL.
+     * @param contentTypeMask Content type mask of the request.
+     * @param documentHost Host of the document making the request.
+     * @param siteKey Public key provided by the document.
+     * @return `false` if no filter matches the request, `true` if the request
+     *         has to be matched by the JavaScript matcher.
+     */
+    bool MayMatch(const std::string& url,
+                  uint32_t contentTypeMask,
+                  const std::string& documentHost,
+                  const std::string& siteKey) const;
+
+    size_t GetFilterCount() const
+    {
+      return filters.size();
+    }
+
+  private:
+    struct CompiledFilter;
+    class DocumentDomain;
+
+    static uint64_t HashKeyword(const char* begin, const char* end);
+    void CountKeyword(const std::string& keyword, int delta);
+    bool MayContainKeyword(uint64_t hash) const;
+    static std::string FindKeywordCandidate(const std::string& pattern, size_t* position);
+    std::string FindKeyword(const std::string& pattern) const;
+    static bool MatchesLocation(const CompiledFilter& filter,
+                                const std::string& url,
+                                const std::string& lowerCaseUrl);
+    static bool MayMatch(const CompiledFilter& filter,
+                         const std::string& url,
+                         const std::string& lowerCaseUrl,
+                         uint32_t contentTypeMask,
+                         DocumentDomain& documentDomain,
+                         const std::string& siteKey);
+
+    // Compiled filters are immutable and shared with copies of the index.
+    std::unordered_map<std::string, std::shared_ptr<const CompiledFilter>> filters;
+    std::unordered_map<std::string, std::vector<const CompiledFilter*>> filtersByKeyword;
+    // Filters without a keyword, they have to be checked for every request.
+    std::vector<const CompiledFilter*> keywordlessFilters;
+    // Filters restricted to or excluded from a domain, and whether the domain
+    // is included.
+    DomainTrie<std::vector<std::pair<const CompiledFilter*, bool>>> filtersByDomain;
+    // Number of keywords in `filtersByKeyword` per Bloom filter slot, every
+    // keyword is counted in two slots. Saturated counters stay at their
+    // maximum.
+    std::vector<uint8_t> keywordCounters;
+  };
+}
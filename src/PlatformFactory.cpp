@@ -24,6 +24,7 @@
 #include "DefaultResourceReader.h"
 #include "DefaultTimer.h"
 #include "DefaultWebRequest.h"
+#include "ThreadPoolExecutor.h"
 
 using namespace AdblockPlus;
 
@@ -56,3 +57,9 @@ std::unique_ptr<IExecutor> PlatformFactory::CreateExecutor()
 {
   return std::unique_ptr<IExecutor>(new OptionalAsyncExecutor());
 }
+
+std::unique_ptr<IExecutor> PlatformFactory::CreateExecutor(size_t threadCount,
+                                                           size_t queueCapacity)
+{
+  return std::unique_ptr<IExecutor>(new ThreadPoolExecutor(threadCount, queueCapacity));
+}
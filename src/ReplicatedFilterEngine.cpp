@@ -0,0 +1,549 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ReplicatedFilterEngine.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "DefaultTimer.h"
+#include "JsEngine.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // Replicas copy the filters from the primary engine, they neither read
+  // nor store anything.
+  class ReplicaFileSystem : public IFileSystem
+  {
+  public:
+    void Read(const std::string& fileName,
+              const ReadCallback& doneCallback,
+              const Callback& errorCallback) const override
+    {
+      errorCallback("File not found: " + fileName);
+    }
+
+    void Write(const std::string& fileName, const IOBuffer& data, const Callback& callback) override
+    {
+      callback("");
+    }
+
+    void Move(const std::string& fromFileName,
+              const std::string& toFileName,
+              const Callback& callback) override
+    {
+      callback("");
+    }
+
+    void Remove(const std::string& fileName, const Callback& callback) override
+    {
+      callback("");
+    }
+
+    void Stat(const std::string& fileName, const StatCallback& callback) const override
+    {
+      callback(StatResult(), "");
+    }
+  };
+
+  // Replicas never download anything, so there are no requests to answer.
+  class ReplicaWebRequest : public IWebRequest
+  {
+  public:
+    void GET(const std::string& url,
+             const HeaderList& requestHeaders,
+             const RequestCallback& callback) override
+    {
+    }
+
+    void HEAD(const std::string& url,
+              const HeaderList& requestHeaders,
+              const RequestCallback& callback) override
+    {
+    }
+  };
+}
+
+struct ReplicatedFilterEngine::Replica
+{
+  FileSystemPtr fileSystem;
+  WebRequestPtr webRequest;
+  std::unique_ptr<JsEngine> jsEngine;
+  // Destroyed before jsEngine, so that no timer fires on a destroyed engine.
+  TimerPtr timer;
+  std::unique_ptr<DefaultFilterEngine> filterEngine;
+  std::atomic<int> activeCalls{0};
+  // Serializes the changes of the replica's filters.
+  std::mutex synchronizationMutex;
+  // Filters generation of the primary engine at the last change the replica
+  // has applied and at the filters it has copied last, only accessed with
+  // synchronizationMutex locked.
+  uint64_t generation = 0;
+  uint64_t synchronizedGeneration = 0;
+  bool synchronized = false;
+};
+
+ReplicatedFilterEngine::ReplicaLease::ReplicaLease(Replica* replica) : replica(replica)
+{
+  ++replica->activeCalls;
+}
+
+ReplicatedFilterEngine::ReplicaLease::ReplicaLease(ReplicaLease&& other) : replica(other.replica)
+{
+  other.replica = nullptr;
+}
+
+ReplicatedFilterEngine::ReplicaLease::~ReplicaLease()
+{
+  if (replica)
+    --replica->activeCalls;
+}
+
+DefaultFilterEngine* ReplicatedFilterEngine::ReplicaLease::operator->() const
+{
+  return replica->filterEngine.get();
+}
+
+// static
+void ReplicatedFilterEngine::CreateAsync(std::unique_ptr<IFilterEngine> primary,
+                                         const FilterEngineFactory::CreationParameters& parameters,
+                                         const AppInfo& appInfo,
+                                         const SharedModules& modules,
+                                         const EvaluateCallback& evaluateCallback,
+                                         const FilterEngineFactory::OnCreatedCallback& onCreated)
+{
+  // FilterEngineFactory always creates a DefaultFilterEngine.
+  auto wrappedFilterEngine = std::make_shared<std::unique_ptr<ReplicatedFilterEngine>>(
+      new ReplicatedFilterEngine(std::unique_ptr<DefaultFilterEngine>(
+          static_cast<DefaultFilterEngine*>(primary.release()))));
+  auto& replicas = (*wrappedFilterEngine)->replicas;
+  for (size_t i = 0; i < parameters.replicaCount; ++i)
+  {
+    auto replica = std::make_unique<Replica>();
+    replica->fileSystem.reset(new ReplicaFileSystem());
+    replica->webRequest.reset(new ReplicaWebRequest());
+    replica->timer.reset(new DefaultTimer());
+    replica->jsEngine = JsEngine::New(appInfo,
+                                      {*replica->timer,
+                                       *replica->fileSystem,
+                                       *replica->webRequest,
+                                       modules.logSystem,
+                                       modules.resourceReader});
+    replicas.push_back(std::move(replica));
+  }
+
+  FilterEngineFactory::CreationParameters replicaParameters;
+  replicaParameters.preconfiguredPrefs.booleanPrefs
+      [FilterEngineFactory::BooleanPrefName::SynchronizationEnabled] = false;
+  replicaParameters.preconfiguredPrefs.booleanPrefs
+      [FilterEngineFactory::BooleanPrefName::FirstRunSubscriptionAutoselect] = false;
+  replicaParameters.matchCacheSize = parameters.matchCacheSize;
+  replicaParameters.nativeMatcherEnabled = parameters.nativeMatcherEnabled;
+
+  auto pendingReplicas = std::make_shared<std::atomic<size_t>>(replicas.size());
+  for (const auto& replica : replicas)
+  {
+    auto* bareReplica = replica.get();
+    FilterEngineFactory::CreateAsync(
+        *bareReplica->jsEngine,
+        [bareReplica, evaluateCallback](const std::string& fileName) {
+          evaluateCallback(*bareReplica->jsEngine, fileName);
+        },
+        [bareReplica, pendingReplicas, wrappedFilterEngine, onCreated](
+            std::unique_ptr<IFilterEngine> filterEngine) {
+          bareReplica->filterEngine.reset(
+              static_cast<DefaultFilterEngine*>(filterEngine.release()));
+          if (--*pendingReplicas != 0)
+            return;
+          // Called with the replica's JavaScript engine locked, so the
+          // filters are copied in the background. Changes made meanwhile
+          // are either forwarded or copied afterwards.
+          auto& engine = **wrappedFilterEngine;
+          engine.primary->AddEventObserver(&engine.primaryObserver);
+          engine.synchronizer.Post([wrappedFilterEngine, onCreated]() {
+            (*wrappedFilterEngine)->SynchronizeReplicas();
+            onCreated(std::move(*wrappedFilterEngine));
+          });
+        },
+        replicaParameters);
+  }
+}
+
+ReplicatedFilterEngine::ReplicatedFilterEngine(std::unique_ptr<DefaultFilterEngine> primary)
+    : primary(std::move(primary))
+{
+}
+
+ReplicatedFilterEngine::~ReplicatedFilterEngine()
+{
+  primary->RemoveEventObserver(&primaryObserver);
+  // Waits for requests being matched by the replicas.
+  asyncMatcher.reset();
+}
+
+ReplicatedFilterEngine::ReplicaLease ReplicatedFilterEngine::AcquireReplica() const
+{
+  // Start at a different replica every time, so that the replicas are used
+  // evenly while they are idle.
+  size_t start = nextReplica++;
+  Replica* replica = nullptr;
+  for (size_t i = 0; i < replicas.size(); ++i)
+  {
+    auto* candidate = replicas[(start + i) % replicas.size()].get();
+    if (!replica || candidate->activeCalls < replica->activeCalls)
+      replica = candidate;
+    if (replica->activeCalls == 0)
+      break;
+  }
+  return ReplicaLease(replica);
+}
+
+ReplicatedFilterEngine::ReplicaLease
+ReplicatedFilterEngine::AcquireReplica(const FrameContext& frame) const
+{
+  auto index = reinterpret_cast<uintptr_t>(&frame) / sizeof(FrameContext);
+  auto* replica = replicas[index % replicas.size()].get();
+  return ReplicaLease(replica);
+}
+
+void ReplicatedFilterEngine::PrimaryObserver::OnFilterEvent(FilterEvent event,
+                                                            const Filter& filter)
+{
+  switch (event)
+  {
+  case FilterEvent::FILTER_ADDED:
+  case FilterEvent::FILTER_REMOVED:
+    engine.ForwardFilterChange(event, filter);
+    break;
+  case FilterEvent::FILTERS_LOAD:
+  case FilterEvent::FILTER_DISABLED:
+    engine.RequestSynchronization();
+    break;
+  default:
+    break;
+  }
+}
+
+void ReplicatedFilterEngine::PrimaryObserver::OnSubscriptionEvent(
+    SubscriptionEvent event, const Subscription& subscription)
+{
+  switch (event)
+  {
+  case SubscriptionEvent::SUBSCRIPTION_ADDED:
+  case SubscriptionEvent::SUBSCRIPTION_REMOVED:
+  case SubscriptionEvent::SUBSCRIPTION_DISABLED:
+  case SubscriptionEvent::SUBSCRIPTION_UPDATED:
+    engine.RequestSynchronization();
+    break;
+  default:
+    break;
+  }
+}
+
+void ReplicatedFilterEngine::ForwardFilterChange(FilterEvent event, const Filter& filter)
+{
+  // A filter removed from one subscription but still listed in another one
+  // remains active, only copying all filters keeps that apart.
+  if (!filter.IsValid() || (event == FilterEvent::FILTER_REMOVED &&
+                            !primary->GetSubscriptionsFromFilter(filter).empty()))
+  {
+    RequestSynchronization();
+    return;
+  }
+  uint64_t generation = primary->GetFiltersGeneration();
+  std::string text = filter.GetRaw();
+  for (const auto& replica : replicas)
+  {
+    std::lock_guard<std::mutex> lock(replica->synchronizationMutex);
+    auto replicaFilter = replica->filterEngine->GetFilter(text);
+    if (event == FilterEvent::FILTER_ADDED)
+      replica->filterEngine->AddFilter(replicaFilter);
+    else
+      replica->filterEngine->RemoveFilter(replicaFilter);
+    replica->generation = generation;
+  }
+}
+
+void ReplicatedFilterEngine::RequestSynchronization()
+{
+  requiredGeneration = primary->GetFiltersGeneration();
+  synchronizer.Post([this]() {
+    SynchronizeReplicas();
+  });
+}
+
+void ReplicatedFilterEngine::SynchronizeReplicas()
+{
+  // Taken without locking any replica, the primary engine forwards changes
+  // to the replicas while it is locked.
+  std::unique_ptr<DefaultFilterEngine::FilterState> state;
+  for (const auto& replica : replicas)
+  {
+    while (true)
+    {
+      uint64_t required = requiredGeneration;
+      {
+        std::lock_guard<std::mutex> lock(replica->synchronizationMutex);
+        if (replica->synchronized && replica->synchronizedGeneration >= required)
+          break;
+      }
+      if (!state || state->generation < required)
+        state = primary->GetFilterState();
+
+      std::lock_guard<std::mutex> lock(replica->synchronizationMutex);
+      // The replica has applied a change the state doesn't contain yet.
+      if (replica->generation > state->generation)
+      {
+        state.reset();
+        continue;
+      }
+      // Other calls prefer the remaining replicas meanwhile.
+      ReplicaLease lease(replica.get());
+      replica->filterEngine->SetFilterState(*state);
+      replica->generation = state->generation;
+      replica->synchronizedGeneration = state->generation;
+      replica->synchronized = true;
+    }
+  }
+}
+
+Filter ReplicatedFilterEngine::GetFilter(const std::string& text) const
+{
+  return primary->GetFilter(text);
+}
+
+Subscription ReplicatedFilterEngine::GetSubscription(const std::string& url) const
+{
+  return primary->GetSubscription(url);
+}
+
+std::vector<Subscription>
+ReplicatedFilterEngine::GetSubscriptionsFromFilter(const Filter& filter) const
+{
+  return primary->GetSubscriptionsFromFilter(filter);
+}
+
+std::vector<Filter> ReplicatedFilterEngine::GetListedFilters() const
+{
+  return primary->GetListedFilters();
+}
+
+std::vector<Subscription> ReplicatedFilterEngine::GetListedSubscriptions() const
+{
+  return primary->GetListedSubscriptions();
+}
+
+std::vector<Subscription> ReplicatedFilterEngine::FetchAvailableSubscriptions() const
+{
+  return primary->FetchAvailableSubscriptions();
+}
+
+void ReplicatedFilterEngine::SetAAEnabled(bool enabled)
+{
+  primary->SetAAEnabled(enabled);
+}
+
+bool ReplicatedFilterEngine::IsAAEnabled() const
+{
+  return primary->IsAAEnabled();
+}
+
+std::string ReplicatedFilterEngine::GetAAUrl() const
+{
+  return primary->GetAAUrl();
+}
+
+Filter ReplicatedFilterEngine::Matches(const std::string& url,
+                                       ContentTypeMask contentTypeMask,
+                                       const std::string& documentUrl,
+                                       const std::string& siteKey,
+                                       bool specificOnly) const
+{
+  return AcquireReplica()->Matches(url, contentTypeMask, documentUrl, siteKey, specificOnly);
+}
+
+Filter ReplicatedFilterEngine::Matches(const std::string& url,
+                                       ContentTypeMask contentTypeMask,
+                                       const FrameContext& frame) const
+{
+  return AcquireReplica(frame)->Matches(url, contentTypeMask, frame);
+}
+
+std::vector<IFilterEngine::MatchResult>
+ReplicatedFilterEngine::MatchesBatch(const std::vector<MatchRequest>& requests) const
+{
+  return AcquireReplica()->MatchesBatch(requests);
+}
+
+void ReplicatedFilterEngine::MatchesAsync(const MatchRequest& request,
+                                          const MatchCallback& callback,
+                                          std::chrono::milliseconds timeout,
+                                          const MatchResult& fallback) const
+{
+  std::unique_lock<std::mutex> lock(asyncMatcherMutex);
+  if (!asyncMatcher)
+    asyncMatcher = std::make_unique<AsyncMatcher>(*this);
+  lock.unlock();
+  asyncMatcher->Match(request, callback, timeout, fallback);
+}
+
+IFilterEngine::MatchCacheStats ReplicatedFilterEngine::GetMatchCacheStats() const
+{
+  // The replicas answer the matching calls, so their caches are the ones
+  // being used.
+  MatchCacheStats stats = primary->GetMatchCacheStats();
+  for (const auto& replica : replicas)
+  {
+    auto replicaStats = replica->filterEngine->GetMatchCacheStats();
+    stats.hits += replicaStats.hits;
+    stats.misses += replicaStats.misses;
+    stats.size += replicaStats.size;
+    stats.capacity += replicaStats.capacity;
+  }
+  return stats;
+}
+
+bool ReplicatedFilterEngine::IsContentAllowlisted(const std::string& url,
+                                                  ContentTypeMask contentTypeMask,
+                                                  const std::vector<std::string>& documentUrls,
+                                                  const std::string& sitekey) const
+{
+  return AcquireReplica()->IsContentAllowlisted(url, contentTypeMask, documentUrls, sitekey);
+}
+
+bool ReplicatedFilterEngine::IsContentAllowlisted(ContentTypeMask contentTypeMask,
+                                                  const FrameContext& frame) const
+{
+  return AcquireReplica(frame)->IsContentAllowlisted(contentTypeMask, frame);
+}
+
+IFilterEngine::BlockingDecision
+ReplicatedFilterEngine::ShouldBlockRequest(const std::string& url,
+                                           ContentTypeMask contentTypeMask,
+                                           const std::vector<std::string>& documentUrls,
+                                           const std::string& siteKey) const
+{
+  return AcquireReplica()->ShouldBlockRequest(url, contentTypeMask, documentUrls, siteKey);
+}
+
+IFilterEngine::BlockingDecision ReplicatedFilterEngine::ShouldBlockRequest(
+    const std::string& url, ContentTypeMask contentTypeMask, const FrameContext& frame) const
+{
+  return AcquireReplica(frame)->ShouldBlockRequest(url, contentTypeMask, frame);
+}
+
+std::string ReplicatedFilterEngine::GetElementHidingStyleSheet(const std::string& domain,
+                                                               bool specificOnly) const
+{
+  return AcquireReplica()->GetElementHidingStyleSheet(domain, specificOnly);
+}
+
+std::string ReplicatedFilterEngine::GetElementHidingStyleSheet(const FrameContext& frame) const
+{
+  return AcquireReplica(frame)->GetElementHidingStyleSheet(frame);
+}
+
+std::vector<IFilterEngine::EmulationSelector>
+ReplicatedFilterEngine::GetElementHidingEmulationSelectors(const std::string& domain) const
+{
+  return AcquireReplica()->GetElementHidingEmulationSelectors(domain);
+}
+
+std::vector<IFilterEngine::EmulationSelector>
+ReplicatedFilterEngine::GetElementHidingEmulationSelectors(const FrameContext& frame) const
+{
+  return AcquireReplica(frame)->GetElementHidingEmulationSelectors(frame);
+}
+
+void ReplicatedFilterEngine::AddEventObserver(EventObserver* observer)
+{
+  primary->AddEventObserver(observer);
+}
+
+void ReplicatedFilterEngine::RemoveEventObserver(EventObserver* observer)
+{
+  primary->RemoveEventObserver(observer);
+}
+
+void ReplicatedFilterEngine::SetAllowedConnectionType(const std::string* value)
+{
+  primary->SetAllowedConnectionType(value);
+}
+
+std::unique_ptr<std::string> ReplicatedFilterEngine::GetAllowedConnectionType() const
+{
+  return primary->GetAllowedConnectionType();
+}
+
+bool ReplicatedFilterEngine::VerifySignature(const std::string& key,
+                                             const std::string& signature,
+                                             const std::string& uri,
+                                             const std::string& host,
+                                             const std::string& userAgent) const
+{
+  return primary->VerifySignature(key, signature, uri, host, userAgent);
+}
+
+std::vector<std::string>
+ReplicatedFilterEngine::ComposeFilterSuggestions(const IElement* element) const
+{
+  return primary->ComposeFilterSuggestions(element);
+}
+
+void ReplicatedFilterEngine::AddSubscription(const Subscription& subscription)
+{
+  primary->AddSubscription(subscription);
+}
+
+void ReplicatedFilterEngine::RemoveSubscription(const Subscription& subscription)
+{
+  primary->RemoveSubscription(subscription);
+}
+
+// Filters returned by the matching calls belong to the JavaScript engine of a
+// replica, so they are looked up in the primary engine by their text.
+void ReplicatedFilterEngine::AddFilter(const Filter& filter)
+{
+  if (filter.IsValid())
+    primary->AddFilter(primary->GetFilter(filter.GetRaw()));
+}
+
+void ReplicatedFilterEngine::RemoveFilter(const Filter& filter)
+{
+  if (filter.IsValid())
+    primary->RemoveFilter(primary->GetFilter(filter.GetRaw()));
+}
+
+void ReplicatedFilterEngine::StartSynchronization()
+{
+  primary->StartSynchronization();
+}
+
+void ReplicatedFilterEngine::StopSynchronization()
+{
+  primary->StopSynchronization();
+}
+
+std::string ReplicatedFilterEngine::GetSnippetScript(const std::string& documentUrl,
+                                                     const std::string& isolatedSource,
+                                                     const std::string& injectedSource,
+                                                     const std::vector<std::string>& injectedList)
+{
+  return primary->GetSnippetScript(documentUrl, isolatedSource, injectedSource, injectedList);
+}
@@ -0,0 +1,243 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <AdblockPlus/AppInfo.h>
+#include <AdblockPlus/FilterEngineFactory.h>
+#include <AdblockPlus/IFileSystem.h>
+#include <AdblockPlus/IFilterEngine.h>
+#include <AdblockPlus/IResourceReader.h>
+#include <AdblockPlus/ITimer.h>
+#include <AdblockPlus/IWebRequest.h>
+#include <AdblockPlus/LogSystem.h>
+
+#include "ActiveObject.h"
+#include "AsyncMatcher.h"
+#include "DefaultFilterEngine.h"
+
+namespace AdblockPlus
+{
+  class JsEngine;
+
+  /**
+   * Filter engine which answers the matching calls with one of several
+   * replicas, each running in its own JavaScript engine, so that they don't
+   * serialize on a single isolate. All other calls, including every change
+   * of filters, subscriptions and preferences, go to the primary filter
+   * engine. Filters added to or removed from the primary engine are added to
+   * or removed from the replicas right away, after any other change the
+   * replicas copy the filters of the primary engine in a background thread
+   * and keep answering with the previous filters until then.
+   */
+  class ReplicatedFilterEngine : public IFilterEngine
+  {
+  public:
+    /**
+     * Evaluates one of the library's JavaScript files in a JavaScript engine.
+     */
+    typedef std::function<void(JsEngine&, const std::string&)> EvaluateCallback;
+
+    /**
+     * Modules of the platform shared with the replicas.
+     */
+    struct SharedModules
+    {
+      LogSystem& logSystem;
+      IResourceReader& resourceReader;
+    };
+
+    /**
+     * Creates the replicas of a filter engine.
+     * @param primary Filter engine created by `FilterEngineFactory`.
+     * @param parameters Parameters the primary engine has been created with.
+     * @param appInfo Information about the app.
+     * @param modules Modules shared with the replicas.
+     * @param evaluateCallback Callback evaluating the library's JavaScript
+     *        files.
+     * @param onCreated Callback receiving the replicated filter engine once
+     *        all replicas have been created.
+     */
+    static void CreateAsync(std::unique_ptr<IFilterEngine> primary,
+                            const FilterEngineFactory::CreationParameters& parameters,
+                            const AppInfo& appInfo,
+                            const SharedModules& modules,
+                            const EvaluateCallback& evaluateCallback,
+                            const FilterEngineFactory::OnCreatedCallback& onCreated);
+
+    ~ReplicatedFilterEngine();
+
+    Filter GetFilter(const std::string& text) const final;
+
+    Subscription GetSubscription(const std::string& url) const final;
+    std::vector<Subscription> GetSubscriptionsFromFilter(const Filter& filter) const final;
+
+    std::vector<Filter> GetListedFilters() const final;
+
+    std::vector<Subscription> GetListedSubscriptions() const final;
+
+    std::vector<Subscription> FetchAvailableSubscriptions() const final;
+
+    void SetAAEnabled(bool enabled) final;
+
+    bool IsAAEnabled() const final;
+
+    std::string GetAAUrl() const final;
+
+    Filter Matches(const std::string& url,
+                   ContentTypeMask contentTypeMask,
+                   const std::string& documentUrl,
+                   const std::string& siteKey = "",
+                   bool specificOnly = false) const final;
+
+    Filter Matches(const std::string& url,
+                   ContentTypeMask contentTypeMask,
+                   const FrameContext& frame) const final;
+
+    std::vector<MatchResult> MatchesBatch(const std::vector<MatchRequest>& requests) const final;
+
+    void MatchesAsync(const MatchRequest& request,
+                      const MatchCallback& callback,
+                      std::chrono::milliseconds timeout = std::chrono::milliseconds::max(),
+                      const MatchResult& fallback = {"", Filter::Type::TYPE_INVALID}) const final;
+
+    MatchCacheStats GetMatchCacheStats() const final;
+
+    bool IsContentAllowlisted(const std::string& url,
+                              ContentTypeMask contentTypeMask,
+                              const std::vector<std::string>& documentUrls,
+                              const std::string& sitekey = "") const final;
+
+    bool IsContentAllowlisted(ContentTypeMask contentTypeMask,
+                              const FrameContext& frame) const final;
+
+    BlockingDecision ShouldBlockRequest(const std::string& url,
+                                        ContentTypeMask contentTypeMask,
+                                        const std::vector<std::string>& documentUrls,
+                                        const std::string& siteKey = "") const final;
+
+    BlockingDecision ShouldBlockRequest(const std::string& url,
+                                        ContentTypeMask contentTypeMask,
+                                        const FrameContext& frame) const final;
+
+    std::string GetElementHidingStyleSheet(const std::string& domain,
+                                           bool specificOnly = false) const final;
+
+    std::string GetElementHidingStyleSheet(const FrameContext& frame) const final;
+
+    std::vector<EmulationSelector>
+    GetElementHidingEmulationSelectors(const std::string& domain) const final;
+
+    std::vector<EmulationSelector>
+    GetElementHidingEmulationSelectors(const FrameContext& frame) const final;
+
+    void AddEventObserver(EventObserver* observer) final;
+    void RemoveEventObserver(EventObserver* observer) final;
+
+    void SetAllowedConnectionType(const std::string* value) final;
+
+    std::unique_ptr<std::string> GetAllowedConnectionType() const final;
+
+    bool VerifySignature(const std::string& key,
+                         const std::string& signature,
+                         const std::string& uri,
+                         const std::string& host,
+                         const std::string& userAgent) const final;
+
+    std::vector<std::string> ComposeFilterSuggestions(const IElement* element) const final;
+
+    void AddSubscription(const Subscription& subscripton) final;
+    void RemoveSubscription(const Subscription& subscription) final;
+    void AddFilter(const Filter& filter) final;
+    void RemoveFilter(const Filter& filter) final;
+    void StartSynchronization() final;
+    void StopSynchronization() final;
+    std::string GetSnippetScript(const std::string& documentUrl,
+                                 const std::string& isolatedSource,
+                                 const std::string& injectedSource,
+                                 const std::vector<std::string>& injectedList) final;
+
+  private:
+    struct Replica;
+
+    // Applies the changes of the primary engine's filters to the replicas.
+    class PrimaryObserver : public EventObserver
+    {
+    public:
+      explicit PrimaryObserver(ReplicatedFilterEngine& engine) : engine(engine)
+      {
+      }
+
+      void OnFilterEvent(FilterEvent event, const Filter& filter) override;
+      void OnSubscriptionEvent(SubscriptionEvent event, const Subscription& subscription) override;
+
+    private:
+      ReplicatedFilterEngine& engine;
+    };
+
+    // Marks a replica as used for as long as it exists.
+    class ReplicaLease
+    {
+    public:
+      explicit ReplicaLease(Replica* replica);
+      ReplicaLease(ReplicaLease&& other);
+      ~ReplicaLease();
+      ReplicaLease(const ReplicaLease&) = delete;
+      ReplicaLease& operator=(const ReplicaLease&) = delete;
+
+      DefaultFilterEngine* operator->() const;
+
+    private:
+      Replica* replica;
+    };
+
+    explicit ReplicatedFilterEngine(std::unique_ptr<DefaultFilterEngine> primary);
+
+    // Returns the least used replica.
+    ReplicaLease AcquireReplica() const;
+    // Returns the replica which handles |frame|, a FrameContext remembers
+    // results of one filter engine only.
+    ReplicaLease AcquireReplica(const FrameContext& frame) const;
+    // Called by the primary engine's event, so with its JavaScript engine
+    // locked.
+    void ForwardFilterChange(FilterEvent event, const Filter& filter);
+    void RequestSynchronization();
+    // Copies the filters of the primary engine to all replicas which haven't
+    // copied them since the last change requiring it.
+    void SynchronizeReplicas();
+
+    std::unique_ptr<DefaultFilterEngine> primary;
+    std::vector<std::unique_ptr<Replica>> replicas;
+    mutable std::atomic<size_t> nextReplica{0};
+    // Filters generation of the primary engine at the last change which
+    // can't be forwarded to the replicas.
+    std::atomic<uint64_t> requiredGeneration{0};
+    PrimaryObserver primaryObserver{*this};
+    mutable std::mutex asyncMatcherMutex;
+    // Created on first use of MatchesAsync.
+    mutable std::unique_ptr<AsyncMatcher> asyncMatcher;
+    // Destroyed first, it waits for the synchronization in progress.
+    ActiveObject synchronizer;
+  };
+}
@@ -54,13 +54,16 @@ namespace ReadPreloadedFilterListCallback
         JsEngine::ScopedWeakValues weakCallbackValue(jsEngine, {converted[1]});
         jsEngine->GetResourceReader().ReadPreloadedFilterList(
             url, [jsEngine, weakCallbackValue](std::unique_ptr<IPreloadedFilterResponse> response) {
-              bool exists = response->exists();
-              const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
-              auto result = jsEngine->NewObject();
-              result.SetProperty("exists", exists);
-              if (exists)
-                result.SetProperty("content", response->content(), response->size());
-              weakCallbackValue.Values()[0].Call(result);
+              std::shared_ptr<IPreloadedFilterResponse> sharedResponse(std::move(response));
+              jsEngine->Post(JsEventLoop::Priority::BACKGROUND, [=] {
+                bool exists = sharedResponse->exists();
+                const JsContext context(jsEngine->GetIsolate(), *jsEngine->GetContext());
+                auto result = jsEngine->NewObject();
+                result.SetProperty("exists", exists);
+                if (exists)
+                  result.SetProperty("content", sharedResponse->content(), sharedResponse->size());
+                weakCallbackValue.Values()[0].Call(result);
+              });
             });
       }
       catch (const std::exception& e)
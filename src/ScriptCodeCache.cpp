@@ -0,0 +1,213 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ScriptCodeCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <sstream>
+
+#include "Utils.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // FNV-1a, unlike std::hash it's the same for every build and run.
+  uint64_t Hash(const uint8_t* data, size_t size)
+  {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= data[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  std::string ToHex(uint64_t value)
+  {
+    std::ostringstream result;
+    result << std::hex << value;
+    return result.str();
+  }
+
+  std::string GetKey(const std::string& source)
+  {
+    std::ostringstream key;
+    key << v8::V8::GetVersion() << ' ' << v8::ScriptCompiler::CachedDataVersionTag() << ' '
+        << ToHex(Hash(reinterpret_cast<const uint8_t*>(source.data()), source.size()));
+    return key.str();
+  }
+
+  // An entry consists of the key and a hash of the data on the first line,
+  // followed by the data. Release builds of V8 don't verify the checksum of
+  // the data, so a damaged entry has to be detected here.
+  size_t FindData(const IFileSystem::IOBuffer& entry, const std::string& key)
+  {
+    const size_t offset = key.size() + 1;
+    if (entry.size() <= offset || std::memcmp(entry.data(), key.data(), key.size()) != 0 ||
+        entry[key.size()] != ' ')
+      return 0;
+    auto end = std::find(entry.begin() + offset, entry.end(), '\n');
+    if (end == entry.end())
+      return 0;
+    const size_t dataOffset = end - entry.begin() + 1;
+    const std::string hash(entry.begin() + offset, end);
+    if (hash != ToHex(Hash(entry.data() + dataOffset, entry.size() - dataOffset)))
+      return 0;
+    return dataOffset;
+  }
+}
+
+ScriptCodeCache::ScriptCodeCache(IFileSystem& fileSystem)
+    : fileSystem(fileSystem), entries(std::make_shared<Entries>())
+{
+}
+
+void ScriptCodeCache::Load(const std::vector<std::string>& fileNames,
+                           const std::function<void()>& done)
+{
+  if (fileNames.empty())
+  {
+    done();
+    return;
+  }
+
+  auto remaining = std::make_shared<std::atomic<size_t>>(fileNames.size());
+  auto entries = this->entries;
+  auto readDone = [remaining, done]() {
+    if (--*remaining == 0)
+      done();
+  };
+  for (const auto& fileName : fileNames)
+  {
+    fileSystem.Read(
+        GetCacheFileName(fileName),
+        [entries, fileName, readDone](IFileSystem::IOBuffer&& data) {
+          {
+            std::lock_guard<std::mutex> lock(entries->mutex);
+            entries->data[fileName] = std::move(data);
+          }
+          readDone();
+        },
+        [readDone](const std::string&) { readDone(); });
+  }
+}
+
+v8::MaybeLocal<v8::Script> ScriptCodeCache::Compile(v8::Isolate* isolate,
+                                                    const std::string& source,
+                                                    const std::string& fileName)
+{
+  auto v8Source = Utils::ToV8String(isolate, source);
+  auto v8FileName = Utils::ToV8String(isolate, fileName);
+  if (v8Source.IsEmpty() || v8FileName.IsEmpty())
+    return v8::MaybeLocal<v8::Script>();
+  v8::ScriptOrigin origin(v8FileName.ToLocalChecked());
+
+  const std::string key = GetKey(source);
+  IFileSystem::IOBuffer entry;
+  {
+    std::lock_guard<std::mutex> lock(entries->mutex);
+    auto it = entries->data.find(fileName);
+    if (it != entries->data.end())
+    {
+      entry = std::move(it->second);
+      entries->data.erase(it);
+    }
+  }
+  const size_t offset = FindData(entry, key);
+  const bool useEntry = offset > 0;
+
+  auto context = isolate->GetCurrentContext();
+  const auto start = std::chrono::steady_clock::now();
+  v8::MaybeLocal<v8::Script> result;
+  bool rejected = false;
+  if (useEntry)
+  {
+    // Source takes the ownership of the cached data, but not of the buffer.
+    v8::ScriptCompiler::Source compilerSource(
+        v8Source.ToLocalChecked(),
+        origin,
+        new v8::ScriptCompiler::CachedData(entry.data() + offset,
+                                           static_cast<int>(entry.size() - offset)));
+    result = v8::ScriptCompiler::Compile(
+        context, &compilerSource, v8::ScriptCompiler::kConsumeCodeCache);
+    rejected = compilerSource.GetCachedData()->rejected;
+  }
+  else
+  {
+    v8::ScriptCompiler::Source compilerSource(v8Source.ToLocalChecked(), origin);
+    result = v8::ScriptCompiler::Compile(context, &compilerSource);
+  }
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (useEntry && !rejected)
+  {
+    ++stats.hits;
+    stats.cachedCompileTime += elapsed;
+  }
+  else
+  {
+    ++stats.misses;
+    if (rejected)
+      ++stats.rejections;
+    stats.uncachedCompileTime += elapsed;
+    outdated[fileName] = key;
+  }
+  return result;
+}
+
+void ScriptCodeCache::Update(const std::string& fileName, const v8::Local<v8::Script>& script)
+{
+  std::string key;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = outdated.find(fileName);
+    if (it == outdated.end())
+      return;
+    key = std::move(it->second);
+    outdated.erase(it);
+  }
+
+  std::unique_ptr<v8::ScriptCompiler::CachedData> cachedData(
+      v8::ScriptCompiler::CreateCodeCache(script->GetUnboundScript()));
+  if (!cachedData || cachedData->length <= 0)
+    return;
+
+  const std::string header =
+      key + ' ' + ToHex(Hash(cachedData->data, cachedData->length)) + '\n';
+  IFileSystem::IOBuffer entry(header.begin(), header.end());
+  entry.insert(entry.end(), cachedData->data, cachedData->data + cachedData->length);
+  // A failed write only means that the script is compiled from source again
+  // on the next run.
+  fileSystem.Write(GetCacheFileName(fileName), entry, [](const std::string&) {});
+}
+
+ScriptCodeCache::Stats ScriptCodeCache::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return stats;
+}
+
+std::string ScriptCodeCache::GetCacheFileName(const std::string& fileName)
+{
+  return fileName + ".v8cache";
+}
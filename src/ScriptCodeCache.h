@@ -0,0 +1,110 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <v8.h>
+#include <vector>
+
+#include <AdblockPlus/IFileSystem.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Persistent cache of the code V8 compiles for scripts, stored as one file
+   * per script through `IFileSystem`. Every entry is keyed by the V8
+   * version, the cache data version tag of V8 (which also covers the flags)
+   * and a hash of the script source, entries not matching any of them or
+   * rejected by V8 are replaced.
+   * Reading is asynchronous, so the entries have to be loaded via `Load()`
+   * before the scripts are compiled.
+   */
+  class ScriptCodeCache
+  {
+  public:
+    struct Stats
+    {
+      Stats() : hits(0), misses(0), rejections(0), cachedCompileTime(0), uncachedCompileTime(0)
+      {
+      }
+
+      /// Scripts compiled from a cache entry.
+      uint64_t hits;
+      /// Scripts compiled without a cache entry, or with a stale one.
+      uint64_t misses;
+      /// Cache entries V8 refused to use, they are counted as misses too.
+      uint64_t rejections;
+      /// Time spent compiling scripts from a cache entry.
+      std::chrono::microseconds cachedCompileTime;
+      /// Time spent compiling scripts without a usable cache entry.
+      std::chrono::microseconds uncachedCompileTime;
+    };
+
+    explicit ScriptCodeCache(IFileSystem& fileSystem);
+
+    /**
+     * Reads the cache entries of the scripts, missing or unreadable ones are
+     * ignored.
+     * @param fileNames File names of the scripts.
+     * @param done Called once all entries are read.
+     */
+    void Load(const std::vector<std::string>& fileNames, const std::function<void()>& done);
+
+    /**
+     * Compiles a script, using its cache entry if there is a valid one.
+     * Has to be called with the isolate locked and a context entered.
+     */
+    v8::MaybeLocal<v8::Script>
+    Compile(v8::Isolate* isolate, const std::string& source, const std::string& fileName);
+
+    /**
+     * Writes a new cache entry for a script if `Compile()` couldn't use the
+     * existing one. Should be called after the script ran, so that the entry
+     * includes the functions compiled lazily while running.
+     */
+    void Update(const std::string& fileName, const v8::Local<v8::Script>& script);
+
+    Stats GetStats() const;
+
+    /**
+     * @return Name of the file the cache entry of a script is stored in.
+     */
+    static std::string GetCacheFileName(const std::string& fileName);
+
+  private:
+    struct Entries
+    {
+      std::mutex mutex;
+      std::map<std::string, IFileSystem::IOBuffer> data;
+    };
+
+    IFileSystem& fileSystem;
+    // Shared with pending reads, which may outlive this instance.
+    std::shared_ptr<Entries> entries;
+    mutable std::mutex mutex;
+    // Keys of the scripts which need a new cache entry.
+    std::map<std::string, std::string> outdated;
+    Stats stats;
+  };
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPoolExecutor.h"
+
+#include <algorithm>
+
+using namespace AdblockPlus;
+
+ThreadPoolExecutor::ThreadPoolExecutor(size_t threadCount, size_t queueCapacity)
+    : queue(std::max<size_t>(queueCapacity, 1)), head(0), size(0), isRunning(true)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  threadCount = std::max<size_t>(threadCount, 1);
+  for (size_t i = 0; i < threadCount; ++i)
+  {
+    threads.emplace_back([this] {
+      ThreadFunc();
+    });
+  }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor()
+{
+  Stop();
+}
+
+void ThreadPoolExecutor::Dispatch(const std::function<void()>& call)
+{
+  if (!call)
+    return;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!isRunning)
+      return;
+    // Waiting for a worker could deadlock if the caller holds a lock the
+    // dispatched tasks need, e.g. the one of the JavaScript engine.
+    if (size == queue.size())
+      GrowQueue();
+    queue[(head + size) % queue.size()] = call;
+    ++size;
+  }
+  notEmpty.notify_one();
+}
+
+void ThreadPoolExecutor::Stop()
+{
+  std::vector<std::thread> workers;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    isRunning = false;
+    workers.swap(threads);
+  }
+  notEmpty.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+void ThreadPoolExecutor::ThreadFunc()
+{
+  for (;;)
+  {
+    std::function<void()> call;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      notEmpty.wait(lock, [this]() -> bool {
+        return size > 0 || !isRunning;
+      });
+      // The queue is drained before the workers finish.
+      if (size == 0)
+        return;
+      call = std::move(queue[head]);
+      queue[head] = nullptr;
+      head = (head + 1) % queue.size();
+      --size;
+    }
+    try
+    {
+      call();
+    }
+    catch (...)
+    {
+      // do nothing, but the thread will be alive.
+    }
+  }
+}
+
+void ThreadPoolExecutor::GrowQueue()
+{
+  std::vector<std::function<void()>> grown(queue.size() * 2);
+  for (size_t i = 0; i < size; ++i)
+    grown[i] = std::move(queue[(head + i) % queue.size()]);
+  queue.swap(grown);
+  head = 0;
+}
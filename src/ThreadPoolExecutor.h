@@ -0,0 +1,81 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <AdblockPlus/IExecutor.h>
+
+namespace AdblockPlus
+{
+  /**
+   * Runs dispatched tasks on a fixed number of worker threads, unlike
+   * `AsyncExecutor` which spawns a thread per task. Tasks wait for a worker
+   * in a queue.
+   */
+  class ThreadPoolExecutor : public IExecutor
+  {
+  public:
+    /**
+     * Constructor, the worker threads are started after finishing this call.
+     * @param threadCount Number of worker threads, at least one is started.
+     * @param queueCapacity Number of tasks which can wait for a worker
+     *        before the queue has to grow, at least one.
+     */
+    ThreadPoolExecutor(size_t threadCount, size_t queueCapacity);
+
+    /**
+     * Destructor, same as `Stop()`.
+     */
+    ~ThreadPoolExecutor();
+
+    /**
+     * Adds `call` to the queue, never blocks. If the queue is full then it
+     * grows.
+     * @param call is a function object which is called within a worker
+     *        thread. There is no effect if `call` is empty or if `Stop` had
+     *        been already called.
+     */
+    void Dispatch(const std::function<void()>& call) override;
+
+    /**
+     * Waits until all already dispatched tasks are finished and stops the
+     * worker threads, any subsequent calls of `Dispatch` have no effect.
+     * Must not be called from a dispatched task.
+     */
+    void Stop() override;
+
+  private:
+    void ThreadFunc();
+    // Doubles the capacity of the full queue, called with `mutex` locked.
+    void GrowQueue();
+
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    // Ring buffer of `size` tasks starting at `head`.
+    std::vector<std::function<void()>> queue;
+    size_t head;
+    size_t size;
+    bool isRunning;
+    std::vector<std::thread> threads;
+  };
+}
@@ -0,0 +1,379 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "UrlParser.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  typedef std::string::size_type Position;
+
+  // Positions as computed by the constructor of `URI` in lib/uri.js. Since all
+  // the delimiters are ASCII characters the positions in a UTF-8 string can be
+  // used the same way as the positions in the UTF-16 string in JavaScript.
+  struct Components
+  {
+    Position schemeEnd;
+    Position hostPortStart;
+    Position hostPortEnd;
+    Position hostStart;
+    Position hostEnd;
+    Position portStart;
+  };
+
+  bool Split(const std::string& spec, Components* components)
+  {
+    Components& c = *components;
+    c.schemeEnd = spec.find(':');
+    if (c.schemeEnd == std::string::npos)
+      return false;
+
+    if (spec.compare(c.schemeEnd + 1, 2, "//") != 0)
+      c.hostPortStart = c.schemeEnd + 1;
+    else
+      c.hostPortStart = c.schemeEnd + 3;
+
+    if (c.hostPortStart == spec.length())
+      return false;
+
+    c.hostPortEnd = spec.find('/', c.hostPortStart);
+    if (c.hostPortEnd == std::string::npos)
+    {
+      c.hostPortEnd = std::min(spec.find('?', c.hostPortStart), spec.find('#', c.hostPortStart));
+      if (c.hostPortEnd == std::string::npos)
+        c.hostPortEnd = spec.length();
+    }
+
+    Position authEnd = spec.find('@', c.hostPortStart);
+    if (authEnd != std::string::npos && authEnd < c.hostPortEnd)
+      c.hostPortStart = authEnd + 1;
+
+    c.portStart = std::string::npos;
+    c.hostEnd = spec.find(']', c.hostPortStart + 1);
+    if (c.hostPortStart < spec.length() && spec[c.hostPortStart] == '[' &&
+        c.hostEnd != std::string::npos && c.hostEnd < c.hostPortEnd)
+    {
+      // The host is an IPv6 literal
+      c.hostStart = c.hostPortStart + 1;
+      if (c.hostEnd + 1 < spec.length() && spec[c.hostEnd + 1] == ':')
+        c.portStart = c.hostEnd + 2;
+    }
+    else
+    {
+      c.hostStart = c.hostPortStart;
+      c.hostEnd = spec.find(':', c.hostStart);
+      if (c.hostEnd != std::string::npos && c.hostEnd < c.hostPortEnd)
+        c.portStart = c.hostEnd + 1;
+      else
+        c.hostEnd = c.hostPortEnd;
+    }
+    return true;
+  }
+
+  bool IsAscii(const std::string& str)
+  {
+    for (char c : str)
+    {
+      if (static_cast<unsigned char>(c) > 0x7F)
+        return false;
+    }
+    return true;
+  }
+
+  bool IsSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+  }
+
+  // Simplified parseInt(str, 10), returns -1 instead of NaN and for numbers
+  // which don't fit into a port.
+  int ParsePort(const std::string& str)
+  {
+    Position pos = 0;
+    while (pos < str.length() && IsSpace(str[pos]))
+      ++pos;
+    int sign = 1;
+    if (pos < str.length() && (str[pos] == '+' || str[pos] == '-'))
+    {
+      if (str[pos] == '-')
+        sign = -1;
+      ++pos;
+    }
+    Position digitsStart = pos;
+    int value = 0;
+    for (; pos < str.length() && str[pos] >= '0' && str[pos] <= '9'; ++pos)
+    {
+      value = value * 10 + (str[pos] - '0');
+      if (value > 0xFFFF)
+        return -1;
+    }
+    return pos == digitsStart ? -1 : sign * value;
+  }
+
+  // Strict UTF-8 decoder, fails for everything which V8 would replace
+  // with U+FFFD.
+  bool DecodeUtf8(const std::string& str, std::vector<uint32_t>* codePoints)
+  {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(str.data());
+    const Position length = str.length();
+    for (Position i = 0; i < length;)
+    {
+      uint32_t lead = bytes[i++];
+      if (lead < 0x80)
+      {
+        codePoints->push_back(lead);
+        continue;
+      }
+
+      int continuationCount;
+      uint32_t min = 0x80;
+      uint32_t max = 0xBF;
+      uint32_t codePoint;
+      if (lead >= 0xC2 && lead <= 0xDF)
+      {
+        continuationCount = 1;
+        codePoint = lead & 0x1F;
+      }
+      else if (lead >= 0xE0 && lead <= 0xEF)
+      {
+        continuationCount = 2;
+        codePoint = lead & 0x0F;
+        if (lead == 0xE0)
+          min = 0xA0;
+        else if (lead == 0xED)
+          max = 0x9F;
+      }
+      else if (lead >= 0xF0 && lead <= 0xF4)
+      {
+        continuationCount = 3;
+        codePoint = lead & 0x07;
+        if (lead == 0xF0)
+          min = 0x90;
+        else if (lead == 0xF4)
+          max = 0x8F;
+      }
+      else
+        return false;
+
+      for (int j = 0; j < continuationCount; ++j, ++i)
+      {
+        if (i >= length || bytes[i] < min || bytes[i] > max)
+          return false;
+        codePoint = (codePoint << 6) | (bytes[i] & 0x3F);
+        min = 0x80;
+        max = 0xBF;
+      }
+      codePoints->push_back(codePoint);
+    }
+    return true;
+  }
+
+  // Bootstring parameters for punycode, see RFC 3492.
+  const int64_t maxInt = 0x7FFFFFFF;
+  const int64_t base = 36;
+  const int64_t tMin = 1;
+  const int64_t tMax = 26;
+  const int64_t skew = 38;
+  const int64_t damp = 700;
+  const int64_t initialBias = 72;
+  const int64_t initialN = 0x80;
+
+  char DigitToBasic(int64_t digit)
+  {
+    return static_cast<char>(digit < 26 ? 'a' + digit : '0' + digit - 26);
+  }
+
+  int64_t Adapt(int64_t delta, int64_t numPoints, bool firstTime)
+  {
+    int64_t k = 0;
+    delta = firstTime ? delta / damp : delta >> 1;
+    delta += delta / numPoints;
+    for (; delta > (base - tMin) * tMax >> 1; k += base)
+      delta = delta / (base - tMin);
+    return k + (base - tMin + 1) * delta / (delta + skew);
+  }
+
+  bool EncodePunycode(const std::vector<uint32_t>& input, std::string* output)
+  {
+    const int64_t inputLength = input.size();
+    int64_t n = initialN;
+    int64_t delta = 0;
+    int64_t bias = initialBias;
+
+    for (uint32_t codePoint : input)
+    {
+      if (codePoint < 0x80)
+        output->push_back(static_cast<char>(codePoint));
+    }
+    const int64_t basicLength = output->length();
+    int64_t handledCount = basicLength;
+    if (basicLength)
+      output->push_back('-');
+
+    while (handledCount < inputLength)
+    {
+      int64_t m = maxInt;
+      for (uint32_t codePoint : input)
+      {
+        if (codePoint >= n && codePoint < m)
+          m = codePoint;
+      }
+
+      const int64_t handledCountPlusOne = handledCount + 1;
+      if (m - n > (maxInt - delta) / handledCountPlusOne)
+        return false;
+      delta += (m - n) * handledCountPlusOne;
+      n = m;
+
+      for (uint32_t codePoint : input)
+      {
+        if (codePoint < n && ++delta > maxInt)
+          return false;
+        if (codePoint == n)
+        {
+          int64_t q = delta;
+          for (int64_t k = base;; k += base)
+          {
+            const int64_t t = k <= bias ? tMin : (k >= bias + tMax ? tMax : k - bias);
+            if (q < t)
+              break;
+            output->push_back(DigitToBasic(t + (q - t) % (base - t)));
+            q = (q - t) / (base - t);
+          }
+          output->push_back(DigitToBasic(q));
+          bias = Adapt(delta, handledCountPlusOne, handledCount == basicLength);
+          delta = 0;
+          ++handledCount;
+        }
+      }
+      ++delta;
+      ++n;
+    }
+    return true;
+  }
+
+  bool IsLabelSeparator(uint32_t codePoint)
+  {
+    // RFC 3490 separators
+    return codePoint == 0x2E || codePoint == 0x3002 || codePoint == 0xFF0E ||
+           codePoint == 0xFF61;
+  }
+}
+
+UrlParser::Result UrlParser::Parse(const std::string& url, ParsedUrl* parsed)
+{
+  Components components;
+  if (!Split(url, &components))
+    return Result::INVALID;
+
+  std::string scheme = url.substr(0, components.schemeEnd);
+  if (!IsAscii(scheme))
+    return Result::UNSUPPORTED;
+  std::transform(scheme.begin(), scheme.end(), scheme.begin(), [](char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+  });
+
+  std::string host =
+      url.substr(components.hostStart, components.hostEnd - components.hostStart);
+  std::string asciiHost;
+  if (!host.empty() && IsAscii(host))
+    asciiHost = host;
+  else
+  {
+    Result result = ToAscii(host, &asciiHost);
+    if (result != Result::VALID)
+      return result;
+  }
+
+  parsed->scheme = std::move(scheme);
+  parsed->host = std::move(host);
+  parsed->asciiHost = std::move(asciiHost);
+  parsed->port = components.portStart == std::string::npos
+                     ? -1
+                     : ParsePort(url.substr(components.portStart,
+                                            components.hostPortEnd - components.portStart));
+  parsed->path = url.substr(components.hostPortEnd);
+  return Result::VALID;
+}
+
+std::string UrlParser::ExtractHost(const std::string& url)
+{
+  Components components;
+  if (url.empty() || !Split(url, &components))
+    return "";
+  return url.substr(components.hostStart, components.hostEnd - components.hostStart);
+}
+
+UrlParser::Result UrlParser::ToAscii(const std::string& domain, std::string* asciiDomain)
+{
+  std::vector<uint32_t> codePoints;
+  if (!DecodeUtf8(domain, &codePoints))
+    return Result::UNSUPPORTED;
+
+  // Like punycode.js keep the part before the first '@' as is and ignore
+  // everything after the second one.
+  std::string result;
+  auto begin = codePoints.begin();
+  auto end = codePoints.end();
+  auto at = std::find(begin, end, '@');
+  if (at != end)
+  {
+    Position userLength = domain.find('@') + 1;
+    result = domain.substr(0, userLength);
+    begin = at + 1;
+    end = std::find(begin, end, '@');
+  }
+
+  std::vector<uint32_t> label;
+  for (auto it = begin;; ++it)
+  {
+    if (it != end && !IsLabelSeparator(*it))
+    {
+      label.push_back(*it);
+      continue;
+    }
+
+    bool isAscii = std::all_of(label.begin(), label.end(), [](uint32_t codePoint) {
+      return codePoint <= 0x7E;
+    });
+    if (isAscii)
+    {
+      for (uint32_t codePoint : label)
+        result.push_back(static_cast<char>(codePoint));
+    }
+    else
+    {
+      std::string encoded;
+      if (!EncodePunycode(label, &encoded))
+        return Result::INVALID;
+      result += "xn--" + encoded;
+    }
+
+    if (it == end)
+      break;
+    result.push_back('.');
+    label.clear();
+  }
+
+  *asciiDomain = std::move(result);
+  return Result::VALID;
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace AdblockPlus
+{
+  /**
+   * Components of a URL, see `UrlParser::Parse()`.
+   */
+  struct ParsedUrl
+  {
+    // Lower case scheme without the trailing colon.
+    std::string scheme;
+    std::string host;
+    // Host with non-ASCII labels converted to punycode.
+    std::string asciiHost;
+    // -1 if there is no port or it is not a number.
+    int port = -1;
+    std::string path;
+  };
+
+  /**
+   * Native counterpart of the `URI` class from lib/uri.js, it produces the
+   * same results for the same input, so that the URLs don't have to be parsed
+   * in JavaScript on the match path.
+   * The input is expected to be UTF-8 encoded.
+   */
+  namespace UrlParser
+  {
+    enum class Result
+    {
+      VALID,
+      // `URI` would throw for this input.
+      INVALID,
+      // The input is not handled natively, e.g. the scheme contains non-ASCII
+      // characters or the host is not valid UTF-8, use `URI` instead.
+      UNSUPPORTED
+    };
+
+    /**
+     * Splits the URL into components.
+     * @param url URL to parse.
+     * @param parsed Receives the components if the result is `VALID`.
+     * @return Whether the URL could be parsed.
+     */
+    Result Parse(const std::string& url, ParsedUrl* parsed);
+
+    /**
+     * Does the same as `extractHostFromURL()` from lib/uri.js.
+     * @param url URL to extract the host from.
+     * @return The host of the URL, an empty string if the URL is invalid.
+     */
+    std::string ExtractHost(const std::string& url);
+
+    /**
+     * Does the same as `punycode.toASCII()` from lib/punycode.js.
+     * @param domain UTF-8 encoded domain name.
+     * @param asciiDomain Receives the converted domain name if the result is
+     *        `VALID`.
+     * @return `INVALID` if the conversion overflows, what makes
+     *         `punycode.toASCII()` throw, `UNSUPPORTED` if the domain is not
+     *         valid UTF-8.
+     */
+    Result ToAscii(const std::string& domain, std::string* asciiDomain);
+  }
+}
@@ -22,10 +22,35 @@
 #include <Windows.h>
 #endif
 
+#include "AsciiScanner.h"
 #include "Utils.h"
 
 using namespace AdblockPlus;
 
+namespace
+{
+  class ExternalFileContent : public v8::String::ExternalOneByteStringResource
+  {
+  public:
+    explicit ExternalFileContent(const IFileSystem::FileContentPtr& content) : content(content)
+    {
+    }
+
+    const char* data() const override
+    {
+      return reinterpret_cast<const char*>(content->data());
+    }
+
+    size_t length() const override
+    {
+      return content->size();
+    }
+
+  private:
+    IFileSystem::FileContentPtr content;
+  };
+}
+
 void Utils::CheckTryCatch(v8::Isolate* isolate, const v8::TryCatch& tryCatch)
 {
   if (tryCatch.HasCaught())
@@ -63,6 +88,21 @@ v8::MaybeLocal<v8::String> Utils::StringBufferToV8String(v8::Isolate* isolate,
       isolate, reinterpret_cast<const char*>(str.data()), v8::NewStringType::kNormal, str.size());
 }
 
+v8::MaybeLocal<v8::String>
+Utils::FileContentToV8String(v8::Isolate* isolate, const IFileSystem::FileContentPtr& content)
+{
+  if (!content->size())
+    return v8::String::Empty(isolate);
+  if (!AsciiScanner::IsAscii(content->data(), content->size()))
+    return v8::String::NewFromUtf8(isolate,
+                                   reinterpret_cast<const char*>(content->data()),
+                                   v8::NewStringType::kNormal,
+                                   content->size());
+  // V8 takes ownership of the resource and deletes it once the string is
+  // garbage collected, which releases the content.
+  return v8::String::NewExternalOneByte(isolate, new ExternalFileContent(content));
+}
+
 void Utils::ThrowExceptionInJS(v8::Isolate* isolate, const std::string& str)
 {
   auto maybe = Utils::ToV8String(isolate, str);
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 
+#include <AdblockPlus/IFileSystem.h>
 #include <AdblockPlus/JsValue.h>
 
 #include "JsError.h"
@@ -77,6 +78,13 @@ namespace AdblockPlus
     v8::MaybeLocal<v8::String> ToV8String(v8::Isolate* isolate, const std::string& str);
     v8::MaybeLocal<v8::String> StringBufferToV8String(v8::Isolate* isolate,
                                                       const StringBuffer& bytes);
+    /*
+     * Creates a string from file content. ASCII content is exposed to V8 as
+     * an external string which keeps `content` alive instead of copying it,
+     * anything else is decoded as UTF-8.
+     */
+    v8::MaybeLocal<v8::String> FileContentToV8String(v8::Isolate* isolate,
+                                                     const IFileSystem::FileContentPtr& content);
     void ThrowExceptionInJS(v8::Isolate* isolate, const std::string& str);
 
     // Code for templated function has to be in a header file, can't be in .cpp
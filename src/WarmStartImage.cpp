@@ -0,0 +1,239 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WarmStartImage.h"
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+// Generated by convert_js.py, file names and sources alternating.
+extern std::string jsSources[];
+
+using namespace AdblockPlus;
+
+namespace
+{
+  // Changes whenever the layout of the image changes.
+  const char magic[] = "ABPWARM1";
+
+  // FNV-1a, unlike std::hash it's the same for every build and run.
+  uint64_t Hash(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+  {
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash ^= data[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  uint64_t HashScripts()
+  {
+    uint64_t hash = Hash(nullptr, 0);
+    for (int i = 0; !jsSources[i].empty(); ++i)
+    {
+      const auto& value = jsSources[i];
+      hash = Hash(reinterpret_cast<const uint8_t*>(value.data()), value.size(), hash);
+    }
+    return hash;
+  }
+
+  class Writer
+  {
+  public:
+    void WriteUint(uint32_t value)
+    {
+      for (int i = 0; i < 4; ++i)
+        data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void WriteBool(bool value)
+    {
+      data.push_back(value ? 1 : 0);
+    }
+
+    void WriteString(const std::string& value)
+    {
+      WriteUint(static_cast<uint32_t>(value.size()));
+      data.insert(data.end(), value.begin(), value.end());
+    }
+
+    IFileSystem::IOBuffer data;
+  };
+
+  class Reader
+  {
+  public:
+    Reader(const uint8_t* begin, const uint8_t* end) : position(begin), end(end)
+    {
+    }
+
+    uint32_t ReadUint()
+    {
+      Check(4);
+      uint32_t value = 0;
+      for (int i = 0; i < 4; ++i)
+        value |= static_cast<uint32_t>(*position++) << (8 * i);
+      return value;
+    }
+
+    // Number of elements, every element takes at least one byte.
+    uint32_t ReadCount()
+    {
+      uint32_t count = ReadUint();
+      Check(count);
+      return count;
+    }
+
+    bool ReadBool()
+    {
+      Check(1);
+      return *position++ != 0;
+    }
+
+    std::string ReadString()
+    {
+      uint32_t size = ReadUint();
+      Check(size);
+      std::string value(reinterpret_cast<const char*>(position), size);
+      position += size;
+      return value;
+    }
+
+    bool AtEnd() const
+    {
+      return position == end;
+    }
+
+  private:
+    void Check(size_t size) const
+    {
+      if (static_cast<size_t>(end - position) < size)
+        throw std::runtime_error("Unexpected end of warm start image");
+    }
+
+    const uint8_t* position;
+    const uint8_t* end;
+  };
+}
+
+const char* const WarmStartImage::fileName = "patterns.image";
+
+WarmStartImage::KeyBuilder::KeyBuilder()
+    : patternsHash(Hash(nullptr, 0)), journalHash(Hash(nullptr, 0))
+{
+}
+
+void WarmStartImage::KeyBuilder::AddPatterns(const uint8_t* data, size_t size)
+{
+  patternsHash = Hash(data, size, patternsHash);
+}
+
+void WarmStartImage::KeyBuilder::AddJournal(const uint8_t* data, size_t size)
+{
+  journalHash = Hash(data, size, journalHash);
+}
+
+std::string WarmStartImage::KeyBuilder::GetKey() const
+{
+  static const uint64_t scriptsHash = HashScripts();
+  std::ostringstream key;
+  key << std::hex << patternsHash << ' ' << journalHash << ' ' << scriptsHash;
+  return key.str();
+}
+
+IFileSystem::IOBuffer WarmStartImage::Serialize(const std::string& key) const
+{
+  Writer writer;
+  writer.data.assign(magic, magic + sizeof(magic) - 1);
+  writer.WriteString(key);
+  writer.WriteUint(static_cast<uint32_t>(urlFilters.size()));
+  for (const auto& filter : urlFilters)
+  {
+    writer.WriteString(filter.text);
+    writer.WriteString(filter.pattern);
+    writer.WriteBool(filter.isRegExp);
+    writer.WriteBool(filter.hasPattern);
+    writer.WriteUint(filter.contentType);
+    writer.WriteBool(filter.matchCase);
+    writer.WriteBool(filter.hasSitekeys);
+    writer.WriteUint(static_cast<uint32_t>(filter.domains.size()));
+    for (const auto& domain : filter.domains)
+    {
+      writer.WriteString(domain.first);
+      writer.WriteBool(domain.second);
+    }
+  }
+  writer.WriteUint(static_cast<uint32_t>(elementHidingDomains.size()));
+  for (const auto& domain : elementHidingDomains)
+    writer.WriteString(domain);
+
+  uint64_t checksum = Hash(writer.data.data(), writer.data.size());
+  writer.WriteUint(static_cast<uint32_t>(checksum));
+  writer.WriteUint(static_cast<uint32_t>(checksum >> 32));
+  return std::move(writer.data);
+}
+
+bool WarmStartImage::Deserialize(const IFileSystem::IOBuffer& data, const std::string& key)
+{
+  const size_t magicSize = sizeof(magic) - 1;
+  if (data.size() < magicSize + 8 || std::memcmp(data.data(), magic, magicSize) != 0)
+    return false;
+  const uint8_t* end = data.data() + data.size() - 8;
+  Reader checksumReader(end, end + 8);
+  uint64_t checksum = checksumReader.ReadUint();
+  checksum |= static_cast<uint64_t>(checksumReader.ReadUint()) << 32;
+  if (checksum != Hash(data.data(), end - data.data()))
+    return false;
+
+  WarmStartImage image;
+  try
+  {
+    Reader reader(data.data() + magicSize, end);
+    if (reader.ReadString() != key)
+      return false;
+    image.urlFilters.resize(reader.ReadCount());
+    for (auto& filter : image.urlFilters)
+    {
+      filter.text = reader.ReadString();
+      filter.pattern = reader.ReadString();
+      filter.isRegExp = reader.ReadBool();
+      filter.hasPattern = reader.ReadBool();
+      filter.contentType = reader.ReadUint();
+      filter.matchCase = reader.ReadBool();
+      filter.hasSitekeys = reader.ReadBool();
+      filter.domains.resize(reader.ReadCount());
+      for (auto& domain : filter.domains)
+      {
+        domain.first = reader.ReadString();
+        domain.second = reader.ReadBool();
+      }
+    }
+    image.elementHidingDomains.resize(reader.ReadCount());
+    for (auto& domain : image.elementHidingDomains)
+      domain = reader.ReadString();
+    if (!reader.AtEnd())
+      return false;
+  }
+  catch (const std::exception&)
+  {
+    return false;
+  }
+  *this = std::move(image);
+  return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <AdblockPlus/IFileSystem.h>
+
+#include "NativeMatcher.h"
+
+namespace AdblockPlus
+{
+  /**
+   * Data the native side retrieves from JavaScript once the filters are
+   * loaded, saved so that the next start with the same filters can restore
+   * it instead of retrieving it again.
+   * An image is only valid for the `patterns.ini`, its journal and the
+   * scripts it has been created with, see `KeyBuilder`. The subscriptions in
+   * `patterns.ini` include their versions, so updating a filter list
+   * invalidates the image too.
+   */
+  struct WarmStartImage
+  {
+    /// File name of the image.
+    static const char* const fileName;
+
+    /// URL filters, as added to `NativeMatcher`.
+    std::vector<NativeMatcher::UrlFilter> urlFilters;
+    /// Domains element hiding filters are restricted to or excluded from.
+    std::vector<std::string> elementHidingDomains;
+
+    /**
+     * Computes the key of the images created for the filters loaded from
+     * `patterns.ini` and its journal, see `FilterStorageJournal`. Both are
+     * added in chunks, so that neither has to be held in memory.
+     */
+    class KeyBuilder
+    {
+    public:
+      KeyBuilder();
+
+      /**
+       * Adds the next chunk of `patterns.ini`.
+       */
+      void AddPatterns(const uint8_t* data, size_t size);
+
+      /**
+       * Adds the next chunk of the journal, none if there is no journal.
+       */
+      void AddJournal(const uint8_t* data, size_t size);
+
+      /**
+       * @return Key of the content added so far.
+       */
+      std::string GetKey() const;
+
+    private:
+      uint64_t patternsHash;
+      uint64_t journalHash;
+    };
+
+    /**
+     * Serializes the image, including a checksum of the data.
+     * @param key Key of the filters the image has been created for.
+     */
+    IFileSystem::IOBuffer Serialize(const std::string& key) const;
+
+    /**
+     * Restores an image saved with `Serialize()`.
+     * @param data Serialized image.
+     * @param key Key of the current filters.
+     * @return `false` if the image is damaged or created for other filters,
+     *         the image is left unchanged then.
+     */
+    bool Deserialize(const IFileSystem::IOBuffer& data, const std::string& key);
+  };
+}
@@ -74,10 +74,16 @@ void JsEngine::ScheduleWebRequest(WebRequestMethod method, const v8::FunctionCal
     weakCallbackValue.Values()[0].Call(resultObject);
   };
 
+  auto backgroundCallback = [jsEngine, reuqestCallback](const ServerResponse& response) {
+    jsEngine->Post(JsEventLoop::Priority::BACKGROUND, [reuqestCallback, response] {
+      reuqestCallback(response);
+    });
+  };
+
   if (method == WebRequestMethod::kGet)
-    jsEngine->GetWebRequest().GET(url, headers, reuqestCallback);
+    jsEngine->GetWebRequest().GET(url, headers, backgroundCallback);
   else if (method == WebRequestMethod::kHead)
-    jsEngine->GetWebRequest().HEAD(url, headers, reuqestCallback);
+    jsEngine->GetWebRequest().HEAD(url, headers, backgroundCallback);
   else
     throw std::runtime_error("Unknown web request method");
 }
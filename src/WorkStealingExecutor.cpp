@@ -0,0 +1,198 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AdblockPlus/WorkStealingExecutor.h>
+
+#include <algorithm>
+#include <random>
+
+#include "ChaseLevDeque.h"
+
+using namespace AdblockPlus;
+
+class WorkStealingExecutor::Worker
+{
+public:
+  explicit Worker(size_t index) : index(index), random(static_cast<unsigned>(index + 1))
+  {
+  }
+
+  const size_t index;
+  std::thread::id threadId;
+  ChaseLevDeque<Task*> tasks;
+  // Picks the first victim to steal from, only used by the worker itself.
+  std::minstd_rand random;
+};
+
+WorkStealingExecutor::WorkStealingExecutor(size_t threadCount)
+    : isRunning(true), pendingCount(0), sleepingCount(0), localTasks(0), sharedTasks(0), steals(0)
+{
+  threadCount = std::max<size_t>(threadCount, 1);
+  for (size_t i = 0; i < threadCount; ++i)
+    workers.emplace_back(new Worker(i));
+
+  // The workers wait for all thread IDs to be known.
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& worker : workers)
+  {
+    Worker* workerPtr = worker.get();
+    threads.emplace_back([this, workerPtr] {
+      ThreadFunc(*workerPtr);
+    });
+    worker->threadId = threads.back().get_id();
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor()
+{
+  Stop();
+}
+
+void WorkStealingExecutor::Dispatch(const std::function<void()>& call)
+{
+  if (!call)
+    return;
+  Worker* worker = CurrentWorker();
+  if (worker)
+  {
+    // A task racing with Stop() is still run, the worker only finishes once
+    // no tasks are pending.
+    if (!isRunning)
+      return;
+    ++pendingCount;
+    ++localTasks;
+    worker->tasks.Push(new Task(call));
+    if (sleepingCount > 0)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      wakeUp.notify_one();
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isRunning)
+      return;
+    sharedQueue.push_back(new Task(call));
+    ++pendingCount;
+    ++sharedTasks;
+  }
+  wakeUp.notify_one();
+}
+
+void WorkStealingExecutor::Stop()
+{
+  std::vector<std::thread> workerThreads;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    isRunning = false;
+    workerThreads.swap(threads);
+  }
+  wakeUp.notify_all();
+  for (auto& thread : workerThreads)
+    thread.join();
+}
+
+WorkStealingExecutor::Statistics WorkStealingExecutor::GetStatistics() const
+{
+  Statistics result;
+  result.queueDepth = pendingCount;
+  for (const auto& worker : workers)
+    result.workerQueueDepths.push_back(worker->tasks.Size());
+  result.localTasks = localTasks;
+  result.sharedTasks = sharedTasks;
+  result.steals = steals;
+  return result;
+}
+
+void WorkStealingExecutor::ThreadFunc(Worker& worker)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  for (;;)
+  {
+    Task* task = FindTask(worker);
+    if (task)
+    {
+      --pendingCount;
+      try
+      {
+        (*task)();
+      }
+      catch (...)
+      {
+        // do nothing, but the thread will be alive.
+      }
+      delete task;
+      continue;
+    }
+
+    // Tasks can be pending in the deque of a worker which is about to take
+    // them, so there is no waiting for them then.
+    std::unique_lock<std::mutex> lock(mutex);
+    ++sleepingCount;
+    wakeUp.wait(lock, [this]() -> bool {
+      return pendingCount > 0 || !isRunning;
+    });
+    --sleepingCount;
+    if (!isRunning && pendingCount == 0)
+      return;
+  }
+}
+
+WorkStealingExecutor::Worker* WorkStealingExecutor::CurrentWorker() const
+{
+  const auto id = std::this_thread::get_id();
+  for (const auto& worker : workers)
+  {
+    if (worker->threadId == id)
+      return worker.get();
+  }
+  return nullptr;
+}
+
+WorkStealingExecutor::Task* WorkStealingExecutor::FindTask(Worker& worker)
+{
+  Task* task = nullptr;
+  if (worker.tasks.Take(&task))
+    return task;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!sharedQueue.empty())
+    {
+      task = sharedQueue.front();
+      sharedQueue.pop_front();
+      return task;
+    }
+  }
+
+  const size_t count = workers.size();
+  const size_t first = worker.random() % count;
+  for (size_t i = 0; i < count; ++i)
+  {
+    Worker& victim = *workers[(first + i) % count];
+    if (&victim != &worker && victim.tasks.Steal(&task))
+    {
+      ++steals;
+      return task;
+    }
+  }
+  return nullptr;
+}
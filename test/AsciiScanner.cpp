@@ -0,0 +1,201 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../src/AsciiScanner.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  typedef std::vector<std::pair<size_t, size_t>> Runs;
+
+  Runs KeywordRuns(const std::string& str, bool vectorized)
+  {
+    std::vector<uint64_t> mask;
+    if (vectorized)
+      AsciiScanner::FindKeywordCharacters(str, &mask);
+    else
+      AsciiScanner::FindKeywordCharactersScalar(str, &mask);
+    Runs runs;
+    size_t end = 0;
+    for (;;)
+    {
+      size_t start = AsciiScanner::NextKeywordRun(mask, str.size(), &end);
+      if (start == str.size())
+        break;
+      runs.emplace_back(start, end);
+    }
+    return runs;
+  }
+
+  // Request URLs of the recorded sessions used by HarnessTest.
+  std::vector<std::string> RecordedUrls()
+  {
+    std::vector<std::string> urls;
+    for (const char* file : {"data/rec_allegro_pl.log",
+                             "data/rec_en_wikipedia_org.log",
+                             "data/rec_news_mail_ru.log",
+                             "data/rec_www_amazon_com.log",
+                             "data/rec_www_baidu_com.log",
+                             "data/rec_www_bbc_com.log"})
+    {
+      std::ifstream stream(file);
+      std::string line;
+      const std::string key = "\"request_url\":\"";
+      while (std::getline(stream, line))
+      {
+        size_t start = line.find(key);
+        if (start == std::string::npos)
+          continue;
+        start += key.size();
+        urls.push_back(line.substr(start, line.find('"', start) - start));
+      }
+    }
+    return urls;
+  }
+
+  template<typename Function>
+  double Microseconds(Function&& function)
+  {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+        .count();
+  }
+}
+
+TEST(AsciiScannerTest, ToLowerAscii)
+{
+  std::string lowerCase;
+  EXPECT_TRUE(AsciiScanner::ToLowerAscii("", &lowerCase));
+  EXPECT_EQ("", lowerCase);
+  EXPECT_TRUE(AsciiScanner::ToLowerAscii("HTTP://Example.ORG/Path?Q=@[`{", &lowerCase));
+  EXPECT_EQ("http://example.org/path?q=@[`{", lowerCase);
+
+  // Non-ASCII characters in a vectorized block and in the remainder.
+  EXPECT_FALSE(AsciiScanner::ToLowerAscii("http://example.org/\xC3\xA4/abcdefghijklmnop",
+                                          &lowerCase));
+  EXPECT_FALSE(AsciiScanner::ToLowerAscii("http://example.org/abcdefghijklmnop/\xC3\xA4",
+                                          &lowerCase));
+  EXPECT_FALSE(AsciiScanner::ToLowerAsciiScalar("\xC3\xA4", &lowerCase));
+
+  for (size_t length = 0; length < 70; ++length)
+  {
+    std::string str;
+    for (size_t i = 0; i < length; ++i)
+      str.push_back(static_cast<char>(i * 7 % 128));
+    std::string expected;
+    ASSERT_TRUE(AsciiScanner::ToLowerAsciiScalar(str, &expected));
+    ASSERT_TRUE(AsciiScanner::ToLowerAscii(str, &lowerCase));
+    EXPECT_EQ(expected, lowerCase) << length;
+  }
+}
+
+TEST(AsciiScannerTest, IsAscii)
+{
+  std::string str(70, 'a');
+  auto data = reinterpret_cast<const uint8_t*>(str.data());
+  for (size_t length = 0; length < str.size(); ++length)
+  {
+    EXPECT_TRUE(AsciiScanner::IsAscii(data, length)) << length;
+    EXPECT_TRUE(AsciiScanner::IsAsciiScalar(data, length)) << length;
+  }
+
+  // A non-ASCII byte at every position, in the vectorized blocks and in the
+  // remainder.
+  for (size_t i = 0; i < str.size(); ++i)
+  {
+    str[i] = '\xC3';
+    EXPECT_FALSE(AsciiScanner::IsAscii(data, str.size())) << i;
+    EXPECT_FALSE(AsciiScanner::IsAsciiScalar(data, str.size())) << i;
+    EXPECT_TRUE(AsciiScanner::IsAscii(data, i)) << i;
+    str[i] = 'a';
+  }
+}
+
+TEST(AsciiScannerTest, KeywordRuns)
+{
+  for (bool vectorized : {false, true})
+  {
+    EXPECT_EQ(Runs(), KeywordRuns("", vectorized));
+    EXPECT_EQ(Runs(), KeywordRuns("://.-_", vectorized));
+    EXPECT_EQ(Runs({{0, 4}, {7, 14}, {15, 18}, {19, 22}}),
+              KeywordRuns("http://example.org/a%2", vectorized));
+
+    // Runs crossing the 16 character blocks and the 64 bit mask elements.
+    std::string str = std::string(60, 'a') + "/" + std::string(70, '9') + "-";
+    EXPECT_EQ(Runs({{0, 60}, {61, 131}}), KeywordRuns(str, vectorized));
+    str = std::string(128, 'z');
+    EXPECT_EQ(Runs({{0, 128}}), KeywordRuns(str, vectorized));
+  }
+}
+
+// Also a microbenchmark of the scans, on the URLs of the recorded sessions.
+TEST(AsciiScannerTest, RecordedUrls)
+{
+  auto urls = RecordedUrls();
+  ASSERT_FALSE(urls.empty());
+
+  std::string lowerCase;
+  std::string expected;
+  for (const auto& url : urls)
+  {
+    bool isAscii = AsciiScanner::ToLowerAsciiScalar(url, &expected);
+    ASSERT_EQ(isAscii, AsciiScanner::ToLowerAscii(url, &lowerCase)) << url;
+    if (!isAscii)
+      continue;
+    EXPECT_EQ(expected, lowerCase) << url;
+    EXPECT_EQ(KeywordRuns(expected, false), KeywordRuns(expected, true)) << url;
+  }
+
+  const int iterations = 20;
+  size_t runCount = 0;
+  auto scan = [&](bool vectorized) {
+    std::vector<uint64_t> mask;
+    for (int i = 0; i < iterations; ++i)
+    {
+      for (const auto& url : urls)
+      {
+        if (!(vectorized ? AsciiScanner::ToLowerAscii(url, &lowerCase)
+                         : AsciiScanner::ToLowerAsciiScalar(url, &lowerCase)))
+          continue;
+        if (vectorized)
+          AsciiScanner::FindKeywordCharacters(lowerCase, &mask);
+        else
+          AsciiScanner::FindKeywordCharactersScalar(lowerCase, &mask);
+        size_t end = 0;
+        while (AsciiScanner::NextKeywordRun(mask, lowerCase.size(), &end) != lowerCase.size())
+          ++runCount;
+      }
+    }
+  };
+  double scalar = Microseconds([&]() { scan(false); });
+  double vectorized = Microseconds([&]() { scan(true); });
+  EXPECT_GT(runCount, 0u);
+
+  const double count = static_cast<double>(iterations * urls.size());
+  std::cout << "Scanned " << urls.size() << " URLs " << iterations << " times, per URL: scalar "
+            << scalar / count << " us, vectorized " << vectorized / count << " us" << std::endl;
+}
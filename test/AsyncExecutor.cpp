@@ -17,8 +17,15 @@
 
 #include "../src/AsyncExecutor.h"
 
+#include <AdblockPlus/WorkStealingExecutor.h>
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <gtest/gtest.h>
+#include <iostream>
+
+#include "../src/ChaseLevDeque.h"
+#include "../src/ThreadPoolExecutor.h"
 
 using namespace AdblockPlus;
 
@@ -101,6 +108,47 @@ template<> struct BaseAsyncExecutorTestTraits<AsyncExecutor>
   }
 };
 
+// Small pool with a short queue, so that it has to grow.
+class TestThreadPoolExecutor : public ThreadPoolExecutor
+{
+public:
+  TestThreadPoolExecutor() : ThreadPoolExecutor(4, 16)
+  {
+  }
+};
+
+template<>
+struct BaseAsyncExecutorTestTraits<TestThreadPoolExecutor>
+    : BaseAsyncExecutorTestTraits<AsyncExecutor>
+{
+  typedef TestThreadPoolExecutor Executor;
+
+  static void Dispatch(Executor& executor, std::function<void()> call)
+  {
+    executor.Dispatch(std::move(call));
+  }
+};
+
+class TestWorkStealingExecutor : public WorkStealingExecutor
+{
+public:
+  TestWorkStealingExecutor() : WorkStealingExecutor(4)
+  {
+  }
+};
+
+template<>
+struct BaseAsyncExecutorTestTraits<TestWorkStealingExecutor>
+    : BaseAsyncExecutorTestTraits<AsyncExecutor>
+{
+  typedef TestWorkStealingExecutor Executor;
+
+  static void Dispatch(Executor& executor, std::function<void()> call)
+  {
+    executor.Dispatch(std::move(call));
+  }
+};
+
 template<typename Executor> void BaseAsyncExecutorTest<Executor>::MultithreadedCallsTest()
 {
   typename Traits::PayloadResults results;
@@ -231,4 +279,266 @@ namespace
   {
     MultithreadedCallsTest();
   }
+
+  typedef BaseAsyncExecutorTest<TestThreadPoolExecutor> ThreadPoolExecutorTest;
+
+  INSTANTIATE_TEST_SUITE_P(DifferentProducersNumber1,
+                           ThreadPoolExecutorTest,
+                           MultithreadedCallsGenerator1,
+                           humanReadbleParams);
+
+  INSTANTIATE_TEST_SUITE_P(DifferentProducersNumber2,
+                           ThreadPoolExecutorTest,
+                           MultithreadedCallsGenerator2,
+                           humanReadbleParams);
+
+  INSTANTIATE_TEST_SUITE_P(DifferentProducersNumber3,
+                           ThreadPoolExecutorTest,
+                           MultithreadedCallsGenerator3,
+                           humanReadbleParams);
+
+  TEST_P(ThreadPoolExecutorTest, MultithreadedCalls)
+  {
+    MultithreadedCallsTest();
+  }
+
+  TEST(ThreadPoolTest, StopRunsDispatchedTasks)
+  {
+    ThreadPoolExecutor executor(2, 4);
+    std::atomic<int> counter(0);
+    for (int i = 0; i < 10; ++i)
+    {
+      executor.Dispatch([&counter] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++counter;
+      });
+    }
+    executor.Stop();
+    EXPECT_EQ(10, counter);
+
+    executor.Dispatch([&counter] {
+      ++counter;
+    });
+    executor.Stop();
+    EXPECT_EQ(10, counter);
+  }
+
+  TEST(ThreadPoolTest, WorkerDispatchesBehindQueuedTasks)
+  {
+    ThreadPoolExecutor executor(1, 1);
+    std::vector<int> order;
+    std::promise<void> taskDone;
+    executor.Dispatch([&] {
+      // The queue is full after the first task.
+      for (int i = 0; i < 3; ++i)
+      {
+        executor.Dispatch([&order, i] {
+          order.push_back(i);
+        });
+      }
+      order.push_back(-1);
+      taskDone.set_value();
+    });
+    // Tasks dispatched after Stop() would be ignored.
+    taskDone.get_future().wait();
+    executor.Stop();
+    EXPECT_EQ(std::vector<int>({-1, 0, 1, 2}), order);
+  }
+
+  TEST(ThreadPoolTest, DispatchDoesNotBlockIfQueueIsFull)
+  {
+    ThreadPoolExecutor executor(1, 1);
+    std::promise<void> unblock;
+    auto blocker = unblock.get_future().share();
+    std::atomic<int> counter(0);
+    executor.Dispatch([blocker] {
+      blocker.wait();
+    });
+    // The only worker is busy, dispatching would wait for it if the queue
+    // didn't grow.
+    for (int i = 0; i < 10; ++i)
+    {
+      executor.Dispatch([&counter] {
+        ++counter;
+      });
+    }
+    EXPECT_EQ(0, counter);
+    unblock.set_value();
+    executor.Stop();
+    EXPECT_EQ(10, counter);
+  }
+
+  // Compares the latency and the throughput of dispatching short tasks with
+  // a thread per task and with a pool, as a microbenchmark.
+  TEST(ThreadPoolTest, DispatchBenchmark)
+  {
+    const int taskCount = 1000;
+    auto measure = [taskCount](IExecutor& executor, const std::string& name) {
+      typedef std::chrono::steady_clock Clock;
+      std::atomic<int64_t> latency(0);
+      std::atomic<int> counter(0);
+      auto start = Clock::now();
+      for (int i = 0; i < taskCount; ++i)
+      {
+        auto dispatched = Clock::now();
+        executor.Dispatch([&latency, &counter, dispatched] {
+          latency += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                                           dispatched)
+                         .count();
+          ++counter;
+        });
+      }
+      executor.Stop();
+      auto total = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+      EXPECT_EQ(taskCount, counter);
+      std::cout << name << ": " << taskCount << " tasks in " << total / 1000
+                << " ms, average latency " << latency / taskCount << " us" << std::endl;
+    };
+
+    OptionalAsyncExecutor asyncExecutor;
+    measure(asyncExecutor, "Thread per task");
+    ThreadPoolExecutor threadPoolExecutor(4, 256);
+    measure(threadPoolExecutor, "Thread pool");
+    WorkStealingExecutor workStealingExecutor(4);
+    measure(workStealingExecutor, "Work stealing");
+  }
+
+  typedef BaseAsyncExecutorTest<TestWorkStealingExecutor> WorkStealingExecutorTest;
+
+  INSTANTIATE_TEST_SUITE_P(DifferentProducersNumber1,
+                           WorkStealingExecutorTest,
+                           MultithreadedCallsGenerator1,
+                           humanReadbleParams);
+
+  INSTANTIATE_TEST_SUITE_P(DifferentProducersNumber2,
+                           WorkStealingExecutorTest,
+                           MultithreadedCallsGenerator2,
+                           humanReadbleParams);
+
+  INSTANTIATE_TEST_SUITE_P(DifferentProducersNumber3,
+                           WorkStealingExecutorTest,
+                           MultithreadedCallsGenerator3,
+                           humanReadbleParams);
+
+  TEST_P(WorkStealingExecutorTest, MultithreadedCalls)
+  {
+    MultithreadedCallsTest();
+  }
+
+  TEST(ChaseLevDequeTest, OwnerTakesNewestThiefStealsOldest)
+  {
+    ChaseLevDeque<int> deque(2);
+    int value = 0;
+    EXPECT_FALSE(deque.Take(&value));
+    EXPECT_FALSE(deque.Steal(&value));
+
+    // Also grows the buffer twice.
+    for (int i = 0; i < 8; ++i)
+      deque.Push(i);
+    EXPECT_EQ(8u, deque.Size());
+    ASSERT_TRUE(deque.Take(&value));
+    EXPECT_EQ(7, value);
+    ASSERT_TRUE(deque.Steal(&value));
+    EXPECT_EQ(0, value);
+    EXPECT_EQ(6u, deque.Size());
+    for (int expected = 6; expected > 0; --expected)
+    {
+      ASSERT_TRUE(deque.Take(&value));
+      EXPECT_EQ(expected, value);
+    }
+    EXPECT_FALSE(deque.Take(&value));
+    EXPECT_FALSE(deque.Steal(&value));
+    EXPECT_EQ(0u, deque.Size());
+  }
+
+  TEST(ChaseLevDequeTest, ConcurrentSteals)
+  {
+    const int valueCount = 100000;
+    ChaseLevDeque<int> deque;
+    std::vector<std::atomic<int>> seen(valueCount);
+    std::atomic<bool> isDone(false);
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i)
+    {
+      thieves.emplace_back([&] {
+        int value;
+        while (!isDone)
+        {
+          if (deque.Steal(&value))
+            ++seen[value];
+        }
+      });
+    }
+
+    int value;
+    for (int i = 0; i < valueCount; ++i)
+    {
+      deque.Push(i);
+      if (i % 3 == 0 && deque.Take(&value))
+        ++seen[value];
+    }
+    while (deque.Take(&value))
+      ++seen[value];
+    isDone = true;
+    for (auto& thief : thieves)
+      thief.join();
+
+    // Every value is taken or stolen exactly once.
+    for (int i = 0; i < valueCount; ++i)
+      EXPECT_EQ(1, seen[i]) << i;
+  }
+
+  TEST(WorkStealingExecutorStatisticsTest, TasksOfTasksAreLocalOrStolen)
+  {
+    const int taskCount = 100;
+    std::atomic<int> counter(0);
+    std::promise<void> subtasksDone;
+    std::promise<void> taskDone;
+    WorkStealingExecutor executor(2);
+    executor.Dispatch([&] {
+      for (int i = 0; i < taskCount; ++i)
+      {
+        executor.Dispatch([&] {
+          if (++counter == taskCount)
+            subtasksDone.set_value();
+        });
+      }
+      // This worker doesn't get back to its deque before the other one has
+      // stolen all the tasks.
+      subtasksDone.get_future().wait();
+      taskDone.set_value();
+    });
+    // Tasks dispatched after Stop() would be ignored.
+    taskDone.get_future().wait();
+    executor.Stop();
+
+    EXPECT_EQ(taskCount, counter);
+    auto statistics = executor.GetStatistics();
+    EXPECT_EQ(0u, statistics.queueDepth);
+    EXPECT_EQ(std::vector<size_t>({0, 0}), statistics.workerQueueDepths);
+    EXPECT_EQ(1u, statistics.sharedTasks);
+    EXPECT_EQ(static_cast<uint64_t>(taskCount), statistics.localTasks);
+    EXPECT_EQ(static_cast<uint64_t>(taskCount), statistics.steals);
+  }
+
+  TEST(WorkStealingExecutorStatisticsTest, StopRunsDispatchedTasks)
+  {
+    WorkStealingExecutor executor(2);
+    std::atomic<int> counter(0);
+    for (int i = 0; i < 10; ++i)
+    {
+      executor.Dispatch([&counter] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++counter;
+      });
+    }
+    executor.Stop();
+    EXPECT_EQ(10, counter);
+
+    executor.Dispatch([&counter] {
+      ++counter;
+    });
+    executor.Stop();
+    EXPECT_EQ(10, counter);
+  }
 }
@@ -155,6 +155,125 @@ TEST_F(DefaultFileSystemTest, WriteReadRemove)
   EXPECT_TRUE(hasRemoveRun);
 }
 
+TEST_F(DefaultFileSystemTest, WriteAppendReadRemove)
+{
+  WriteString("foo");
+
+  bool hasAppendRun = false;
+  fileSystem->Append(testFileName,
+                     IFileSystem::IOBuffer{'b', 'a', 'r'},
+                     [&hasAppendRun](const std::string& error) {
+                       EXPECT_TRUE(error.empty()) << error;
+                       hasAppendRun = true;
+                     });
+  EXPECT_FALSE(hasAppendRun);
+  PumpTask();
+  EXPECT_TRUE(hasAppendRun);
+
+  bool hasReadRun = false;
+  fileSystem->Read(
+      testFileName,
+      [&hasReadRun](IFileSystem::IOBuffer&& content) {
+        EXPECT_EQ("foobar", std::string(content.cbegin(), content.cend()));
+        hasReadRun = true;
+      },
+      [](const std::string& error) { FAIL() << error; });
+  PumpTask();
+  EXPECT_TRUE(hasReadRun);
+
+  fileSystem->Remove(testFileName, [](const std::string& error) {
+    EXPECT_TRUE(error.empty()) << error;
+  });
+  PumpTask();
+}
+
+TEST_F(DefaultFileSystemTest, WriteReadContentRemove)
+{
+  for (const std::string& expected : {std::string(), std::string("foo\nb\xc3\xa4r\n")})
+  {
+    WriteString(expected);
+
+    IFileSystem::FileContentPtr content;
+    fileSystem->ReadContent(
+        testFileName,
+        [&content](const IFileSystem::FileContentPtr& result) {
+          content = result;
+        },
+        [](const std::string& error) {
+          ADD_FAILURE() << error;
+        });
+    EXPECT_FALSE(content);
+    PumpTask();
+    ASSERT_TRUE(content);
+    EXPECT_EQ(expected,
+              std::string(reinterpret_cast<const char*>(content->data()), content->size()));
+
+    // Writing replaces the file, the content which is still held stays intact.
+    WriteString("overwritten");
+    EXPECT_EQ(expected,
+              std::string(reinterpret_cast<const char*>(content->data()), content->size()));
+  }
+
+  bool hasRemoveRun = false;
+  fileSystem->Remove(testFileName, [&hasRemoveRun](const std::string& error) {
+    EXPECT_TRUE(error.empty());
+    hasRemoveRun = true;
+  });
+  PumpTask();
+  EXPECT_TRUE(hasRemoveRun);
+}
+
+TEST_F(DefaultFileSystemTest, WriteReadChunksRemove)
+{
+  WriteString("0123456789");
+
+  std::vector<std::string> chunks;
+  std::function<void()> next;
+  fileSystem->ReadChunks(
+      testFileName,
+      4,
+      [&chunks, &next](IFileSystem::IOBuffer&& chunk, const std::function<void()>& readNext) {
+        chunks.emplace_back(chunk.cbegin(), chunk.cend());
+        next = readNext;
+      },
+      [](const std::string& error) {
+        ADD_FAILURE() << error;
+      });
+  for (const char* expected : {"0123", "4567", "89", ""})
+  {
+    PumpTask();
+    ASSERT_FALSE(chunks.empty());
+    EXPECT_EQ(expected, chunks.back());
+    // Nothing is read until the next chunk is requested.
+    EXPECT_TRUE(fileSystemTasks.empty());
+    next();
+  }
+  EXPECT_EQ(4u, chunks.size());
+  EXPECT_TRUE(fileSystemTasks.empty());
+
+  bool hasErrorRun = false;
+  fileSystem->ReadChunks(
+      "non-existing-file",
+      4,
+      [](IFileSystem::IOBuffer&& chunk, const std::function<void()>& readNext) {
+        ADD_FAILURE() << "Unexpected chunk";
+      },
+      [&hasErrorRun](const std::string& error) {
+        EXPECT_FALSE(error.empty());
+        hasErrorRun = true;
+      });
+  PumpTask();
+  EXPECT_TRUE(hasErrorRun);
+
+  bool hasRemoveRun = false;
+  fileSystem->Remove(testFileName, [&hasRemoveRun](const std::string& error) {
+    EXPECT_TRUE(error.empty());
+    hasRemoveRun = true;
+  });
+  PumpTask();
+  EXPECT_TRUE(hasRemoveRun);
+}
+
 TEST_F(DefaultFileSystemTest, StatWorkingDirectory)
 {
   bool hasStatRun = false;
@@ -15,8 +15,11 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <chrono>
 #include <sstream>
+#include <thread>
 
+#include "../src/FilterStorageFile.h"
 #include "../src/Thread.h"
 #include "BaseJsTest.h"
 
@@ -39,8 +42,10 @@ namespace
     mutable std::string statFile;
     bool statExists;
     int statLastModified;
+    size_t readChunkSize;
+    mutable size_t chunksRead;
 
-    MockFileSystem() : success(true)
+    MockFileSystem() : success(true), readChunkSize(0), chunksRead(0)
     {
     }
 
@@ -61,6 +66,29 @@ namespace
         errorCallback("Unable to read " + fileName);
     }
 
+    // Splits the content into chunks of `readChunkSize` if it's set.
+    void ReadChunks(const std::string& fileName,
+                    size_t chunkSize,
+                    const ReadChunkCallback& chunkCallback,
+                    const Callback& errorCallback) const override
+    {
+      if (!readChunkSize || !success)
+        return IFileSystem::ReadChunks(fileName, chunkSize, chunkCallback, errorCallback);
+      ReadChunk(0, chunkCallback);
+    }
+
+    void ReadChunk(size_t offset, const ReadChunkCallback& chunkCallback) const
+    {
+      auto begin = contentToRead.begin() + std::min(offset, contentToRead.size());
+      auto end = contentToRead.begin() + std::min(offset + readChunkSize, contentToRead.size());
+      ++chunksRead;
+      if (begin == end)
+        return chunkCallback(IOBuffer(), [] {});
+      chunkCallback(IOBuffer(begin, end), [this, offset, chunkCallback] {
+        ReadChunk(offset + readChunkSize, chunkCallback);
+      });
+    }
+
     void Write(const std::string& fileName, const IOBuffer& data, const Callback& callback) override
     {
       if (!success)
@@ -188,6 +216,47 @@ TEST_F(FileSystemJsObjectTest, WriteError)
   ASSERT_NE("", GetJsEngine().Evaluate("error").AsString());
 }
 
+TEST_F(FileSystemJsObjectTest, WriteLines)
+{
+  GetJsEngine().Evaluate("let error = true; _fileSystem.writeLines('foo', "
+                         "['[Subscription]', 'url=~user~0000', '', 'b\\u00e4r'], "
+                         "function(e) {error = e})");
+  ASSERT_EQ("foo", mockFileSystem->lastWrittenFile);
+  ASSERT_TRUE(GetJsEngine().Evaluate("error").IsUndefined());
+  const auto& content = mockFileSystem->lastWrittenContent;
+  ASSERT_TRUE(AdblockPlus::FilterStorageFile::IsStorageFile(content.data(), content.size()));
+
+  // Reading the file back yields the written lines, the first read chunk is
+  // enough to recognize the format.
+  GetJsEngine().Evaluate("let lines");
+  for (size_t readChunkSize : {0, 16})
+  {
+    mockFileSystem->readChunkSize = readChunkSize;
+    mockFileSystem->contentToRead = content;
+    GetJsEngine().Evaluate("lines = []; _fileSystem.readFromFile('foo', "
+                           "line => lines.push(line), () => {}, e => lines.push(e))");
+    EXPECT_EQ("[Subscription]\nurl=~user~0000\nb\xc3\xa4r",
+              GetJsEngine().Evaluate("lines.join('\\n')").AsString());
+  }
+}
+
+TEST_F(FileSystemJsObjectTest, WriteLinesIllegalArguments)
+{
+  ASSERT_ANY_THROW(GetJsEngine().Evaluate("_fileSystem.writeLines()"));
+  ASSERT_ANY_THROW(GetJsEngine().Evaluate("_fileSystem.writeLines('', '', function() {})"));
+  ASSERT_ANY_THROW(GetJsEngine().Evaluate("_fileSystem.writeLines('', [], '')"));
+}
+
+TEST_F(FileSystemJsObjectTest, ReadDamagedStorageFile)
+{
+  GetJsEngine().Evaluate("_fileSystem.writeLines('foo', ['foo', 'bar'], function() {})");
+  mockFileSystem->contentToRead = mockFileSystem->lastWrittenContent;
+  mockFileSystem->contentToRead.pop_back();
+  GetJsEngine().Evaluate("let error; _fileSystem.readFromFile('foo', "
+                         "line => {}, () => {}, e => error = e)");
+  EXPECT_FALSE(GetJsEngine().Evaluate("error").IsUndefined());
+}
+
 TEST_F(FileSystemJsObjectTest, Move)
 {
   GetJsEngine().Evaluate(
@@ -361,6 +430,72 @@ TEST_F(FileSystemJsObject_ReadFromFileTest, Lines)
                      {"first", "second", "third"});
 }
 
+TEST_F(FileSystemJsObject_ReadFromFileTest, LinesInTimeSlices)
+{
+  GetJsEngine().SetTimeSlice(std::chrono::milliseconds(1));
+  std::string content;
+  Lines expected;
+  for (int i = 0; i < 5; ++i)
+  {
+    expected.push_back("line" + std::to_string(i));
+    content += expected.back() + "\n";
+  }
+  mockFileSystem->contentToRead.assign(content.begin(), content.end());
+
+  // Every line takes longer than a slice.
+  Lines readLines;
+  readFromFile([&readLines](const std::string& line) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    readLines.push_back(line);
+  });
+  EXPECT_EQ(expected, readLines);
+}
+
+TEST_F(FileSystemJsObject_ReadFromFileTest, LinesInChunks)
+{
+  std::string content = "first\nsecond\r\n\nthird\nfourth\nfifth\n";
+  mockFileSystem->contentToRead.assign(content.begin(), content.end());
+  auto& jsEngine = GetJsEngine();
+  jsEngine.SetLineChunkSize(2);
+
+  std::vector<Lines> chunks;
+  bool isOnDoneCalled = false;
+  jsEngine.SetEventCallback("onChunk", [&chunks](JsValueList&& jsArgs) {
+    ASSERT_EQ(1u, jsArgs.size());
+    chunks.emplace_back();
+    for (const auto& line : jsArgs[0].AsList())
+      chunks.back().push_back(line.AsString());
+  });
+  jsEngine.SetEventCallback("onDone", [&isOnDoneCalled](JsValueList&& jsArgs) {
+    EXPECT_EQ(0u, jsArgs.size());
+    isOnDoneCalled = true;
+  });
+  jsEngine.Evaluate(R"js(_fileSystem.readLinesFromFile("foo",
+  (lines) => _triggerEvent("onChunk", lines),
+  () => _triggerEvent("onDone"),
+  (error) => _triggerEvent("onDone", error));
+)js");
+
+  EXPECT_TRUE(isOnDoneCalled);
+  ASSERT_EQ(3u, chunks.size());
+  EXPECT_EQ(Lines({"first", "second"}), chunks[0]);
+  EXPECT_EQ(Lines({"third", "fourth"}), chunks[1]);
+  EXPECT_EQ(Lines({"fifth"}), chunks[2]);
+}
+
+TEST_F(FileSystemJsObject_ReadFromFileTest, LinesAcrossReadChunks)
+{
+  std::string content = "first\r\nsecond\n\nth\xc3\xa4rd\r\nlast";
+  for (size_t readChunkSize : {1, 2, 3, 5, 64})
+  {
+    mockFileSystem->readChunkSize = readChunkSize;
+    mockFileSystem->chunksRead = 0;
+    readFromFile_Lines(content, {"first", "second", "th\xc3\xa4rd", "last"});
+    EXPECT_EQ((content.size() + readChunkSize - 1) / readChunkSize + 1,
+              mockFileSystem->chunksRead);
+  }
+}
+
 TEST_F(FileSystemJsObject_ReadFromFileTest, ProcessLineThrowsException)
 {
   std::string content = "1\n2\n3";
@@ -419,3 +554,192 @@ TEST_F(FileSystemJsObjectTest, MoveNonExistingFile)
   EXPECT_EQ("Unable to move foo to bar", jsEngine.Evaluate("hasError").AsString());
   EXPECT_TRUE(jsEngine.Evaluate("isNextHandlerCalled").AsBool());
 }
+
+TEST_F(FileSystemJsObjectTest, CopyStorageFile)
+{
+  auto& jsEngine = GetJsEngine();
+  for (int i = 0; !jsSources[i].empty(); i += 2)
+  {
+    if (jsSources[i] == "compat.js" || jsSources[i] == "io.js")
+      jsEngine.Evaluate(jsSources[i + 1], jsSources[i]);
+  }
+  jsEngine.Evaluate(R"js(
+    let {IO} = require("io");
+    IO.writeToFile("foo", ["[Subscription]", "url=~user~0000", "b\u00e4r"]);
+  )js");
+  ASSERT_EQ("foo", mockFileSystem->lastWrittenFile);
+
+  mockFileSystem->contentToRead = mockFileSystem->lastWrittenContent;
+  jsEngine.Evaluate("let error; IO.copyFile('foo', 'bar').catch(e => error = e)");
+  ASSERT_TRUE(jsEngine.Evaluate("error").IsUndefined());
+  ASSERT_EQ("bar", mockFileSystem->lastWrittenFile);
+  const auto& content = mockFileSystem->lastWrittenContent;
+  ASSERT_TRUE(AdblockPlus::FilterStorageFile::IsStorageFile(content.data(), content.size()));
+
+  mockFileSystem->contentToRead = content;
+  jsEngine.Evaluate("let lines = []; IO.readFromFile('bar', line => lines.push(line))");
+  EXPECT_EQ("[Subscription]\nurl=~user~0000\nb\xc3\xa4r",
+            jsEngine.Evaluate("lines.join('\\n')").AsString());
+}
+
+namespace
+{
+  class FileSystemJsObject_JournalTest : public BaseJsTest
+  {
+  protected:
+    InMemoryFileSystem* fileSystem;
+    DelayedTimer::SharedTasks timerTasks;
+
+    void SetUp() override
+    {
+      ThrowingPlatformCreationParameters params;
+      params.fileSystem.reset(fileSystem = new InMemoryFileSystem());
+      params.timer = DelayedTimer::New(timerTasks);
+      platform = AdblockPlus::PlatformFactory::CreatePlatform(std::move(params));
+      GetJsEngine().Evaluate("let lines, error");
+    }
+
+    void WriteLines(const std::string& fileName, const std::string& lines)
+    {
+      GetJsEngine().Evaluate("error = true; _fileSystem.writeLines('" + fileName + "', " +
+                             lines + ", e => error = e)");
+      ASSERT_TRUE(GetJsEngine().Evaluate("error").IsUndefined());
+    }
+
+    std::string ReadLines(const std::string& fileName)
+    {
+      GetJsEngine().Evaluate("lines = []; _fileSystem.readFromFile('" + fileName +
+                             "', line => lines.push(line), () => {}, e => lines.push(e))");
+      return GetJsEngine().Evaluate("lines.join(' ')").AsString();
+    }
+
+    bool Exists(const std::string& fileName)
+    {
+      bool exists = false;
+      fileSystem->Stat(fileName,
+                       [&exists](const IFileSystem::StatResult& result, const std::string&) {
+                         exists = result.exists;
+                       });
+      return exists;
+    }
+
+    void EvaluateIO()
+    {
+      for (int i = 0; !jsSources[i].empty(); i += 2)
+      {
+        if (jsSources[i] == "compat.js" || jsSources[i] == "io.js")
+          GetJsEngine().Evaluate(jsSources[i + 1], jsSources[i]);
+      }
+    }
+  };
+}
+
+TEST_F(FileSystemJsObject_JournalTest, ChangesAreWrittenToJournal)
+{
+  WriteLines("foo", "['[Subscription]', 'url=~user~0000', '[Subscription filters]', 'bar']");
+  EXPECT_TRUE(Exists("foo"));
+  EXPECT_FALSE(Exists("foo.journal"));
+
+  WriteLines("foo", "['[Subscription]', 'url=~user~0000', '[Subscription filters]', 'baz']");
+  EXPECT_TRUE(Exists("foo.journal"));
+  EXPECT_EQ("[Subscription] url=~user~0000 [Subscription filters] baz", ReadLines("foo"));
+
+  // Changes can be written after reading the file and its journal.
+  WriteLines("foo", "['[Subscription]', 'url=~user~0000']");
+  EXPECT_EQ("[Subscription] url=~user~0000", ReadLines("foo"));
+
+  GetJsEngine().Evaluate("error = true; _fileSystem.compactLines('foo', e => error = e)");
+  EXPECT_TRUE(GetJsEngine().Evaluate("error").IsUndefined());
+  EXPECT_FALSE(Exists("foo.journal"));
+  EXPECT_EQ("[Subscription] url=~user~0000", ReadLines("foo"));
+}
+
+TEST_F(FileSystemJsObject_JournalTest, JournalIsMovedAndRemoved)
+{
+  WriteLines("foo", "['[Subscription]', 'url=~user~0000']");
+  WriteLines("foo", "['[Subscription]', 'url=~user~0001']");
+  GetJsEngine().Evaluate("error = true; _fileSystem.move('foo', 'bar', e => error = e)");
+  EXPECT_TRUE(GetJsEngine().Evaluate("error").IsUndefined());
+  EXPECT_FALSE(Exists("foo.journal"));
+  EXPECT_EQ("[Subscription] url=~user~0001", ReadLines("bar"));
+
+  GetJsEngine().Evaluate("error = true; _fileSystem.remove('bar', e => error = e)");
+  EXPECT_TRUE(GetJsEngine().Evaluate("error").IsUndefined());
+  EXPECT_FALSE(Exists("bar"));
+  EXPECT_FALSE(Exists("bar.journal"));
+}
+
+TEST_F(FileSystemJsObject_JournalTest, CompactLinesIllegalArguments)
+{
+  ASSERT_ANY_THROW(GetJsEngine().Evaluate("_fileSystem.compactLines()"));
+  ASSERT_ANY_THROW(GetJsEngine().Evaluate("_fileSystem.compactLines('foo', '')"));
+}
+
+TEST_F(FileSystemJsObject_JournalTest, IOCompactsJournalWhenIdle)
+{
+  EvaluateIO();
+  GetJsEngine().Evaluate(R"js(
+    let {IO} = require("io");
+    IO.writeToFile("foo", ["[Subscription]", "url=~user~0000"])
+      .then(() => IO.writeToFile("foo", ["[Subscription]", "url=~user~0001"]))
+      .then(() => IO.copyFile("foo", "bar"));
+  )js");
+  EXPECT_TRUE(Exists("foo.journal"));
+  EXPECT_EQ("[Subscription] url=~user~0001", ReadLines("bar"));
+
+  // Only the timer of the last write compacts the journal.
+  ASSERT_EQ(2u, timerTasks->size());
+  timerTasks->front().callback();
+  timerTasks->pop_front();
+  EXPECT_TRUE(Exists("foo.journal"));
+  timerTasks->front().callback();
+  timerTasks->pop_front();
+  EXPECT_FALSE(Exists("foo.journal"));
+  EXPECT_EQ("[Subscription] url=~user~0001", ReadLines("foo"));
+}
+
+TEST_F(FileSystemJsObject_JournalTest, ChangesDuringSlicedWriteAreSavedAgain)
+{
+  EvaluateIO();
+  GetJsEngine().SetTimeSlice(std::chrono::milliseconds(1));
+  GetJsEngine().Evaluate(R"js(
+    let {IO} = require("io");
+    let listeners = [];
+    require.scopes.filterNotifier = {filterNotifier: {
+      on(event, listener) { listeners.push(listener); }
+    }};
+    let filters = [];
+    for (let i = 0; i < 300; i++)
+      filters.push("filter" + i);
+    // Every hundred lines take longer than a slice.
+    function* exportData()
+    {
+      yield "[Subscription]";
+      yield "url=~user~0000";
+      for (let i = 0; i < filters.length; i++)
+      {
+        if (i % 100 == 0)
+          for (let end = Date.now() + 2; Date.now() < end;);
+        yield filters[i];
+      }
+    }
+    let saveCount = 0;
+    require.scopes.filterStorage = {filterStorage: {
+      saveToDisk() { saveCount++; return IO.writeToFile("foo", exportData()); }
+    }};
+    require("filterStorage").filterStorage.saveToDisk();
+  )js");
+  ASSERT_FALSE(Exists("foo"));
+
+  // The first filter was collected already.
+  GetJsEngine().Evaluate(R"js(
+    filters.shift();
+    filters.push("filter300");
+    for (let listener of listeners)
+      listener();
+  )js");
+  DelayedTimer::ProcessImmediateTimers(timerTasks);
+  EXPECT_EQ(2, GetJsEngine().Evaluate("saveCount").AsInt());
+  EXPECT_EQ(GetJsEngine().Evaluate("Array.from(exportData()).join(' ')").AsString(),
+            ReadLines("foo"));
+}
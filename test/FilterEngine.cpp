@@ -15,9 +15,13 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
 #include <condition_variable>
+#include <future>
+#include <mutex>
 #include <thread>
 
+#include "../src/JsContext.h"
 #include "FilterEngineTest.h"
 
 using namespace AdblockPlus;
@@ -449,6 +453,138 @@ TEST_F(FilterEngineTest, Matches)
   ASSERT_EQ(AdblockPlus::Filter::Type::TYPE_BLOCKING, match12.GetType());
 }
 
+TEST_F(FilterEngineTest, MatchesBatch)
+{
+  auto& filterEngine = GetFilterEngine();
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  filterEngine.AddFilter(filterEngine.GetFilter("@@notbanner.gif"));
+  filterEngine.AddFilter(filterEngine.GetFilter("tpbanner.gif$third-party"));
+  filterEngine.AddFilter(filterEngine.GetFilter("combanner.gif$domain=example.com"));
+  filterEngine.AddFilter(filterEngine.GetFilter("||example.org/generic$image"));
+  filterEngine.AddFilter(filterEngine.GetFilter("||example.org/specific$image,domain=example.com"));
+
+  std::vector<AdblockPlus::IFilterEngine::MatchRequest> requests = {
+      {"http://example.org/foobar.gif",
+       AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE,
+       "",
+       "",
+       false},
+      {"http://example.org/adbanner.gif",
+       AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE,
+       "",
+       "",
+       false},
+      {"http://example.org/notbanner.gif",
+       AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE,
+       "",
+       "",
+       false},
+      {"http://example.org/tpbanner.gif",
+       AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE,
+       "http://example.org/",
+       "",
+       false},
+      {"http://example.org/tpbanner.gif",
+       AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE,
+       "http://example.com/",
+       "",
+       false},
+      {"http://example.org/combanner.gif",
+       AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE,
+       "http://example.com/",
+       "",
+       false},
+      {"http://example.org/generic", AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE, "", "", true},
+      {"http://example.org/specific",
+       AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE,
+       "http://example.com/",
+       "",
+       true},
+      {"", AdblockPlus::IFilterEngine::CONTENT_TYPE_IMAGE, "", "", false}};
+
+  auto results = filterEngine.MatchesBatch(requests);
+  ASSERT_EQ(requests.size(), results.size());
+
+  EXPECT_EQ("", results[0].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_INVALID, results[0].type);
+  EXPECT_EQ("adbanner.gif", results[1].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_BLOCKING, results[1].type);
+  EXPECT_EQ("@@notbanner.gif", results[2].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_EXCEPTION, results[2].type);
+  EXPECT_EQ("", results[3].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_INVALID, results[3].type);
+  EXPECT_EQ("tpbanner.gif$third-party", results[4].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_BLOCKING, results[4].type);
+  EXPECT_EQ("combanner.gif$domain=example.com", results[5].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_BLOCKING, results[5].type);
+  EXPECT_EQ("", results[6].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_INVALID, results[6].type);
+  EXPECT_EQ("||example.org/specific$image,domain=example.com", results[7].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_BLOCKING, results[7].type);
+  EXPECT_EQ("", results[8].filterText);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_INVALID, results[8].type);
+
+  // The results have to be the same as for separate calls.
+  for (size_t i = 0; i < requests.size(); ++i)
+  {
+    auto match = filterEngine.Matches(requests[i].url,
+                                      requests[i].contentTypeMask,
+                                      requests[i].documentUrl,
+                                      requests[i].siteKey,
+                                      requests[i].specificOnly);
+    EXPECT_EQ(match.IsValid() ? match.GetRaw() : "", results[i].filterText);
+  }
+
+  EXPECT_TRUE(filterEngine.MatchesBatch({}).empty());
+}
+
+TEST_F(FilterEngineTest, MatchesAsync)
+{
+  auto& filterEngine = GetFilterEngine();
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  const IFilterEngine::MatchRequest request = {
+      "http://example.org/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE, "", "", false};
+
+  std::mutex mutex;
+  std::condition_variable resultsChanged;
+  std::vector<std::string> results;
+  auto callback = [&](const AdblockPlus::IFilterEngine::MatchResult& result) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      results.push_back(result.filterText);
+    }
+    resultsChanged.notify_all();
+  };
+  auto waitForResults = [&](size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return resultsChanged.wait_for(
+        lock, std::chrono::seconds(10), [&]() { return results.size() >= count; });
+  };
+
+  filterEngine.MatchesAsync(request, callback);
+  ASSERT_TRUE(waitForResults(1));
+  EXPECT_EQ("adbanner.gif", results[0]);
+
+  {
+    // While JavaScript is busy the fallback is used once the timeout has
+    // elapsed, the other callers keep waiting.
+    auto& jsEngine = GetJsEngine();
+    const AdblockPlus::JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    filterEngine.MatchesAsync(request, callback, std::chrono::hours(1));
+    filterEngine.MatchesAsync(request, callback);
+    filterEngine.MatchesAsync(
+        request,
+        callback,
+        std::chrono::milliseconds(10),
+        {"fallback", AdblockPlus::Filter::Type::TYPE_EXCEPTION});
+    ASSERT_TRUE(waitForResults(2));
+    EXPECT_EQ("fallback", results[1]);
+  }
+  ASSERT_TRUE(waitForResults(4));
+  EXPECT_EQ("adbanner.gif", results[2]);
+  EXPECT_EQ("adbanner.gif", results[3]);
+}
+
 TEST_F(FilterEngineTest, GenericblockHierarchy)
 {
   auto& filterEngine = GetFilterEngine();
@@ -961,6 +1097,135 @@ TEST_F(FilterEngineTest, DocumentAllowlisting)
        "http://testpages.adblockplus.org/en/exceptions/document"}));
 }
 
+TEST_F(FilterEngineTest, ShouldBlockRequest)
+{
+  auto& filterEngine = GetFilterEngine();
+  filterEngine.AddFilter(filterEngine.GetFilter("/testcasefiles/genericblock/target-generic.jpg"));
+  filterEngine.AddFilter(filterEngine.GetFilter(
+      "/testcasefiles/genericblock/target-notgeneric.jpg$domain=testpages.adblockplus.org"));
+  filterEngine.AddFilter(filterEngine.GetFilter(
+      "@@||testpages.adblockplus.org/en/exceptions/genericblock$genericblock"));
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  filterEngine.AddFilter(filterEngine.GetFilter("@@notbanner.gif"));
+  filterEngine.AddFilter(filterEngine.GetFilter("@@||example.org^$document"));
+
+  auto decision = filterEngine.ShouldBlockRequest(
+      "http://example.com/foobar.gif", IFilterEngine::CONTENT_TYPE_IMAGE, {"http://example.com/"});
+  EXPECT_FALSE(decision.shouldBlock);
+  EXPECT_FALSE(decision.filter.IsValid());
+
+  decision = filterEngine.ShouldBlockRequest("http://example.com/adbanner.gif",
+                                             IFilterEngine::CONTENT_TYPE_IMAGE,
+                                             {"http://example.com/"});
+  EXPECT_TRUE(decision.shouldBlock);
+  EXPECT_EQ("adbanner.gif", decision.filter.GetRaw());
+
+  decision = filterEngine.ShouldBlockRequest(
+      "http://example.com/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE, {});
+  EXPECT_TRUE(decision.shouldBlock);
+  EXPECT_EQ("adbanner.gif", decision.filter.GetRaw());
+
+  decision = filterEngine.ShouldBlockRequest("http://example.com/notbanner.gif",
+                                             IFilterEngine::CONTENT_TYPE_IMAGE,
+                                             {"http://example.com/"});
+  EXPECT_FALSE(decision.shouldBlock);
+  EXPECT_EQ("@@notbanner.gif", decision.filter.GetRaw());
+
+  // The whole document is allowlisted.
+  decision =
+      filterEngine.ShouldBlockRequest("http://example.com/adbanner.gif",
+                                      IFilterEngine::CONTENT_TYPE_IMAGE,
+                                      {"http://example.com/frame.html", "http://example.org/"});
+  EXPECT_FALSE(decision.shouldBlock);
+  EXPECT_EQ("@@||example.org^$document", decision.filter.GetRaw());
+
+  // Generic blocking filters don't apply.
+  const std::vector<std::string> documentUrls = {
+      "http://testpages.adblockplus.org/testcasefiles/genericblock/frame.html",
+      "http://testpages.adblockplus.org/en/exceptions/genericblock/"};
+  decision = filterEngine.ShouldBlockRequest(
+      "http://testpages.adblockplus.org/testcasefiles/genericblock/target-generic.jpg",
+      IFilterEngine::CONTENT_TYPE_IMAGE,
+      documentUrls);
+  EXPECT_FALSE(decision.shouldBlock);
+  EXPECT_FALSE(decision.filter.IsValid());
+
+  decision = filterEngine.ShouldBlockRequest(
+      "http://testpages.adblockplus.org/testcasefiles/genericblock/target-notgeneric.jpg",
+      IFilterEngine::CONTENT_TYPE_IMAGE,
+      documentUrls);
+  EXPECT_TRUE(decision.shouldBlock);
+  EXPECT_EQ(AdblockPlus::Filter::Type::TYPE_BLOCKING, decision.filter.GetType());
+
+  decision = filterEngine.ShouldBlockRequest("", IFilterEngine::CONTENT_TYPE_IMAGE, documentUrls);
+  EXPECT_FALSE(decision.shouldBlock);
+  EXPECT_FALSE(decision.filter.IsValid());
+}
+
+TEST_F(FilterEngineTest, FrameContext)
+{
+  auto& filterEngine = GetFilterEngine();
+  filterEngine.AddFilter(filterEngine.GetFilter("/testcasefiles/genericblock/target-generic.jpg"));
+  filterEngine.AddFilter(filterEngine.GetFilter(
+      "/testcasefiles/genericblock/target-notgeneric.jpg$domain=testpages.adblockplus.org"));
+  filterEngine.AddFilter(filterEngine.GetFilter(
+      "@@||testpages.adblockplus.org/en/exceptions/genericblock$genericblock"));
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  filterEngine.AddFilter(filterEngine.GetFilter("##.generic"));
+  filterEngine.AddFilter(filterEngine.GetFilter("example.com##.specific"));
+  filterEngine.AddFilter(filterEngine.GetFilter("example.com#?#div:-abp-properties(width: 213px)"));
+
+  FrameContext frame({"http://example.com/frame.html", "http://example.org/"});
+  EXPECT_EQ("http://example.com/frame.html", frame.GetDocumentUrl());
+  EXPECT_FALSE(filterEngine.IsContentAllowlisted(IFilterEngine::CONTENT_TYPE_DOCUMENT, frame));
+  EXPECT_TRUE(filterEngine
+                  .ShouldBlockRequest(
+                      "http://example.com/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE, frame)
+                  .shouldBlock);
+  EXPECT_NE(std::string::npos, filterEngine.GetElementHidingStyleSheet(frame).find(".generic"));
+  EXPECT_NE(std::string::npos, filterEngine.GetElementHidingStyleSheet(frame).find(".specific"));
+  EXPECT_EQ(1u, filterEngine.GetElementHidingEmulationSelectors(frame).size());
+
+  // Remembered answers are discarded when filters change.
+  filterEngine.AddFilter(filterEngine.GetFilter("@@||example.org^$document,elemhide"));
+  EXPECT_TRUE(filterEngine.IsContentAllowlisted(IFilterEngine::CONTENT_TYPE_DOCUMENT, frame));
+  auto decision = filterEngine.ShouldBlockRequest(
+      "http://example.com/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE, frame);
+  EXPECT_FALSE(decision.shouldBlock);
+  EXPECT_EQ("@@||example.org^$document,elemhide", decision.filter.GetRaw());
+  EXPECT_EQ("", filterEngine.GetElementHidingStyleSheet(frame));
+  EXPECT_TRUE(filterEngine.GetElementHidingEmulationSelectors(frame).empty());
+  // Matches doesn't take document allowlisting into account.
+  auto filter = filterEngine.Matches(
+      "http://example.com/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE, frame);
+  EXPECT_EQ("adbanner.gif", filter.GetRaw());
+
+  FrameContext genericblockFrame(
+      {"http://testpages.adblockplus.org/testcasefiles/genericblock/frame.html",
+       "http://testpages.adblockplus.org/en/exceptions/genericblock/"});
+  EXPECT_TRUE(filterEngine.IsContentAllowlisted(IFilterEngine::CONTENT_TYPE_GENERICBLOCK,
+                                                genericblockFrame));
+  EXPECT_FALSE(filterEngine
+                   .Matches("http://testpages.adblockplus.org/testcasefiles/genericblock/"
+                            "target-generic.jpg",
+                            IFilterEngine::CONTENT_TYPE_IMAGE,
+                            genericblockFrame)
+                   .IsValid());
+  EXPECT_TRUE(filterEngine
+                  .Matches("http://testpages.adblockplus.org/testcasefiles/genericblock/"
+                           "target-notgeneric.jpg",
+                           IFilterEngine::CONTENT_TYPE_IMAGE,
+                           genericblockFrame)
+                  .IsValid());
+
+  FrameContext generichideFrame({"http://example.net/"});
+  filterEngine.AddFilter(filterEngine.GetFilter("@@||example.net^$generichide"));
+  filterEngine.AddFilter(filterEngine.GetFilter("example.net##.specific"));
+  auto styleSheet = filterEngine.GetElementHidingStyleSheet(generichideFrame);
+  EXPECT_EQ(std::string::npos, styleSheet.find(".generic"));
+  EXPECT_NE(std::string::npos, styleSheet.find(".specific"));
+}
+
 TEST_F(FilterEngineTest, ElemhideAllowlisting)
 {
   auto& filterEngine = GetFilterEngine();
@@ -1628,6 +1893,201 @@ TEST_F(FilterEngineWithInMemoryFS, DisableSubscriptionsAutoSelectOnFirstRun)
   EXPECT_FALSE(filterEngine.IsAAEnabled());
 }
 
+TEST_F(FilterEngineWithInMemoryFS, MatchCacheIsDisabledByDefault)
+{
+  InitPlatformAndAppInfo();
+  auto& filterEngine = CreateFilterEngine();
+  filterEngine.Matches(
+      "http://example.org/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE, "http://example.com/");
+  auto stats = filterEngine.GetMatchCacheStats();
+  EXPECT_EQ(0u, stats.hits);
+  EXPECT_EQ(0u, stats.misses);
+  EXPECT_EQ(0u, stats.size);
+  EXPECT_EQ(0u, stats.capacity);
+}
+
+TEST_F(FilterEngineWithInMemoryFS, MatchCache)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.matchCacheSize = 2;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+
+  const std::string url = "http://example.org/adbanner.gif";
+  auto filter = filterEngine.Matches(url, IFilterEngine::CONTENT_TYPE_IMAGE, "http://example.com/");
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_EQ("adbanner.gif", filter.GetRaw());
+  // Same document host, so it's served from the cache.
+  filter = filterEngine.Matches(url, IFilterEngine::CONTENT_TYPE_IMAGE, "http://example.com/foo");
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_EQ("adbanner.gif", filter.GetRaw());
+  auto stats = filterEngine.GetMatchCacheStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(1u, stats.size);
+  EXPECT_EQ(2u, stats.capacity);
+
+  // Any other parameter is a different request.
+  EXPECT_TRUE(filterEngine.Matches(url, IFilterEngine::CONTENT_TYPE_SCRIPT, "http://example.com/")
+                  .IsValid());
+  EXPECT_TRUE(filterEngine.Matches(url, IFilterEngine::CONTENT_TYPE_IMAGE, "http://example.net/")
+                  .IsValid());
+  stats = filterEngine.GetMatchCacheStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(3u, stats.misses);
+  EXPECT_EQ(2u, stats.size);
+
+  // The least recently used entry has been evicted.
+  EXPECT_TRUE(filterEngine.Matches(url, IFilterEngine::CONTENT_TYPE_IMAGE, "http://example.com/")
+                  .IsValid());
+  stats = filterEngine.GetMatchCacheStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(4u, stats.misses);
+  EXPECT_EQ(2u, stats.size);
+
+  // Changing the filters drops the cached results.
+  filterEngine.AddFilter(filterEngine.GetFilter("@@||example.org^$image"));
+  stats = filterEngine.GetMatchCacheStats();
+  EXPECT_EQ(0u, stats.size);
+  filter = filterEngine.Matches(url, IFilterEngine::CONTENT_TYPE_IMAGE, "http://example.com/");
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_EQ("@@||example.org^$image", filter.GetRaw());
+  stats = filterEngine.GetMatchCacheStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(5u, stats.misses);
+
+  filterEngine.RemoveFilter(filterEngine.GetFilter("@@||example.org^$image"));
+  filterEngine.RemoveFilter(filterEngine.GetFilter("adbanner.gif"));
+  EXPECT_FALSE(filterEngine.Matches(url, IFilterEngine::CONTENT_TYPE_IMAGE, "http://example.com/")
+                   .IsValid());
+}
+
+TEST_F(FilterEngineWithInMemoryFS, Replicas)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.replicaCount = 2;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  filterEngine.AddFilter(filterEngine.GetFilter("example.org##.ad"));
+
+  const std::string url = "http://example.org/adbanner.gif";
+  const std::string documentUrl = "http://example.org/";
+  const auto image = IFilterEngine::CONTENT_TYPE_IMAGE;
+  // Every replica has the filters of the filter engine.
+  std::vector<std::thread> threads;
+  std::atomic<int> matches(0);
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 10; ++j)
+      {
+        if (filterEngine.Matches(url, image, documentUrl).IsValid())
+          ++matches;
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(40, matches);
+
+  FrameContext frame({documentUrl});
+  auto filter = filterEngine.Matches(url, image, frame);
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_EQ("adbanner.gif", filter.GetRaw());
+  EXPECT_TRUE(filterEngine.ShouldBlockRequest(url, image, {documentUrl}).shouldBlock);
+  EXPECT_EQ(".ad {display: none !important;}\n",
+            filterEngine.GetElementHidingStyleSheet("example.org"));
+
+  // Filters returned by the replicas can be passed back.
+  filterEngine.RemoveFilter(filter);
+  EXPECT_FALSE(filterEngine.Matches(url, image, documentUrl).IsValid());
+  EXPECT_FALSE(filterEngine.Matches(url, image, frame).IsValid());
+  EXPECT_EQ(1u, filterEngine.GetListedFilters().size());
+
+  filterEngine.AddFilter(filterEngine.GetFilter("@@||example.org^$elemhide"));
+  EXPECT_TRUE(filterEngine.IsContentAllowlisted(
+      documentUrl, IFilterEngine::CONTENT_TYPE_ELEMHIDE, {documentUrl}));
+  EXPECT_TRUE(filterEngine.IsContentAllowlisted(IFilterEngine::CONTENT_TYPE_ELEMHIDE, frame));
+}
+
+TEST_F(FilterEngineWithInMemoryFS, CallsOvertakeQueuedBackgroundTasks)
+{
+  AdblockPlus::PlatformFactory::CreationParameters params;
+  params.useJsEventLoop = true;
+  InitPlatformAndAppInfo(std::move(params));
+  auto& filterEngine = CreateFilterEngine();
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  auto& jsEngine = GetJsEngine();
+
+  // Background tasks like reading a filter list hold the JavaScript lock
+  // while they run.
+  std::promise<void> unblock;
+  auto blocker = unblock.get_future().share();
+  jsEngine.Post(JsEventLoop::Priority::BACKGROUND, [&jsEngine, blocker] {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    blocker.wait();
+  });
+  std::promise<void> callFinished;
+  auto callFinishedFuture = callFinished.get_future();
+  std::promise<bool> overtaken;
+  jsEngine.Post(JsEventLoop::Priority::BACKGROUND, [&jsEngine, &callFinishedFuture, &overtaken] {
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    overtaken.set_value(callFinishedFuture.wait_for(std::chrono::seconds(10)) ==
+                        std::future_status::ready);
+  });
+
+  FrameContext frame({"http://example.org/"});
+  Filter filter;
+  std::thread caller([&] {
+    filter = filterEngine.Matches(
+        "http://example.org/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE, frame);
+    callFinished.set_value();
+  });
+  // Gives the call the time to be queued behind the blocking task.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  unblock.set_value();
+  caller.join();
+
+  EXPECT_TRUE(overtaken.get_future().get());
+  ASSERT_TRUE(filter.IsValid());
+  EXPECT_EQ("adbanner.gif", filter.GetRaw());
+}
+
+TEST_F(FilterEngineWithInMemoryFS, ReplicasCopySubscriptionChangesInBackground)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.replicaCount = 2;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  auto filter = filterEngine.GetFilter("adbanner.gif");
+  filterEngine.AddFilter(filter);
+
+  const std::string url = "http://example.org/adbanner.gif";
+  const std::string documentUrl = "http://example.org/";
+  const auto image = IFilterEngine::CONTENT_TYPE_IMAGE;
+  EXPECT_TRUE(filterEngine.Matches(url, image, documentUrl).IsValid());
+
+  // Disabling a subscription isn't forwarded, the replicas copy the filters
+  // eventually and keep matching meanwhile.
+  auto subscriptions = filterEngine.GetSubscriptionsFromFilter(filter);
+  ASSERT_EQ(1u, subscriptions.size());
+  subscriptions[0].SetDisabled(true);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  bool matches = true;
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    matches = false;
+    for (int i = 0; i < 4; ++i)
+      matches = filterEngine.Matches(url, image, documentUrl).IsValid() || matches;
+    if (!matches)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_FALSE(matches);
+}
+
 namespace AA_ApiTest
 {
   const std::string kOtherSubscriptionUrl = "https://non-existing-subscription.txt";
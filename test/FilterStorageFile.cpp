@@ -0,0 +1,135 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../src/FilterStorageFile.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  struct Line
+  {
+    std::string text;
+    bool isAscii;
+
+    bool operator==(const Line& other) const
+    {
+      return text == other.text && isAscii == other.isAscii;
+    }
+  };
+
+  IFileSystem::IOBuffer Write(const std::vector<std::string>& lines)
+  {
+    FilterStorageFile::Writer writer;
+    for (const auto& line : lines)
+      writer.AddLine(reinterpret_cast<const uint8_t*>(line.data()), line.size());
+    return writer.Finish();
+  }
+
+  std::vector<Line> Read(const IFileSystem::IOBuffer& data)
+  {
+    FilterStorageFile::Reader reader(data.data(), data.size());
+    std::vector<Line> lines;
+    const uint8_t* line;
+    size_t size;
+    bool isAscii;
+    while (reader.Next(&line, &size, &isAscii))
+      lines.push_back({std::string(reinterpret_cast<const char*>(line), size), isAscii});
+    return lines;
+  }
+
+  void ReadAll(const IFileSystem::IOBuffer& data)
+  {
+    Read(data);
+  }
+}
+
+TEST(FilterStorageFileTest, ReadsWrittenLines)
+{
+  auto data = Write({"# Adblock Plus preferences",
+                     "version=5",
+                     "",
+                     "[Subscription]",
+                     "url=~user~0000",
+                     "",
+                     "[Subscription filters]",
+                     "||example.com^",
+                     "example.com##.b\xc3\xa4nner",
+                     "[Subscription]",
+                     "url=https://easylist.example/easylist.txt"});
+  EXPECT_TRUE(FilterStorageFile::IsStorageFile(data.data(), data.size()));
+
+  // Sections containing a non-ASCII line are marked as such, empty lines are
+  // skipped.
+  std::vector<Line> expected = {{"# Adblock Plus preferences", true},
+                                {"version=5", true},
+                                {"[Subscription]", true},
+                                {"url=~user~0000", true},
+                                {"[Subscription filters]", false},
+                                {"||example.com^", false},
+                                {"example.com##.b\xc3\xa4nner", false},
+                                {"[Subscription]", true},
+                                {"url=https://easylist.example/easylist.txt", true}};
+  EXPECT_EQ(expected, Read(data));
+}
+
+TEST(FilterStorageFileTest, ReadsEmptyFile)
+{
+  auto data = Write({});
+  EXPECT_TRUE(FilterStorageFile::IsStorageFile(data.data(), data.size()));
+  EXPECT_TRUE(Read(data).empty());
+}
+
+TEST(FilterStorageFileTest, TextIsNoStorageFile)
+{
+  std::string text = "# Adblock Plus preferences\nversion=5\n";
+  IFileSystem::IOBuffer data(text.begin(), text.end());
+  EXPECT_FALSE(FilterStorageFile::IsStorageFile(data.data(), data.size()));
+  EXPECT_THROW(ReadAll(data), std::runtime_error);
+}
+
+TEST(FilterStorageFileTest, RejectsOtherVersions)
+{
+  auto data = Write({"[Subscription]"});
+  data[7] = 2;
+  EXPECT_TRUE(FilterStorageFile::IsStorageFile(data.data(), data.size()));
+  EXPECT_THROW(ReadAll(data), std::runtime_error);
+}
+
+TEST(FilterStorageFileTest, RejectsDamagedFile)
+{
+  auto data = Write({"[Subscription]", "url=~user~0000", "[Subscription filters]", "foo"});
+  for (size_t size = 0; size < data.size(); ++size)
+  {
+    IFileSystem::IOBuffer truncated(data.begin(), data.begin() + size);
+    EXPECT_THROW(ReadAll(truncated), std::runtime_error) << "size " << size;
+  }
+  auto extended = data;
+  extended.push_back(0);
+  EXPECT_THROW(ReadAll(extended), std::runtime_error);
+
+  // First line length.
+  auto damaged = data;
+  damaged[24] = 200;
+  EXPECT_THROW(ReadAll(damaged), std::runtime_error);
+}
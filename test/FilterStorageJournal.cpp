@@ -0,0 +1,256 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../src/FilterStorageJournal.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  typedef std::vector<std::string> Lines;
+
+  std::vector<IFileSystem::IOBuffer> ToSections(const Lines& lines)
+  {
+    FilterStorageFile::Writer writer;
+    for (const auto& line : lines)
+      writer.AddLine(reinterpret_cast<const uint8_t*>(line.data()), line.size());
+    return writer.FinishSections();
+  }
+
+  Lines ToLines(const std::vector<FilterStorageFile::Section>& sections)
+  {
+    FilterStorageFile::Reader reader(sections);
+    Lines lines;
+    const uint8_t* line;
+    size_t size;
+    bool isAscii;
+    while (reader.Next(&line, &size, &isAscii))
+      lines.emplace_back(reinterpret_cast<const char*>(line), size);
+    return lines;
+  }
+
+  Lines Subscription(const std::string& url, size_t filterCount)
+  {
+    Lines lines = {"[Subscription]", "url=" + url, "[Subscription filters]"};
+    for (size_t i = 0; i < filterCount; ++i)
+      lines.push_back("||" + url + "/ad" + std::to_string(i) + "^");
+    return lines;
+  }
+
+  class FilterStorageJournalTest : public ::testing::Test
+  {
+  protected:
+    FilterStorageJournal journal;
+    IFileSystem::IOBuffer file;
+    IFileSystem::IOBuffer journalFile;
+
+    FilterStorageJournal::Action Save(const Lines& lines)
+    {
+      auto change = journal.Update("patterns.ini", ToSections(lines));
+      switch (change.action)
+      {
+      case FilterStorageJournal::Action::NONE:
+        break;
+      case FilterStorageJournal::Action::WRITE_FILE:
+        file = std::move(change.data);
+        journalFile.clear();
+        break;
+      case FilterStorageJournal::Action::WRITE_JOURNAL:
+        journalFile = std::move(change.data);
+        break;
+      case FilterStorageJournal::Action::APPEND_TO_JOURNAL:
+        journalFile.insert(journalFile.end(), change.data.begin(), change.data.end());
+        break;
+      }
+      return change.action;
+    }
+
+    Lines Load(FilterStorageJournal& otherJournal)
+    {
+      return ToLines(otherJournal.Load("patterns.ini", file.data(), file.size(), journalFile));
+    }
+
+    Lines Load()
+    {
+      FilterStorageJournal otherJournal;
+      return Load(otherJournal);
+    }
+  };
+}
+
+TEST_F(FilterStorageJournalTest, UnknownFileIsWritten)
+{
+  Lines lines = Subscription("easylist", 10);
+  EXPECT_EQ(FilterStorageJournal::Action::WRITE_FILE, Save(lines));
+  EXPECT_EQ(lines, Load());
+  EXPECT_EQ("patterns.ini.journal", FilterStorageJournal::GetFileName("patterns.ini"));
+}
+
+TEST_F(FilterStorageJournalTest, ChangesAreAppended)
+{
+  Lines easylist = Subscription("easylist", 1000);
+  Lines lines = easylist;
+  EXPECT_EQ(FilterStorageJournal::Action::WRITE_FILE, Save(lines));
+  EXPECT_FALSE(journal.HasJournal("patterns.ini"));
+
+  Lines custom = Subscription("~user~0000", 1);
+  lines.insert(lines.begin(), custom.begin(), custom.end());
+  EXPECT_EQ(FilterStorageJournal::Action::WRITE_JOURNAL, Save(lines));
+  EXPECT_TRUE(journal.HasJournal("patterns.ini"));
+  size_t firstRecordSize = journalFile.size();
+  EXPECT_LT(firstRecordSize, 200u);
+
+  lines.insert(lines.begin() + custom.size(), "||example.com^");
+  EXPECT_EQ(FilterStorageJournal::Action::APPEND_TO_JOURNAL, Save(lines));
+  EXPECT_LT(journalFile.size(), 2 * firstRecordSize);
+  EXPECT_EQ(FilterStorageJournal::Action::NONE, Save(lines));
+
+  // Sections which moved are kept as well.
+  lines = easylist;
+  lines.insert(lines.end(), custom.begin(), custom.end());
+  lines.push_back("||example.com^");
+  EXPECT_EQ(FilterStorageJournal::Action::APPEND_TO_JOURNAL, Save(lines));
+
+  // The content is restored from the file and the journal, and changes can
+  // be recorded after loading.
+  FilterStorageJournal loadedJournal;
+  EXPECT_EQ(lines, Load(loadedJournal));
+  EXPECT_TRUE(loadedJournal.HasJournal("patterns.ini"));
+  lines.pop_back();
+  auto change = loadedJournal.Update("patterns.ini", ToSections(lines));
+  EXPECT_EQ(FilterStorageJournal::Action::APPEND_TO_JOURNAL, change.action);
+  journalFile.insert(journalFile.end(), change.data.begin(), change.data.end());
+  EXPECT_EQ(lines, Load());
+}
+
+TEST_F(FilterStorageJournalTest, LargeChangesAreWrittenToFile)
+{
+  Lines lines = Subscription("easylist", 10);
+  Save(lines);
+  lines = Subscription("easylist", 5000);
+  EXPECT_EQ(FilterStorageJournal::Action::WRITE_FILE, Save(lines));
+  EXPECT_EQ(lines, Load());
+
+  // Small changes are journaled until the journal reaches its limit.
+  int journaledCount = 0;
+  for (int i = 0; Save(lines) != FilterStorageJournal::Action::WRITE_FILE; ++i)
+  {
+    for (int j = 0; j < 20; ++j)
+    {
+      lines.push_back("[Filter]");
+      lines.push_back("text=||example.com/" + std::to_string(i) + "/" + std::to_string(j) + "^");
+      lines.push_back("hitCount=1");
+    }
+    ++journaledCount;
+  }
+  EXPECT_GT(journaledCount, 10);
+  EXPECT_TRUE(journalFile.empty());
+  EXPECT_FALSE(journal.HasJournal("patterns.ini"));
+  EXPECT_EQ(lines, Load());
+}
+
+TEST_F(FilterStorageJournalTest, DamagedRecordsAreIgnored)
+{
+  Lines first = Subscription("easylist", 100);
+  Save(first);
+  Lines second = first;
+  second.push_back("[Subscription]");
+  second.push_back("url=~user~0000");
+  Save(second);
+  size_t firstRecordEnd = journalFile.size();
+  Lines third = second;
+  third.push_back("[Subscription filters]");
+  third.push_back("||example.com^");
+  Save(third);
+  auto fullJournal = journalFile;
+
+  // A record written only partly.
+  for (size_t size = firstRecordEnd; size < fullJournal.size(); ++size)
+  {
+    journalFile.assign(fullJournal.begin(), fullJournal.begin() + size);
+    EXPECT_EQ(second, Load());
+  }
+
+  // A damaged record.
+  journalFile = fullJournal;
+  journalFile[firstRecordEnd - 1] ^= 1;
+  EXPECT_EQ(first, Load());
+
+  // A damaged journal has to be replaced.
+  FilterStorageJournal loadedJournal;
+  EXPECT_EQ(first, Load(loadedJournal));
+  EXPECT_TRUE(loadedJournal.HasJournal("patterns.ini"));
+  EXPECT_EQ(FilterStorageJournal::Action::WRITE_FILE,
+            loadedJournal.Update("patterns.ini", ToSections(third)).action);
+}
+
+TEST_F(FilterStorageJournalTest, JournalOfOtherContentIsIgnored)
+{
+  Lines lines = Subscription("easylist", 100);
+  Save(lines);
+  lines.push_back("[Subscription]");
+  Save(lines);
+
+  // E.g. the file was written but the journal couldn't be removed.
+  journal.Forget("patterns.ini");
+  auto journalOfOtherContent = journalFile;
+  Lines otherLines = Subscription("other", 100);
+  EXPECT_EQ(FilterStorageJournal::Action::WRITE_FILE, Save(otherLines));
+  journalFile = journalOfOtherContent;
+  FilterStorageJournal loadedJournal;
+  EXPECT_EQ(otherLines, Load(loadedJournal));
+  EXPECT_TRUE(loadedJournal.HasJournal("patterns.ini"));
+
+  loadedJournal.Compacted("patterns.ini", file.size());
+  EXPECT_FALSE(loadedJournal.HasJournal("patterns.ini"));
+}
+
+TEST_F(FilterStorageJournalTest, DamagedFileIsReported)
+{
+  Save(Subscription("easylist", 10));
+  file.pop_back();
+  EXPECT_THROW(Load(), std::runtime_error);
+}
+
+// The file system calls back on its own threads, e.g. for different files.
+TEST_F(FilterStorageJournalTest, FilesAreUpdatedConcurrently)
+{
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.emplace_back([this, i] {
+      const std::string fileName = "file" + std::to_string(i);
+      for (int j = 0; j < 50; ++j)
+      {
+        journal.Update(fileName, ToSections(Subscription("example.com", j)));
+        journal.HasJournal(fileName);
+      }
+      journal.Compacted(fileName, 0);
+      journal.Forget(fileName);
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  for (int i = 0; i < 4; ++i)
+    EXPECT_FALSE(journal.HasJournal("file" + std::to_string(i)));
+}
@@ -119,6 +119,11 @@ protected:
   std::map<std::string, CallStats> stats;
 
   void SetUp() override
+  {
+    StartFilterEngine(AdblockPlus::PlatformFactory::CreationParameters());
+  }
+
+  void StartFilterEngine(AdblockPlus::PlatformFactory::CreationParameters&& params)
   {
     AdblockPlus::AppInfo appInfo;
     appInfo.version = "1.0";
@@ -127,7 +132,6 @@ protected:
     appInfo.applicationVersion = "1.0";
     appInfo.locale = "en-US";
 
-    AdblockPlus::PlatformFactory::CreationParameters params;
     params.executor = AdblockPlus::PlatformFactory::CreateExecutor();
     params.fileSystem.reset(new ReadOnlyFileSystem(*params.executor, "data"));
     params.webRequest.reset(new NoopWebRequest());
@@ -135,12 +139,18 @@ protected:
     AdblockPlus::FilterEngineFactory::CreationParameters engineParams;
     engineParams.preconfiguredPrefs.booleanPrefs
         [AdblockPlus::FilterEngineFactory::BooleanPrefName::FirstRunSubscriptionAutoselect] = false;
+    ConfigureFilterEngine(engineParams);
 
     platform = AdblockPlus::PlatformFactory::CreatePlatform(std::move(params));
     platform->SetUp(appInfo);
     platform->CreateFilterEngineAsync(engineParams);
   }
 
+  virtual void
+  ConfigureFilterEngine(AdblockPlus::FilterEngineFactory::CreationParameters& engineParams)
+  {
+  }
+
   AdblockPlus::JsEngine& GetJsEngine()
   {
     return static_cast<AdblockPlus::DefaultPlatform*>(platform.get())->GetJsEngine();
@@ -171,7 +181,10 @@ protected:
     std::string fn = callInfo.GetProperty("_fn").AsString();
 
     if (fn == "check-filter-match")
+    {
       stats[fn].Add(CheckFilterMatch(callInfo));
+      stats["should-block-request"].Add(ShouldBlockRequest(callInfo));
+    }
     else if (fn == "block-popup")
       stats[fn].Add(BlockPopup(callInfo));
     else if (fn == "generate-js-css")
@@ -293,6 +306,82 @@ protected:
     return lasted;
   }
 
+  // Same as CheckFilterMatch but makes the decision in a single call.
+  double ShouldBlockRequest(const AdblockPlus::JsValue& info) const
+  {
+    auto& engine = GetFilterEngine();
+    auto url = info.GetProperty("request_url").AsString();
+    auto documentUrls = ToList(info.GetProperty("referrers"));
+    auto sitekey = info.GetProperty("sitekey").AsString();
+    AdblockPlus::IFilterEngine::ContentType contentTypeMask =
+        static_cast<AdblockPlus::IFilterEngine::ContentType>(
+            info.GetProperty("adblock_resource_type").AsInt());
+    bool decision = false;
+    double lasted = 0;
+
+    {
+      ElapsedTime timer;
+      decision = engine.ShouldBlockRequest(url, contentTypeMask, documentUrls, sitekey).shouldBlock;
+      lasted = timer.Microseconds();
+    }
+
+    EXPECT_EQ(info.GetProperty("_res").AsInt(), decision);
+    return lasted;
+  }
+
+  void MatchAllSites()
+  {
+    MatchFromFile("data/rec_abudhabi_dubizzle_com.log");
+    MatchFromFile("data/rec_allegro_pl.log");
+    MatchFromFile("data/rec_chron_com.log");
+    MatchFromFile("data/rec_cn_hao123_com.log");
+    MatchFromFile("data/rec_en_wikipedia_org.log");
+    MatchFromFile("data/rec_laodong_vn.log");
+    MatchFromFile("data/rec_news_mail_ru.log");
+    MatchFromFile("data/rec_search_yahoo_com.log");
+    MatchFromFile("data/rec_shopee_vn.log");
+    MatchFromFile("data/rec_shortorial_com.log");
+    MatchFromFile("data/rec_thethao247_vn.log");
+    MatchFromFile("data/rec_vk_com.log");
+    MatchFromFile("data/rec_vnexpress_net.log");
+    MatchFromFile("data/rec_vtv_vn.log");
+    MatchFromFile("data/rec_web_de.log");
+    MatchFromFile("data/rec_www_1tv_ge.log");
+    MatchFromFile("data/rec_www_24h_com_vn.log");
+    MatchFromFile("data/rec_www_amazon_com.log");
+    MatchFromFile("data/rec_www_aparat_com.log");
+    MatchFromFile("data/rec_www_baidu_com.log");
+    MatchFromFile("data/rec_www_bbc_com.log");
+    MatchFromFile("data/rec_www_bedienungsanleitu_ng.log");
+    MatchFromFile("data/rec_www_bing_com.log");
+    MatchFromFile("data/rec_www_boston_com.log");
+    MatchFromFile("data/rec_www_dailymail_co_uk.log");
+    MatchFromFile("data/rec_www_ebay_com.log");
+    MatchFromFile("data/rec_www_flipkart_com.log");
+    MatchFromFile("data/rec_www_forbes_com.log");
+    MatchFromFile("data/rec_www_google_com.log");
+    MatchFromFile("data/rec_www_imdb_com.log");
+    MatchFromFile("data/rec_www_indiatimes_com.log");
+    MatchFromFile("data/rec_www_libero_it.log");
+    MatchFromFile("data/rec_www_manoramaonline_com.log");
+    MatchFromFile("data/rec_www_myauto_ge.log");
+    MatchFromFile("data/rec_www_ndtv_com.log");
+    MatchFromFile("data/rec_www_olx_ro.log");
+    MatchFromFile("data/rec_www_online2pdf_com.log");
+    MatchFromFile("data/rec_www_quora_com.log");
+    MatchFromFile("data/rec_www_reddit_com.log");
+    MatchFromFile("data/rec_www_repubblica_it.log");
+    MatchFromFile("data/rec_www_sapo_pt.log");
+    MatchFromFile("data/rec_www_techradar_com.log");
+    MatchFromFile("data/rec_www_tomsguide_com.log");
+    MatchFromFile("data/rec_www_trustedreviews_com.log");
+    MatchFromFile("data/rec_www_twitch_tv.log");
+    MatchFromFile("data/rec_www_wp_pl.log");
+    MatchFromFile("data/rec_www_xvideos_com.log");
+    MatchFromFile("data/rec_www_youtube_com.log");
+    MatchFromFile("data/rec_yandex_com.log");
+  }
+
   void ReportPerformance()
   {
     std::cout << std::left << std::fixed << std::setprecision(3) << std::setw(20) << "Name"
@@ -310,57 +399,48 @@ protected:
   }
 };
 
+class NativeMatcherHarnessTest : public HarnessTest
+{
+protected:
+  void ConfigureFilterEngine(
+      AdblockPlus::FilterEngineFactory::CreationParameters& engineParams) override
+  {
+    engineParams.nativeMatcherEnabled = true;
+  }
+};
+
 TEST_F(HarnessTest, AllSites)
 {
-  MatchFromFile("data/rec_abudhabi_dubizzle_com.log");
-  MatchFromFile("data/rec_allegro_pl.log");
-  MatchFromFile("data/rec_chron_com.log");
-  MatchFromFile("data/rec_cn_hao123_com.log");
-  MatchFromFile("data/rec_en_wikipedia_org.log");
-  MatchFromFile("data/rec_laodong_vn.log");
-  MatchFromFile("data/rec_news_mail_ru.log");
-  MatchFromFile("data/rec_search_yahoo_com.log");
-  MatchFromFile("data/rec_shopee_vn.log");
-  MatchFromFile("data/rec_shortorial_com.log");
-  MatchFromFile("data/rec_thethao247_vn.log");
-  MatchFromFile("data/rec_vk_com.log");
-  MatchFromFile("data/rec_vnexpress_net.log");
-  MatchFromFile("data/rec_vtv_vn.log");
-  MatchFromFile("data/rec_web_de.log");
-  MatchFromFile("data/rec_www_1tv_ge.log");
-  MatchFromFile("data/rec_www_24h_com_vn.log");
-  MatchFromFile("data/rec_www_amazon_com.log");
-  MatchFromFile("data/rec_www_aparat_com.log");
-  MatchFromFile("data/rec_www_baidu_com.log");
-  MatchFromFile("data/rec_www_bbc_com.log");
-  MatchFromFile("data/rec_www_bedienungsanleitu_ng.log");
-  MatchFromFile("data/rec_www_bing_com.log");
-  MatchFromFile("data/rec_www_boston_com.log");
-  MatchFromFile("data/rec_www_dailymail_co_uk.log");
-  MatchFromFile("data/rec_www_ebay_com.log");
-  MatchFromFile("data/rec_www_flipkart_com.log");
-  MatchFromFile("data/rec_www_forbes_com.log");
-  MatchFromFile("data/rec_www_google_com.log");
-  MatchFromFile("data/rec_www_imdb_com.log");
-  MatchFromFile("data/rec_www_indiatimes_com.log");
-  MatchFromFile("data/rec_www_libero_it.log");
-  MatchFromFile("data/rec_www_manoramaonline_com.log");
-  MatchFromFile("data/rec_www_myauto_ge.log");
-  MatchFromFile("data/rec_www_ndtv_com.log");
-  MatchFromFile("data/rec_www_olx_ro.log");
-  MatchFromFile("data/rec_www_online2pdf_com.log");
-  MatchFromFile("data/rec_www_quora_com.log");
-  MatchFromFile("data/rec_www_reddit_com.log");
-  MatchFromFile("data/rec_www_repubblica_it.log");
-  MatchFromFile("data/rec_www_sapo_pt.log");
-  MatchFromFile("data/rec_www_techradar_com.log");
-  MatchFromFile("data/rec_www_tomsguide_com.log");
-  MatchFromFile("data/rec_www_trustedreviews_com.log");
-  MatchFromFile("data/rec_www_twitch_tv.log");
-  MatchFromFile("data/rec_www_wp_pl.log");
-  MatchFromFile("data/rec_www_xvideos_com.log");
-  MatchFromFile("data/rec_www_youtube_com.log");
-  MatchFromFile("data/rec_yandex_com.log");
+  MatchAllSites();
+  ReportPerformance();
+}
+
+// The recorded decisions must not change when requests which can't match are
+// skipped natively.
+TEST_F(NativeMatcherHarnessTest, AllSites)
+{
+  MatchAllSites();
+  ReportPerformance();
+}
 
+// Loading data/patterns.ini dominates the first start, compare how long it
+// takes depending on how many lines are passed to JavaScript per call.
+TEST_F(HarnessTest, Startup)
+{
+  GetFilterEngine();
+  for (size_t lineChunkSize : {1, 10, 100, 1000})
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      platform.reset();
+      AdblockPlus::PlatformFactory::CreationParameters params;
+      params.jsLineChunkSize = lineChunkSize;
+      ElapsedTime timer;
+      StartFilterEngine(std::move(params));
+      GetFilterEngine();
+      stats["startup-lines-" + std::to_string(lineChunkSize)].Add(timer.Microseconds());
+    }
+    EXPECT_FALSE(GetFilterEngine().GetListedSubscriptions().empty());
+  }
   ReportPerformance();
 }
@@ -15,8 +15,14 @@
  * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <future>
 #include <stdexcept>
+#include <thread>
 
+#include "../src/JsContext.h"
+#include "../src/JsSnapshot.h"
+#include "../src/ScriptCodeCache.h"
+#include "../src/Utils.h"
 #include "BaseJsTest.h"
 
 using namespace AdblockPlus;
@@ -24,6 +30,41 @@ using namespace AdblockPlus;
 namespace
 {
   typedef BaseJsTest JsEngineTest;
+
+  class ScriptCodeCacheTest : public BaseJsTest
+  {
+  protected:
+    InMemoryFileSystem fileSystem;
+
+    int Evaluate(ScriptCodeCache& cache, const std::string& source)
+    {
+      bool loaded = false;
+      cache.Load({"test.js"}, [&loaded] { loaded = true; });
+      EXPECT_TRUE(loaded);
+
+      auto& jsEngine = GetJsEngine();
+      const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+      auto v8Context = jsEngine.GetIsolate()->GetCurrentContext();
+      auto script = cache.Compile(jsEngine.GetIsolate(), source, "test.js").ToLocalChecked();
+      auto result = script->Run(v8Context).ToLocalChecked();
+      cache.Update("test.js", script);
+      return result->Int32Value(v8Context).FromJust();
+    }
+  };
+
+  class JsEngineWithEventLoopTest : public BaseJsTest
+  {
+  protected:
+    DelayedTimer::SharedTasks timerTasks;
+
+    void SetUp() override
+    {
+      ThrowingPlatformCreationParameters platformParams;
+      platformParams.timer = DelayedTimer::New(timerTasks);
+      platformParams.useJsEventLoop = true;
+      platform = AdblockPlus::PlatformFactory::CreatePlatform(std::move(platformParams));
+    }
+  };
 }
 
 TEST_F(JsEngineTest, Evaluate)
@@ -205,3 +246,198 @@ TEST_F(JsEngineTest, DISABLED_32bitsOnly_MemoryLeak_NoLeak)
     JsEngine::New(AppInfo(), interfaces);
   }
 }
+
+TEST_F(JsEngineWithEventLoopTest, TimersRunOnEventLoopThread)
+{
+  auto& jsEngine = GetJsEngine();
+  std::promise<std::thread::id> timerThread;
+  jsEngine.SetEventCallback("timer", [&timerThread](JsValueList&&) {
+    timerThread.set_value(std::this_thread::get_id());
+  });
+  jsEngine.Evaluate("setTimeout(function() { _triggerEvent('timer'); }, 0)");
+  ASSERT_EQ(1u, timerTasks->size());
+
+  timerTasks->front().callback();
+  auto timerThreadId = timerThread.get_future().get();
+  EXPECT_NE(std::this_thread::get_id(), timerThreadId);
+
+  std::thread::id interactiveThreadId;
+  jsEngine.RunInteractive([&interactiveThreadId] {
+    interactiveThreadId = std::this_thread::get_id();
+  });
+  EXPECT_EQ(timerThreadId, interactiveThreadId);
+}
+
+TEST_F(JsEngineWithEventLoopTest, InteractiveTasksGoFirst)
+{
+  auto& jsEngine = GetJsEngine();
+  std::promise<void> unblock;
+  std::promise<void> done;
+  std::vector<std::string> order;
+  auto blocker = unblock.get_future().share();
+  jsEngine.Post(JsEventLoop::Priority::BACKGROUND, [blocker] {
+    blocker.wait();
+  });
+  jsEngine.Post(JsEventLoop::Priority::BACKGROUND, [&order, &done] {
+    order.push_back("background");
+    done.set_value();
+  });
+  jsEngine.Post(JsEventLoop::Priority::INTERACTIVE, [&order] {
+    order.push_back("interactive");
+  });
+  unblock.set_value();
+  done.get_future().wait();
+
+  ASSERT_EQ(2u, order.size());
+  EXPECT_EQ("interactive", order[0]);
+  EXPECT_EQ("background", order[1]);
+}
+
+TEST_F(JsEngineWithEventLoopTest, RunInteractiveRethrows)
+{
+  auto& jsEngine = GetJsEngine();
+  auto evaluateError = [&jsEngine] {
+    jsEngine.Evaluate("doesnotexist()");
+  };
+  ASSERT_THROW(jsEngine.RunInteractive(evaluateError), std::runtime_error);
+  EXPECT_EQ(2, jsEngine.Evaluate("1 + 1").AsInt());
+}
+
+TEST_F(JsEngineWithEventLoopTest, RunInteractiveReturnsValue)
+{
+  auto& jsEngine = GetJsEngine();
+  EXPECT_EQ(42, jsEngine.RunInteractive([&jsEngine] {
+    return jsEngine.Evaluate("6 * 7").AsInt();
+  }));
+}
+
+TEST_F(JsEngineTest, SnapshotContainsEvaluatedScripts)
+{
+  // Initializes V8.
+  auto& jsEngine = GetJsEngine();
+  EXPECT_FALSE(jsEngine.IsEvaluatedInSnapshot("init.js"));
+
+  const std::string snapshot = JsSnapshot::Create(
+      {{"first.js", "var answer = 6;"}, {"second.js", "answer *= 7;"}});
+  ASSERT_FALSE(snapshot.empty());
+
+  v8::StartupData blob = {snapshot.data(), static_cast<int>(snapshot.size())};
+  std::unique_ptr<v8::ArrayBuffer::Allocator> allocator(
+      v8::ArrayBuffer::Allocator::NewDefaultAllocator());
+  v8::Isolate::CreateParams params;
+  params.array_buffer_allocator = allocator.get();
+  params.snapshot_blob = &blob;
+  v8::Isolate* isolate = v8::Isolate::New(params);
+  {
+    const v8::Locker locker(isolate);
+    const v8::Isolate::Scope isolateScope(isolate);
+    const v8::HandleScope handleScope(isolate);
+    auto context = v8::Context::New(isolate);
+    const v8::Context::Scope contextScope(context);
+    auto name = Utils::ToV8String(isolate, "answer").ToLocalChecked();
+    auto answer = context->Global()->Get(context, name).ToLocalChecked();
+    EXPECT_EQ(42, answer->Int32Value(context).FromJust());
+  }
+  isolate->Dispose();
+}
+
+TEST_F(JsEngineTest, SnapshotCreationReportsScriptErrors)
+{
+  GetJsEngine();
+  ASSERT_THROW(JsSnapshot::Create({{"broken.js", "doesnotexist()"}}), std::runtime_error);
+}
+
+TEST_F(ScriptCodeCacheTest, CompilesFromCacheEntry)
+{
+  const std::string source = "(function(a, b) { return a * b; })(6, 7)";
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(42, Evaluate(cache, source));
+    EXPECT_EQ(0u, cache.GetStats().hits);
+    EXPECT_EQ(1u, cache.GetStats().misses);
+  }
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(42, Evaluate(cache, source));
+    EXPECT_EQ(1u, cache.GetStats().hits);
+    EXPECT_EQ(0u, cache.GetStats().misses);
+  }
+}
+
+TEST_F(ScriptCodeCacheTest, ReplacesEntryOfChangedSource)
+{
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(42, Evaluate(cache, "6 * 7"));
+  }
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(43, Evaluate(cache, "6 * 7 + 1"));
+    EXPECT_EQ(0u, cache.GetStats().hits);
+    EXPECT_EQ(1u, cache.GetStats().misses);
+  }
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(43, Evaluate(cache, "6 * 7 + 1"));
+    EXPECT_EQ(1u, cache.GetStats().hits);
+  }
+}
+
+TEST_F(JsEngineTest, CodeCacheIsOnlyUsedForListedScripts)
+{
+  InMemoryFileSystem* fileSystem;
+  ThrowingPlatformCreationParameters platformParams;
+  platformParams.fileSystem.reset(fileSystem = new InMemoryFileSystem());
+  platform = AdblockPlus::PlatformFactory::CreatePlatform(std::move(platformParams));
+  auto& jsEngine = GetJsEngine();
+  bool loaded = false;
+  jsEngine.UseCodeCache({"listed.js"}, [&loaded] { loaded = true; });
+  ASSERT_TRUE(loaded);
+
+  // Scripts evaluated by the embedder aren't cached.
+  EXPECT_EQ(42, jsEngine.Evaluate("6 * 7", "listed.js").AsInt());
+  EXPECT_EQ(42, jsEngine.Evaluate("6 * 7", "embedder.js").AsInt());
+  auto exists = [fileSystem](const std::string& fileName) {
+    bool result = false;
+    fileSystem->Stat(fileName, [&result](const IFileSystem::StatResult& stat, const std::string&) {
+      result = stat.exists;
+    });
+    return result;
+  };
+  EXPECT_TRUE(exists(ScriptCodeCache::GetCacheFileName("listed.js")));
+  EXPECT_FALSE(exists(ScriptCodeCache::GetCacheFileName("embedder.js")));
+  EXPECT_EQ(1u, jsEngine.GetCodeCacheStats().misses);
+}
+
+TEST_F(ScriptCodeCacheTest, ReplacesDamagedEntry)
+{
+  const std::string source = "6 * 7";
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(42, Evaluate(cache, source));
+  }
+
+  // Keep the key but damage the data.
+  const auto cacheFileName = ScriptCodeCache::GetCacheFileName("test.js");
+  IFileSystem::IOBuffer entry;
+  fileSystem.Read(
+      cacheFileName,
+      [&entry](IFileSystem::IOBuffer&& data) { entry = std::move(data); },
+      [](const std::string& error) { FAIL() << error; });
+  ASSERT_FALSE(entry.empty());
+  for (auto it = std::find(entry.begin(), entry.end(), '\n') + 1; it != entry.end(); ++it)
+    *it = ~*it;
+  fileSystem.Write(cacheFileName, entry, [](const std::string&) {});
+
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(42, Evaluate(cache, source));
+    EXPECT_EQ(0u, cache.GetStats().hits);
+    EXPECT_EQ(1u, cache.GetStats().misses);
+  }
+  {
+    ScriptCodeCache cache(fileSystem);
+    EXPECT_EQ(42, Evaluate(cache, source));
+    EXPECT_EQ(1u, cache.GetStats().hits);
+  }
+}
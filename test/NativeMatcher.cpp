@@ -0,0 +1,668 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../src/NativeMatcher.h"
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <AdblockPlus/IFilterEngine.h>
+
+#include "../src/JsContext.h"
+#include "../src/WarmStartImage.h"
+#include "FilterEngineTest.h"
+
+using namespace AdblockPlus;
+
+namespace
+{
+  const uint32_t ANY_TYPE = 0xFFFFFFFF & ~(IFilterEngine::CONTENT_TYPE_DOCUMENT |
+                                          IFilterEngine::CONTENT_TYPE_GENERICBLOCK |
+                                          IFilterEngine::CONTENT_TYPE_ELEMHIDE |
+                                          IFilterEngine::CONTENT_TYPE_GENERICHIDE);
+
+  NativeMatcher::UrlFilter UrlFilter(const std::string& pattern, uint32_t contentType = ANY_TYPE)
+  {
+    NativeMatcher::UrlFilter filter;
+    filter.text = pattern;
+    filter.pattern = pattern;
+    filter.contentType = contentType;
+    return filter;
+  }
+
+  bool MayMatch(const NativeMatcher::UrlFilter& filter,
+                const std::string& url,
+                uint32_t contentTypeMask = IFilterEngine::CONTENT_TYPE_IMAGE,
+                const std::string& documentHost = "example.com",
+                const std::string& siteKey = "")
+  {
+    NativeMatcher matcher;
+    matcher.Add(filter);
+    return matcher.MayMatch(url, contentTypeMask, documentHost, siteKey);
+  }
+
+  bool MayMatch(const std::string& pattern, const std::string& url)
+  {
+    return MayMatch(UrlFilter(pattern), url);
+  }
+}
+
+TEST(NativeMatcherTest, EmptyMatcher)
+{
+  NativeMatcher matcher;
+  EXPECT_EQ(0u, matcher.GetFilterCount());
+  EXPECT_FALSE(matcher.MayMatch("http://example.org/ad.gif", ANY_TYPE, "example.com", ""));
+}
+
+TEST(NativeMatcherTest, Patterns)
+{
+  EXPECT_TRUE(MayMatch("adbanner", "http://example.org/adbanner.gif"));
+  EXPECT_TRUE(MayMatch("ADBANNER", "http://example.org/AdBanner.gif"));
+  EXPECT_FALSE(MayMatch("adbanner", "http://example.org/banner.gif"));
+  EXPECT_TRUE(MayMatch("", "http://example.org/"));
+
+  EXPECT_TRUE(MayMatch("/ad*.gif", "http://example.org/adbanner.gif"));
+  EXPECT_TRUE(MayMatch("/ad*.gif", "http://example.org/ad.gif"));
+  EXPECT_FALSE(MayMatch("/ad*.gif", "http://example.org/ad.png"));
+  EXPECT_FALSE(MayMatch("/ad*.gif", "http://example.org/.gif/ad"));
+}
+
+TEST(NativeMatcherTest, Anchors)
+{
+  EXPECT_TRUE(MayMatch("|http://example.org/", "http://example.org/ad.gif"));
+  EXPECT_FALSE(MayMatch("|http://example.org/", "https://example.org/ad.gif"));
+  EXPECT_TRUE(MayMatch(".gif|", "http://example.org/ad.gif"));
+  EXPECT_FALSE(MayMatch(".gif|", "http://example.org/ad.gif?x"));
+  EXPECT_TRUE(MayMatch("|http://example.org/ad.gif|", "http://example.org/ad.gif"));
+  EXPECT_FALSE(MayMatch("|http://example.org/ad.gif|", "http://example.org/ad.gif?"));
+
+  EXPECT_TRUE(MayMatch("||example.org/ad", "http://example.org/ad.gif"));
+  EXPECT_TRUE(MayMatch("||example.org/ad", "https://ads.example.org/ad.gif"));
+  EXPECT_FALSE(MayMatch("||example.org/ad", "http://badexample.org/ad.gif"));
+
+  // Anchors next to wildcards don't anchor anything.
+  EXPECT_TRUE(MayMatch("|*.gif", "http://example.org/ad.gif"));
+  EXPECT_TRUE(MayMatch("/ad*|", "http://example.org/ad.gif"));
+}
+
+TEST(NativeMatcherTest, Separators)
+{
+  EXPECT_TRUE(MayMatch("example.org^", "http://example.org/ad.gif"));
+  EXPECT_TRUE(MayMatch("example.org^", "http://example.org:8080/"));
+  EXPECT_TRUE(MayMatch("example.org^", "http://example.org"));
+  EXPECT_FALSE(MayMatch("example.org^", "http://example.org.uk/"));
+  EXPECT_FALSE(MayMatch("example.org^", "http://example.organic/"));
+  EXPECT_TRUE(MayMatch("||example.org^", "http://example.org/"));
+  EXPECT_TRUE(MayMatch("^ad^", "http://example.org/ad/banner.gif"));
+  EXPECT_FALSE(MayMatch("^ad^", "http://example.org/adbanner.gif"));
+}
+
+TEST(NativeMatcherTest, IndexedFilters)
+{
+  NativeMatcher matcher;
+  matcher.Add(UrlFilter("/adbanner."));
+  matcher.Add(UrlFilter("||ads.example.org^"));
+  matcher.Add(UrlFilter("&ad_type="));
+  matcher.Add(UrlFilter("/tracker/*"));
+  EXPECT_EQ(4u, matcher.GetFilterCount());
+
+  const auto type = IFilterEngine::CONTENT_TYPE_IMAGE;
+  EXPECT_TRUE(matcher.MayMatch("http://example.org/adbanner.gif", type, "", ""));
+  EXPECT_TRUE(matcher.MayMatch("http://ads.example.org/banner.gif", type, "", ""));
+  EXPECT_TRUE(matcher.MayMatch("http://example.org/?x=1&ad_type=2", type, "", ""));
+  EXPECT_TRUE(matcher.MayMatch("http://example.org/tracker/pixel.gif", type, "", ""));
+  EXPECT_FALSE(matcher.MayMatch("http://example.org/banner.gif", type, "", ""));
+  EXPECT_FALSE(matcher.MayMatch("http://example.org/adbanners/", type, "", ""));
+  EXPECT_FALSE(matcher.MayMatch("http://example.org/trackers/", type, "", ""));
+}
+
+TEST(NativeMatcherTest, RemoveFilters)
+{
+  NativeMatcher matcher;
+  auto domainFilter = UrlFilter("/tracker/*");
+  domainFilter.text = "/tracker/*$domain=example.com";
+  domainFilter.domains = {{"", false}, {"example.com", true}};
+  matcher.Add(UrlFilter("/adbanner."));
+  matcher.Add(UrlFilter("/adbanner."));
+  matcher.Add(UrlFilter("/banners/"));
+  matcher.Add(UrlFilter("*.gif"));
+  matcher.Add(domainFilter);
+  EXPECT_EQ(4u, matcher.GetFilterCount());
+
+  // Copies are independent of the original.
+  NativeMatcher copy(matcher);
+  copy.Remove("/adbanner.");
+  copy.Remove("*.gif");
+  copy.Remove("unknown");
+  EXPECT_EQ(2u, copy.GetFilterCount());
+  EXPECT_EQ(4u, matcher.GetFilterCount());
+
+  const auto type = IFilterEngine::CONTENT_TYPE_IMAGE;
+  EXPECT_TRUE(matcher.MayMatch("http://example.org/adbanner.png", type, "", ""));
+  EXPECT_FALSE(copy.MayMatch("http://example.org/adbanner.png", type, "", ""));
+  EXPECT_TRUE(copy.MayMatch("http://example.org/banners/1.png", type, "", ""));
+  EXPECT_TRUE(matcher.MayMatch("http://example.org/x.gif", type, "", ""));
+  EXPECT_FALSE(copy.MayMatch("http://example.org/x.gif", type, "", ""));
+  EXPECT_TRUE(copy.MayMatch("http://example.org/tracker/x", type, "example.com", ""));
+
+  copy.Remove("/banners/");
+  copy.Remove("/tracker/*$domain=example.com");
+  EXPECT_EQ(0u, copy.GetFilterCount());
+  EXPECT_FALSE(copy.MayMatch("http://example.org/banners/1.png", type, "", ""));
+  EXPECT_FALSE(copy.MayMatch("http://example.org/tracker/x", type, "example.com", ""));
+  EXPECT_TRUE(matcher.MayMatch("http://example.org/tracker/x", type, "example.com", ""));
+
+  // Removed filters can be added again.
+  copy.Add(UrlFilter("/adbanner."));
+  EXPECT_TRUE(copy.MayMatch("http://example.org/adbanner.png", type, "", ""));
+}
+
+TEST(NativeMatcherTest, ContentType)
+{
+  auto filter = UrlFilter("adbanner", IFilterEngine::CONTENT_TYPE_IMAGE);
+  const std::string url = "http://example.org/adbanner.gif";
+  EXPECT_TRUE(MayMatch(filter, url, IFilterEngine::CONTENT_TYPE_IMAGE));
+  EXPECT_TRUE(MayMatch(
+      filter, url, IFilterEngine::CONTENT_TYPE_IMAGE | IFilterEngine::CONTENT_TYPE_SCRIPT));
+  EXPECT_FALSE(MayMatch(filter, url, IFilterEngine::CONTENT_TYPE_SCRIPT));
+}
+
+TEST(NativeMatcherTest, Domains)
+{
+  const std::string url = "http://example.org/adbanner.gif";
+  const auto type = IFilterEngine::CONTENT_TYPE_IMAGE;
+
+  // adbanner$domain=example.com|~foo.example.com
+  auto filter = UrlFilter("adbanner");
+  filter.domains = {{"", false}, {"example.com", true}, {"foo.example.com", false}};
+  EXPECT_TRUE(MayMatch(filter, url, type, "example.com"));
+  EXPECT_TRUE(MayMatch(filter, url, type, "www.Example.com."));
+  EXPECT_FALSE(MayMatch(filter, url, type, "foo.example.com"));
+  EXPECT_FALSE(MayMatch(filter, url, type, "bar.foo.example.com"));
+  EXPECT_FALSE(MayMatch(filter, url, type, "example.net"));
+  EXPECT_FALSE(MayMatch(filter, url, type, ""));
+
+  // adbanner$domain=~example.com
+  filter.domains = {{"", true}, {"example.com", false}};
+  EXPECT_FALSE(MayMatch(filter, url, type, "example.com"));
+  EXPECT_TRUE(MayMatch(filter, url, type, "example.net"));
+  EXPECT_TRUE(MayMatch(filter, url, type, ""));
+
+  // adbanner$domain=.example.com, JavaScript never applies it, but that's
+  // left to JavaScript.
+  filter.domains = {{"", false}, {".example.com", true}};
+  EXPECT_TRUE(MayMatch(filter, url, type, "example.com"));
+  EXPECT_FALSE(MayMatch(filter, url, type, "example.net"));
+  NativeMatcher matcher;
+  filter.text = "adbanner$domain=.example.com";
+  matcher.Add(filter);
+  matcher.Remove(filter.text);
+  EXPECT_EQ(0u, matcher.GetFilterCount());
+  EXPECT_FALSE(matcher.MayMatch(url, type, "example.com", ""));
+
+  // adbanner$domain=~.example.com excludes nothing.
+  filter.domains = {{"", true}, {".example.com", false}};
+  EXPECT_TRUE(MayMatch(filter, url, type, "example.com"));
+
+  // adbanner$domain=...
+  filter.domains = {{"", false}, {"...", true}};
+  EXPECT_FALSE(MayMatch(filter, url, type, "example.com"));
+}
+
+TEST(NativeMatcherTest, Sitekeys)
+{
+  auto filter = UrlFilter("adbanner");
+  filter.hasSitekeys = true;
+  const std::string url = "http://example.org/adbanner.gif";
+  const auto type = IFilterEngine::CONTENT_TYPE_IMAGE;
+  EXPECT_FALSE(MayMatch(filter, url, type, "example.com", ""));
+  // The sitekey itself is checked by JavaScript.
+  EXPECT_TRUE(MayMatch(filter, url, type, "example.com", "somekey"));
+}
+
+TEST(NativeMatcherTest, RegularExpressions)
+{
+  auto filter = UrlFilter("banner\\d+\\.gif");
+  filter.isRegExp = true;
+  EXPECT_TRUE(MayMatch(filter, "http://example.org/BANNER123.gif"));
+  EXPECT_FALSE(MayMatch(filter, "http://example.org/banner.gif"));
+
+  filter.matchCase = true;
+  EXPECT_FALSE(MayMatch(filter, "http://example.org/BANNER123.gif"));
+
+  // Regular expressions which can't be compiled natively are left to
+  // JavaScript.
+  filter.pattern = "(?<=banner)\\d";
+  EXPECT_TRUE(MayMatch(filter, "http://example.org/"));
+}
+
+TEST(NativeMatcherTest, UnknownPatternAndNonAscii)
+{
+  auto filter = UrlFilter("");
+  filter.hasPattern = false;
+  EXPECT_TRUE(MayMatch(filter, "http://example.org/"));
+
+  EXPECT_TRUE(MayMatch("\xC3\xA4", "http://example.org/"));
+  EXPECT_TRUE(MayMatch("adbanner", "http://example.org/\xC3\xA4"));
+}
+
+TEST(DomainTrieTest, ForEachMatch)
+{
+  DomainTrie<int> trie;
+  trie["org"] = 1;
+  trie["example.org"] = 2;
+  trie["www.example.org"] = 3;
+  trie["example.com"] = 4;
+  EXPECT_EQ(4u, trie.Size());
+
+  auto matches = [&trie](const std::string& host) {
+    std::vector<int> result;
+    trie.ForEachMatch(host, [&result](int value) { result.push_back(value); });
+    return result;
+  };
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), matches("www.example.org"));
+  EXPECT_EQ(std::vector<int>({1, 2}), matches("foo.example.org"));
+  EXPECT_EQ(std::vector<int>({1}), matches("org"));
+  EXPECT_EQ(std::vector<int>({4}), matches("a.b.example.com"));
+  EXPECT_TRUE(matches("com").empty());
+  EXPECT_TRUE(matches("example.net").empty());
+  EXPECT_TRUE(matches("").empty());
+  EXPECT_TRUE(matches("www.example.org.evil").empty());
+}
+
+TEST(DomainTrieTest, EmptyLabelsAreSkipped)
+{
+  DomainTrie<int> trie;
+  trie[".example.org"] = 1;
+  trie["www..example.org"] = 2;
+  trie["..com"] = 3;
+  EXPECT_EQ(3u, trie.Size());
+  EXPECT_EQ(1, trie["example.org"]);
+  EXPECT_EQ(2, trie["www.example.org"]);
+  EXPECT_EQ(3u, trie.Size());
+
+  auto matches = [&trie](const std::string& host) {
+    std::vector<int> result;
+    trie.ForEachMatch(host, [&result](int value) { result.push_back(value); });
+    return result;
+  };
+  EXPECT_EQ(std::vector<int>({1, 2}), matches("www.example.org"));
+  EXPECT_EQ(std::vector<int>({1, 2}), matches(".www..example.org"));
+  EXPECT_EQ(std::vector<int>({3}), matches("example.com"));
+  EXPECT_TRUE(matches(".").empty());
+}
+
+namespace
+{
+  class NativeMatcherFilterEngineTest : public FilterEngineWithInMemoryFS
+  {
+  };
+
+  // Lets the files outlive the platform, so that the engine can be restarted.
+  class SharedFileSystem : public IFileSystem
+  {
+  public:
+    explicit SharedFileSystem(const std::shared_ptr<IFileSystem>& files) : files(files)
+    {
+    }
+
+    void Read(const std::string& fileName,
+              const ReadCallback& callback,
+              const Callback& errorCallback) const override
+    {
+      files->Read(fileName, callback, errorCallback);
+    }
+
+    void Write(const std::string& fileName, const IOBuffer& data, const Callback& callback) override
+    {
+      files->Write(fileName, data, callback);
+    }
+
+    void Move(const std::string& fromFileName,
+              const std::string& toFileName,
+              const Callback& callback) override
+    {
+      files->Move(fromFileName, toFileName, callback);
+    }
+
+    void Remove(const std::string& fileName, const Callback& callback) override
+    {
+      files->Remove(fileName, callback);
+    }
+
+    void Stat(const std::string& fileName, const StatCallback& callback) const override
+    {
+      files->Stat(fileName, callback);
+    }
+
+  private:
+    std::shared_ptr<IFileSystem> files;
+  };
+}
+
+// The engine must make the same decisions with and without the native
+// matcher.
+TEST_F(NativeMatcherFilterEngineTest, SameResultsAsJavaScript)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.nativeMatcherEnabled = true;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  for (const auto& text : {"adbanner.gif",
+                           "@@notbanner.gif",
+                           "||tracker.example.org^$third-party",
+                           "/ad*.png$image,domain=example.com|~foo.example.com",
+                           "/banner\\d+\\.js/$script",
+                           "|https://example.org/popup$popup",
+                           "@@||allowed.example.org^$document",
+                           "@@||generic.example.org^$genericblock",
+                           "||example.org/generic-ad.gif$image"})
+    filterEngine.AddFilter(filterEngine.GetFilter(text));
+
+  struct Request
+  {
+    std::string url;
+    IFilterEngine::ContentTypeMask contentTypeMask;
+    std::string documentUrl;
+  };
+  const auto image = IFilterEngine::CONTENT_TYPE_IMAGE;
+  const auto script = IFilterEngine::CONTENT_TYPE_SCRIPT;
+  const Request requests[] = {
+      {"http://example.org/adbanner.gif", image, "http://example.com/"},
+      {"http://example.org/notbanner.gif", image, "http://example.com/"},
+      {"http://example.org/banner.gif", image, "http://example.com/"},
+      {"http://tracker.example.org/pixel", image, "http://example.com/"},
+      {"http://tracker.example.org/pixel", image, "http://tracker.example.org/"},
+      {"http://example.org/adx.png", image, "http://www.example.com/"},
+      {"http://example.org/adx.png", image, "http://foo.example.com/"},
+      {"http://example.org/adx.png", script, "http://example.com/"},
+      {"http://example.org/banner12.js", script, "http://example.com/"},
+      {"http://example.org/banner.js", script, "http://example.com/"},
+      {"https://example.org/popup", IFilterEngine::CONTENT_TYPE_POPUP, "http://example.com/"},
+      {"http://example.org/adbanner.gif", image, "http://allowed.example.org/"},
+      {"http://example.org/generic-ad.gif", image, "http://generic.example.org/"},
+      {"ftp://example.org/adbanner.gif", image, ""},
+      {"not a url", image, ""}};
+
+  // The JavaScript API doesn't go through the native matcher.
+  auto& jsEngine = GetJsEngine();
+  auto checkFilterMatch = jsEngine.Evaluate(R"js((url, mask, documentUrl) => {
+    let filter = API.checkFilterMatch(url, mask, documentUrl, "", false);
+    return filter ? filter.text : "";
+  })js");
+  auto shouldBlockRequest = jsEngine.Evaluate(R"js((url, mask, documentUrl) => {
+    let filter = API.shouldBlockRequest(url, mask, [documentUrl], "");
+    return filter ? filter.text : "";
+  })js");
+  for (const auto& request : requests)
+  {
+    JsValueList params;
+    params.push_back(jsEngine.NewValue(request.url));
+    params.push_back(jsEngine.NewValue(request.contentTypeMask));
+    params.push_back(jsEngine.NewValue(request.documentUrl));
+
+    auto filter = filterEngine.Matches(request.url, request.contentTypeMask, request.documentUrl);
+    EXPECT_EQ(checkFilterMatch.Call(params).AsString(), filter.IsValid() ? filter.GetRaw() : "")
+        << request.url;
+
+    auto decision = filterEngine.ShouldBlockRequest(
+        request.url, request.contentTypeMask, {request.documentUrl});
+    EXPECT_EQ(shouldBlockRequest.Call(params).AsString(),
+              decision.filter.IsValid() ? decision.filter.GetRaw() : "")
+        << request.url;
+  }
+}
+
+TEST_F(NativeMatcherFilterEngineTest, SameElementHidingAsJavaScript)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.nativeMatcherEnabled = true;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  for (const auto& text : {"##.generic",
+                           "example.org##.specific",
+                           "~foo.example.org##.notfoo",
+                           "bar.example.org#@#.generic",
+                           "example.com#?#div:-abp-has(.ad)",
+                           "#?#.emulated"})
+    filterEngine.AddFilter(filterEngine.GetFilter(text));
+
+  auto& jsEngine = GetJsEngine();
+  auto styleSheet = jsEngine.Evaluate(R"js((domain, specificOnly) =>
+    API.getElementHidingStyleSheet(domain, specificOnly))js");
+  auto emulationSelectors = jsEngine.Evaluate(R"js(domain =>
+    API.getElementHidingEmulationSelectors(domain).map(f => f.selector).join("\n"))js");
+  // Domains which no filter mentions come first and last, so that their
+  // result is reused for the others.
+  for (const auto& domain : {"http://unrelated.test/",
+                             "http://example.org/",
+                             "http://WWW.Example.org./",
+                             "https://foo.example.org:8080/",
+                             "bar.example.org",
+                             "http://example.com/",
+                             "example.net",
+                             "",
+                             "http://other.test/"})
+  {
+    for (bool specificOnly : {false, true})
+    {
+      JsValueList params;
+      params.push_back(jsEngine.NewValue(domain));
+      params.push_back(jsEngine.NewValue(specificOnly));
+      EXPECT_EQ(styleSheet.Call(params).AsString(),
+                filterEngine.GetElementHidingStyleSheet(domain, specificOnly))
+          << domain;
+    }
+
+    std::string selectors;
+    for (const auto& selector : filterEngine.GetElementHidingEmulationSelectors(domain))
+      selectors += (selectors.empty() ? "" : "\n") + selector.selector;
+    EXPECT_EQ(emulationSelectors.Call(jsEngine.NewValue(domain)).AsString(), selectors) << domain;
+  }
+
+  // Changed filters are taken into account.
+  filterEngine.AddFilter(filterEngine.GetFilter("other.test##.new"));
+  EXPECT_NE(std::string::npos,
+            filterEngine.GetElementHidingStyleSheet("http://other.test/").find(".new"));
+  EXPECT_EQ(std::string::npos,
+            filterEngine.GetElementHidingStyleSheet("http://unrelated.test/").find(".new"));
+}
+
+TEST_F(NativeMatcherFilterEngineTest, NoMatchWithoutLockingJavaScript)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.nativeMatcherEnabled = true;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  const auto image = IFilterEngine::CONTENT_TYPE_IMAGE;
+  const std::string documentUrl = "http://example.com/";
+  EXPECT_TRUE(
+      filterEngine.Matches("http://example.org/adbanner.gif", image, documentUrl).IsValid());
+
+  std::future<bool> matched;
+  {
+    // Requests which no filter matches must not wait for the engine.
+    auto& jsEngine = GetJsEngine();
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    matched = std::async(std::launch::async, [&]() {
+      const std::string url = "http://example.org/banner.gif";
+      FrameContext frame({documentUrl});
+      return filterEngine.Matches(url, image, documentUrl).IsValid() ||
+             filterEngine.Matches(url, image, frame).IsValid() ||
+             filterEngine.ShouldBlockRequest(url, image, {documentUrl}).filter.IsValid() ||
+             filterEngine.ShouldBlockRequest(url, image, frame).filter.IsValid() ||
+             filterEngine.MatchesBatch({{url, image, documentUrl, "", false}})[0].type !=
+                 Filter::Type::TYPE_INVALID;
+    });
+    ASSERT_EQ(std::future_status::ready, matched.wait_for(std::chrono::seconds(10)));
+  }
+  EXPECT_FALSE(matched.get());
+
+  // The snapshot is replaced when the filters change, readers don't have to
+  // bring it up to date.
+  filterEngine.AddFilter(filterEngine.GetFilter("/banner.gif"));
+  {
+    auto& jsEngine = GetJsEngine();
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    matched = std::async(std::launch::async, [&]() {
+      return filterEngine.Matches("http://example.org/other.gif", image, documentUrl).IsValid();
+    });
+    ASSERT_EQ(std::future_status::ready, matched.wait_for(std::chrono::seconds(10)));
+  }
+  EXPECT_FALSE(matched.get());
+  EXPECT_TRUE(filterEngine.Matches("http://example.org/banner.gif", image, documentUrl).IsValid());
+}
+
+TEST_F(NativeMatcherFilterEngineTest, RepeatedMatchesWithoutLockingJavaScript)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.nativeMatcherEnabled = true;
+  createParams.matchCacheSize = 10;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  const IFilterEngine::MatchRequest request{
+      "http://example.org/adbanner.gif", IFilterEngine::CONTENT_TYPE_IMAGE,
+      "http://example.com/", "", false};
+  EXPECT_EQ("adbanner.gif", filterEngine.MatchesBatch({request})[0].filterText);
+
+  std::future<std::string> matched;
+  {
+    // Found by JavaScript with the same filters before.
+    auto& jsEngine = GetJsEngine();
+    const JsContext context(jsEngine.GetIsolate(), *jsEngine.GetContext());
+    matched = std::async(std::launch::async, [&]() {
+      std::promise<std::string> asyncResult;
+      filterEngine.MatchesAsync(
+          request,
+          [&asyncResult](const IFilterEngine::MatchResult& result) {
+            asyncResult.set_value(result.filterText);
+          },
+          std::chrono::seconds(10),
+          {"", Filter::Type::TYPE_INVALID});
+      return filterEngine.MatchesBatch({request})[0].filterText + " " +
+             asyncResult.get_future().get();
+    });
+    ASSERT_EQ(std::future_status::ready, matched.wait_for(std::chrono::seconds(5)));
+  }
+  EXPECT_EQ("adbanner.gif adbanner.gif", matched.get());
+
+  // The results are dropped together with the snapshot.
+  filterEngine.AddFilter(filterEngine.GetFilter("@@adbanner.gif"));
+  EXPECT_EQ(Filter::Type::TYPE_EXCEPTION, filterEngine.MatchesBatch({request})[0].type);
+}
+
+TEST_F(NativeMatcherFilterEngineTest, FiltersAddedInOneTask)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.nativeMatcherEnabled = true;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  // The native matcher is updated once for all of them.
+  GetJsEngine().Evaluate(R"js(
+    let {filterStorage} = require("filterStorage");
+    let {Filter} = require("filterClasses");
+    for (let text of ["/first.gif", "/second.gif", "/third.gif"])
+      filterStorage.addFilter(Filter.fromText(text));
+  )js");
+  const auto image = IFilterEngine::CONTENT_TYPE_IMAGE;
+  const std::string documentUrl = "http://example.com/";
+  for (const auto& url : {"http://example.org/first.gif",
+                          "http://example.org/second.gif",
+                          "http://example.org/third.gif"})
+    EXPECT_TRUE(filterEngine.Matches(url, image, documentUrl).IsValid()) << url;
+  EXPECT_FALSE(filterEngine.Matches("http://example.org/fourth.gif", image, documentUrl).IsValid());
+}
+
+TEST_F(NativeMatcherFilterEngineTest, AddAndRemoveFilters)
+{
+  InitPlatformAndAppInfo();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.nativeMatcherEnabled = true;
+  auto& filterEngine = CreateFilterEngine(createParams);
+  const auto image = IFilterEngine::CONTENT_TYPE_IMAGE;
+  const std::string documentUrl = "http://example.com/";
+  const std::string url = "http://example.org/adbanner.gif";
+  EXPECT_FALSE(filterEngine.Matches(url, image, documentUrl).IsValid());
+
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  filterEngine.AddFilter(filterEngine.GetFilter("/other.gif"));
+  EXPECT_TRUE(filterEngine.Matches(url, image, documentUrl).IsValid());
+
+  filterEngine.RemoveFilter(filterEngine.GetFilter("adbanner.gif"));
+  EXPECT_FALSE(filterEngine.Matches(url, image, documentUrl).IsValid());
+  EXPECT_TRUE(
+      filterEngine.Matches("http://example.org/other.gif", image, documentUrl).IsValid());
+
+  filterEngine.AddFilter(filterEngine.GetFilter("adbanner.gif"));
+  EXPECT_TRUE(filterEngine.Matches(url, image, documentUrl).IsValid());
+}
+
+// The warm start image must not stand in for filters which have been added
+// to the journal of patterns.ini after the image has been saved.
+TEST_F(NativeMatcherFilterEngineTest, WarmStartKeepsFiltersFromJournal)
+{
+  auto files = std::make_shared<InMemoryFileSystem>();
+  FilterEngineFactory::CreationParameters createParams;
+  createParams.nativeMatcherEnabled = true;
+  createParams.warmStartImageEnabled = true;
+  auto restart = [&]() -> IFilterEngine& {
+    platform.reset();
+    PlatformFactory::CreationParameters params;
+    params.fileSystem.reset(new SharedFileSystem(files));
+    InitPlatformAndAppInfo(std::move(params));
+    return CreateFilterEngine(createParams);
+  };
+  auto save = [this]() {
+    GetJsEngine().Evaluate("var saved = false;"
+                           "require('filterStorage').filterStorage.saveToDisk()"
+                           "  .then(() => saved = true);");
+    ASSERT_TRUE(GetJsEngine().Evaluate("saved").AsBool());
+  };
+  auto exists = [&files](const std::string& fileName) {
+    bool result = false;
+    files->Stat(fileName, [&result](const IFileSystem::StatResult& stat, const std::string&) {
+      result = stat.exists;
+    });
+    return result;
+  };
+
+  const std::string documentUrl = "http://example.com/";
+  const std::string firstUrl = "http://example.org/first.gif";
+  const std::string secondUrl = "http://example.org/second.gif";
+  const auto image = IFilterEngine::CONTENT_TYPE_IMAGE;
+
+  IFilterEngine* filterEngine = &restart();
+  filterEngine->AddFilter(filterEngine->GetFilter("/first.gif"));
+  save();
+
+  // Saves the image for the filters in patterns.ini.
+  filterEngine = &restart();
+  EXPECT_TRUE(filterEngine->Matches(firstUrl, image, documentUrl).IsValid());
+  EXPECT_TRUE(exists(WarmStartImage::fileName));
+  filterEngine->AddFilter(filterEngine->GetFilter("/second.gif"));
+  save();
+  EXPECT_TRUE(exists("patterns.ini.journal"));
+
+  filterEngine = &restart();
+  EXPECT_TRUE(filterEngine->Matches(firstUrl, image, documentUrl).IsValid());
+  EXPECT_TRUE(filterEngine->Matches(secondUrl, image, documentUrl).IsValid());
+}
@@ -0,0 +1,130 @@
+/*
+ * This file is part of Adblock Plus <https://adblockplus.org/>,
+ * Copyright (C) 2006-present eyeo GmbH
+ *
+ * Adblock Plus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * Adblock Plus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Adblock Plus.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../src/WarmStartImage.h"
+
+#include <gtest/gtest.h>
+
+using namespace AdblockPlus;
+
+namespace
+{
+  std::string GetKey(const std::string& patterns, const std::string& journal = "")
+  {
+    WarmStartImage::KeyBuilder keyBuilder;
+    keyBuilder.AddPatterns(reinterpret_cast<const uint8_t*>(patterns.data()), patterns.size());
+    keyBuilder.AddJournal(reinterpret_cast<const uint8_t*>(journal.data()), journal.size());
+    return keyBuilder.GetKey();
+  }
+
+  WarmStartImage CreateImage()
+  {
+    WarmStartImage image;
+    NativeMatcher::UrlFilter filter;
+    filter.text = "||example.com^$script,domain=foo.com|~bar.foo.com";
+    filter.pattern = "||example.com^";
+    filter.contentType = 2;
+    filter.domains = {{"", false}, {"foo.com", true}, {"bar.foo.com", false}};
+    image.urlFilters.push_back(filter);
+    NativeMatcher::UrlFilter regExpFilter;
+    regExpFilter.text = "/ad[sv]/$match-case";
+    regExpFilter.pattern = "ad[sv]";
+    regExpFilter.isRegExp = true;
+    regExpFilter.matchCase = true;
+    regExpFilter.hasSitekeys = true;
+    image.urlFilters.push_back(regExpFilter);
+    NativeMatcher::UrlFilter optionsOnlyFilter;
+    optionsOnlyFilter.text = "$websocket";
+    optionsOnlyFilter.hasPattern = false;
+    image.urlFilters.push_back(optionsOnlyFilter);
+    image.elementHidingDomains = {"example.com", "foo.com"};
+    return image;
+  }
+}
+
+TEST(WarmStartImageTest, KeyDependsOnPatterns)
+{
+  auto key = GetKey("[Subscription]\nurl=~user~0000\n");
+  EXPECT_EQ(key, GetKey("[Subscription]\nurl=~user~0000\n"));
+  EXPECT_NE(key, GetKey("[Subscription]\nurl=~user~0001\n"));
+}
+
+TEST(WarmStartImageTest, KeyDependsOnJournal)
+{
+  const std::string patterns = "[Subscription]\nurl=~user~0000\n";
+  auto key = GetKey(patterns);
+  EXPECT_NE(key, GetKey(patterns, "ABPJRNL"));
+  // The same content split differently between the files is different.
+  EXPECT_NE(key, GetKey("[Subscription]\n", "url=~user~0000\n"));
+}
+
+TEST(WarmStartImageTest, KeyDoesNotDependOnChunks)
+{
+  WarmStartImage::KeyBuilder keyBuilder;
+  for (char c : std::string("[Subscription]\nurl=~user~0000\n"))
+    keyBuilder.AddPatterns(reinterpret_cast<const uint8_t*>(&c), 1);
+  keyBuilder.AddJournal(nullptr, 0);
+  EXPECT_EQ(GetKey("[Subscription]\nurl=~user~0000\n"), keyBuilder.GetKey());
+}
+
+TEST(WarmStartImageTest, RestoresSerializedImage)
+{
+  auto data = CreateImage().Serialize("key");
+  WarmStartImage image;
+  ASSERT_TRUE(image.Deserialize(data, "key"));
+
+  auto expected = CreateImage();
+  ASSERT_EQ(expected.urlFilters.size(), image.urlFilters.size());
+  for (size_t i = 0; i < expected.urlFilters.size(); ++i)
+  {
+    const auto& expectedFilter = expected.urlFilters[i];
+    const auto& filter = image.urlFilters[i];
+    EXPECT_EQ(expectedFilter.text, filter.text);
+    EXPECT_EQ(expectedFilter.pattern, filter.pattern);
+    EXPECT_EQ(expectedFilter.isRegExp, filter.isRegExp);
+    EXPECT_EQ(expectedFilter.hasPattern, filter.hasPattern);
+    EXPECT_EQ(expectedFilter.contentType, filter.contentType);
+    EXPECT_EQ(expectedFilter.matchCase, filter.matchCase);
+    EXPECT_EQ(expectedFilter.hasSitekeys, filter.hasSitekeys);
+    EXPECT_EQ(expectedFilter.domains, filter.domains);
+  }
+  EXPECT_EQ(expected.elementHidingDomains, image.elementHidingDomains);
+}
+
+TEST(WarmStartImageTest, RejectsImageOfOtherFilters)
+{
+  auto data = CreateImage().Serialize("key");
+  WarmStartImage image;
+  EXPECT_FALSE(image.Deserialize(data, "other key"));
+  EXPECT_TRUE(image.urlFilters.empty());
+}
+
+TEST(WarmStartImageTest, RejectsDamagedImage)
+{
+  auto data = CreateImage().Serialize("key");
+  WarmStartImage image;
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    auto damaged = data;
+    damaged[i] ^= 0x20;
+    EXPECT_FALSE(image.Deserialize(damaged, "key")) << "at " << i;
+  }
+  data.pop_back();
+  EXPECT_FALSE(image.Deserialize(data, "key"));
+  EXPECT_FALSE(image.Deserialize(IFileSystem::IOBuffer(), "key"));
+  EXPECT_TRUE(image.urlFilters.empty());
+}
@@ -15,18 +15,24 @@
       'test/BaseJsTest.h',
       'test/BaseJsTest.cpp',
       'test/AppInfoJsObject.cpp',
+      'test/AsciiScanner.cpp',
       'test/ConsoleJsObject.cpp',
       'test/DefaultFileSystem.cpp',
       'test/FileSystemJsObject.cpp',
       'test/FilterEngineTest.h',
       'test/FilterEngine.cpp',
+      'test/FilterStorageFile.cpp',
+      'test/FilterStorageJournal.cpp',
       'test/GlobalJsObject.cpp',
       'test/HarnessTest.cpp',
       'test/JsEngine.cpp',
       'test/JsValue.cpp',
+      'test/NativeMatcher.cpp',
       'test/PreloadedSubscriptions.cpp',
       'test/ReferrerMapping.cpp',
+      'test/UrlParser.cpp',
       'test/Utils.cpp',
+      'test/WarmStartImage.cpp',
       'test/WebRequest.cpp'
     ],
     'msvs_settings': {